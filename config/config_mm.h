@@ -11,6 +11,7 @@
 /* ------ Value-based config variables -------- */
 
 #define USER_STACK_PAGES       @USER_STACK_PAGES@
+#define FAULT_AROUND_PAGES     @FAULT_AROUND_PAGES@
 
 /* --------- Boolean config variables --------- */
 
@@ -37,12 +38,17 @@
 #define HI_VMEM_SIZE             (128ul * MB)
 
 #define USER_VDSO_VADDR       (HI_VMEM_START)
+#define USER_VDSO_DATA_VADDR  (USER_VDSO_VADDR + 4096) /* vDSO + 1 page */
 
 #define USERMODE_VADDR_END          (BASE_VA) /* biggest user vaddr + 1 */
 #define MAX_BRK                  (0x40000000) /* +1 GB (virtual memory) */
 #define USER_MMAP_BEGIN               MAX_BRK /* +1 GB (virtual memory) */
-#define USER_MMAP_MIN_SZ            (16 * MB)
-#define USER_MMAP_MAX_SZ          (1024 * MB)
+#define USER_STACK_AREA_SZ          (64 * MB) /* below USERMODE_VADDR_END */
+#define USER_STACK_GUARD_GAP         (1 * MB) /* never mapped, above mmaps */
+#define USER_STACK_MAX_SZ \
+   (USER_STACK_AREA_SZ - USER_STACK_GUARD_GAP)
+#define USER_MMAP_END \
+   (USERMODE_VADDR_END - USER_STACK_AREA_SZ)
 #define USERMODE_STACK_ALIGN              16u
 
 #define USERMODE_STACK_MAX \
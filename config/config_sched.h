@@ -13,6 +13,7 @@
 /* --------- Boolean config variables --------- */
 #cmakedefine01 KRN_RESCHED_ENABLE_PREEMPT
 #cmakedefine01 KRN_MINIMAL_TIME_SLICE
+#cmakedefine01 KRN_NO_HZ_IDLE
 
 /*
  * --------------------------------------------------------------------------
@@ -9,6 +9,7 @@
 
 /* ------ Value-based config variables -------- */
 #define MAX_HANDLES            @MAX_HANDLES@
+#define PIPE_MAX_SIZE_KB       @PIPE_MAX_SIZE_KB@
 
 /* --------- Boolean config variables --------- */
 #cmakedefine01 KERNEL_BIG_IO_BUF
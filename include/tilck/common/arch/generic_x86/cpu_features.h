@@ -116,6 +116,11 @@ static ALWAYS_INLINE bool in_hypervisor(void)
    return x86_cpu_features.ecx1.hypervisor;
 }
 
+static ALWAYS_INLINE bool cpu_has_tsc(void)
+{
+   return x86_cpu_features.edx1.tsc;
+}
+
 
 void enable_mtrr(void);
 void reset_mtrr(u32 num);
@@ -184,6 +184,16 @@ static ALWAYS_INLINE void halt(void)
    asmVolatile("hlt");
 }
 
+/*
+ * Enable the interrupts and halt the CPU atomically: thanks to the STI
+ * interrupt shadow, no IRQ can be served between the two instructions, so
+ * there is no risk of halting after a wake-up condition has been missed.
+ */
+static ALWAYS_INLINE void safe_halt(void)
+{
+   asmVolatile("sti\n\thlt");
+}
+
 static ALWAYS_INLINE void wrmsr(u32 msr_id, u64 msr_value)
 {
    asmVolatile( "wrmsr" : : "c" (msr_id), "A" (msr_value) );
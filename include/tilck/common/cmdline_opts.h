@@ -16,6 +16,7 @@ DEFINE_KOPT(selftest          ,     , wordstr, NULL)
 DEFINE_KOPT(sched_alive_thread, sat , bool,    false)
 DEFINE_KOPT(sercon            ,     , bool,    !MOD_console)
 DEFINE_KOPT(noacpi            ,     , bool,    false)
+DEFINE_KOPT(noapic            ,     , bool,    false)
 DEFINE_KOPT(fb_no_opt         ,     , bool,    false)
 DEFINE_KOPT(fb_no_wc          ,     , bool,    false)
 DEFINE_KOPT(no_fpu_memcpy     ,     , bool,    false)
@@ -38,7 +38,9 @@ struct x86_arch_proc_members {
 
 struct x86_arch_task_members {
    u16 fpu_regs_size;
+   u16 tls_gdt_index;  /* GDT entry of the thread's TLS, valid if > 0 */
    void *aligned_fpu_regs;
+   u32 tls_desc[2];    /* the raw GDT descriptor to load at `tls_gdt_index` */
 };
 
 NORETURN void context_switch(regs_t *r);
@@ -53,6 +55,11 @@ static ALWAYS_INLINE void set_return_register(regs_t *r, ulong value)
    r->eax = value;
 }
 
+static ALWAYS_INLINE void regs_set_usersp(regs_t *r, ulong value)
+{
+   r->useresp = value;
+}
+
 static ALWAYS_INLINE ulong get_rem_stack(void)
 {
    return (get_stack_ptr() & ((ulong)KERNEL_STACK_SIZE - 1));
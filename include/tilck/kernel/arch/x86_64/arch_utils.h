@@ -38,6 +38,11 @@ static ALWAYS_INLINE void set_return_register(regs_t *r, ulong value)
    NOT_IMPLEMENTED();
 }
 
+static ALWAYS_INLINE void regs_set_usersp(regs_t *r, ulong value)
+{
+   NOT_IMPLEMENTED();
+}
+
 NORETURN static ALWAYS_INLINE void context_switch(regs_t *r)
 {
    NOT_IMPLEMENTED();
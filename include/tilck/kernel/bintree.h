@@ -65,6 +65,17 @@ bintree_find_internal(void *root_obj,
                       long bintree_offset);
 
 
+/*
+ * Like bintree_find_internal(), but in case there's no object matching
+ * `value_ptr`, returns the smallest object bigger than it or NULL, when
+ * there's no such object.
+ */
+void *
+bintree_find_ceil_internal(void *root_obj,
+                           const void *value_ptr,
+                           cmpfun_ptr objval_cmpfun,   // cmp(root_obj, value)
+                           long bintree_offset);
+
 /*
  * returns a pointer to the removed object (if found) or NULL.
  */
@@ -140,6 +151,11 @@ bintree_remove_ptr_internal(void **root_obj_ref,
                          (value), (objval_cmpfun),                            \
                          OFFSET_OF(struct_type, elem_name))
 
+#define bintree_find_ceil(root_obj, value, cmpfun, struct_type, elem_name)    \
+   bintree_find_ceil_internal((void*)(root_obj),                              \
+                              (value), (cmpfun),                              \
+                              OFFSET_OF(struct_type, elem_name))
+
 /*
  * Find the object with key `value`, where value is a pointer-sized integer.
  * The comparison function is hard-coded and it just compares the given field
@@ -28,6 +28,7 @@ static inline bool is_leap_year(u32 year)
 }
 
 u64 get_sys_time(void);
+u64 get_mono_time(void);
 s64 get_timestamp(void);
 void init_system_time(void);
 int clock_get_second_drift(void);
@@ -36,10 +37,17 @@ bool clock_in_full_resync(void);
 struct k_timeval k_ts64_to_k_timeval(struct k_timespec64 ts);
 void ticks_to_timespec(u64 ticks, struct k_timespec64 *tp);
 u64 timespec_to_ticks(const struct k_timespec64 *tp);
+void ns_to_timespec(u64 t, struct k_timespec64 *tp);
+u64 timespec_to_ns(const struct k_timespec64 *tp);
 void real_time_get_timespec(struct k_timespec64 *tp);
 void monotonic_time_get_timespec(struct k_timespec64 *tp);
 void clock_get_resync_stats(struct clock_resync_stats *s);
 
+static inline bool is_valid_timespec(const struct k_timespec64 *tp)
+{
+   return tp->tv_sec >= 0 && IN_RANGE(tp->tv_nsec, 0, BILLION);
+}
+
 static ALWAYS_INLINE struct k_timespec32
 to_k_timespec32(struct k_timespec64 tp)
 {
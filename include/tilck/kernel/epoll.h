@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+
+struct epoll;
+
+struct epoll *create_epoll(void);
+void destroy_epoll(struct epoll *ep);
+fs_handle epoll_create_handle(struct epoll *ep);
+void epoll_on_handle_close(fs_handle h);
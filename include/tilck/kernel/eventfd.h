@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+
+struct eventfd;
+
+struct eventfd *create_eventfd(u64 initval, int flags);
+void destroy_eventfd(struct eventfd *e);
+fs_handle eventfd_create_handle(struct eventfd *e, int fl_flags);
@@ -101,6 +101,21 @@ typedef ssize_t        (*func_writev)       (fs_handle,
                                              int);
 
 typedef int            (*func_fsync)        (fs_handle);
+
+/*
+ * Data callback used by splice_read(): it gets a kernel pointer to a chunk of
+ * the file's data and returns the number of bytes consumed, or a value < 0.
+ * When the last param (page_ref) is true, the chunk belongs to a ref-counted
+ * kernel page and the callback can keep a reference to it with
+ * retain_kernel_page() instead of copying the data.
+ */
+typedef ssize_t        (*vfs_data_cb)       (void *, char *, size_t, bool);
+
+typedef ssize_t        (*func_splice_read)  (fs_handle,
+                                             size_t,
+                                             offt *,
+                                             vfs_data_cb,
+                                             void *);
 typedef void           (*func_syncfs)       (struct mnt_fs *);
 
 /*
@@ -170,6 +185,13 @@ struct file_ops {
 
    func_handle_fault handle_fault;     /* if NULL -> false     */
 
+   /*
+    * Optional, zero-copy read: instead of copying the data in a buffer, pass
+    * to the callback pointers to the FS's own backing memory. Used by
+    * sendfile(). If NULL, emulated with read() and a bounce buffer.
+    */
+   func_splice_read splice_read;
+
    /*
     * Optional, r/w/e ready funcs
     *
@@ -224,6 +246,7 @@ ssize_t vfs_readv(fs_handle h, const struct iovec *iov, int iovcnt);
 ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt);
 ssize_t vfs_pread(fs_handle h, void *buf, size_t buf_size, offt off);
 ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off);
+ssize_t vfs_sendfile(fs_handle out, fs_handle in, offt *in_pos, size_t cnt);
 
 int vfs_exlock_noblock(struct mnt_fs *fs, vfs_inode_ptr_t i);
 int vfs_exunlock(struct mnt_fs *fs, vfs_inode_ptr_t i);
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+struct task;
+
+void init_futexes(void);
+
+/*
+ * Called by each exiting user task, while its address space is still there:
+ * walks its robust futex list and handles its clear_child_tid pointer.
+ */
+void futex_exit(struct task *ti);
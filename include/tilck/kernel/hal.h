@@ -86,6 +86,11 @@
       /* STUB function: do nothing */
    }
 
+   static ALWAYS_INLINE void regs_set_usersp(regs_t *r, ulong value)
+   {
+      /* STUB function: do nothing */
+   }
+
    static ALWAYS_INLINE int int_to_irq(int int_num)
    {
       NOT_IMPLEMENTED();
@@ -116,6 +121,11 @@
       /* STUB function: do nothing */
    }
 
+   static ALWAYS_INLINE void safe_halt(void)
+   {
+      /* STUB function: do nothing */
+   }
+
    static ALWAYS_INLINE void init_fpu_memcpy(void)
    {
       /* STUB function: do nothing */
@@ -126,6 +136,11 @@
       return false;
    }
 
+   static ALWAYS_INLINE bool cpu_has_tsc(void)
+   {
+      return false;
+   }
+
    static ALWAYS_INLINE ulong get_rem_stack(void)
    {
       return KERNEL_STACK_SIZE;
@@ -171,6 +186,12 @@ void on_first_pdir_update(void);
 extern void (*hw_read_clock)(struct datetime *out);
 void hw_read_clock_cmos(struct datetime *out);
 u32 hw_timer_setup(u32 hz);
+void hw_timer_periodic_resume(void);
+u32 hw_timer_oneshot_start(u32 ticks);
+u32 hw_timer_oneshot_stop(bool *expired);
+bool hw_timer_oneshot_expired(void);
+bool hw_timer_subtick_start(u32 off);
+bool hw_timer_subtick_next(u32 off);
 
 bool allocate_fpu_regs(arch_task_members_t *arch_fields);
 void copy_main_tss_on_regs(regs_t *ctx);
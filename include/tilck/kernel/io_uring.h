@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+
+#define IO_URING_MAX_ENTRIES             1024
+
+struct io_uring_ctx;
+struct io_uring_params;
+
+struct io_uring_ctx *create_io_uring(u32 sq_entries, u32 cq_entries);
+void destroy_io_uring(struct io_uring_ctx *ctx);
+void io_uring_get_params(struct io_uring_ctx *ctx, struct io_uring_params *p);
+fs_handle io_uring_create_handle(struct io_uring_ctx *ctx);
+void io_uring_on_handle_close(fs_handle h);
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * Typed object caches for hot, fixed-size, kernel objects. Each cache keeps a
+ * free-list of objects of the same size, refilled in batches through a kmalloc
+ * accelerator: in the common case, allocating and freeing an object is just a
+ * pop or a push on that free-list.
+ *
+ * Caches are meant to be statically defined with KMEM_CACHE_INIT(); they're
+ * set up lazily, at the first allocation. Objects are aligned at their size,
+ * rounded up to the next power of 2, exactly like kmalloc() chunks.
+ */
+
+typedef void (*kmem_cache_ctor)(void *obj);
+
+struct kmem_cache {
+
+   const char *name;
+   size_t obj_size;
+   kmem_cache_ctor ctor;      /* optional: called on each allocated object */
+
+   /* Set up at the first allocation */
+   struct list_node node;     /* node in the global list of caches */
+   u32 elem_size;             /* obj_size rounded up to a power of 2 */
+   u32 max_free;              /* max number of objects kept in free_list */
+   struct kmalloc_acc acc;
+   void *free_list;
+
+   /* Statistics */
+   u32 free_count;            /* objects in free_list */
+   u32 active;                /* objects currently allocated */
+   u32 peak_active;
+   u32 refills;               /* batches allocated through kmalloc */
+   u64 allocs;
+   u64 frees;
+};
+
+#define KMEM_CACHE_INIT(cache_name, size, ctor_func)                       \
+   {                                                                       \
+      .name = (cache_name),                                                \
+      .obj_size = (size),                                                  \
+      .ctor = (ctor_func),                                                 \
+      .node = { NULL, NULL },                                              \
+      .elem_size = 0,                                                      \
+      .max_free = 0,                                                       \
+      .acc = { 0, 0, 0, NULL },                                            \
+      .free_list = NULL,                                                   \
+      .free_count = 0,                                                     \
+      .active = 0,                                                         \
+      .peak_active = 0,                                                    \
+      .refills = 0,                                                        \
+      .allocs = 0,                                                         \
+      .frees = 0,                                                          \
+   }
+
+void *kmem_cache_alloc(struct kmem_cache *c);
+void *kmem_cache_zalloc(struct kmem_cache *c);
+void kmem_cache_free(struct kmem_cache *c, void *obj);
+void kmem_cache_destroy(struct kmem_cache *c);
+
+struct debug_kmem_cache_info {
+
+   const char *name;
+   size_t obj_size;
+   u32 elem_size;
+   u32 batch;
+   u32 free_count;
+   u32 active;
+   u32 peak_active;
+   u32 refills;
+   u64 allocs;
+   u64 frees;
+};
+
+bool
+debug_kmem_cache_get_info(int n, struct debug_kmem_cache_info *i);
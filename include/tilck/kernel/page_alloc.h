@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * The page-frame allocator hands out blocks of 2^order physically contiguous
+ * pages, up to 2^PG_ALLOC_MAX_ORDER pages. It's meant for all the page-sized
+ * allocations (user pages, page tables, ramfs blocks, pipe buffers etc.) and
+ * falls back to kmalloc() before init_page_alloc() has been called.
+ */
+
+#define PG_ALLOC_MAX_ORDER                     4
+
+void init_page_alloc(void);
+
+void *kalloc_pages(u32 order);
+void kfree_pages(void *vaddr, u32 order);
+size_t page_alloc_get_free_pages(void);
+
+/*
+ * Is `vaddr` a page returned by kalloc_page() and not freed yet? Only pages
+ * like that can be shared by reference and released with kfree_page() when
+ * their ref-count drops to 0 (see release_kernel_page()).
+ */
+bool is_kalloc_page(void *vaddr);
+
+static inline void *kalloc_page(void)
+{
+   return kalloc_pages(0);
+}
+
+static inline void kfree_page(void *vaddr)
+{
+   kfree_pages(vaddr, 0);
+}
+
+void *kzalloc_page(void);
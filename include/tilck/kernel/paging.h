@@ -53,6 +53,7 @@ extern char zero_page[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
 
 void early_init_paging();
 bool handle_potential_cow(void *r);
+bool handle_potential_demand_paging(void *r);
 
 /*
  * Map a pageframe at `paddr` at the virtual address `vaddr` in the page
@@ -90,6 +91,9 @@ map_zero_pages(pdir_t *pdir,
                size_t page_count,
                u32 pg_flags);
 
+NODISCARD int
+move_pages(pdir_t *pdir, void *src, void *dst, size_t page_count);
+
 void init_paging(void);
 bool is_mapped(pdir_t *pdir, void *vaddr);
 bool is_rw_mapped(pdir_t *pdir, void *vaddrp);
@@ -107,6 +111,16 @@ void set_page_rw(pdir_t *pdir, void *vaddr, bool rw);
 void retain_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 void release_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 
+/*
+ * Ref-counting for kmalloc-ed kernel pages shared by reference (e.g. ramfs
+ * blocks and pipe buffers): the last release_kernel_page() frees the page.
+ */
+void retain_kernel_page(void *vaddr);
+void release_kernel_page(void *vaddr);
+u32 page_ref_count(void *vaddr);
+
+void *user_page_share_cow(pdir_t *pdir, void *user_vaddr);
+
 static ALWAYS_INLINE pdir_t *get_kernel_pdir(void)
 {
    extern pdir_t *__kernel_pdir;
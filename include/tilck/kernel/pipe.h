@@ -1,11 +1,37 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
-#define PIPE_BUF_SIZE   4096
+
+/* Default capacity of a pipe, in page buffers */
+#define PIPE_DEF_BUFS   16
 
 struct pipe;
+struct iovec;
+
+extern ulong pipe_max_size;
 
 struct pipe *create_pipe(void);
 void destroy_pipe(struct pipe *p);
 fs_handle pipe_create_read_handle(struct pipe *p);
 fs_handle pipe_create_write_handle(struct pipe *p);
+
+bool is_pipe_read_end(fs_handle h);
+bool is_pipe_write_end(fs_handle h);
+
+int pipe_get_size(fs_handle h);
+int pipe_set_size(fs_handle h, ulong size);
+
+ssize_t
+pipe_splice_in(fs_handle wh, fs_handle in, offt *pos, size_t len, bool nb);
+
+ssize_t
+pipe_splice_out(fs_handle rh, fs_handle out, offt *pos, size_t len, bool nb);
+
+ssize_t
+pipe_splice_pipe(fs_handle rh, fs_handle wh, size_t len, bool nb, bool dup);
+
+ssize_t
+pipe_vmsplice_in(fs_handle wh, const struct iovec *iov, int iovcnt, bool nb);
+
+ssize_t
+pipe_vmsplice_out(fs_handle rh, const struct iovec *iov, int iovcnt, bool nb);
@@ -28,9 +28,8 @@ struct kernel_alloc {
 
 struct mappings_info {
 
-   struct kmalloc_heap *mmap_heap;
-   size_t mmap_heap_size;
-   struct list mappings;
+   struct user_mapping *mappings;    /* root of the tree, ordered by vaddr */
+   ulong free_area_hint;             /* where to start looking for free vmem */
 };
 
 struct process {
@@ -48,6 +47,7 @@ struct process {
    struct mappings_info *mi;
 
    struct list children;
+   struct list threads;              /* user threads, except the main one */
 
    void *proc_tty;
    bool did_call_execve;
@@ -55,11 +55,19 @@ struct process {
    bool vforked;                 /* after vfork(), before execve() */
    bool inherited_mmap_heap;
    bool did_set_tty_medium_raw;
+   bool group_exit;              /* exit_group() or fatal signal in progress */
 
-   int *set_child_tid;                    /* NOTE: this is an user pointer */
+   int vfork_parent_tid;         /* the task stopped by vfork(), if vforked */
+   int group_exit_code;          /* valid only when `group_exit` is true */
+   int group_term_sig;           /* valid only when `group_exit` is true */
+
+   u64 dead_threads_ticks;       /* total ticks of the threads already dead */
+   u64 dead_threads_ticks_kernel;
 
    struct kmutex fslock;                  /* protects `handles` and `cwd` */
    mode_t umask;
+   ulong stack_rlim_cur;                  /* RLIMIT_STACK's soft limit */
+   ulong stack_rlim_max;                  /* RLIMIT_STACK's hard limit */
 
    struct vfs_path cwd;                   /* CWD as a struct vfs_path */
    char *debug_cmdline;                   /* debug field used by debugpanel */
@@ -114,7 +122,7 @@ get_process_task(struct process *pi)
 static ALWAYS_INLINE bool
 task_is_parent(struct task *parent, struct task *child)
 {
-   return child->pi->parent_pid == parent->pi->pid;
+   return child->pi->parent_pid == parent->pi->pid && is_main_thread(child);
 }
 
 int do_fork(bool vfork);
@@ -141,6 +149,9 @@ allocate_new_thread(struct process *pi, int tid, bool alloc_bufs);
 void free_task(struct task *ti);
 void free_mem_for_zombie_task(struct task *ti);
 bool arch_specific_new_task_setup(struct task *ti, struct task *parent);
+int arch_specific_new_thread_setup(struct task *ti,
+                                   struct task *parent,
+                                   void *tls);
 void arch_specific_free_task(struct task *ti);
 void arch_specific_new_proc_setup(struct process *pi, struct process *parent);
 void arch_specific_free_proc(struct process *pi);
@@ -150,6 +161,9 @@ void init_process_lists(struct process *pi);
 void process_set_cwd2_nolock(struct vfs_path *tp);
 void process_set_cwd2_nolock_raw(struct process *pi, struct vfs_path *tp);
 void terminate_process(int exit_code, int term_sig);
+void terminate_thread(int exit_code);
+bool kill_other_threads_and_wait(void);
+void process_get_ticks(struct process *pi, u64 *total, u64 *total_kernel);
 void close_cloexec_handles(struct process *pi);
 int setup_sig_handler(struct task *ti,
                       enum sig_state sig_state,
@@ -5,10 +5,13 @@
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/list.h>
+#include <tilck/kernel/bintree.h>
+
+struct mappings_info;
 
 struct user_mapping {
 
-   struct list_node pi_node;
+   struct bintree_node pi_node;
    struct list_node inode_node;
    struct process *pi;
 
@@ -32,16 +35,29 @@ void full_remove_user_mapping(struct process *pi, struct user_mapping *um);
 void remove_all_mappings_of_handle(struct process *pi, fs_handle h);
 void remove_all_user_zero_mem_mappings(struct process *pi);
 struct user_mapping *process_get_user_mapping(void *vaddr);
+struct user_mapping *mi_get_mapping(struct mappings_info *mi, ulong vaddr);
+struct user_mapping *
+mi_get_first_mapping_in(struct mappings_info *mi, ulong vaddr, size_t len);
+struct user_mapping *
+mi_get_next_mapping(struct mappings_info *mi, struct user_mapping *um);
 void remove_all_file_mappings(struct process *pi);
 struct mappings_info *
 duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi);
+bool handle_user_demand_fault(void *vaddr, bool p, bool rw);
+
 
+/*
+ * Iterate over the user mappings in `mi`, in address order. Like
+ * list_for_each(), it's safe to remove the current mapping.
+ */
+#define mi_for_each_mapping(pos, tmp, mi)                                   \
+   for (pos = bintree_get_first_obj((mi)->mappings,                         \
+                                    struct user_mapping, pi_node);          \
+        pos && ((tmp = mi_get_next_mapping((mi), pos)), true);              \
+        pos = tmp)
 
 /* Internal functions */
-bool user_valloc_and_map(ulong user_vaddr, size_t page_count);
 void user_vfree_and_unmap(ulong user_vaddr, size_t page_count);
-void user_unmap_zero_page(ulong user_vaddr, size_t page_count);
-bool user_map_zero_page(ulong user_vaddr, size_t page_count);
 int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len);
 
 /* Special one-time funcs */
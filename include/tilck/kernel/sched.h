@@ -10,6 +10,7 @@
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/signal.h>
+#include <tilck/kernel/timer.h>
 
 #include <tilck_gen_headers/config_sched.h>
 
@@ -75,9 +76,11 @@ struct task {
    void *worker_thread;                      /* only for worker threads */
 
    struct bintree_node tree_by_tid_node;
-   struct list_node runnable_node;
+   struct bintree_node runnable_tree_node;   /* node in the vruntime tree */
+   struct list_node runnable_node;           /* node in the timer_ready list */
    struct list_node wakeup_timer_node;
    struct list_node siblings_node;    /* nodes in parent's pi's children list */
+   struct list_node thread_node;      /* node in pi->threads (user threads) */
 
    struct list tasks_waiting_list;    /* tasks waiting this task to end */
 
@@ -93,7 +96,8 @@ struct task {
    };
 
    struct wait_obj wobj;
-   u32 ticks_before_wake_up;
+   u64 wakeup_timer_tick;             /* abs. tick of the wakeup, 0 = none */
+   struct hrtimer wakeup_hrtimer;     /* sub-tick wakeup, see timer.h */
 
    /* List of callbacks to call on exit */
    struct list on_exit;
@@ -101,6 +105,10 @@ struct task {
    /* Temp kernel allocations for user requests */
    struct kernel_alloc *kallocs_tree_root;
 
+   /* User pointers set by clone(), set_tid_address() and set_robust_list() */
+   int *clear_child_tid;
+   void *robust_list;
+
    /* This task is stopped because of its vfork-ed child */
    bool vfork_stopped;
 
@@ -139,7 +147,6 @@ extern struct task *kernel_process;
 extern struct process *kernel_process_pi;
 extern struct task *idle_task;
 
-extern struct list runnable_tasks_list;
 extern const char *const task_state_str[5];
 
 #define KTH_ALLOC_BUFS                       (1 << 0)
@@ -384,6 +391,7 @@ int get_curr_tid(void);
 int get_curr_pid(void);
 void save_current_task_state(regs_t *, bool);
 void sched_account_ticks(void);
+void sched_account_idle_ticks(u32 ticks);
 int create_new_pid(void);
 int create_new_kernel_tid(void);
 void task_info_reset_kernel_stack(struct task *ti);
@@ -400,6 +408,7 @@ int kthread_join_all(const int *tids, size_t n, bool ignore_signals);
 void task_set_wakeup_timer(struct task *task, u32 ticks);
 void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks);
 u32 task_cancel_wakeup_timer(struct task *ti);
+void task_set_wakeup_hrtimer(struct task *ti, u64 expires);
 
 typedef void (*kthread_func_ptr)();
 
@@ -27,6 +27,8 @@ int send_signal2(int pid, int tid, int signum, int flags);
 bool process_signals(void *curr, enum sig_state new_sig_state, void *regs);
 void drop_all_pending_signals(void *curr);
 void reset_all_custom_signal_handlers(void *curr);
+int sigmask_temp_set(const sigset_t *u_mask, size_t sigsetsize);
+void sigmask_temp_restore(void);
 
 static inline int send_signal(int tid, int signum, int flags)
 {
@@ -15,6 +15,7 @@ enum wo_type {
    WOBJ_KCOND,
    WOBJ_TASK,
    WOBJ_SEM,
+   WOBJ_FUTEX,      /* ptr is a struct futex_key, see futex.c */
 
    /* Special "meta-object" types */
 
@@ -190,13 +191,32 @@ bool kmutex_is_curr_task_holding_lock(struct kmutex *m);
 struct kcond {
 
    struct list wait_list;
+   struct list watch_list;     /* list of struct kcond_watch */
 };
 
-#define STATIC_KCOND_INIT(s)                     \
-   {                                             \
-      .wait_list = STATIC_LIST_INIT(s.wait_list),\
+#define STATIC_KCOND_INIT(s)                       \
+   {                                               \
+      .wait_list = STATIC_LIST_INIT(s.wait_list),  \
+      .watch_list = STATIC_LIST_INIT(s.watch_list),\
    }
 
+/*
+ * A persistent observer of a kcond: unlike the tasks in `wait_list`, which get
+ * removed once signaled, watches stay registered until kcond_watch_remove() and
+ * their `func` is called on every kcond_signal_one() or kcond_signal_all(),
+ * with preemption disabled. The callback must not sleep, nor signal the same
+ * kcond again. Used by epoll.
+ */
+struct kcond_watch;
+typedef void (*kcond_watch_func)(struct kcond_watch *);
+
+struct kcond_watch {
+
+   struct list_node node;
+   kcond_watch_func func;
+   void *arg;
+};
+
 #define KCOND_WAIT_FOREVER 0
 
 void kcond_init(struct kcond *c);
@@ -205,3 +225,6 @@ void kcond_signal_one(struct kcond *c);
 void kcond_signal_all(struct kcond *c);
 bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks);
 bool kcond_is_anyone_waiting(struct kcond *c);
+void kcond_watch_init(struct kcond_watch *w, kcond_watch_func func, void *arg);
+void kcond_watch_add(struct kcond *c, struct kcond_watch *w);
+void kcond_watch_remove(struct kcond_watch *w);
@@ -19,6 +19,7 @@
 #include <sys/resource.h> // system header
 #include <time.h>         // system header
 #include <poll.h>         // system header
+#include <sys/epoll.h>    // system header
 #include <utime.h>        // system header
 #include <sys/stat.h>     // system header
 #include <unistd.h>       // system header
@@ -125,6 +126,54 @@ struct k_timespec64 {
    long tv_nsec;
 };
 
+struct k_itimerspec32 {
+
+   struct k_timespec32 it_interval;
+   struct k_timespec32 it_value;
+};
+
+/*
+ * The userspace itimerspec with 64-bit time. Note: on 32-bit systems,
+ * struct k_timespec64 is 12 bytes, while the userspace one is padded to 16.
+ */
+struct k_itimerspec64 {
+
+   struct k_timespec64 it_interval;
+
+#ifdef BITS32
+   u32 __pad0;
+#endif
+
+   struct k_timespec64 it_value;
+
+#ifdef BITS32
+   u32 __pad1;
+#endif
+};
+
+STATIC_ASSERT(sizeof(struct k_itimerspec64) == 32);
+
+/*
+ * Classic rlimit struct (getrlimit, setrlimit), with pointer-size fields.
+ */
+struct k_rlimit {
+
+   ulong rlim_cur;
+   ulong rlim_max;
+};
+
+/*
+ * Modern rlimit struct (prlimit64), with 64-bit fields on all the systems.
+ */
+struct k_rlimit64 {
+
+   u64 rlim_cur;
+   u64 rlim_max;
+};
+
+#define K_RLIM_INFINITY                                    (~0ull)
+#define K_RLIMIT_NLIMITS                                        16
+
 #ifdef BITS32
 
 /*
@@ -131,7 +131,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_setregid16)
 CREATE_STUB_SYSCALL_IMPL(sys_sigsuspend)
 CREATE_STUB_SYSCALL_IMPL(sys_sigpending)
 CREATE_STUB_SYSCALL_IMPL(sys_sethostname)
-CREATE_STUB_SYSCALL_IMPL(sys_setrlimit)
+int sys_setrlimit(int resource, const struct k_rlimit *user_lim);
 CREATE_STUB_SYSCALL_IMPL(sys_old_getrlimit)
 
 int sys_getrusage(int who, struct k_rusage *user_buf);
@@ -192,7 +192,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_ipc)
 int sys_fsync(int fd);
 CREATE_STUB_SYSCALL_IMPL(sys_sigreturn);
 
-CREATE_STUB_SYSCALL_IMPL(sys_clone)
+int sys_clone(ulong flags, void *newsp, int *ptid, void *tls, int *ctid);
 CREATE_STUB_SYSCALL_IMPL(sys_setdomainname)
 
 int sys_newuname(struct utsname *buf);
@@ -250,7 +250,9 @@ CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval_time32)
 int sys_nanosleep_time32(const struct k_timespec32 *req,
                          struct k_timespec32 *rem);
 
-CREATE_STUB_SYSCALL_IMPL(sys_mremap)
+long sys_mremap(void *old_addr, size_t old_len, size_t new_len,
+                int flags, void *new_addr);
+
 CREATE_STUB_SYSCALL_IMPL(sys_setresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_getresuid16)
 CREATE_STUB_SYSCALL_IMPL(sys_vm86)
@@ -291,11 +293,12 @@ int sys_getcwd(char *buf, size_t size);
 CREATE_STUB_SYSCALL_IMPL(sys_capget)
 CREATE_STUB_SYSCALL_IMPL(sys_capset)
 CREATE_STUB_SYSCALL_IMPL(sys_sigaltstack)
-CREATE_STUB_SYSCALL_IMPL(sys_sendfile)
+
+int sys_sendfile(int out_fd, int in_fd, long *u_offset, size_t count);
 
 int sys_vfork(void);
 
-CREATE_STUB_SYSCALL_IMPL(sys_getrlimit)
+int sys_getrlimit(int resource, struct k_rlimit *user_lim);
 
 long sys_mmap_pgoff(void *addr, size_t length, int prot,
                     int flags, int fd, size_t pgoffset);
@@ -354,8 +357,11 @@ CREATE_STUB_SYSCALL_IMPL(sys_fremovexattr)
 
 int sys_tkill(int tid, int sig);
 
-CREATE_STUB_SYSCALL_IMPL(sys_sendfile64)
-CREATE_STUB_SYSCALL_IMPL(sys_futex_time32)
+int sys_sendfile64(int out_fd, int in_fd, s64 *u_offset, size_t count);
+
+int sys_futex_time32(u32 *uaddr, int op, u32 val,
+                     const struct k_timespec32 *user_ts,
+                     u32 *uaddr2, u32 val3);
 CREATE_STUB_SYSCALL_IMPL(sys_sched_setaffinity)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_getaffinity)
 
@@ -372,12 +378,11 @@ CREATE_STUB_SYSCALL_IMPL(sys_ia32_fadvise64)
 NORETURN int sys_exit_group(int status);
 
 CREATE_STUB_SYSCALL_IMPL(sys_lookup_dcookie)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_create)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_ctl)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_wait)
+int sys_epoll_create(int size);
+int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *u_ev);
+int sys_epoll_wait(int epfd, struct epoll_event *u_evs, int maxevents, int tm);
 CREATE_STUB_SYSCALL_IMPL(sys_remap_file_pages)
 
-// TODO: complete the implementation when thread creation is implemented.
 int sys_set_tid_address(int *tidptr);
 
 CREATE_STUB_SYSCALL_IMPL(sys_timer_create)
@@ -389,8 +394,11 @@ CREATE_STUB_SYSCALL_IMPL(sys_clock_settime32)
 
 int sys_clock_gettime32(clockid_t clk_id, struct k_timespec32 *tp);
 int sys_clock_getres_time32(clockid_t clk_id, struct k_timespec32 *res);
+int sys_clock_nanosleep_time32(clockid_t clk_id,
+                               int flags,
+                               const struct k_timespec32 *req,
+                               struct k_timespec32 *rem);
 
-CREATE_STUB_SYSCALL_IMPL(sys_clock_nanosleep_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_statfs64)
 CREATE_STUB_SYSCALL_IMPL(sys_fstatfs64)
 
@@ -437,28 +445,44 @@ CREATE_STUB_SYSCALL_IMPL(sys_faccessat)
 CREATE_STUB_SYSCALL_IMPL(sys_pselect6)
 CREATE_STUB_SYSCALL_IMPL(sys_ppoll)
 CREATE_STUB_SYSCALL_IMPL(sys_unshare)
-CREATE_STUB_SYSCALL_IMPL(sys_set_robust_list)
-CREATE_STUB_SYSCALL_IMPL(sys_get_robust_list)
-CREATE_STUB_SYSCALL_IMPL(sys_splice)
+int sys_set_robust_list(void *head, size_t len);
+int sys_get_robust_list(int tid, void **user_head, size_t *user_len);
+
+int sys_splice(int fd_in, s64 *u_off_in, int fd_out, s64 *u_off_out,
+               size_t len, unsigned int flags);
+
 CREATE_STUB_SYSCALL_IMPL(sys_ia32_sync_file_range)
-CREATE_STUB_SYSCALL_IMPL(sys_tee)
-CREATE_STUB_SYSCALL_IMPL(sys_vmsplice)
+int sys_tee(int fd_in, int fd_out, size_t len, unsigned int flags);
+int sys_vmsplice(int fd, const struct iovec *u_iov, ulong nr_segs,
+                 unsigned int flags);
 CREATE_STUB_SYSCALL_IMPL(sys_move_pages)
 CREATE_STUB_SYSCALL_IMPL(sys_getcpu)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_pwait)
+
+int sys_epoll_pwait(int epfd,
+                    struct epoll_event *u_evs,
+                    int maxevents,
+                    int timeout,
+                    const sigset_t *u_sigmask,
+                    size_t sigsetsize);
 
 int sys_utimensat_time32(int dirfd, const char *u_path,
                          const struct k_timespec32 times[2], int flags);
 
 CREATE_STUB_SYSCALL_IMPL(sys_signalfd)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_create)
-CREATE_STUB_SYSCALL_IMPL(sys_eventfd)
+int sys_timerfd_create(clockid_t clk_id, int flags);
+int sys_eventfd(unsigned int initval);
 CREATE_STUB_SYSCALL_IMPL(sys_fallocate)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_settime32)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_gettime32)
+
+int sys_timerfd_settime32(int fd,
+                          int flags,
+                          const struct k_itimerspec32 *u_new,
+                          struct k_itimerspec32 *u_old);
+
+int sys_timerfd_gettime32(int fd, struct k_itimerspec32 *u_curr);
+
 CREATE_STUB_SYSCALL_IMPL(sys_signalfd4)
-CREATE_STUB_SYSCALL_IMPL(sys_eventfd2)
-CREATE_STUB_SYSCALL_IMPL(sys_epoll_create1)
+int sys_eventfd2(unsigned int initval, int flags);
+int sys_epoll_create1(int flags);
 CREATE_STUB_SYSCALL_IMPL(sys_dup3)
 
 int sys_pipe2(int u_pipefd[2], int flags);
@@ -472,7 +496,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_recvmmsg_time32)
 
 CREATE_STUB_SYSCALL_IMPL(sys_fanotify_init)
 CREATE_STUB_SYSCALL_IMPL(sys_fanotify_mark)
-CREATE_STUB_SYSCALL_IMPL(sys_prlimit64)
+int sys_prlimit64(int pid,
+                  int resource,
+                  const struct k_rlimit64 *user_new_lim,
+                  struct k_rlimit64 *user_old_lim);
 CREATE_STUB_SYSCALL_IMPL(sys_name_to_handle_at)
 CREATE_STUB_SYSCALL_IMPL(sys_open_by_handle_at)
 CREATE_STUB_SYSCALL_IMPL(sys_clock_adjtime32)
@@ -540,11 +567,21 @@ CREATE_STUB_SYSCALL_IMPL(sys_clock_adjtime)
 
 int sys_clock_getres(clockid_t clk_id, struct k_timespec64 *user_res);
 
-CREATE_STUB_SYSCALL_IMPL(sys_clock_nanosleep)
+
+int sys_clock_nanosleep(clockid_t clk_id,
+                        int flags,
+                        const struct k_timespec64 *req,
+                        struct k_timespec64 *rem);
+
 CREATE_STUB_SYSCALL_IMPL(sys_timer_gettime)
 CREATE_STUB_SYSCALL_IMPL(sys_timer_settime)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_gettime)
-CREATE_STUB_SYSCALL_IMPL(sys_timerfd_settime)
+int sys_timerfd_gettime(int fd, struct k_itimerspec64 *u_curr);
+
+int sys_timerfd_settime(int fd,
+                        int flags,
+                        const struct k_itimerspec64 *u_new,
+                        struct k_itimerspec64 *u_old);
+
 CREATE_STUB_SYSCALL_IMPL(sys_utimensat)
 CREATE_STUB_SYSCALL_IMPL(sys_pselect6_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_ppoll_time32)
@@ -554,11 +591,19 @@ CREATE_STUB_SYSCALL_IMPL(sys_mq_timedsend)
 CREATE_STUB_SYSCALL_IMPL(sys_mq_timedreceive)
 CREATE_STUB_SYSCALL_IMPL(sys_semtimedop)
 CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait)
-CREATE_STUB_SYSCALL_IMPL(sys_futex)
+int sys_futex(u32 *uaddr, int op, u32 val,
+              const struct k_timespec64 *user_ts,
+              u32 *uaddr2, u32 val3);
 CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_send_signal)
-CREATE_STUB_SYSCALL_IMPL(sys_io_uring_setup)
-CREATE_STUB_SYSCALL_IMPL(sys_io_uring_enter)
+struct io_uring_params;
+int sys_io_uring_setup(u32 entries, struct io_uring_params *u_params);
+int sys_io_uring_enter(int fd,
+                       u32 to_submit,
+                       u32 min_complete,
+                       u32 flags,
+                       const sigset_t *u_sigmask,
+                       size_t sigsetsize);
 CREATE_STUB_SYSCALL_IMPL(sys_io_uring_register)
 CREATE_STUB_SYSCALL_IMPL(sys_open_tree)
 CREATE_STUB_SYSCALL_IMPL(sys_move_mount)
@@ -567,7 +612,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_fsconfig)
 CREATE_STUB_SYSCALL_IMPL(sys_fsmount)
 CREATE_STUB_SYSCALL_IMPL(sys_fspick)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_open)
-CREATE_STUB_SYSCALL_IMPL(sys_clone3)
+int sys_clone3(void *user_args, size_t size);
 CREATE_STUB_SYSCALL_IMPL(sys_close_range)
 CREATE_STUB_SYSCALL_IMPL(sys_openat2)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_getfd)
@@ -10,4 +10,7 @@ extern struct kmalloc_heap first_heap_struct;
 extern struct kmalloc_heap *heaps[KMALLOC_HEAPS_COUNT];
 extern int used_heaps;
 extern size_t max_tot_heap_mem_free;
+
+void page_alloc_reset(void);
+void kmem_cache_reset_all(void);
 #endif
@@ -3,6 +3,7 @@
 #pragma once
 #include <tilck_gen_headers/config_sched.h>
 #include <tilck/common/basic_defs.h>
+#include <tilck/kernel/bintree.h>
 
 void kernel_sleep(u64 ticks);  /* sleep for `ticks` timer ticks (jiffies) */
 void kernel_sleep_ms(u64 ms);  /* sleep for `ms` milliseconds */
@@ -15,4 +16,33 @@ ms_to_ticks(u64 ms)
 }
 
 u64 get_ticks(void);
+u32 ns_since_last_tick(void);  /* expects interrupts disabled */
+bool has_tsc_clocksource(void);
 void init_timer(void);
+void nohz_idle_enter(void);    /* called by idle(), with interrupts disabled */
+void nohz_irq_enter(int irq);  /* called on each IRQ, before the handlers */
+
+/*
+ * High-resolution timers: unlike the task wakeup timers, which have a tick
+ * granularity, they expire at an absolute monotonic time (in TS_SCALE units)
+ * and are served by programming the hardware timer in one-shot mode inside
+ * the current tick. Their callbacks run in IRQ context, with interrupts
+ * disabled.
+ */
+struct hrtimer;
+typedef void (*hrtimer_func)(struct hrtimer *);
+
+struct hrtimer {
+   struct bintree_node node;
+   u64 expires;
+   hrtimer_func func;
+   bool active;
+};
+
+void hrtimer_init(struct hrtimer *t, hrtimer_func func);
+void hrtimer_start(struct hrtimer *t, u64 expires);
+bool hrtimer_cancel(struct hrtimer *t);
+u64 hrtimer_expiry_in(u64 ns);
+
+/* Sleep until the monotonic time `deadline` or until a signal arrives */
+void kernel_sleep_until(u64 deadline);
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/vfs_base.h>
+#include <tilck/kernel/sys_types.h>
+
+struct timerfd;
+
+struct timerfd *create_timerfd(clockid_t clk_id);
+void destroy_timerfd(struct timerfd *t);
+fs_handle timerfd_create_handle(struct timerfd *t, int fl_flags);
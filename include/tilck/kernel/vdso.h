@@ -1,10 +1,54 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
+
+/*
+ * Layout of the vDSO data page, mapped read-only for userspace right after the
+ * vDSO page, at USER_VDSO_DATA_VADDR. It's updated by the kernel on each tick
+ * and it's read by the __vdso_* functions in vdso.S, which retry as long as
+ * `seq` is odd or it changed during the read.
+ */
+#define VDSO_DATA_SEQ_OFF                  0
+#define VDSO_DATA_TSC_PER_TICK_OFF         4
+#define VDSO_DATA_TSC_NS_MULT_OFF          8
+#define VDSO_DATA_TICK_TSC_OFF            16
+#define VDSO_DATA_SYS_TIME_OFF            24
+#define VDSO_DATA_MONO_TIME_OFF           32
+#define VDSO_DATA_BOOT_TS_OFF             40
+#define VDSO_DATA_SYS_NS_CAP_OFF          48
+#define VDSO_DATA_MONO_NS_CAP_OFF         52
+
+#ifndef ASM_FILE
+
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/page_size.h>
+
+struct vdso_data {
+
+   volatile u32 seq;       /* seqcount: odd while the kernel writes */
+   u32 tsc_per_tick;       /* TSC cycles per tick, 0 = no TSC clocksource */
+   u64 tsc_ns_mult;        /* ns = (cycles * tsc_ns_mult) >> 32 */
+   u64 tick_tsc;           /* TSC value at the last tick */
+   u64 sys_time;           /* system time (ns since boot) at the last tick */
+   u64 mono_time;          /* monotonic time (ns) at the last tick */
+   s64 boot_timestamp;     /* UNIX timestamp at boot, in seconds */
+   u32 sys_ns_cap;         /* max ns to interpolate on `sys_time` */
+   u32 mono_ns_cap;        /* max ns to interpolate on `mono_time` */
+};
+
+union vdso_data_page {
+   struct vdso_data data;
+   char raw[PAGE_SIZE];    /* nothing else must share this page */
+};
+
+extern union vdso_data_page vdso_data_page;
+
+void vdso_update_time(void);
 
 extern const ulong vdso_begin;
 extern const ulong vdso_end;
 extern const ulong sysexit_user_code_user_vaddr;
 extern const ulong post_sig_handler_user_vaddr;
 extern const ulong pause_trampoline_user_vaddr;
+
+#endif
@@ -15,6 +15,21 @@ enum acpi_init_status {
    ais_fully_initialized   = 4,
 };
 
+#define MADT_IRQ_ACTIVE_LOW            (1 << 0)
+#define MADT_IRQ_LEVEL                 (1 << 1)
+
+/* Interrupt controllers info, as read from ACPI's MADT table */
+struct acpi_madt_info {
+
+   ulong lapic_paddr;         /* Physical address of the local APIC */
+   ulong ioapic_paddr;        /* Physical address of the IO-APIC */
+   u32 ioapic_gsi_base;       /* First GSI handled by the IO-APIC */
+   bool has_8259;             /* The dual 8259 PICs are present as well */
+
+   u32 isa_gsi[16];           /* The GSI of each ISA IRQ */
+   u8 isa_flags[16];          /* MADT_IRQ_* flags for each ISA IRQ */
+};
+
 #if MOD_acpi
 
 static inline enum acpi_init_status
@@ -26,12 +41,14 @@ get_acpi_init_status(void)
 
 void acpi_mod_init_tables(void);
 void acpi_set_root_pointer(ulong);
+bool acpi_read_madt(struct acpi_madt_info *info);
 
 #else
 
 #define get_acpi_init_status()            ais_not_started
 #define acpi_mod_init_tables()
 #define acpi_set_root_pointer(...)
+#define acpi_read_madt(...)               false
 
 #endif
 
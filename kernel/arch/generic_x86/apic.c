@@ -0,0 +1,494 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_debug.h>
+#include <tilck_gen_headers/mod_acpi.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/cmdline.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/mods/acpi.h>
+
+#include "apic.h"
+#include "pit.h"
+
+/* Local APIC registers */
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080     /* Task Priority Register */
+#define LAPIC_EOI               0x0b0
+#define LAPIC_SVR               0x0f0     /* Spurious Interrupt Vector Reg. */
+#define LAPIC_ISR               0x100     /* In-Service Register (8 x 32 bit) */
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_ICR         0x380     /* Timer's initial count */
+#define LAPIC_TIMER_CCR         0x390     /* Timer's current count */
+#define LAPIC_TIMER_DCR         0x3e0     /* Timer's divide configuration */
+
+#define LAPIC_SVR_ENABLE        (1u << 8)
+#define LAPIC_LVT_MASKED        (1u << 16)
+#define LAPIC_LVT_ONESHOT       (0u << 17)
+#define LAPIC_LVT_PERIODIC      (1u << 17)
+#define LAPIC_TIMER_DIV_16      0x3
+
+#define APIC_BASE_MSR_ENABLE    (1u << 11)
+
+/* IO-APIC registers */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WIN              0x10
+#define IOAPIC_REG_VER          0x01
+#define IOAPIC_REG_REDTBL       0x10      /* 2 x 32 bit regs per pin */
+
+#define IOAPIC_RED_ACTIVE_LOW   (1u << 13)
+#define IOAPIC_RED_LEVEL        (1u << 15)
+#define IOAPIC_RED_MASKED       (1u << 16)
+
+#define IOAPIC_NO_PIN           0xff
+
+/*
+ * On P6 family CPUs, the lower 4 bits of the spurious vector are hard-wired to
+ * 1. Therefore, just use the vector of IRQ 15 and tell the spurious interrupts
+ * apart from the real IRQ 15 by checking the In-Service Register, as we do for
+ * the 8259 PICs.
+ */
+#define APIC_SPUR_VECTOR        (32 + 15)
+
+#define LAPIC_CALIB_MS          10
+
+bool apic_enabled;
+bool lapic_timer_enabled;
+
+static volatile u32 *lapic;
+static volatile u32 *ioapic;
+static u32 ioapic_max_pin;
+static u8 irq_to_pin[16];           /* IO-APIC pin for each ISA IRQ */
+
+static u32 lapic_timer_freq;        /* LAPIC timer's freq. after the divider */
+static u32 lapic_counts_per_tick;   /* counts per tick, in periodic mode */
+static u32 lapic_oneshot_ticks;     /* tick boundaries covered by one-shot */
+static u32 lapic_oneshot_count;     /* initial count of the one-shot */
+static u32 lapic_oneshot_first;     /* counts until the first tick boundary */
+static u32 lapic_subtick_rem;       /* counts until the tick boundary */
+static u32 lapic_subtick_count;     /* initial count of the sub-tick one-shot */
+
+static ALWAYS_INLINE u32 lapic_read(u32 reg)
+{
+   return lapic[reg / sizeof(u32)];
+}
+
+static ALWAYS_INLINE void lapic_write(u32 reg, u32 val)
+{
+   lapic[reg / sizeof(u32)] = val;
+}
+
+/* NOTE: the IO-APIC functions below expect the interrupts to be disabled */
+static ALWAYS_INLINE u32 ioapic_read(u32 reg)
+{
+   ioapic[IOAPIC_REGSEL / sizeof(u32)] = reg;
+   return ioapic[IOAPIC_WIN / sizeof(u32)];
+}
+
+static ALWAYS_INLINE void ioapic_write(u32 reg, u32 val)
+{
+   ioapic[IOAPIC_REGSEL / sizeof(u32)] = reg;
+   ioapic[IOAPIC_WIN / sizeof(u32)] = val;
+}
+
+static ALWAYS_INLINE bool is_lapic_timer_irq(int irq)
+{
+   return irq == X86_PC_TIMER_IRQ && lapic_timer_enabled;
+}
+
+static volatile u32 *apic_map_mmio(ulong paddr)
+{
+   void *va = hi_vmem_reserve(PAGE_SIZE);
+
+   if (!va)
+      return NULL;
+
+   if (map_kernel_page(va, paddr & PAGE_MASK, PAGING_FL_RW) < 0) {
+      hi_vmem_release(va, PAGE_SIZE);
+      return NULL;
+   }
+
+   return (volatile u32 *)((ulong)va + (paddr & OFFSET_IN_PAGE_MASK));
+}
+
+void apic_send_eoi(int irq)
+{
+   lapic_write(LAPIC_EOI, 0);
+}
+
+void apic_set_mask(int irq)
+{
+   ulong var;
+   u32 reg;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   disable_interrupts(&var);
+   {
+      if (is_lapic_timer_irq(irq)) {
+
+         lapic_write(LAPIC_LVT_TIMER,
+                     lapic_read(LAPIC_LVT_TIMER) | LAPIC_LVT_MASKED);
+
+      } else if (irq_to_pin[irq] != IOAPIC_NO_PIN) {
+
+         reg = IOAPIC_REG_REDTBL + 2 * irq_to_pin[irq];
+         ioapic_write(reg, ioapic_read(reg) | IOAPIC_RED_MASKED);
+      }
+   }
+   enable_interrupts(&var);
+}
+
+void apic_clear_mask(int irq)
+{
+   ulong var;
+   u32 reg;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   disable_interrupts(&var);
+   {
+      if (is_lapic_timer_irq(irq)) {
+
+         lapic_write(LAPIC_LVT_TIMER,
+                     lapic_read(LAPIC_LVT_TIMER) & ~LAPIC_LVT_MASKED);
+
+      } else if (irq_to_pin[irq] != IOAPIC_NO_PIN) {
+
+         reg = IOAPIC_REG_REDTBL + 2 * irq_to_pin[irq];
+         ioapic_write(reg, ioapic_read(reg) & ~IOAPIC_RED_MASKED);
+      }
+   }
+   enable_interrupts(&var);
+}
+
+bool apic_is_masked(int irq)
+{
+   ulong var;
+   bool res = true;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   disable_interrupts(&var);
+   {
+      if (is_lapic_timer_irq(irq)) {
+
+         res = lapic_read(LAPIC_LVT_TIMER) & LAPIC_LVT_MASKED;
+
+      } else if (irq_to_pin[irq] != IOAPIC_NO_PIN) {
+
+         res = ioapic_read(IOAPIC_REG_REDTBL + 2 * irq_to_pin[irq])
+                  & IOAPIC_RED_MASKED;
+      }
+   }
+   enable_interrupts(&var);
+   return res;
+}
+
+void apic_mask_and_send_eoi(int irq)
+{
+   apic_set_mask(irq);
+   apic_send_eoi(irq);
+}
+
+bool apic_is_spur_irq(int irq)
+{
+   const u32 vec = 32 + (u32)irq;
+   ASSERT(!are_interrupts_enabled());
+
+   /*
+    * A spurious interrupt never sets its bit in the ISR and must not be
+    * acknowledged with an EOI. That's the case for the LAPIC's spurious vector
+    * and for the very unlikely interrupts coming from the masked 8259 PICs.
+    */
+   return !(lapic_read(LAPIC_ISR + 0x10 * (vec / 32)) & (1u << (vec % 32)));
+}
+
+/* Is the GSI used by an ISA IRQ other than `irq`, because of an override? */
+static bool
+is_gsi_overridden(struct acpi_madt_info *info, int irq, u32 gsi)
+{
+   for (int i = 0; i < ARRAY_SIZE(info->isa_gsi); i++)
+      if (i != irq && info->isa_gsi[i] == gsi && info->isa_gsi[i] != (u32)i)
+         return true;
+
+   return false;
+}
+
+static void init_ioapic(struct acpi_madt_info *info)
+{
+   const u32 dest = lapic_read(LAPIC_ID) >> 24;
+   u32 gsi, pin, red;
+
+   ioapic_max_pin = (ioapic_read(IOAPIC_REG_VER) >> 16) & 0xff;
+
+   for (pin = 0; pin <= ioapic_max_pin; pin++) {
+      ioapic_write(IOAPIC_REG_REDTBL + 2 * pin, IOAPIC_RED_MASKED);
+      ioapic_write(IOAPIC_REG_REDTBL + 2 * pin + 1, 0);
+   }
+
+   for (int irq = 0; irq < ARRAY_SIZE(irq_to_pin); irq++) {
+
+      irq_to_pin[irq] = IOAPIC_NO_PIN;
+      gsi = info->isa_gsi[irq];
+
+      if (irq == 2)
+         continue; /* The cascade IRQ of the 8259 PICs: never used */
+
+      if (gsi < info->ioapic_gsi_base)
+         continue;
+
+      pin = gsi - info->ioapic_gsi_base;
+
+      if (pin > ioapic_max_pin)
+         continue;
+
+      if (gsi == (u32)irq && is_gsi_overridden(info, irq, gsi))
+         continue; /* Another ISA IRQ has been routed to this pin */
+
+      red = 32 + (u32)irq;     /* Same vectors as with the 8259 PICs */
+
+      if (info->isa_flags[irq] & MADT_IRQ_ACTIVE_LOW)
+         red |= IOAPIC_RED_ACTIVE_LOW;
+
+      if (info->isa_flags[irq] & MADT_IRQ_LEVEL)
+         red |= IOAPIC_RED_LEVEL;
+
+      /* Fixed delivery, physical destination: our LAPIC */
+      ioapic_write(IOAPIC_REG_REDTBL + 2 * pin + 1, dest << 24);
+      ioapic_write(IOAPIC_REG_REDTBL + 2 * pin, red | IOAPIC_RED_MASKED);
+      irq_to_pin[irq] = (u8)pin;
+   }
+}
+
+static void init_lapic(void)
+{
+   u64 base = rdmsr(MSR_IA32_APIC_BASE);
+
+   if (!(base & APIC_BASE_MSR_ENABLE))
+      wrmsr(MSR_IA32_APIC_BASE, base | APIC_BASE_MSR_ENABLE);
+
+   lapic_write(LAPIC_TPR, 0);                     /* Accept all the vectors */
+   lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+   lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);   /* No ExtINT from PICs */
+   lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+   lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPUR_VECTOR);
+   lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * Measure the frequency of the LAPIC timer, which depends on the bus clock,
+ * by letting it count down while the PIT's channel 2 counts LAPIC_CALIB_MS.
+ */
+static bool lapic_timer_calibrate(void)
+{
+   u64 freq;
+   u32 elapsed;
+
+   lapic_write(LAPIC_TIMER_DCR, LAPIC_TIMER_DIV_16);
+   lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_LVT_ONESHOT);
+   lapic_write(LAPIC_TIMER_ICR, 0xffffffff);
+
+   pit_ch2_busy_wait(PIT_FREQ / (1000 / LAPIC_CALIB_MS));
+
+   elapsed = 0xffffffff - lapic_read(LAPIC_TIMER_CCR);
+   lapic_write(LAPIC_TIMER_ICR, 0);               /* Stop the timer */
+
+   freq = (u64)elapsed * (1000 / LAPIC_CALIB_MS);
+
+   if (freq < 1000 * TIMER_HZ || freq > 0xffffffff)
+      return false; /* Too coarse, or something went wrong */
+
+   lapic_timer_freq = (u32)freq;
+   return true;
+}
+
+bool init_apic(void)
+{
+   struct acpi_madt_info info;
+   ASSERT(!are_interrupts_enabled());
+
+   if (kopt_noapic || !x86_cpu_features.edx1.apic)
+      return false;
+
+   if (!acpi_read_madt(&info))
+      return false;
+
+   if (!(lapic = apic_map_mmio(info.lapic_paddr)))
+      return false;
+
+   if (!(ioapic = apic_map_mmio(info.ioapic_paddr)))
+      return false;
+
+   init_lapic();
+   init_ioapic(&info);
+   apic_enabled = true;
+   lapic_timer_enabled = lapic_timer_calibrate();
+
+   printk("APIC: using LAPIC + IO-APIC (%u pins)\n", ioapic_max_pin + 1);
+
+   if (lapic_timer_enabled)
+      printk("APIC: LAPIC timer freq: %u kHz\n", lapic_timer_freq / 1000);
+   else
+      printk("APIC: LAPIC timer calibration failed, use the PIT\n");
+
+   return true;
+}
+
+/*
+ * LAPIC timer: same interface as the PIT's functions in pit.c, but with a
+ * 32-bit counter and no slow port I/O.
+ */
+
+static bool lapic_subtick_program(u32 rem, u32 off);
+
+static void lapic_timer_set(u32 mode, u32 count)
+{
+   const u32 masked = lapic_read(LAPIC_LVT_TIMER) & LAPIC_LVT_MASKED;
+
+   lapic_write(LAPIC_LVT_TIMER, masked | mode | (32 + X86_PC_TIMER_IRQ));
+   lapic_write(LAPIC_TIMER_ICR, count);
+}
+
+u32 lapic_timer_setup(u32 interval)
+{
+   u64 counts = (u64)lapic_timer_freq * interval / TS_SCALE;
+   ASSERT(IN_RANGE_INC(counts, 1, 0xffffffff));
+
+   lapic_counts_per_tick = (u32)counts;
+   lapic_write(LAPIC_TIMER_DCR, LAPIC_TIMER_DIV_16);
+   lapic_timer_periodic_resume();
+
+   return (u32)(counts * TS_SCALE / lapic_timer_freq);
+}
+
+void lapic_timer_periodic_resume(void)
+{
+   lapic_timer_set(LAPIC_LVT_PERIODIC, lapic_counts_per_tick);
+}
+
+u32 lapic_timer_oneshot_start(u32 ticks)
+{
+   u32 first, max_ticks;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(ticks > 0);
+
+   first = lapic_read(LAPIC_TIMER_CCR);
+
+   if (!IN_RANGE_INC(first, 1, lapic_counts_per_tick))
+      return 0;
+
+   max_ticks = 1 + (0xffffffff - first) / lapic_counts_per_tick;
+   ticks = MIN(ticks, max_ticks);
+
+   lapic_oneshot_ticks = ticks;
+   lapic_oneshot_first = first;
+   lapic_oneshot_count = first + (ticks - 1) * lapic_counts_per_tick;
+   lapic_timer_set(LAPIC_LVT_ONESHOT, lapic_oneshot_count);
+   return ticks;
+}
+
+u32 lapic_timer_oneshot_stop(bool *expired)
+{
+   u32 count, elapsed, passed, rem;
+   ASSERT(!are_interrupts_enabled());
+
+   count = lapic_read(LAPIC_TIMER_CCR);
+
+   if (!count) {
+      *expired = true;
+      return lapic_oneshot_ticks;
+   }
+
+   *expired = false;
+   count = MIN(count, lapic_oneshot_count);
+   elapsed = lapic_oneshot_count - count;
+
+   if (elapsed < lapic_oneshot_first) {
+      passed = 0;
+      rem = lapic_oneshot_first - elapsed;
+   } else {
+      elapsed -= lapic_oneshot_first;
+      passed = 1 + elapsed / lapic_counts_per_tick;
+      rem = lapic_counts_per_tick - elapsed % lapic_counts_per_tick;
+   }
+
+   /* Make the IRQ fire on the next tick boundary */
+   lapic_subtick_program(rem, 0);
+   return passed;
+}
+
+/*
+ * Sub-tick one-shots: same as in pit.c, except that the LAPIC timer stops at
+ * zero in one-shot mode, therefore the time between the expiry and the next
+ * lapic_timer_subtick_next() call is lost, as it is in lapic_timer_periodic_resume().
+ */
+
+static u32 lapic_off_to_counts(u32 off)
+{
+   const u64 counts = (u64)off * lapic_timer_freq / TS_SCALE;
+   return (u32)MIN(counts, (u64)lapic_counts_per_tick);
+}
+
+static bool lapic_subtick_program(u32 rem, u32 off)
+{
+   const u32 per_tick = lapic_counts_per_tick;
+   const u32 from_start = per_tick - MIN(rem, per_tick);
+   u32 count = rem;
+   bool before_boundary = false;
+
+   if (off) {
+
+      const u32 target = lapic_off_to_counts(off);
+      const u32 delta = target > from_start ? target - from_start : 1;
+
+      if (delta < rem) {
+         count = delta;
+         before_boundary = true;
+      }
+   }
+
+   lapic_subtick_rem = rem;
+   lapic_subtick_count = count;
+   lapic_timer_set(LAPIC_LVT_ONESHOT, count);
+   return before_boundary;
+}
+
+bool lapic_timer_subtick_start(u32 off)
+{
+   u32 first;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(off > 0);
+
+   first = lapic_read(LAPIC_TIMER_CCR);
+
+   if (!IN_RANGE_INC(first, 2, lapic_counts_per_tick))
+      return false;
+
+   if (lapic_off_to_counts(off) >= lapic_counts_per_tick)
+      return false;
+
+   return lapic_subtick_program(first, off);
+}
+
+bool lapic_timer_subtick_next(u32 off)
+{
+   const u32 count = lapic_read(LAPIC_TIMER_CCR);
+   const u32 elapsed = lapic_subtick_count - MIN(count, lapic_subtick_count);
+   u32 rem = 1;
+   ASSERT(!are_interrupts_enabled());
+
+   if (elapsed < lapic_subtick_rem)
+      rem = lapic_subtick_rem - elapsed;
+
+   return lapic_subtick_program(rem, off);
+}
+
+bool lapic_timer_oneshot_expired(void)
+{
+   return lapic_read(LAPIC_TIMER_CCR) == 0;
+}
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+extern bool apic_enabled;           /* IRQs come through LAPIC + IO-APIC */
+extern bool lapic_timer_enabled;    /* The LAPIC timer replaces the PIT */
+
+bool init_apic(void);
+void apic_send_eoi(int irq);
+void apic_mask_and_send_eoi(int irq);
+bool apic_is_spur_irq(int irq);
+void apic_set_mask(int irq);
+void apic_clear_mask(int irq);
+bool apic_is_masked(int irq);
+
+u32 lapic_timer_setup(u32 interval);
+void lapic_timer_periodic_resume(void);
+u32 lapic_timer_oneshot_start(u32 ticks);
+u32 lapic_timer_oneshot_stop(bool *expired);
+bool lapic_timer_oneshot_expired(void);
+bool lapic_timer_subtick_start(u32 off);
+bool lapic_timer_subtick_next(u32 off);
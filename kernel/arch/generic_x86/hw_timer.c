@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/hal.h>
+
+#include "apic.h"
+#include "pit.h"
+
+/*
+ * The HAL timer interface: use the LAPIC timer when it's available and it has
+ * been calibrated, the legacy PIT otherwise. See pit.c for the semantics.
+ */
+
+u32 hw_timer_setup(u32 interval)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_setup(interval);
+
+   return pit_timer_setup(interval);
+}
+
+void hw_timer_periodic_resume(void)
+{
+   if (lapic_timer_enabled)
+      lapic_timer_periodic_resume();
+   else
+      pit_periodic_resume();
+}
+
+u32 hw_timer_oneshot_start(u32 ticks)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_oneshot_start(ticks);
+
+   return pit_oneshot_start(ticks);
+}
+
+u32 hw_timer_oneshot_stop(bool *expired)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_oneshot_stop(expired);
+
+   return pit_oneshot_stop(expired);
+}
+
+bool hw_timer_oneshot_expired(void)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_oneshot_expired();
+
+   return pit_oneshot_expired();
+}
+
+bool hw_timer_subtick_start(u32 off)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_subtick_start(off);
+
+   return pit_subtick_start(off);
+}
+
+bool hw_timer_subtick_next(u32 off)
+{
+   if (lapic_timer_enabled)
+      return lapic_timer_subtick_next(off);
+
+   return pit_subtick_next(off);
+}
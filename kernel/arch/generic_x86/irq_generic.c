@@ -13,6 +13,7 @@
 #include <tilck/kernel/timer.h>
 
 #include "pic.h"
+#include "apic.h"
 
 struct list irq_handlers_lists[16] = {
    STATIC_LIST_INIT(irq_handlers_lists[ 0]),
@@ -64,6 +65,54 @@ void irq_uninstall_handler(u8 irq, struct irq_handler_node *n)
    enable_interrupts(&var);
 }
 
+void irq_set_mask(int irq)
+{
+   if (apic_enabled)
+      apic_set_mask(irq);
+   else
+      pic_set_mask(irq);
+}
+
+void irq_clear_mask(int irq)
+{
+   if (apic_enabled)
+      apic_clear_mask(irq);
+   else
+      pic_clear_mask(irq);
+}
+
+bool irq_is_masked(int irq)
+{
+   if (apic_enabled)
+      return apic_is_masked(irq);
+
+   return pic_is_masked(irq);
+}
+
+static inline void irq_send_eoi(int irq)
+{
+   if (apic_enabled)
+      apic_send_eoi(irq);
+   else
+      pic_send_eoi(irq);
+}
+
+static inline void irq_mask_and_send_eoi(int irq)
+{
+   if (apic_enabled)
+      apic_mask_and_send_eoi(irq);
+   else
+      pic_mask_and_send_eoi(irq);
+}
+
+static inline bool irq_is_spur(int irq)
+{
+   if (apic_enabled)
+      return apic_is_spur_irq(irq);
+
+   return pic_is_spur_irq(irq);
+}
+
 static inline void handle_irq_set_mask_and_eoi(int irq)
 {
    if (KRN_TRACK_NESTED_INTERR) {
@@ -75,12 +124,12 @@ static inline void handle_irq_set_mask_and_eoi(int irq)
        */
 
       if (irq != X86_PC_TIMER_IRQ)
-         pic_mask_and_send_eoi(irq);
+         irq_mask_and_send_eoi(irq);
       else
-         pic_send_eoi(irq);
+         irq_send_eoi(irq);
 
    } else {
-      pic_mask_and_send_eoi(irq);
+      irq_mask_and_send_eoi(irq);
    }
 }
 
@@ -105,11 +154,12 @@ void arch_irq_handling(regs_t *r)
    ASSERT(!are_interrupts_enabled());
    ASSERT(!is_preemption_enabled());
 
-   if (pic_is_spur_irq(irq)) {
+   if (irq_is_spur(irq)) {
       spur_irq_count++;
       return;
    }
 
+   nohz_irq_enter(irq);
    push_nested_interrupt(r->int_num);
    handle_irq_set_mask_and_eoi(irq);
    enable_interrupts_forced();
@@ -10,6 +10,7 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/system_mmap.h>
 #include <tilck/kernel/vdso.h>
@@ -57,6 +58,27 @@ void release_pageframes_mapped_at(pdir_t *pdir, void *vaddrp, size_t len)
    }
 }
 
+void retain_kernel_page(void *vaddr)
+{
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+   pf_ref_count_inc(LIN_VA_TO_PA(vaddr));
+}
+
+void release_kernel_page(void *vaddr)
+{
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+
+   if (!pf_ref_count_dec(LIN_VA_TO_PA(vaddr))) {
+      ASSERT(vaddr != zero_page);
+      kfree_page(vaddr);
+   }
+}
+
+u32 page_ref_count(void *vaddr)
+{
+   return pf_ref_count_get(LIN_VA_TO_PA(vaddr));
+}
+
 void invalidate_page(ulong vaddr)
 {
    invalidate_page_hw(vaddr);
@@ -95,17 +117,18 @@ void init_paging(void)
    init_hi_vmem_heap();
 
    /*
-    * Now use the just-created hi vmem heap to reserve a page for the user
-    * vdso-like page and expect it to be == USER_VDSO_VADDR.
+    * Now use the just-created hi vmem heap to reserve two pages for the user
+    * vdso-like page and its data page and expect them to be at USER_VDSO_VADDR.
     */
-   user_vdso_vaddr = hi_vmem_reserve(PAGE_SIZE);
+   user_vdso_vaddr = hi_vmem_reserve(2 * PAGE_SIZE);
 
    if (user_vdso_vaddr != (void *)USER_VDSO_VADDR)
       panic("user_vdso_vaddr != USER_VDSO_VADDR");
 
    /*
-    * Map a special vdso-like page used for the sysenter interface.
-    * This is the only user-mapped page with a vaddr in the kernel space.
+    * Map a special vdso-like page used for the sysenter interface and for the
+    * __vdso_* functions. Along with the vDSO data page below, this is the only
+    * user-mapped page with a vaddr in the kernel space.
     */
    rc = map_page(get_kernel_pdir(),
                  user_vdso_vaddr,
@@ -114,6 +137,18 @@ void init_paging(void)
 
    if (rc < 0)
       panic("Unable to map the vdso-like page");
+
+   /*
+    * Map the vDSO data page, read-only for userspace. The kernel writes it
+    * through its regular mapping in the kernel image.
+    */
+   rc = map_page(get_kernel_pdir(),
+                 (void *)USER_VDSO_DATA_VADDR,
+                 KERNEL_VA_TO_PA(&vdso_data_page),
+                 PAGING_FL_US);
+
+   if (rc < 0)
+      panic("Unable to map the vdso data page");
 }
 
 void *
@@ -149,7 +149,7 @@ void pic_mask_and_send_eoi(int __irq)
    enable_interrupts(&var);
 }
 
-void irq_set_mask(int irq)
+void pic_set_mask(int irq)
 {
    u16 port;
    ulong var;
@@ -182,7 +182,7 @@ void irq_set_mask(int irq)
    enable_interrupts(&var);
 }
 
-void irq_clear_mask(int irq)
+void pic_clear_mask(int irq)
 {
    u16 port;
    ulong var;
@@ -205,7 +205,7 @@ void irq_clear_mask(int irq)
    enable_interrupts(&var);
 }
 
-bool irq_is_masked(int irq)
+bool pic_is_masked(int irq)
 {
    ulong var;
    bool res;
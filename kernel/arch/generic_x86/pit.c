@@ -5,7 +5,7 @@
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/datetime.h>
 
-#define PIT_FREQ           1193182
+#include "pit.h"
 
 #define PIT_CMD_PORT          0x43
 #define PIT_CH0_PORT          0x40
@@ -31,6 +31,24 @@
 #define PIT_CH2         0b10000000   // select channel 2
 
 #define PIT_READ_BACK   0b11000000   // read-back command (8254 only)
+#define PIT_RB_NO_COUNT 0b00100000   // read-back: don't latch the count
+#define PIT_RB_NO_STAT  0b00010000   // read-back: don't latch the status
+#define PIT_RB_CH0      0b00000010   // read-back: select channel 0
+
+#define PIT_STAT_OUT    0b10000000   // status: state of the OUT pin
+#define PIT_STAT_NULL   0b01000000   // status: null count (not loaded yet)
+
+#define PIT_CH2_CTRL_PORT     0x61   // NMI status & control: gate/out of ch2
+#define PIT_CH2_GATE    0b00000001   // ch2 gate input
+#define PIT_CH2_SPKR    0b00000010   // PC speaker data enable
+#define PIT_CH2_OUT     0b00100000   // ch2 output status
+
+static u32 pit_divisor;          /* counts per tick, in periodic mode */
+static u32 pit_oneshot_ticks;    /* tick boundaries covered by the one-shot */
+static u32 pit_oneshot_count;    /* initial count of the one-shot */
+static u32 pit_oneshot_first;    /* counts until the first tick boundary */
+static u32 pit_subtick_rem;      /* counts until the tick boundary, see below */
+static u32 pit_subtick_count;    /* initial count of the sub-tick one-shot */
 
 /*
  * Set the time between ticks to be `interval`, where 1 means 1/TS_SCALE sec.
@@ -39,7 +57,7 @@
  *
  * Returns the _real_ interval between ticks, which is hw-specific.
  */
-u32 hw_timer_setup(u32 interval)
+u32 pit_timer_setup(u32 interval)
 {
    const u32 hz = TS_SCALE / interval;
    const u32 divisor = PIT_FREQ / hz;
@@ -78,9 +96,250 @@ u32 hw_timer_setup(u32 interval)
    actual_interval /= PIT_FREQ;
    ASSERT(actual_interval < UINT32_MAX);
 
-   outb(PIT_CMD_PORT, PIT_MODE_BIN | PIT_MODE_2 | PIT_ACC_LOHI | PIT_CH0);
-   outb(PIT_CH0_PORT, divisor & 0xff);            /* Set low byte of divisor */
-   outb(PIT_CH0_PORT, (divisor >> 8) & 0xff);     /* Set high byte of divisor */
-
+   pit_divisor = divisor;
+   pit_periodic_resume();
    return (u32)actual_interval;
 }
+
+static bool pit_subtick_program(u32 rem, u32 off);
+
+static void pit_set_ch0(u8 mode, u32 count)
+{
+   ASSERT(IN_RANGE_INC(count, 1, 0xffff));
+
+   outb(PIT_CMD_PORT, PIT_MODE_BIN | mode | PIT_ACC_LOHI | PIT_CH0);
+   outb(PIT_CH0_PORT, count & 0xff);              /* Set low byte of count */
+   outb(PIT_CH0_PORT, (count >> 8) & 0xff);       /* Set high byte of count */
+}
+
+static u32 pit_read_ch0_count(void)
+{
+   u32 lo, hi;
+
+   outb(PIT_CMD_PORT, PIT_CH0);                   /* Counter latch command */
+   lo = inb(PIT_CH0_PORT);
+   hi = inb(PIT_CH0_PORT);
+   return lo | (hi << 8);
+}
+
+/*
+ * Go back to the regular periodic mode, starting a whole new tick from now.
+ * Expects interrupts to be disabled, as all the functions below.
+ */
+void pit_periodic_resume(void)
+{
+   pit_set_ch0(PIT_MODE_2, pit_divisor);
+}
+
+/*
+ * Stop the periodic ticks and program a one-shot IRQ on the `ticks`-th tick
+ * boundary from now, keeping the phase of the periodic ticks: the first of
+ * them is still due when the current tick ends.
+ *
+ * Returns the number of tick boundaries actually covered by the one-shot,
+ * which might be less than `ticks` because of the 16-bit counter. In case
+ * of 0, nothing has been done.
+ */
+u32 pit_oneshot_start(u32 ticks)
+{
+   u32 first, max_ticks;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(ticks > 0);
+
+   first = pit_read_ch0_count();
+
+   if (!IN_RANGE_INC(first, 1, pit_divisor))
+      return 0; /* The counter is being reloaded right now: don't bother */
+
+   max_ticks = 1 + (0xffff - first) / pit_divisor;
+   ticks = MIN(ticks, max_ticks);
+
+   pit_oneshot_ticks = ticks;
+   pit_oneshot_first = first;
+   pit_oneshot_count = first + (ticks - 1) * pit_divisor;
+   pit_set_ch0(PIT_MODE_0, pit_oneshot_count);
+   return ticks;
+}
+
+/*
+ * Stop the one-shot started by pit_oneshot_start(). Returns the number of
+ * tick boundaries passed since then. If the one-shot already expired, that's
+ * the whole number of ticks it covered, `*expired` is set and the IRQ has been
+ * (or will be) raised. Otherwise, the hardware is left in one-shot mode and it
+ * will raise an IRQ on the next tick boundary: the caller is expected to call
+ * pit_periodic_resume() then.
+ */
+u32 pit_oneshot_stop(bool *expired)
+{
+   u32 status, count, elapsed, passed, rem;
+   ASSERT(!are_interrupts_enabled());
+
+   outb(PIT_CMD_PORT, PIT_READ_BACK | PIT_RB_CH0);   /* status + count */
+   status = inb(PIT_CH0_PORT);
+   count = inb(PIT_CH0_PORT);
+   count |= (u32)inb(PIT_CH0_PORT) << 8;
+
+   if (status & PIT_STAT_OUT) {
+      *expired = true;
+      return pit_oneshot_ticks;
+   }
+
+   *expired = false;
+
+   if (status & PIT_STAT_NULL)
+      count = pit_oneshot_count;      /* The count has not been loaded yet */
+
+   count = MIN(count, pit_oneshot_count);
+   elapsed = pit_oneshot_count - count;
+
+   if (elapsed < pit_oneshot_first) {
+      passed = 0;
+      rem = pit_oneshot_first - elapsed;
+   } else {
+      elapsed -= pit_oneshot_first;
+      passed = 1 + elapsed / pit_divisor;
+      rem = pit_divisor - elapsed % pit_divisor;
+   }
+
+   /* Make the IRQ fire on the next tick boundary */
+   pit_subtick_program(rem, 0);
+   return passed;
+}
+
+/*
+ * Sub-tick one-shots
+ * --------------------
+ *
+ * Split the current tick in order to get an IRQ at `off` (in TS_SCALE units)
+ * from its beginning, for the high-resolution timers. The tick boundary is
+ * kept: after the last sub-tick event, a final one-shot fires exactly there
+ * and the caller is expected to call pit_periodic_resume() on its IRQ, as for
+ * pit_oneshot_stop(). Because in mode 0 the counter keeps going after the
+ * terminal count, we can measure how late we are and lose no time.
+ */
+
+static u32 pit_off_to_counts(u32 off)
+{
+   return (u32)MIN((u64)off * PIT_FREQ / TS_SCALE, (u64)pit_divisor);
+}
+
+/* Counts elapsed since the last one-shot started by pit_subtick_program() */
+static u32 pit_subtick_elapsed(void)
+{
+   u32 status, count;
+
+   outb(PIT_CMD_PORT, PIT_READ_BACK | PIT_RB_CH0);   /* status + count */
+   status = inb(PIT_CH0_PORT);
+   count = inb(PIT_CH0_PORT);
+   count |= (u32)inb(PIT_CH0_PORT) << 8;
+
+   if (status & PIT_STAT_NULL)
+      return 0;                  /* The count has not been loaded yet */
+
+   if (status & PIT_STAT_OUT)
+      return pit_subtick_count + ((0x10000 - count) & 0xffff);
+
+   return pit_subtick_count - MIN(count, pit_subtick_count);
+}
+
+/*
+ * Program a one-shot either at `off` from the beginning of the current tick or
+ * at its end, whichever comes first, given `rem` counts until the tick
+ * boundary. Returns true in the first case.
+ */
+static bool pit_subtick_program(u32 rem, u32 off)
+{
+   const u32 from_start = pit_divisor - MIN(rem, pit_divisor);
+   u32 count = rem;
+   bool before_boundary = false;
+
+   if (off) {
+
+      const u32 target = pit_off_to_counts(off);
+      const u32 delta = target > from_start ? target - from_start : 1;
+
+      if (delta < rem) {
+         count = delta;
+         before_boundary = true;
+      }
+   }
+
+   pit_subtick_rem = rem;
+   pit_subtick_count = count;
+   pit_set_ch0(PIT_MODE_0, count);
+   return before_boundary;
+}
+
+/*
+ * Start splitting the current tick, while in periodic mode. Returns false if
+ * `off` is not before the end of the current tick: in that case, nothing has
+ * been done.
+ */
+bool pit_subtick_start(u32 off)
+{
+   u32 first;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(off > 0);
+
+   first = pit_read_ch0_count();
+
+   if (!IN_RANGE_INC(first, 2, pit_divisor))
+      return false; /* The counter is being reloaded right now: don't bother */
+
+   if (pit_off_to_counts(off) >= pit_divisor)
+      return false;
+
+   return pit_subtick_program(first, off);
+}
+
+/*
+ * Re-program the one-shot within the current tick, after the IRQ of the last
+ * sub-tick event or to anticipate it. With `off` == 0, the next IRQ will be on
+ * the tick boundary. Returns true if the next IRQ will be before it.
+ */
+bool pit_subtick_next(u32 off)
+{
+   const u32 elapsed = pit_subtick_elapsed();
+   u32 rem = 1;
+   ASSERT(!are_interrupts_enabled());
+
+   if (elapsed < pit_subtick_rem)
+      rem = pit_subtick_rem - elapsed;
+
+   return pit_subtick_program(rem, off);
+}
+
+/* Has the one-shot currently programmed already reached its terminal count? */
+bool pit_oneshot_expired(void)
+{
+   outb(PIT_CMD_PORT, PIT_READ_BACK | PIT_RB_NO_COUNT | PIT_RB_CH0);
+   return !!(inb(PIT_CH0_PORT) & PIT_STAT_OUT);
+}
+
+/*
+ * Busy-wait for `counts` PIT cycles (at most 65535), using the channel 2 with
+ * the PC speaker disconnected. It does not need any IRQs and it does not touch
+ * the channel 0, therefore it's suitable for calibrating the other timers.
+ */
+void pit_ch2_busy_wait(u32 counts)
+{
+   u8 ctrl;
+   ASSERT(IN_RANGE_INC(counts, 1, 0xffff));
+
+   /* Disable the gate and the speaker */
+   ctrl = inb(PIT_CH2_CTRL_PORT) & ~(PIT_CH2_GATE | PIT_CH2_SPKR);
+   outb(PIT_CH2_CTRL_PORT, ctrl);
+
+   outb(PIT_CMD_PORT, PIT_MODE_BIN | PIT_MODE_0 | PIT_ACC_LOHI | PIT_CH2);
+   outb(PIT_CH2_PORT, counts & 0xff);
+   outb(PIT_CH2_PORT, (counts >> 8) & 0xff);
+
+   /* Enable the gate: the counting starts now */
+   outb(PIT_CH2_CTRL_PORT, ctrl | PIT_CH2_GATE);
+
+   while (!(inb(PIT_CH2_CTRL_PORT) & PIT_CH2_OUT)) {
+      /* wait */
+   }
+
+   outb(PIT_CH2_CTRL_PORT, ctrl);
+}
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#define PIT_FREQ           1193182
+
+u32 pit_timer_setup(u32 interval);
+void pit_periodic_resume(void);
+u32 pit_oneshot_start(u32 ticks);
+u32 pit_oneshot_stop(bool *expired);
+bool pit_oneshot_expired(void);
+bool pit_subtick_start(u32 off);
+bool pit_subtick_next(u32 off);
+void pit_ch2_busy_wait(u32 counts);
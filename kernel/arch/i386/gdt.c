@@ -381,6 +381,78 @@ static void gdt_set_slot(struct process *pi, u16 slot, u16 gdt_index)
    get_proc_arch_fields(pi)->gdt_entries[slot] = gdt_index;
 }
 
+static inline bool is_empty_user_desc(struct user_desc *dc)
+{
+   return dc->flags == USER_DESC_FLAGS_EMPTY && !dc->base_addr && !dc->limit;
+}
+
+static void user_desc_to_gdt_entry(struct user_desc *dc, struct gdt_entry *e)
+{
+   gdt_set_entry(e, dc->base_addr, dc->limit, 0, 0);
+   e->s = 1;
+   e->dpl = 3;
+   e->d = dc->seg_32bit;
+   e->type |= (dc->contents << 2);
+   e->type |= !dc->read_exec_only ? GDT_ACCESS_RW : 0;
+   e->g = dc->limit_in_pages;
+   e->avl = dc->useable;
+   e->p = !dc->seg_not_present;
+}
+
+static void task_set_tls(struct task *ti, u32 index, struct gdt_entry *e)
+{
+   arch_task_members_t *arch = get_task_arch_fields(ti);
+   STATIC_ASSERT(sizeof(arch->tls_desc) == sizeof(*e));
+
+   arch->tls_gdt_index = (u16)index;
+   memcpy(arch->tls_desc, e, sizeof(*e));
+}
+
+/*
+ * Threads of the same process share the GDT entries allocated with
+ * set_thread_area(), but each one of them has its own TLS descriptor, loaded
+ * by switch_to_task() with this function.
+ */
+void gdt_load_task_tls(struct task *ti)
+{
+   arch_task_members_t *arch = get_task_arch_fields(ti);
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(arch->tls_gdt_index < gdt_size);
+
+   memcpy(&gdt[arch->tls_gdt_index], arch->tls_desc, sizeof(struct gdt_entry));
+}
+
+/*
+ * Set the TLS of the new thread `ti`, as requested by clone(CLONE_SETTLS).
+ * Unlike set_thread_area(), we don't allocate anything here: the entry must
+ * be one of the GDT entries already allocated by the process.
+ */
+int gdt_set_new_thread_tls(struct task *ti, void *arg)
+{
+   struct gdt_entry e = {0};
+   struct user_desc dc;
+
+   if (copy_from_user(&dc, arg, sizeof(struct user_desc)))
+      return -EFAULT;
+
+   if (is_empty_user_desc(&dc))
+      return -EINVAL;
+
+   disable_preemption();
+   {
+      if (get_user_task_slot_for_gdt_entry(dc.entry_number) < 0) {
+         enable_preemption();
+         return -EINVAL;
+      }
+
+      user_desc_to_gdt_entry(&dc, &e);
+      task_set_tls(ti, dc.entry_number, &e);
+   }
+   enable_preemption();
+   return 0;
+}
+
 int sys_set_thread_area(void *arg)
 {
    int rc = 0;
@@ -395,16 +467,8 @@ int sys_set_thread_area(void *arg)
 
    disable_preemption();
 
-   if (!(dc.flags == USER_DESC_FLAGS_EMPTY && !dc.base_addr && !dc.limit)) {
-      gdt_set_entry(&e, dc.base_addr, dc.limit, 0, 0);
-      e.s = 1;
-      e.dpl = 3;
-      e.d = dc.seg_32bit;
-      e.type |= (dc.contents << 2);
-      e.type |= !dc.read_exec_only ? GDT_ACCESS_RW : 0;
-      e.g = dc.limit_in_pages;
-      e.avl = dc.useable;
-      e.p = !dc.seg_not_present;
+   if (!is_empty_user_desc(&dc)) {
+      user_desc_to_gdt_entry(&dc, &e);
    } else {
       /* The user passed an empty descriptor: entry_number cannot be -1 */
       if (dc.entry_number == INVALID_ENTRY_NUM) {
@@ -438,6 +502,7 @@ int sys_set_thread_area(void *arg)
       }
 
       gdt_set_slot(get_curr_proc(), (u16)slot, (u16)dc.entry_number);
+      task_set_tls(get_curr_task(), dc.entry_number, &e);
       goto out;
    }
 
@@ -469,6 +534,7 @@ int sys_set_thread_area(void *arg)
    ASSERT(dc.entry_number < gdt_size);
 
    set_entry_num(dc.entry_number, &e);
+   task_set_tls(get_curr_task(), dc.entry_number, &e);
 
    /*
     * We're here because either we found a slot already containing this index
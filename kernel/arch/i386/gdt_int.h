@@ -133,11 +133,15 @@ struct user_desc {
    };
 };
 
+struct task;
+
 void load_ldt(u32 entry_index_in_gdt, u32 dpl);
 void gdt_set_entry(struct gdt_entry *e, ulong base, ulong lim, u8 accs, u8 fl);
 int gdt_add_entry(struct gdt_entry *e);
 void gdt_clear_entry(u32 index);
 void gdt_entry_inc_ref_count(u32 n);
+void gdt_load_task_tls(struct task *ti);
+int gdt_set_new_thread_tls(struct task *ti, void *arg);
 
 #define TSS_MAIN                   0
 #define TSS_DOUBLE_FAULT           1
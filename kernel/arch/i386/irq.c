@@ -10,18 +10,24 @@
 
 #include "idt_int.h"
 #include "../generic_x86/pic.h"
+#include "../generic_x86/apic.h"
 
 
 /*
  * We first remap the interrupt controllers, and then we install
  * the appropriate ISRs to the correct entries in the IDT. This
  * is just like installing the exception handlers.
+ *
+ * When the LAPIC and the IO-APIC are available, the 8259 PICs are left
+ * completely masked and the IO-APIC delivers the ISA IRQs using the same
+ * vectors (32 + irq). Therefore, nothing else changes.
  */
 
 void init_irq_handling(void)
 {
    ASSERT(!are_interrupts_enabled());
    init_pic_8259(32, 40);
+   init_apic();
 
    for (int i = 0; i < ARRAY_SIZE(irq_handlers_lists); i++) {
 
@@ -11,6 +11,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/hal.h>
@@ -40,9 +41,117 @@ pdir_get_page_table(pdir_t *pdir, u32 i)
    return PA_TO_LIN_VA(pdir->entries[i].ptaddr << PAGE_SHIFT);
 }
 
+/*
+ * Page tables are copy-on-write too: pdir_clone() doesn't copy them, but just
+ * marks as read-only the page directory entries in both the page directories,
+ * which share the same page tables. The ref-count of a page table's pageframe
+ * is the number of page directories sharing it, or 0 when it's private.
+ *
+ * A shared page table is copied at the first attempt to modify it: a write
+ * to one of its pages or a map/unmap operation in its range. Only at that
+ * point the private pages it maps are marked as CoW, exactly as it happened
+ * for all the page tables at fork time, before.
+ */
+static page_table_t *pdir_unshare_page_table(pdir_t *pdir, u32 pd_index)
+{
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+   page_table_t *orig_pt = pdir_get_page_table(pdir, pd_index);
+   const ulong orig_pt_paddr = LIN_VA_TO_PA(orig_pt);
+   page_table_t *new_pt = orig_pt;
+
+   ASSERT(e->avail & PDE_COW_PT);
+   ASSERT(pf_ref_count_get(orig_pt_paddr) > 0);
+
+   if (pf_ref_count_get(orig_pt_paddr) > 1) {
+
+      if (!(new_pt = kalloc_page()))
+         return NULL;
+
+      /* Mark all the non-shared pages in that page-table as COW. */
+      for (u32 j = 0; j < 1024; j++) {
+
+         page_t *const p = &orig_pt->pages[j];
+
+         if (!p->present)
+            continue;
+
+         const ulong orig_paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+
+         /* Sanity-check: a mapped page MUST have ref-count > 0 */
+         ASSERT(pf_ref_count_get(orig_paddr) > 0);
+
+         if (!(p->avail & PAGE_SHARED)) {
+
+            if (p->rw)
+               p->avail |= PAGE_COW_ORIG_RW;
+
+            p->rw = false;
+         }
+
+         pf_ref_count_inc(orig_paddr);
+      }
+
+      memcpy32(new_pt, orig_pt, sizeof(page_table_t) / 4);
+      e->ptaddr = SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
+
+   } else {
+
+      /*
+       * All the other page directories have already copied or released this
+       * page table: it's ours now and its entries are still valid.
+       */
+   }
+
+   pf_ref_count_dec(orig_pt_paddr);
+   e->avail &= ~PDE_COW_PT;
+   e->rw = true;
+
+   /*
+    * Flush the whole TLB, because we changed a page directory entry and,
+    * possibly, many page table entries.
+    */
+   if (pdir == get_curr_pdir())
+      set_curr_pdir(pdir);
+
+   return new_pt;
+}
+
+/*
+ * Get the page table for the given page directory entry, ready to be modified:
+ * a shared page table is copied, if necessary. Returns NULL in case of OOM.
+ */
+static ALWAYS_INLINE page_table_t *
+pdir_get_private_page_table(pdir_t *pdir, u32 pd_index)
+{
+   if (UNLIKELY(pdir->entries[pd_index].avail & PDE_COW_PT))
+      return pdir_unshare_page_table(pdir, pd_index);
+
+   return pdir_get_page_table(pdir, pd_index);
+}
+
+static void cow_out_of_memory(const char *what)
+{
+   struct task *curr = get_curr_task();
+
+   if (!curr->running_in_kernel) {
+
+      // The task was not running in kernel: we can safely kill it.
+      printk("Out-of-memory: killing pid %d\n", get_curr_pid());
+      send_signal2(get_curr_pid(), curr->tid, SIGKILL, SIG_FL_FAULT);
+      return;
+   }
+
+   // We cannot kill a task running in kernel during a CoW page fault
+   // In this case (but in the one above too), Linux puts the process to
+   // sleep, while the OOM killer runs and frees some memory.
+   panic("Out-of-memory: can't copy a CoW %s [pid %d]", what, get_curr_pid());
+}
+
 bool handle_potential_cow(void *context)
 {
    regs_t *r = context;
+   pdir_t *pdir = get_curr_pdir();
+   page_table_t *pt;
    u32 vaddr;
 
    if ((r->err_code & PAGE_FAULT_FL_COW) != PAGE_FAULT_FL_COW)
@@ -53,7 +162,25 @@ bool handle_potential_cow(void *context)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
    const void *const page_vaddr = (void *)(vaddr & PAGE_MASK);
-   page_table_t *pt = pdir_get_page_table(get_curr_pdir(), pd_index);
+
+   if (pdir->entries[pd_index].avail & PDE_COW_PT) {
+
+      if (!(pt = pdir_unshare_page_table(pdir, pd_index))) {
+         cow_out_of_memory("page table");
+         return true;
+      }
+
+      /*
+       * The page might have been writable, just its page table was shared:
+       * in that case, we're done.
+       */
+      if (pt->pages[pt_index].rw)
+         return true;
+
+   } else {
+
+      pt = pdir_get_page_table(pdir, pd_index);
+   }
 
    if (!(pt->pages[pt_index].avail & PAGE_COW_ORIG_RW))
       return false; /* Not a COW page */
@@ -79,27 +206,11 @@ bool handle_potential_cow(void *context)
    }
 
    // Allocate a new page.
-   void *new_page_vaddr = kmalloc(PAGE_SIZE);
+   void *new_page_vaddr = kalloc_page();
 
    if (!new_page_vaddr) {
-
-      // Out-of-memory case
-      struct task *curr = get_curr_task();
-
-      if (!curr->running_in_kernel) {
-
-         // The task was not running in kernel: we can safely kill it.
-         printk("Out-of-memory: killing pid %d\n", get_curr_pid());
-         send_signal(get_curr_pid(), SIGKILL, SIG_FL_PROCESS | SIG_FL_FAULT);
-         return true;
-
-      } else {
-
-         // We cannot kill a task running in kernel during a CoW page fault
-         // In this case (but in the one above too), Linux puts the process to
-         // sleep, while the OOM killer runs and frees some memory.
-         panic("Out-of-memory: can't copy a CoW page [pid %d]", get_curr_pid());
-      }
+      cow_out_of_memory("page");
+      return true;
    }
 
    ASSERT(IS_PAGE_ALIGNED(new_page_vaddr));
@@ -128,6 +239,22 @@ bool handle_potential_cow(void *context)
    return true;
 }
 
+bool handle_potential_demand_paging(void *context)
+{
+   regs_t *r = context;
+   u32 vaddr;
+
+   asmVolatile("movl %%cr2, %0" : "=r"(vaddr));
+
+   if (vaddr >= BASE_VA)
+      return false;
+
+   return
+      handle_user_demand_fault((void *)vaddr,
+                               !!(r->err_code & PAGE_FAULT_FL_PRESENT),
+                               !!(r->err_code & PAGE_FAULT_FL_RW));
+}
+
 static void kernel_page_fault_panic(regs_t *r, u32 vaddr, bool rw, bool p)
 {
    long off = 0;
@@ -163,19 +290,15 @@ void handle_page_fault_int(regs_t *r)
 
    um = process_get_user_mapping((void *)vaddr);
 
-   if (um) {
+   if (um && um->h) {
 
       /*
-       * Call vfs_handle_fault() only if in first place the mapping allowed
-       * writing or if it didn't but the memory access type was a READ.
+       * handle_user_demand_fault() already called vfs_handle_fault() for this
+       * mapping, if the access type was allowed, and the filesystem couldn't
+       * handle the fault (e.g. access past EOF).
        */
-      if (!!(um->prot & PROT_WRITE) || !rw) {
-
-         if (vfs_handle_fault(um, (void *)vaddr, p, rw))
-            return;
-
+      if (!!(um->prot & PROT_WRITE) || !rw)
          sig = SIGBUS;
-      }
    }
 
    if (KRN_PAGE_FAULT_PRINTK) {
@@ -199,7 +322,7 @@ void handle_page_fault_int(regs_t *r)
       get_curr_proc()->debug_cmdline
    );
 
-   send_signal(get_curr_tid(), sig, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal2(get_curr_pid(), get_curr_tid(), sig, SIG_FL_FAULT);
 }
 
 bool is_mapped(pdir_t *pdir, void *vaddrp)
@@ -239,7 +362,7 @@ bool is_rw_mapped(pdir_t *pdir, void *vaddrp)
 
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    page = pt->pages[pt_index];
-   return page.present && page.rw;
+   return e->rw && page.present && page.rw;
 }
 
 void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
@@ -249,12 +372,80 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
    const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
    const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
 
-   pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
-   ASSERT(LIN_VA_TO_PA(pt) != 0);
+   ASSERT(pdir->entries[pd_index].present);
+
+   if (!(pt = pdir_get_private_page_table(pdir, pd_index)))
+      panic("Out-of-memory: unable to copy a shared page table");
+
    pt->pages[pt_index].rw = rw;
    invalidate_page_hw(vaddr);
 }
 
+/*
+ * Take a reference to the user page mapped at `vaddrp`, in order to share it
+ * with the kernel (e.g. vmsplice()). If the page is private and writable, it
+ * becomes a CoW page: the next write from user space will copy it, leaving
+ * the referenced page unchanged. Returns the page in the linear mapping or
+ * NULL if there's no page from kalloc_page() mapped at `vaddrp`.
+ */
+void *user_page_share_cow(pdir_t *pdir, void *vaddrp)
+{
+   page_table_t *pt;
+   page_t *p;
+   ulong paddr;
+   const ulong vaddr = (ulong) vaddrp;
+   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+   page_dir_entry_t *e = &pdir->entries[pd_index];
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+
+   if (vaddr >= BASE_VA || !e->present || e->psize)
+      return NULL;
+
+   pt = PA_TO_LIN_VA(e->ptaddr << PAGE_SHIFT);
+   p = &pt->pages[pt_index];
+
+   if (!p->present || !p->us)
+      return NULL;
+
+   paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+
+   /*
+    * Pages not coming from kalloc_page() (e.g. the framebuffer, the zero-page
+    * or kmalloc-ed buffers like the io_uring rings) might be freed by their
+    * owner while we hold a reference, or they'd be freed in the wrong way by
+    * release_kernel_page(). The caller will have to copy them.
+    */
+   if (!is_kalloc_page(PA_TO_LIN_VA(paddr)))
+      return NULL;
+
+   ASSERT(pf_ref_count_get(paddr) > 0);
+
+   if (p->rw && !(p->avail & PAGE_SHARED)) {
+
+      /*
+       * The page table might be shared with other processes after fork():
+       * copy it before making the page CoW. In case of OOM, the caller will
+       * just copy the page's data instead.
+       */
+      if (!(pt = pdir_get_private_page_table(pdir, pd_index)))
+         return NULL;
+
+      p = &pt->pages[pt_index];
+
+      if (p->rw) {
+         p->avail |= PAGE_COW_ORIG_RW;
+         p->rw = false;
+         invalidate_page_hw(vaddr);
+      }
+   }
+
+   pf_ref_count_inc(paddr);
+   return PA_TO_LIN_VA(paddr);
+}
+
 static inline int
 __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 {
@@ -278,6 +469,14 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
       ASSERT(pt->pages[pt_index].present);
    }
 
+   if (!(pt = pdir_get_private_page_table(pdir, pd_index))) {
+
+      if (permissive)
+         return -ENOMEM;
+
+      panic("Out-of-memory: unable to copy a shared page table");
+   }
+
    const ulong paddr = (ulong)
       pt->pages[pt_index].pageAddr << PAGE_SHIFT;
 
@@ -286,7 +485,7 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 
    if (!pf_ref_count_dec(paddr) && free_pageframe) {
       ASSERT(paddr != KERNEL_VA_TO_PA(zero_page));
-      kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+      kfree_page(PA_TO_LIN_VA(paddr));
    }
 
    return 0;
@@ -406,27 +605,27 @@ int get_mapping2(pdir_t *pdir, void *vaddrp, ulong *pa_ref)
    return 0;
 }
 
-NODISCARD int
-map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
+/*
+ * Like pdir_get_private_page_table(), but creates the page table if missing.
+ * Returns NULL in case of OOM.
+ */
+static page_table_t *
+pdir_get_or_create_page_table(pdir_t *pdir, u32 pd_index, u32 hw_flags)
 {
    page_table_t *pt;
-   const u32 vaddr = (u32) vaddrp;
-   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
-   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
 
-   ASSERT(!(vaddr & OFFSET_IN_PAGE_MASK)); // the vaddr must be page-aligned
-   ASSERT(!(paddr & OFFSET_IN_PAGE_MASK)); // the paddr must be page-aligned
+   if (UNLIKELY(!(pt = pdir_get_private_page_table(pdir, pd_index))))
+      return NULL;
 
-   pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(IS_PAGE_ALIGNED(pt));
 
    if (UNLIKELY(LIN_VA_TO_PA(pt) == 0)) {
 
       // we have to create a page table for mapping 'vaddr'.
-      pt = kzalloc_obj(page_table_t);
+      pt = kzalloc_page();
 
       if (UNLIKELY(!pt))
-         return -ENOMEM;
+         return NULL;
 
       ASSERT(IS_PAGE_ALIGNED(pt));
 
@@ -437,6 +636,25 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
          LIN_VA_TO_PA(pt);
    }
 
+   return pt;
+}
+
+NODISCARD int
+map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
+{
+   page_table_t *pt;
+   const u32 vaddr = (u32) vaddrp;
+   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+
+   ASSERT(!(vaddr & OFFSET_IN_PAGE_MASK)); // the vaddr must be page-aligned
+   ASSERT(!(paddr & OFFSET_IN_PAGE_MASK)); // the paddr must be page-aligned
+
+   pt = pdir_get_or_create_page_table(pdir, pd_index, hw_flags);
+
+   if (UNLIKELY(!pt))
+      return -ENOMEM;
+
    if (pt->pages[pt_index].present)
       return -EADDRINUSE;
 
@@ -523,7 +741,7 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
       void *va;
       ASSERT(paddr == 0);
 
-      if (!(va = kmalloc(PAGE_SIZE)))
+      if (!(va = kalloc_page()))
          return -ENOMEM;
 
       if (pg_flags & PAGING_FL_ZERO_PG)
@@ -548,7 +766,7 @@ map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
                    /* Kernel pages are global */
 
    if (UNLIKELY(rc != 0) && (pg_flags & PAGING_FL_DO_ALLOC)) {
-      kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+      kfree_page(PA_TO_LIN_VA(paddr));
    }
 
    return rc;
@@ -606,77 +824,121 @@ map_pages(pdir_t *pdir,
                     (u32)((!us) << PG_GLOBAL_BIT_POS));
 }
 
-pdir_t *pdir_clone(pdir_t *pdir)
+/*
+ * Move the page mapped at `src`, if any, to `dst`, which must be unmapped. The
+ * page table entry is moved as it is, with all of its flags: the pageframe
+ * doesn't change and, therefore, neither its ref-count.
+ */
+static int move_page_int(pdir_t *pdir, ulong src, ulong dst)
 {
-   pdir_t *new_pdir = kalloc_obj(pdir_t);
+   const u32 src_pd_index = src >> BIG_PAGE_SHIFT;
+   const u32 dst_pd_index = dst >> BIG_PAGE_SHIFT;
+   const u32 src_pt_index = (src >> PAGE_SHIFT) & 1023;
+   const u32 dst_pt_index = (dst >> PAGE_SHIFT) & 1023;
+   const u32 us = pdir->entries[src_pd_index].raw & PG_US_BIT;
+   page_table_t *src_pt = pdir_get_page_table(pdir, src_pd_index);
+   page_table_t *dst_pt;
 
-   if (!new_pdir)
-      return NULL;
+   if (LIN_VA_TO_PA(src_pt) == 0 || !src_pt->pages[src_pt_index].present)
+      return 0; /* Nothing to move */
 
-   ASSERT(IS_PAGE_ALIGNED(new_pdir));
-   memcpy32(new_pdir, pdir, sizeof(pdir_t) / 4);
+   /*
+    * NOTE: get the destination page table first because, when both the
+    * addresses belong to the same (shared) page table, getting its private
+    * copy for `dst` makes it private for `src` as well.
+    */
+   if (!(dst_pt = pdir_get_or_create_page_table(pdir, dst_pd_index, us)))
+      return -ENOMEM;
 
-   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+   if (!(src_pt = pdir_get_private_page_table(pdir, src_pd_index)))
+      return -ENOMEM;
 
-      /* User-space cannot use 4-MB pages */
-      ASSERT(!pdir->entries[i].psize);
+   ASSERT(!dst_pt->pages[dst_pt_index].present);
 
-      if (!pdir->entries[i].present)
-         continue;
+   dst_pt->pages[dst_pt_index].raw = src_pt->pages[src_pt_index].raw;
+   src_pt->pages[src_pt_index].raw = 0;
+   invalidate_page_hw(src);
+   invalidate_page_hw(dst);
+   return 0;
+}
 
-      page_table_t *pt = kalloc_obj(page_table_t);
+NODISCARD int
+move_pages(pdir_t *pdir, void *src, void *dst, size_t page_count)
+{
+   const ulong s = (ulong)src;
+   const ulong d = (ulong)dst;
+   DEBUG_ONLY_UNSAFE(int rc2);
+   size_t i;
+   int rc = 0;
 
-      if (UNLIKELY(!pt)) {
+   ASSERT(IS_PAGE_ALIGNED(s));
+   ASSERT(IS_PAGE_ALIGNED(d));
 
-         for (; i > 0; i--) {
-            if (pdir->entries[i - 1].present)
-               kfree_obj(pdir_get_page_table(pdir, i - 1), page_table_t);
-         }
+   for (i = 0; i < page_count; i++) {
 
-         kfree_obj(new_pdir, pdir_t);
-         return NULL;
-      }
+      rc = move_page_int(pdir, s + (i << PAGE_SHIFT), d + (i << PAGE_SHIFT));
 
-      ASSERT(IS_PAGE_ALIGNED(pt));
-      new_pdir->entries[i].ptaddr=SHR_BITS(LIN_VA_TO_PA(pt),PAGE_SHIFT,u32);
+      if (UNLIKELY(rc))
+         break;
    }
 
-   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
+   if (UNLIKELY(rc)) {
 
-      if (!pdir->entries[i].present)
-         continue;
+      /*
+       * Out of memory: move back the pages already moved. That cannot fail,
+       * because all the page tables involved exist and are private now.
+       */
+      while (i-- > 0) {
 
-      page_table_t *orig_pt = pdir_get_page_table(pdir, i);
-      page_table_t *new_pt = pdir_get_page_table(new_pdir, i);
+         DEBUG_ONLY_UNSAFE(rc2 =)
+            move_page_int(pdir, d + (i << PAGE_SHIFT), s + (i << PAGE_SHIFT));
 
-      /* Mark all the non-shared pages in that page-table as COW. */
-      for (u32 j = 0; j < 1024; j++) {
+         ASSERT(rc2 == 0);
+      }
+   }
 
-         page_t *const p = &orig_pt->pages[j];
+   return rc;
+}
 
-         if (!p->present)
-            continue;
+pdir_t *pdir_clone(pdir_t *pdir)
+{
+   pdir_t *new_pdir = kalloc_page();
 
-         const ulong orig_paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+   if (!new_pdir)
+      return NULL;
 
-         /* Sanity-check: a mapped page MUST have ref-count > 0 */
-         ASSERT(pf_ref_count_get(orig_paddr) > 0);
+   ASSERT(IS_PAGE_ALIGNED(new_pdir));
 
-         if (!(p->avail & PAGE_SHARED)) {
+   /*
+    * Share all the page tables with the new page directory, marking them as
+    * copy-on-write: see pdir_unshare_page_table().
+    */
+   for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
-            if (p->rw)
-               p->avail |= PAGE_COW_ORIG_RW;
+      page_dir_entry_t *e = &pdir->entries[i];
 
-            p->rw = false;
-         }
+      /* User-space cannot use 4-MB pages */
+      ASSERT(!e->psize);
 
-         pf_ref_count_inc(orig_paddr);
+      if (!e->present)
+         continue;
+
+      const ulong pt_paddr = (ulong)e->ptaddr << PAGE_SHIFT;
+
+      if (!(e->avail & PDE_COW_PT)) {
+
+         /* A private page table, becoming shared right now */
+         ASSERT(pf_ref_count_get(pt_paddr) == 0);
+         pf_ref_count_inc(pt_paddr);
+
+         e->avail |= PDE_COW_PT;
+         e->rw = false;
       }
 
-      // copy the page table
-      memcpy(new_pt, orig_pt, sizeof(page_table_t));
+      pf_ref_count_inc(pt_paddr);
    }
 
+   memcpy32(new_pdir, pdir, sizeof(pdir_t) / 4);
    return new_pdir;
 }
 
@@ -686,10 +948,7 @@ pdir_deep_clone(pdir_t *pdir)
    STATIC_ASSERT(sizeof(pdir_t) == PAGE_SIZE);
    STATIC_ASSERT(sizeof(page_table_t) == PAGE_SIZE);
 
-   struct kmalloc_acc acc;
-   kmalloc_create_accelerator(&acc, PAGE_SIZE, 4);
-
-   pdir_t *new_pdir = kmalloc_accelerator_get_elem(&acc);
+   pdir_t *new_pdir = kzalloc_page();
 
    if (UNLIKELY(!new_pdir))
       goto oom_exit;
@@ -707,25 +966,33 @@ pdir_deep_clone(pdir_t *pdir)
          continue;
 
       page_table_t *orig_pt = pdir_get_page_table(pdir, i);
-      page_table_t *new_pt = kmalloc_accelerator_get_elem(&acc);
+      page_table_t *new_pt = kzalloc_page();
 
-      if (UNLIKELY(!new_pt))
+      if (UNLIKELY(!new_pt)) {
+         new_pdir->entries[i].raw = 0;
          goto oom_exit;
+      }
 
       ASSERT(IS_PAGE_ALIGNED(new_pt));
+      new_pdir->entries[i].ptaddr =
+         SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
 
-      for (u32 j = 0; j < 1024; j++) {
+      /* The original page table might be shared, the new one is private */
+      new_pdir->entries[i].avail &= ~PDE_COW_PT;
+      new_pdir->entries[i].rw = true;
 
-         new_pt->pages[j].raw = orig_pt->pages[j].raw;
+      for (u32 j = 0; j < 1024; j++) {
 
          if (!orig_pt->pages[j].present)
             continue;
 
-         void *new_page = kmalloc_accelerator_get_elem(&acc);
+         void *new_page = kalloc_page();
 
          if (!new_page)
             goto oom_exit;
 
+         new_pt->pages[j].raw = orig_pt->pages[j].raw;
+
          ASSERT(IS_PAGE_ALIGNED(new_page));
 
          ulong orig_page_paddr =
@@ -740,22 +1007,16 @@ pdir_deep_clone(pdir_t *pdir)
          memcpy32(new_page, orig_page, PAGE_SIZE / 4);
          new_pt->pages[j].pageAddr = SHR_BITS(new_page_paddr, PAGE_SHIFT, u32);
       }
-
-      new_pdir->entries[i].ptaddr =
-         SHR_BITS(LIN_VA_TO_PA(new_pt), PAGE_SHIFT, u32);
    }
 
    for (u32 i = BASE_VADDR_PD_IDX; i < 1024; i++) {
       new_pdir->entries[i].raw = pdir->entries[i].raw;
    }
 
-   kmalloc_destroy_accelerator(&acc);
    return new_pdir;
 
 oom_exit:
 
-   kmalloc_destroy_accelerator(&acc);
-
    if (new_pdir)
       pdir_destroy(new_pdir);
 
@@ -773,6 +1034,14 @@ void pdir_destroy(pdir_t *pdir)
          continue;
 
       page_table_t *pt = pdir_get_page_table(pdir, i);
+      const ulong pt_paddr = LIN_VA_TO_PA(pt);
+
+      if (pdir->entries[i].avail & PDE_COW_PT) {
+
+         /* Shared page table: just drop our reference, if it's not the last */
+         if (pf_ref_count_dec(pt_paddr) > 0)
+            continue;
+      }
 
       for (u32 j = 0; j < 1024; j++) {
 
@@ -782,15 +1051,15 @@ void pdir_destroy(pdir_t *pdir)
          const ulong paddr = (ulong)pt->pages[j].pageAddr << PAGE_SHIFT;
 
          if (pf_ref_count_dec(paddr) == 0)
-            kfree2(PA_TO_LIN_VA(paddr), PAGE_SIZE);
+            kfree_page(PA_TO_LIN_VA(paddr));
       }
 
       // We freed all the pages, now free the whole page-table.
-      kfree_obj(pt, page_table_t);
+      kfree_page(pt);
    }
 
    // We freed all pages and all the page-tables, now free pdir.
-   kfree_obj(pdir, pdir_t);
+   kfree_page(pdir);
 }
 
 
@@ -846,9 +1115,8 @@ static void set_4kb_page_pat_wc(pdir_t *pdir, void *vaddrp)
 
    ASSERT(!(vaddr & OFFSET_IN_PAGE_MASK)); // the vaddr must be page-aligned
 
-   pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
-   ASSERT(IS_PAGE_ALIGNED(pt));
-   ASSERT(pt != NULL);
+   if (!(pt = pdir_get_private_page_table(pdir, pd_index)))
+      panic("Out-of-memory: unable to copy a shared page table");
 
    // 111 => entry[7] in the PAT MSR. See init_pat()
    pt->pages[pt_index].pat = 1;
@@ -42,6 +42,15 @@
 #define PAGE_FAULT_FL_US      (1u << 2)
 
 #define PAGE_FAULT_FL_COW (PAGE_FAULT_FL_PRESENT | PAGE_FAULT_FL_RW)
+
+/*
+ * When this flag is set in the 'avail' bits of a page directory entry, it
+ * means that its page table is shared with other page directories (after
+ * fork) and that, on the first attempt to modify it, it has to be copied.
+ * Such entries are always marked as read-only.
+ */
+#define PDE_COW_PT                                           (1 << 0)
+
 #define BIG_PAGE_SHIFT                                            22
 #define BASE_VADDR_PD_IDX                (BASE_VA >> BIG_PAGE_SHIFT)
 
@@ -21,6 +21,7 @@
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/vdso.h>
+#include <tilck/kernel/elf_utils.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -110,18 +111,21 @@ push_args_on_user_stack(regs_t *r,
       env_pointers[i] = r->useresp;
    }
 
-   // push the env array (in reverse order)
-
-   push_on_user_stack(r, 0); /*
-                              * 2nd mandatory NULL pointer: after the 'env'
-                              * pointers there could additional aux information
-                              * that some libc implementations check for.
-                              * Therefore, it is essential to add another NULL
-                              * after the env pointers to inform the libc impl
-                              * that no such information exist. For more info,
-                              * check __init_libc() in libmusl.
-                              */
+   /*
+    * Push the aux vector (in reverse order), right after the NULL pointer at
+    * the end of the 'env' pointers. It's a list of (type, value) pairs
+    * terminated by AT_NULL: libc implementations scan it to find, among other
+    * things, the ELF header of the vDSO (AT_SYSINFO_EHDR). For more info,
+    * check __init_libc() and __vdsosym() in libmusl.
+    */
+   push_on_user_stack(r, 0);
+   push_on_user_stack(r, AT_NULL);
+   push_on_user_stack(r, PAGE_SIZE);
+   push_on_user_stack(r, AT_PAGESZ);
+   push_on_user_stack(r, USER_VDSO_VADDR);
+   push_on_user_stack(r, AT_SYSINFO_EHDR);
 
+   // push the env array (in reverse order)
    push_on_user_stack(r, 0); // mandatory final NULL pointer (end of 'env' ptrs)
 
    for (u32 i = envc; i > 0; i--) {
@@ -782,6 +786,9 @@ switch_to_task(struct task *ti)
             load_ldt(arch->ldt_index_in_gdt, arch->ldt_size);
       }
 
+      if (get_task_arch_fields(ti)->tls_gdt_index)
+         gdt_load_task_tls(ti);
+
       if (!ti->running_in_kernel)
          process_signals(ti, sig_in_usermode, state);
 
@@ -817,7 +824,7 @@ sys_set_tid_address(int *tidptr)
     * is not valid, we'll send SIGSEGV to the just created thread.
     */
 
-   get_curr_proc()->set_child_tid = tidptr;
+   get_curr_task()->clear_child_tid = tidptr;
    return get_curr_task()->tid;
 }
 
@@ -872,9 +879,37 @@ arch_specific_new_task_setup(struct task *ti, struct task *parent)
       }
    }
 
+   if (parent) {
+
+      /* The TLS of the task calling fork() is preserved in the child */
+      arch_task_members_t *parent_arch = get_task_arch_fields(parent);
+      arch->tls_gdt_index = parent_arch->tls_gdt_index;
+      memcpy(arch->tls_desc, parent_arch->tls_desc, sizeof(arch->tls_desc));
+
+   } else {
+
+      /* execve(): the GDT entries of the process are going to be released */
+      arch->tls_gdt_index = 0;
+      bzero(arch->tls_desc, sizeof(arch->tls_desc));
+   }
+
    return true;
 }
 
+int
+arch_specific_new_thread_setup(struct task *ti, struct task *parent, void *tls)
+{
+   arch_task_members_t *arch = get_task_arch_fields(ti);
+   arch_task_members_t *parent_arch = get_task_arch_fields(parent);
+
+   /* By default, the new thread has the same TLS of the calling one */
+   arch->tls_gdt_index = parent_arch->tls_gdt_index;
+   memcpy(arch->tls_desc, parent_arch->tls_desc, sizeof(arch->tls_desc));
+
+   /* On i386, `tls` is a struct user_desc pointer, as for set_thread_area() */
+   return tls ? gdt_set_new_thread_tls(ti, tls) : 0;
+}
+
 void
 arch_specific_free_task(struct task *ti)
 {
@@ -900,8 +935,6 @@ arch_specific_new_proc_setup(struct process *pi, struct process *parent)
    for (int i = 0; i < ARRAY_SIZE(arch->gdt_entries); i++)
       if (arch->gdt_entries[i])
          gdt_entry_inc_ref_count(arch->gdt_entries[i]);
-
-   pi->set_child_tid = NULL;
 }
 
 void
@@ -925,7 +958,7 @@ arch_specific_free_proc(struct process *pi)
 static void
 handle_fatal_error(regs_t *r, int signum)
 {
-   send_signal(get_curr_tid(), signum, SIG_FL_PROCESS | SIG_FL_FAULT);
+   send_signal2(get_curr_pid(), get_curr_tid(), signum, SIG_FL_FAULT);
 }
 
 /* General protection fault handler */
@@ -72,6 +72,11 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
    NOT_IMPLEMENTED();
 }
 
+void *user_page_share_cow(pdir_t *pdir, void *vaddrp)
+{
+   NOT_IMPLEMENTED();
+}
+
 NODISCARD int
 map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
 {
@@ -94,6 +99,12 @@ map_zero_page(pdir_t *pdir, void *vaddrp, u32 pg_flags)
    NOT_IMPLEMENTED();
 }
 
+NODISCARD int
+move_pages(pdir_t *pdir, void *src, void *dst, size_t page_count)
+{
+   NOT_IMPLEMENTED();
+}
+
 static inline int
 __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
 {
@@ -152,6 +163,11 @@ bool handle_potential_cow(void *context)
    NOT_IMPLEMENTED();
 }
 
+bool handle_potential_demand_paging(void *context)
+{
+   NOT_IMPLEMENTED();
+}
+
 void init_hi_vmem_heap(void)
 {
    NOT_IMPLEMENTED();
@@ -36,6 +36,12 @@ arch_specific_free_task(struct task *ti)
    NOT_IMPLEMENTED();
 }
 
+int
+arch_specific_new_thread_setup(struct task *ti, struct task *parent, void *tls)
+{
+   NOT_IMPLEMENTED();
+}
+
 void
 arch_specific_new_proc_setup(struct process *pi, struct process *parent)
 {
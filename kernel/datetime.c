@@ -11,6 +11,7 @@
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/vdso.h>
 
 #define FULL_RESYNC_MAX_ATTEMPTS       10
 
@@ -30,8 +31,10 @@ const char *months3[12] =
    "Dec",
 };
 
-static s64 boot_timestamp;
+s64 boot_timestamp;              /* also published on the vDSO page */
 static bool in_full_resync;
+static u64 last_sys_time;        /* last value returned by get_sys_time() */
+static u64 last_mono_time;       /* last value returned by get_mono_time() */
 
 #if KRN_CLOCK_DRIFT_COMP
 static bool first_sssync_failed; /* first_sub_second_sync_failed */
@@ -211,6 +214,8 @@ retry:
          __tick_adj_val = (TS_SCALE / TIMER_HZ) / 10;
          __tick_adj_ticks_rem = abs_drift / __tick_adj_val;
       }
+
+      vdso_update_time();
    }
    enable_interrupts_forced();
    clock_rstats.full_resync_count++;
@@ -266,6 +271,7 @@ static void clock_multi_second_resync(int drift)
    {
       __tick_adj_val = adj_val;
       __tick_adj_ticks_rem = adj_ticks;
+      vdso_update_time();
    }
    enable_interrupts_forced();
    clock_rstats.multi_second_resync_count++;
@@ -395,6 +401,7 @@ int clock_get_second_drift(void)
 void init_system_time(void)
 {
    struct datetime d;
+   ulong var;
 
 #if KRN_CLOCK_DRIFT_COMP
       if (kthread_create(&clock_drift_adj, 0, NULL) < 0)
@@ -407,16 +414,56 @@ void init_system_time(void)
    if (boot_timestamp < 0)
       panic("Invalid boot-time UNIX timestamp: %d\n", boot_timestamp);
 
-   __time_ns = 0;
+   disable_interrupts(&var);
+   {
+      __time_ns = 0;
+      last_sys_time = 0;
+      vdso_update_time();
+   }
+   enable_interrupts(&var);
 }
 
+/*
+ * The system time: it's the time since boot, compensated for the clock drift
+ * and interpolated between the ticks, when possible (see timer.c). Because of
+ * the drift compensation and of the interpolation, the value computed at a
+ * given moment might be slightly behind the one returned before: never go
+ * backwards by returning the last value in that case.
+ */
 u64 get_sys_time(void)
 {
    u64 ts;
    ulong var;
    disable_interrupts(&var);
    {
-      ts = __time_ns;
+      ts = __time_ns + ns_since_last_tick();
+
+      if (ts > last_sys_time)
+         last_sys_time = ts;
+      else
+         ts = last_sys_time;
+   }
+   enable_interrupts(&var);
+   return ts;
+}
+
+/*
+ * The monotonic time: the time since boot, computed just from the number of
+ * ticks and their duration, plus the interpolation. It's never affected by the
+ * drift compensation, nor by any changes to the system time.
+ */
+u64 get_mono_time(void)
+{
+   u64 ts;
+   ulong var;
+   disable_interrupts(&var);
+   {
+      ts = get_ticks() * __tick_duration + ns_since_last_tick();
+
+      if (ts > last_mono_time)
+         last_mono_time = ts;
+      else
+         ts = last_mono_time;
    }
    enable_interrupts(&var);
    return ts;
@@ -472,11 +519,10 @@ u64 timespec_to_ticks(const struct k_timespec64 *tp)
    return ticks;
 }
 
-void real_time_get_timespec(struct k_timespec64 *tp)
+/* Convert the time `t` in TS_SCALE units to a timespec */
+void ns_to_timespec(u64 t, struct k_timespec64 *tp)
 {
-   const u64 t = get_sys_time();
-
-   tp->tv_sec = (s64)boot_timestamp + (s64)(t / TS_SCALE);
+   tp->tv_sec = (s64)(t / TS_SCALE);
 
    if (TS_SCALE <= BILLION)
       tp->tv_nsec = (t % TS_SCALE) * (BILLION / TS_SCALE);
@@ -484,10 +530,35 @@ void real_time_get_timespec(struct k_timespec64 *tp)
       tp->tv_nsec = (t % TS_SCALE) / (TS_SCALE / BILLION);
 }
 
+/*
+ * Convert a timespec to TS_SCALE units, saturating on overflow. Expects a valid
+ * timespec, with a non-negative tv_sec and tv_nsec in [0, BILLION).
+ */
+u64 timespec_to_ns(const struct k_timespec64 *tp)
+{
+   const u64 sec = (u64)tp->tv_sec;
+   u64 sub;
+
+   if (sec >= UINT64_MAX / TS_SCALE)
+      return UINT64_MAX;
+
+   if (TS_SCALE <= BILLION)
+      sub = (u64)tp->tv_nsec / (BILLION / TS_SCALE);
+   else
+      sub = (u64)tp->tv_nsec * (TS_SCALE / BILLION);
+
+   return sec * TS_SCALE + sub;
+}
+
+void real_time_get_timespec(struct k_timespec64 *tp)
+{
+   ns_to_timespec(get_sys_time(), tp);
+   tp->tv_sec += (s64)boot_timestamp;
+}
+
 void monotonic_time_get_timespec(struct k_timespec64 *tp)
 {
-   /* Same as the real_time clock, for the moment */
-   real_time_get_timespec(tp);
+   ns_to_timespec(get_mono_time(), tp);
 }
 
 static void
@@ -565,10 +636,23 @@ do_clock_getres(clockid_t clk_id, struct k_timespec64 *res)
    switch (clk_id) {
 
       case CLOCK_REALTIME:
-      case CLOCK_REALTIME_COARSE:
       case CLOCK_MONOTONIC:
-      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_MONOTONIC_RAW:
+
+         if (has_tsc_clocksource()) {
+
+            *res = (struct k_timespec64) {
+               .tv_sec = 0,
+               .tv_nsec = 1,
+            };
+
+            break;
+         }
+
+         /* fall-through */
+
+      case CLOCK_REALTIME_COARSE:
+      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_PROCESS_CPUTIME_ID:
       case CLOCK_THREAD_CPUTIME_ID:
 
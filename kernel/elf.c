@@ -11,6 +11,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/elf_utils.h>
@@ -32,6 +33,15 @@
    #error Architecture not supported.
 #endif
 
+/*
+ * Stack pages allocated at exec time: the args strings take at most
+ * USER_ARGS_PAGE_COUNT pages, plus one page for their pointers and the aux
+ * vector. See push_args_on_user_stack().
+ */
+#define USER_STACK_PREALLOC_PAGES        (USER_ARGS_PAGE_COUNT + 1)
+
+STATIC_ASSERT(USER_STACK_PREALLOC_PAGES <= USER_STACK_PAGES);
+
 typedef int (*load_segment_func)(fs_handle *, pdir_t *, Elf_Phdr *, ulong *);
 
 static int
@@ -67,11 +77,11 @@ load_segment_by_copy(fs_handle *elf_h,
 
       if (!is_mapped(pdir, vaddr)) {
 
-         if (!(p = kzmalloc(PAGE_SIZE)))
+         if (!(p = kzalloc_page()))
             return -ENOMEM;
 
          if ((rc = map_page(pdir, vaddr, LIN_VA_TO_PA(p), PAGING_FL_RWUS))) {
-            kfree2(p, PAGE_SIZE);
+            kfree_page(p);
             return (int)rc;
          }
 
@@ -294,7 +304,7 @@ static int
 alloc_and_map_stack_page(pdir_t *pdir, void *stack_top, u32 i)
 {
    int rc;
-   void *p = kzmalloc(PAGE_SIZE);
+   void *p = kzalloc_page();
 
    if (!p)
       return -ENOMEM;
@@ -304,6 +314,9 @@ alloc_and_map_stack_page(pdir_t *pdir, void *stack_top, u32 i)
                  LIN_VA_TO_PA(p),
                  PAGING_FL_RW | PAGING_FL_US);
 
+   if (rc)
+      kfree_page(p);
+
    return rc;
 }
 
@@ -366,7 +379,6 @@ load_elf_program(const char *filepath,
    fs_handle elf_h = NULL;
    struct elf_headers eh;
    ulong brk = 0;
-   size_t count;
    int rc;
 
    pinfo->wrong_arch = false;
@@ -427,30 +439,16 @@ load_elf_program(const char *filepath,
    /*
     * Mapping the user stack.
     *
-    * In the "NOCOW" case, all the pages are pre-allocated.
-    * In the default case instead, most of the pages are zero-mapped and so,
-    * therefore, allocated on-demand. But, `USER_ARGS_PAGE_COUNT` pages are
-    * pre-allocated anyway.
+    * The stack is populated on demand by handle_user_demand_fault(), like the
+    * heap. Only its top USER_STACK_PREALLOC_PAGES pages are allocated here,
+    * because the kernel writes there the args, before switching to the new
+    * process.
     */
 
-   const size_t pre_allocated_pages =
-      MMAP_NO_COW ? USER_STACK_PAGES : USER_ARGS_PAGE_COUNT;
-
-   const size_t zero_mapped_pages = USER_STACK_PAGES - pre_allocated_pages;
-   const ulong stack_top = (USERMODE_VADDR_END - USER_STACK_PAGES * PAGE_SIZE);
-
-   count = map_zero_pages(pinfo->pdir,
-                          (void *)stack_top,
-                          zero_mapped_pages,
-                          PAGING_FL_US | PAGING_FL_RW);
-
-   if (count != zero_mapped_pages) {
-      unmap_pages(pinfo->pdir, (void *)stack_top, count, true);
-      rc = -ENOMEM;
-      goto out;
-   }
+   const ulong stack_top =
+      USERMODE_VADDR_END - USER_STACK_PREALLOC_PAGES * PAGE_SIZE;
 
-   for (u32 i = zero_mapped_pages; i < USER_STACK_PAGES; i++) {
+   for (u32 i = 0; i < USER_STACK_PREALLOC_PAGES; i++) {
       if ((rc = alloc_and_map_stack_page(pinfo->pdir, (void *)stack_top, i)))
          goto out;
    }
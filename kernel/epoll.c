@@ -0,0 +1,593 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_userlim.h>
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/epoll.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/signal.h>
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+
+#include <sys/epoll.h>  // system header
+
+/*
+ * epoll
+ * -------
+ *
+ * An epoll instance is a kernelfs object, like pipes. It holds the interest
+ * list, an AVL tree of `struct epitem` keyed by file handle, and the ready
+ * list. Each item registers a kcond watch (see sync.h) on the r/w/e conditions
+ * of its file: when one of them gets signaled, the watch callback appends the
+ * item to the ready list and wakes up the tasks waiting on the instance. In
+ * this way, epoll_wait() looks only at the items in the ready list and its
+ * cost is proportional to the number of ready files, not to the watched ones.
+ *
+ * In level-triggered mode, an item reported as ready goes back to the ready
+ * list, to be checked again on the next epoll_wait(). In edge-triggered mode
+ * (EPOLLET), it leaves the ready list until one of its conditions gets
+ * signaled again.
+ *
+ * The watch callbacks run with preemption disabled, from kcond_signal_*():
+ * that's why the ready list is protected by disabling the preemption, while
+ * the interest list is protected by the instance's mutex.
+ *
+ * Limitations: adding an epoll instance to another one is not supported and
+ * the items are keyed by file handle, which, in Tilck, corresponds to a file
+ * descriptor: closing a file descriptor removes it from all the instances,
+ * even if it had been duplicated.
+ */
+
+#define EP_PRIVATE_BITS  (EPOLLONESHOT | EPOLLET | EPOLLWAKEUP | EPOLLEXCLUSIVE)
+#define EP_ALWAYS_EVENTS (EPOLLERR | EPOLLHUP)
+
+enum ep_watch_type {
+   EP_WATCH_R,
+   EP_WATCH_W,
+   EP_WATCH_E,
+   EP_WATCH_COUNT,
+};
+
+struct epitem {
+
+   struct bintree_node node;        /* node in the interest list */
+   struct list_node rdl_node;       /* node in the ready list */
+   struct epoll *ep;
+
+   fs_handle h;                     /* the key */
+   u32 events;                      /* requested events and flags */
+   u64 data;                        /* opaque user data */
+
+   struct kcond_watch watches[EP_WATCH_COUNT];
+};
+
+struct epoll {
+
+   KOBJ_BASE_FIELDS
+
+   struct kmutex mutex;             /* protects the interest list */
+   struct epitem *items_root;       /* the interest list */
+   struct list rdlist;              /* the ready list */
+   struct kcond rd_cond;            /* signaled when an item gets ready */
+   struct list_node node;           /* node in `epoll_list` */
+};
+
+/* All the epoll instances, used when a watched file handle gets closed */
+static struct list epoll_list = STATIC_LIST_INIT(epoll_list);
+static struct kmutex epoll_list_mutex = STATIC_KMUTEX_INIT(epoll_list_mutex, 0);
+
+static const struct file_ops static_ops_epoll;
+
+static inline bool is_epoll_handle(fs_handle h)
+{
+   return ((struct fs_handle_base *)h)->fops == &static_ops_epoll;
+}
+
+/* Append `it` to the ready list, if it's not already there */
+static void ep_queue_item(struct epitem *it)
+{
+   struct epoll *ep = it->ep;
+   ASSERT(!is_preemption_enabled());
+
+   if (!(it->events & ~EP_PRIVATE_BITS))
+      return; /* Disabled by EPOLLONESHOT */
+
+   if (list_is_node_in_list(&it->rdl_node))
+      return;
+
+   list_add_tail(&ep->rdlist, &it->rdl_node);
+   kcond_signal_all(&ep->rd_cond);
+}
+
+static void ep_watch_cb(struct kcond_watch *w)
+{
+   ep_queue_item(w->arg);
+}
+
+static void ep_item_watch(struct epitem *it)
+{
+   struct kcond *conds[EP_WATCH_COUNT] = {
+      (it->events & EPOLLIN) ? vfs_get_rready_cond(it->h) : NULL,
+      (it->events & EPOLLOUT) ? vfs_get_wready_cond(it->h) : NULL,
+      vfs_get_except_cond(it->h),   /* errors are always reported */
+   };
+
+   for (int i = 0; i < EP_WATCH_COUNT; i++) {
+      if (conds[i])
+         kcond_watch_add(conds[i], &it->watches[i]);
+   }
+}
+
+static void ep_item_unwatch(struct epitem *it)
+{
+   for (int i = 0; i < EP_WATCH_COUNT; i++)
+      kcond_watch_remove(&it->watches[i]);
+}
+
+/* Returns the events currently ready for `it`, among the requested ones */
+static u32 ep_item_poll(struct epitem *it)
+{
+   u32 revents = 0;
+   int rc;
+
+   if ((it->events & EPOLLIN) && vfs_read_ready(it->h))
+      revents |= EPOLLIN;
+
+   if ((it->events & EPOLLOUT) && vfs_write_ready(it->h))
+      revents |= EPOLLOUT;
+
+   if ((rc = vfs_except_ready(it->h)))
+      revents |= rc > 0 ? (u32)rc & (it->events | EP_ALWAYS_EVENTS) : EPOLLERR;
+
+   return revents;
+}
+
+static void ep_queue_if_ready(struct epitem *it)
+{
+   if (ep_item_poll(it)) {
+      disable_preemption();
+      {
+         ep_queue_item(it);
+      }
+      enable_preemption();
+   }
+}
+
+static void ep_item_set_event(struct epitem *it, struct epoll_event *ev)
+{
+   it->events = ev->events | EP_ALWAYS_EVENTS;
+   it->data = ev->data.u64;
+}
+
+static int
+ep_insert(struct epoll *ep, fs_handle h, struct epoll_event *ev)
+{
+   struct fs_handle_base *hb = h;
+   struct epitem *it;
+
+   if (!vfs_get_rready_cond(h) &&
+       !vfs_get_wready_cond(h) &&
+       !vfs_get_except_cond(h))
+   {
+      /* As on Linux, files which are always ready (e.g. regular files) */
+      return -EPERM;
+   }
+
+   if (!(it = kzalloc_obj(struct epitem)))
+      return -ENOMEM;
+
+   bintree_node_init(&it->node);
+   list_node_init(&it->rdl_node);
+   it->ep = ep;
+   it->h = h;
+   ep_item_set_event(it, ev);
+
+   for (int i = 0; i < EP_WATCH_COUNT; i++)
+      kcond_watch_init(&it->watches[i], &ep_watch_cb, it);
+
+   DEBUG_ONLY_UNSAFE(bool ok =)
+      bintree_insert_ptr(&ep->items_root, it, struct epitem, node, h);
+
+   ASSERT(ok);
+   hb->spec_flags |= VFS_SPFL_EPOLL_WATCHED;
+   ep_item_watch(it);
+   ep_queue_if_ready(it);
+   return 0;
+}
+
+static void
+ep_remove(struct epoll *ep, struct epitem *it)
+{
+   ep_item_unwatch(it);
+
+   disable_preemption();
+   {
+      if (list_is_node_in_list(&it->rdl_node))
+         list_remove(&it->rdl_node);
+   }
+   enable_preemption();
+
+   bintree_remove_ptr(&ep->items_root, it, struct epitem, node, h);
+   kfree_obj(it, struct epitem);
+}
+
+static int
+ep_ctl(struct epoll *ep, int op, fs_handle h, struct epoll_event *ev)
+{
+   struct epitem *it;
+   ASSERT(kmutex_is_curr_task_holding_lock(&ep->mutex));
+
+   it = bintree_find_ptr(ep->items_root, h, struct epitem, node, h);
+
+   switch (op) {
+
+      case EPOLL_CTL_ADD:
+
+         if (it)
+            return -EEXIST;
+
+         return ep_insert(ep, h, ev);
+
+      case EPOLL_CTL_MOD:
+
+         if (!it)
+            return -ENOENT;
+
+         ep_item_unwatch(it);
+         ep_item_set_event(it, ev);
+         ep_item_watch(it);
+         ep_queue_if_ready(it);
+         return 0;
+
+      case EPOLL_CTL_DEL:
+
+         if (!it)
+            return -ENOENT;
+
+         ep_remove(ep, it);
+         return 0;
+
+      default:
+         return -EINVAL;
+   }
+}
+
+/*
+ * Check the items in the ready list and fill `evs` with at most `maxevents`
+ * events. Returns the number of events.
+ */
+static int
+ep_collect(struct epoll *ep, struct epoll_event *evs, int maxevents)
+{
+   struct list txlist = STATIC_LIST_INIT(txlist);
+   struct epitem *it, *temp;
+   u32 revents;
+   int n = 0;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&ep->mutex));
+
+   /*
+    * Move the whole ready list to `txlist`. While an item is in there, the
+    * watch callbacks consider it as already queued.
+    */
+   disable_preemption();
+   {
+      list_for_each(it, temp, &ep->rdlist, rdl_node) {
+         list_remove(&it->rdl_node);
+         list_add_tail(&txlist, &it->rdl_node);
+      }
+   }
+   enable_preemption();
+
+   while (n < maxevents) {
+
+      disable_preemption();
+      {
+         if (list_is_empty(&txlist)) {
+            enable_preemption();
+            break;
+         }
+
+         it = list_first_obj(&txlist, struct epitem, rdl_node);
+         list_remove(&it->rdl_node);
+         list_node_init(&it->rdl_node);
+      }
+      enable_preemption();
+
+      /*
+       * From now on, a signaled condition puts the item back in the ready
+       * list: no edge can be lost while we check the item.
+       */
+      if (!(revents = ep_item_poll(it)))
+         continue; /* Spurious: the item is not ready anymore */
+
+      evs[n++] = (struct epoll_event) {
+         .events = revents,
+         .data.u64 = it->data,
+      };
+
+      if (it->events & EPOLLONESHOT) {
+
+         /* Disable the item until the next EPOLL_CTL_MOD */
+         it->events &= EP_PRIVATE_BITS;
+
+      } else if (!(it->events & EPOLLET)) {
+
+         /* Level-triggered: check the item again in the next call */
+         disable_preemption();
+         {
+            ep_queue_item(it);
+         }
+         enable_preemption();
+      }
+   }
+
+   /* Put back in the ready list, in order, the items we had no room for */
+   disable_preemption();
+   {
+      while (!list_is_empty(&txlist)) {
+         it = list_last_obj(&txlist, struct epitem, rdl_node);
+         list_remove(&it->rdl_node);
+         list_add_head(&ep->rdlist, &it->rdl_node);
+      }
+   }
+   enable_preemption();
+   return n;
+}
+
+static int
+ep_wait(struct epoll *ep, struct epoll_event *evs, int maxevents, int timeout)
+{
+   struct task *curr = get_curr_task();
+   bool timed_out = false;
+   u64 deadline = 0;
+   int n;
+
+   if (timeout > 0)
+      deadline = hrtimer_expiry_in((u64)timeout * (TS_SCALE / 1000));
+
+   while (true) {
+
+      kmutex_lock(&ep->mutex);
+      {
+         n = ep_collect(ep, evs, maxevents);
+      }
+      kmutex_unlock(&ep->mutex);
+
+      if (n > 0 || timeout == 0 || timed_out)
+         break;
+
+      disable_preemption();
+
+      if (!list_is_empty(&ep->rdlist)) {
+         enable_preemption();
+         continue;
+      }
+
+      prepare_to_wait_on(WOBJ_KCOND, &ep->rd_cond, NO_EXTRA,
+                         &ep->rd_cond.wait_list);
+
+      if (timeout > 0)
+         task_set_wakeup_hrtimer(curr, deadline);
+
+      enter_sleep_wait_state();
+
+      /* As in kcond_wait(), the wobj is still set only in case of timeout */
+      timed_out = wait_obj_reset(&curr->wobj) != NULL;
+
+      if (pending_signals()) {
+
+         if (timeout > 0)
+            task_cancel_wakeup_timer(curr);
+
+         return -EINTR;
+      }
+   }
+
+   return n;
+}
+
+static int epoll_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct epoll *ep = (void *)kh->kobj;
+   bool ret;
+
+   disable_preemption();
+   {
+      ret = !list_is_empty(&ep->rdlist);
+   }
+   enable_preemption();
+   return ret;
+}
+
+static struct kcond *epoll_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct epoll *ep = (void *)kh->kobj;
+   return &ep->rd_cond;
+}
+
+static const struct file_ops static_ops_epoll =
+{
+   .read_ready = epoll_read_ready,
+   .get_rready_cond = epoll_get_rready_cond,
+};
+
+void destroy_epoll(struct epoll *ep)
+{
+   struct epitem *it;
+
+   kmutex_lock(&epoll_list_mutex);
+   {
+      if (list_is_node_in_list(&ep->node))
+         list_remove(&ep->node);
+   }
+   kmutex_unlock(&epoll_list_mutex);
+
+   while ((it = bintree_get_first_obj(ep->items_root, struct epitem, node)))
+      ep_remove(ep, it);
+
+   kcond_destory(&ep->rd_cond);
+   kmutex_destroy(&ep->mutex);
+   kfree_obj(ep, struct epoll);
+}
+
+struct epoll *create_epoll(void)
+{
+   struct epoll *ep;
+
+   if (!(ep = (void *)kzalloc_obj(struct epoll)))
+      return NULL;
+
+   ep->destory_obj = (void *)&destroy_epoll;
+   kmutex_init(&ep->mutex, 0);
+   list_init(&ep->rdlist);
+   kcond_init(&ep->rd_cond);
+   list_node_init(&ep->node);
+
+   kmutex_lock(&epoll_list_mutex);
+   {
+      list_add_tail(&epoll_list, &ep->node);
+   }
+   kmutex_unlock(&epoll_list_mutex);
+   return ep;
+}
+
+fs_handle epoll_create_handle(struct epoll *ep)
+{
+   return kfs_create_new_handle(&static_ops_epoll, (void *)ep, O_RDONLY);
+}
+
+/*
+ * Called by vfs_close() for the handles with VFS_SPFL_EPOLL_WATCHED: remove
+ * the handle from the interest list of all the epoll instances.
+ */
+void epoll_on_handle_close(fs_handle h)
+{
+   struct epoll *ep;
+   struct epitem *it;
+
+   kmutex_lock(&epoll_list_mutex);
+
+   list_for_each_ro(ep, &epoll_list, node) {
+
+      kmutex_lock(&ep->mutex);
+      {
+         it = bintree_find_ptr(ep->items_root, h, struct epitem, node, h);
+
+         if (it)
+            ep_remove(ep, it);
+      }
+      kmutex_unlock(&ep->mutex);
+   }
+
+   kmutex_unlock(&epoll_list_mutex);
+}
+
+/*
+ * ----------------- SYSCALLS -----------------------
+ */
+
+int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *u_ev)
+{
+   struct process *pi = get_curr_proc();
+   struct epoll_event ev = {0};
+   struct kfs_handle *eh;
+   struct epoll *ep;
+   fs_handle h;
+   int rc;
+
+   if (op != EPOLL_CTL_DEL && copy_from_user(&ev, u_ev, sizeof(ev)))
+      return -EFAULT;
+
+   /*
+    * Hold the fslock, so that `fd` cannot be closed under our feet. The lock
+    * order is: fslock -> epoll_list_mutex -> ep->mutex.
+    */
+   kmutex_lock(&pi->fslock);
+
+   eh = get_fs_handle(epfd);
+   h = get_fs_handle(fd);
+
+   if (!eh || !h) {
+      rc = -EBADF;
+      goto out;
+   }
+
+   if (!is_epoll_handle(eh) || h == eh) {
+      rc = -EINVAL;
+      goto out;
+   }
+
+   if (is_epoll_handle(h)) {
+      rc = -EINVAL; /* Nested epoll instances are not supported */
+      goto out;
+   }
+
+   ep = (void *)eh->kobj;
+
+   kmutex_lock(&ep->mutex);
+   {
+      rc = ep_ctl(ep, op, h, &ev);
+   }
+   kmutex_unlock(&ep->mutex);
+
+out:
+   kmutex_unlock(&pi->fslock);
+   return rc;
+}
+
+int sys_epoll_wait(int epfd, struct epoll_event *u_evs, int maxevents, int tm)
+{
+   struct task *curr = get_curr_task();
+   struct epoll_event *evs = curr->args_copybuf;
+   struct kfs_handle *eh;
+   int n;
+
+   if (maxevents <= 0)
+      return -EINVAL;
+
+   if (!(eh = get_fs_handle(epfd)))
+      return -EBADF;
+
+   if (!is_epoll_handle(eh))
+      return -EINVAL;
+
+   /* The events are collected in `args_copybuf`: return at most as many */
+   maxevents = MIN(maxevents, (int)(ARGS_COPYBUF_SIZE / sizeof(*evs)));
+   n = ep_wait((void *)eh->kobj, evs, maxevents, tm);
+
+   if (n > 0 && copy_to_user(u_evs, evs, sizeof(*evs) * (u32)n))
+      return -EFAULT;
+
+   return n;
+}
+
+int sys_epoll_pwait(int epfd,
+                    struct epoll_event *u_evs,
+                    int maxevents,
+                    int timeout,
+                    const sigset_t *u_sigmask,
+                    size_t sigsetsize)
+{
+   int rc;
+
+   if (!u_sigmask)
+      return sys_epoll_wait(epfd, u_evs, maxevents, timeout);
+
+   if ((rc = sigmask_temp_set(u_sigmask, sigsetsize)))
+      return rc;
+
+   rc = sys_epoll_wait(epfd, u_evs, maxevents, timeout);
+   sigmask_temp_restore();
+   return rc;
+}
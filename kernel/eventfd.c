@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/eventfd.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+
+#include <sys/eventfd.h>   // system header
+
+/*
+ * eventfd
+ * ---------
+ *
+ * A 64-bit counter, incremented by write() and consumed by read(). Unlike
+ * pipes, there's no buffer and no mutex: the counter is protected by disabling
+ * the preemption, as the wait lists of the conditions are, so a wake-up costs
+ * just an addition plus a kcond_signal_all().
+ */
+
+#define EVENTFD_MAX_COUNT           (UINT64_MAX - 1)
+
+struct eventfd {
+
+   KOBJ_BASE_FIELDS
+
+   u64 count;
+   bool semaphore;               /* EFD_SEMAPHORE */
+   struct kcond rd_cond;         /* signaled when `count` becomes > 0 */
+   struct kcond wr_cond;         /* signaled when `count` decreases */
+};
+
+/*
+ * Sleep on `c` until it's signaled. Must be called with preemption disabled,
+ * returns with preemption enabled. Returns -EINTR if a signal is pending.
+ */
+static int efd_wait(struct kcond *c)
+{
+   struct task *curr = get_curr_task();
+   ASSERT(!is_preemption_enabled());
+
+   prepare_to_wait_on(WOBJ_KCOND, c, NO_EXTRA, &c->wait_list);
+   enter_sleep_wait_state();
+   wait_obj_reset(&curr->wobj);
+
+   return pending_signals() ? -EINTR : 0;
+}
+
+static ssize_t efd_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   u64 val;
+   int rc;
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   while (true) {
+
+      disable_preemption();
+
+      if (e->count > 0)
+         break;
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         enable_preemption();
+         return -EAGAIN;
+      }
+
+      if ((rc = efd_wait(&e->rd_cond)))
+         return rc;
+   }
+
+   val = e->semaphore ? 1 : e->count;
+   e->count -= val;
+   kcond_signal_all(&e->wr_cond);
+   enable_preemption();
+
+   memcpy(buf, &val, sizeof(val));
+   return sizeof(val);
+}
+
+static ssize_t efd_write(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   u64 val;
+   int rc;
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   memcpy(&val, buf, sizeof(val));
+
+   if (val > EVENTFD_MAX_COUNT)
+      return -EINVAL;
+
+   while (true) {
+
+      disable_preemption();
+
+      if (EVENTFD_MAX_COUNT - e->count >= val)
+         break;
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         enable_preemption();
+         return -EAGAIN;
+      }
+
+      if ((rc = efd_wait(&e->wr_cond)))
+         return rc;
+   }
+
+   e->count += val;
+
+   if (val)
+      kcond_signal_all(&e->rd_cond);
+
+   enable_preemption();
+   return sizeof(val);
+}
+
+static int efd_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   bool ret;
+
+   disable_preemption();
+   {
+      ret = e->count > 0;
+   }
+   enable_preemption();
+   return ret;
+}
+
+static int efd_write_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   bool ret;
+
+   disable_preemption();
+   {
+      ret = e->count < EVENTFD_MAX_COUNT;
+   }
+   enable_preemption();
+   return ret;
+}
+
+static struct kcond *efd_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   return &e->rd_cond;
+}
+
+static struct kcond *efd_get_wready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct eventfd *e = (void *)kh->kobj;
+   return &e->wr_cond;
+}
+
+static const struct file_ops static_ops_eventfd =
+{
+   .read = efd_read,
+   .write = efd_write,
+   .read_ready = efd_read_ready,
+   .write_ready = efd_write_ready,
+   .get_rready_cond = efd_get_rready_cond,
+   .get_wready_cond = efd_get_wready_cond,
+};
+
+void destroy_eventfd(struct eventfd *e)
+{
+   kcond_destory(&e->wr_cond);
+   kcond_destory(&e->rd_cond);
+   kfree_obj(e, struct eventfd);
+}
+
+struct eventfd *create_eventfd(u64 initval, int flags)
+{
+   struct eventfd *e;
+
+   if (!(e = (void *)kzalloc_obj(struct eventfd)))
+      return NULL;
+
+   e->destory_obj = (void *)&destroy_eventfd;
+   e->count = initval;
+   e->semaphore = !!(flags & EFD_SEMAPHORE);
+   kcond_init(&e->rd_cond);
+   kcond_init(&e->wr_cond);
+   return e;
+}
+
+fs_handle eventfd_create_handle(struct eventfd *e, int fl_flags)
+{
+   return kfs_create_new_handle(&static_ops_eventfd, (void *)e, fl_flags);
+}
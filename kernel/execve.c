@@ -406,12 +406,26 @@ int sys_execve(const char *user_filename,
    struct task *curr = get_curr_task();
    ASSERT(curr != NULL);
 
+   /*
+    * NOTE: execve() from a thread other than the main one is not supported,
+    * as the `struct process` is allocated together with the main task.
+    */
+   if (!is_main_thread(curr))
+      return -EINVAL;
+
    if ((rc = execve_get_path(user_filename, &path)))
       return rc;
 
    if ((rc = execve_get_args(user_argv, user_env, &argv, &env)))
       return rc;
 
+   /*
+    * The other threads, if any, are killed before loading the new program:
+    * unlike Linux, they're gone even if execve() fails after this point.
+    */
+   if (!kill_other_threads_and_wait())
+      return -EINTR; /* the process is dying */
+
    return do_execve(curr,
                     path,
                     (const char *const *)argv,
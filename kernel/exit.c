@@ -13,6 +13,8 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/futex.h>
+#include <tilck/kernel/signal.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -200,13 +202,157 @@ switch_stack_free_mem_and_schedule(void)
    NOT_REACHED();
 }
 
+/*
+ * Exit path of the user threads other than the main one. The process is
+ * shared with the other threads: here we release only what belongs to the
+ * task itself. Nobody waits for threads with waitpid(): they're reaped right
+ * away, by free_mem_for_zombie_task().
+ */
+NORETURN static void exit_thread(int exit_code)
+{
+   struct task *const ti = get_curr_task();
+   struct process *const pi = ti->pi;
+
+   ASSERT(!is_main_thread(ti));
+   ASSERT(is_preemption_enabled());
+
+   futex_exit(ti);
+   disable_preemption();
+
+   if (ti->wobj.type != WOBJ_NONE)
+      wait_obj_reset(&ti->wobj);
+
+   task_cancel_wakeup_timer(ti);
+   drop_all_pending_signals(ti);
+   ti->nested_sig_handlers = -1;
+
+   task_change_state(ti, TASK_STATE_ZOMBIE);
+   ti->wstatus = EXITCODE(exit_code, 0);
+
+   call_on_task_exit_callbacks();
+   task_free_all_kernel_allocs(ti);
+
+   list_remove(&ti->thread_node);
+   pi->dead_threads_ticks += ti->ticks.total;
+   pi->dead_threads_ticks_kernel += ti->ticks.total_kernel;
+
+   /* Wake-up the main thread, in case it's waiting for us to exit */
+   wake_up_tasks_waiting_on(ti, task_died);
+   switch_stack_free_mem_and_schedule();
+}
 
 /*
- * NOTE: this code ASSUMES that user processes have a _single_ thread:
- *
- *    process = task = thread
- *
- * TODO: re-design this function when thread support is introduced.
+ * Send SIGKILL to all the threads of the process, except the current one.
+ * Called by the thread starting a group exit.
+ */
+static void kill_other_threads(struct task *ti)
+{
+   struct process *pi = ti->pi;
+   struct task *pos;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (!is_main_thread(ti))
+      send_signal2(pi->pid, pi->pid, SIGKILL, 0);
+
+   list_for_each_ro(pos, &pi->threads, thread_node) {
+      if (pos != ti)
+         send_signal2(pi->pid, pos->tid, SIGKILL, 0);
+   }
+}
+
+/*
+ * Called by the main thread: sleep until all the other threads of the process
+ * have exited. Expects the preemption to be disabled.
+ */
+static void wait_for_other_threads(struct task *ti)
+{
+   struct process *pi = ti->pi;
+   struct task *t;
+
+   ASSERT(is_main_thread(ti));
+   ASSERT(!is_preemption_enabled());
+
+   while (!list_is_empty(&pi->threads)) {
+
+      t = list_first_obj(&pi->threads, struct task, thread_node);
+
+      prepare_to_wait_on(WOBJ_TASK,
+                         TO_PTR(t->tid),
+                         NO_EXTRA,
+                         &t->tasks_waiting_list);
+
+      enter_sleep_wait_state();
+      wait_obj_reset(&ti->wobj);
+      disable_preemption();
+   }
+}
+
+/*
+ * Called by execve() in the main thread: kill all the other threads and wait
+ * for them to exit, without terminating the process. Returns false when the
+ * process is already dying.
+ */
+bool kill_other_threads_and_wait(void)
+{
+   struct task *const ti = get_curr_task();
+   struct process *const pi = ti->pi;
+
+   ASSERT(is_main_thread(ti));
+   disable_preemption();
+
+   if (pi->group_exit) {
+      enable_preemption();
+      return false;
+   }
+
+   if (!list_is_empty(&pi->threads)) {
+
+      /* Make the other threads exit just as threads, see terminate_process() */
+      pi->group_exit = true;
+      pi->group_exit_code = 0;
+      pi->group_term_sig = SIGKILL;
+
+      kill_other_threads(ti);
+      wait_for_other_threads(ti);
+      pi->group_exit = false;
+   }
+
+   enable_preemption();
+   return true;
+}
+
+/*
+ * exit(): terminate the current thread. When the main thread exits while other
+ * threads are still alive, it waits for them before terminating the process,
+ * because the `struct process` lives in the same allocation of its task.
+ */
+void terminate_thread(int exit_code)
+{
+   struct task *const ti = get_curr_task();
+
+   if (!is_main_thread(ti))
+      exit_thread(exit_code);
+
+   if (!list_is_empty(&ti->pi->threads)) {
+
+      disable_preemption();
+      {
+         /* Let the signals sent to the process go to the other threads */
+         ti->nested_sig_handlers = -1;
+         wait_for_other_threads(ti);
+      }
+      enable_preemption();
+   }
+
+   terminate_process(exit_code, 0 /* term_sig */);
+}
+
+/*
+ * Terminate the whole process (exit_group() or a fatal signal). The first
+ * thread getting here kills all the others; then, the main thread waits for
+ * them to exit, before doing the actual work, with the exit code and the
+ * signal of the first thread.
  *
  * NOTE: the kernel "process" has multiple threads (kthreads), but they cannot
  * be signalled nor killed.
@@ -227,6 +373,26 @@ void terminate_process(int exit_code, int term_sig)
 
    disable_preemption();
 
+   if (!pi->group_exit) {
+      pi->group_exit = true;
+      pi->group_exit_code = exit_code;
+      pi->group_term_sig = term_sig;
+      kill_other_threads(ti);
+   }
+
+   if (!is_main_thread(ti)) {
+      enable_preemption();
+      exit_thread(0);
+   }
+
+   exit_code = pi->group_exit_code;
+   term_sig = pi->group_term_sig;
+   enable_preemption();
+
+   /* Handle the robust futexes and clear_child_tid, as for any thread */
+   futex_exit(ti);
+   disable_preemption();
+
    if (ti->wobj.type != WOBJ_NONE) {
 
       /*
@@ -250,6 +416,9 @@ void terminate_process(int exit_code, int term_sig)
    drop_all_pending_signals(ti);
    ti->nested_sig_handlers = -1;
 
+   /* The other threads, if any, are dying: wait for them */
+   wait_for_other_threads(ti);
+
    /*
     * Close all the handles, keeping the preemption enabled while doing so.
     */
@@ -9,8 +9,50 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/test/fork.h>
 
+#include <linux/sched.h>   // system header
+
+/* The flags required by clone() to create a thread sharing everything */
+#define CLONE_THREAD_FLAGS                                              \
+   (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD)
+
+/* The flags accepted by clone() for thread creation */
+#define CLONE_THREAD_SUPP_FLAGS                                         \
+   (CLONE_THREAD_FLAGS | CLONE_SYSVSEM | CLONE_SETTLS |                 \
+    CLONE_PARENT_SETTID | CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID |   \
+    CLONE_DETACHED)
+
+/* The flags accepted by clone() for process creation (fork/vfork) */
+#define CLONE_PROC_SUPP_FLAGS                                           \
+   (CLONE_VM | CLONE_VFORK | CLONE_SETTLS | CLONE_PARENT_SETTID |       \
+    CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID | CLONE_DETACHED)
+
+/* Bits of the flags containing the signal to send to the parent on exit */
+#define CLONE_EXIT_SIG_MASK      0xff
+
+struct clone_params {
+   ulong flags;
+   void *stack;            /* child's user stack pointer, NULL = parent's */
+   int *ptid;              /* CLONE_PARENT_SETTID */
+   int *ctid;              /* CLONE_CHILD_SETTID and CLONE_CHILD_CLEARTID */
+   void *tls;              /* CLONE_SETTLS */
+};
+
+/* Same layout as Linux's struct clone_args (CLONE_ARGS_SIZE_VER0 part) */
+struct k_clone_args {
+   u64 flags;
+   u64 pidfd;
+   u64 child_tid;
+   u64 parent_tid;
+   u64 exit_signal;
+   u64 stack;
+   u64 stack_size;
+   u64 tls;
+};
+
 STATIC int fork_dup_all_handles(struct process *pi)
 {
    ASSERT(!is_preemption_enabled());
@@ -20,7 +62,7 @@ STATIC int fork_dup_all_handles(struct process *pi)
       int rc;
       fs_handle dup_h = NULL;
       fs_handle h = pi->handles[i];
-      struct user_mapping *um;
+      struct user_mapping *um, *tmp;
 
       if (!h)
          continue;
@@ -47,7 +89,7 @@ STATIC int fork_dup_all_handles(struct process *pi)
       if (!pi->mi)
          continue;
 
-      list_for_each_ro(um, &pi->mi->mappings, pi_node) {
+      mi_for_each_mapping(um, tmp, pi->mi) {
          if (um->h == h)
             um->h = dup_h;
       }
@@ -56,8 +98,29 @@ STATIC int fork_dup_all_handles(struct process *pi)
    return 0;
 }
 
+/*
+ * Write the tid of the child in the CLONE_CHILD_SETTID location. After fork(),
+ * that's in the address space of the child, so we temporarily switch to it.
+ */
+static void
+clone_set_child_tid(struct task *child, struct clone_params *p)
+{
+   pdir_t *curr_pdir = get_curr_pdir();
+
+   ASSERT(!is_preemption_enabled());
+
+   if (child->pi->pdir != curr_pdir)
+      set_curr_pdir(child->pi->pdir);
+
+   /* As in Linux, a failure here is silently ignored */
+   copy_to_user(p->ctid, &child->tid, sizeof(child->tid));
+
+   if (child->pi->pdir != curr_pdir)
+      set_curr_pdir(curr_pdir);
+}
+
 // Returns child's pid
-int do_fork(bool vfork)
+static int do_clone_process(struct clone_params *p)
 {
    int pid;
    int rc = -EAGAIN;
@@ -65,6 +128,7 @@ int do_fork(bool vfork)
    struct task *curr = get_curr_task();
    struct process *curr_pi = curr->pi;
    pdir_t *new_pdir = NULL;
+   const bool vfork = !!(p->flags & CLONE_VFORK);
 
    disable_preemption();
 
@@ -110,12 +174,28 @@ int do_fork(bool vfork)
    *child->state_regs = *curr->state_regs; // copy parent's regs_t
    set_return_register(child->state_regs, 0);
 
+   if (p->stack)
+      regs_set_usersp(child->state_regs, (ulong)p->stack);
+
    // Make the parent to get child's pid as return value.
    set_return_register(curr->state_regs, (ulong) child->tid);
 
+   if (p->flags & CLONE_SETTLS)
+      if ((rc = arch_specific_new_thread_setup(child, curr, p->tls)))
+         goto err_case;
+
    if (fork_dup_all_handles(child->pi) < 0)
       goto oom_case;
 
+   if (p->flags & CLONE_CHILD_CLEARTID)
+      child->clear_child_tid = p->ctid;
+
+   if (p->flags & CLONE_CHILD_SETTID)
+      clone_set_child_tid(child, p);
+
+   if (p->flags & CLONE_PARENT_SETTID)
+      copy_to_user(p->ptid, &child->tid, sizeof(child->tid));
+
    add_task(child);
 
    if (vfork) {
@@ -163,6 +243,8 @@ oom_case:
 
    rc = -ENOMEM;
 
+err_case:
+
    if (new_pdir)
       pdir_destroy(new_pdir);
 
@@ -176,3 +258,165 @@ out:
    enable_preemption();
    return rc;
 }
+
+int do_fork(bool vfork)
+{
+   struct clone_params p = {
+      .flags = vfork ? (CLONE_VM | CLONE_VFORK) : 0,
+   };
+
+   return do_clone_process(&p);
+}
+
+/*
+ * Create a new thread in the current process. The new task shares everything
+ * with the calling one, including the `struct process`, which is ref-counted.
+ */
+static int do_clone_thread(struct clone_params *p)
+{
+   struct task *curr = get_curr_task();
+   struct process *pi = curr->pi;
+   struct task *ti;
+   int tid, rc;
+
+   if (pi->vforked)
+      return -EINVAL; /* we share the memory with our parent */
+
+   disable_preemption();
+
+   if (pi->group_exit) {
+      rc = -EAGAIN; /* the process is dying */
+      goto out;
+   }
+
+   if ((tid = create_new_pid()) < 0) {
+      rc = -EAGAIN;
+      goto out;
+   }
+
+   if (!(ti = allocate_new_thread(pi, tid, true))) {
+      rc = -ENOMEM;
+      goto out;
+   }
+
+   /* From now on, free_task() will release this reference */
+   retain_obj(pi);
+
+   rc = arch_specific_new_thread_setup(ti,
+                                       curr,
+                                       p->flags & CLONE_SETTLS ? p->tls : NULL);
+
+   if (rc) {
+      ti->state = TASK_STATE_ZOMBIE;
+      free_common_task_allocs(ti);
+      free_task(ti);
+      goto out;
+   }
+
+   /* The signal mask is per-thread and it's inherited by the new thread */
+   memcpy(ti->sa_mask, curr->sa_mask, sizeof(ti->sa_mask));
+
+   ti->state = TASK_STATE_RUNNABLE;
+   ti->running_in_kernel = false;
+   task_info_reset_kernel_stack(ti);
+
+   ti->state_regs--;                  // make room for a regs_t struct
+   *ti->state_regs = *curr->state_regs;
+   set_return_register(ti->state_regs, 0);
+   regs_set_usersp(ti->state_regs, (ulong)p->stack);
+
+   if (p->flags & CLONE_CHILD_CLEARTID)
+      ti->clear_child_tid = p->ctid;
+
+   /* We share the address space: both the writes happen in our memory */
+   if (p->flags & CLONE_PARENT_SETTID)
+      copy_to_user(p->ptid, &tid, sizeof(tid));
+
+   if (p->flags & CLONE_CHILD_SETTID)
+      copy_to_user(p->ctid, &tid, sizeof(tid));
+
+   list_add_tail(&pi->threads, &ti->thread_node);
+   add_task(ti);
+   rc = tid;
+
+out:
+   enable_preemption();
+   return rc;
+}
+
+static int do_clone(struct clone_params *p)
+{
+   const ulong flags = p->flags & ~CLONE_EXIT_SIG_MASK;
+
+   if (flags & CLONE_THREAD) {
+
+      if ((flags & CLONE_THREAD_FLAGS) != CLONE_THREAD_FLAGS)
+         return -EINVAL;
+
+      if (flags & ~CLONE_THREAD_SUPP_FLAGS)
+         return -EINVAL;
+
+      if (!p->stack)
+         return -EINVAL;
+
+      return do_clone_thread(p);
+   }
+
+   if (flags & ~CLONE_PROC_SUPP_FLAGS)
+      return -EINVAL;
+
+   /* Sharing the memory without CLONE_VFORK is not supported */
+   if (!!(flags & CLONE_VM) != !!(flags & CLONE_VFORK))
+      return -EINVAL;
+
+   /*
+    * NOTE: the exit signal in the low bits of `flags` is ignored: the parent
+    * always gets SIGCHLD, as after fork().
+    */
+   return do_clone_process(p);
+}
+
+int sys_clone(ulong flags, void *newsp, int *ptid, void *tls, int *ctid)
+{
+   struct clone_params p = {
+      .flags = flags,
+      .stack = newsp,
+      .ptid = ptid,
+      .ctid = ctid,
+      .tls = tls,
+   };
+
+   return do_clone(&p);
+}
+
+int sys_clone3(void *user_args, size_t size)
+{
+   struct k_clone_args args = {0};
+   struct clone_params p;
+
+   if (size < sizeof(args) || size > PAGE_SIZE)
+      return -EINVAL;
+
+   /* Fields added after CLONE_ARGS_SIZE_VER0 are not supported */
+   if (copy_from_user(&args, user_args, sizeof(args)))
+      return -EFAULT;
+
+   if ((args.flags >> 32) || (args.flags & CLONE_EXIT_SIG_MASK))
+      return -EINVAL;
+
+   if (args.exit_signal > CLONE_EXIT_SIG_MASK)
+      return -EINVAL;
+
+   if (!!args.stack != !!args.stack_size)
+      return -EINVAL;
+
+   p = (struct clone_params) {
+      .flags = (ulong)args.flags,
+      .stack = args.stack ? TO_PTR(args.stack + args.stack_size) : NULL,
+      .ptid = TO_PTR(args.parent_tid),
+      .ctid = TO_PTR(args.child_tid),
+      .tls = TO_PTR(args.tls),
+   };
+
+   return do_clone(&p);
+}
@@ -105,6 +105,83 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
    return (ssize_t)written_to_buf;
 }
 
+/*
+ * Zero-copy read used by sendfile(): pass to `cb` pointers directly to the
+ * clusters in the (ramdisk) device's memory.
+ */
+STATIC ssize_t
+fat_splice_read(fs_handle handle,
+                size_t len,
+                offt *pos,
+                vfs_data_cb cb,
+                void *arg)
+{
+   struct fatfs_handle *h = (struct fatfs_handle *) handle;
+   struct fat_fs_device_data *d = h->fs->device_data;
+   const bool use_fpos = pos == &h->h_fpos;
+   offt fsize = (offt)h->e->DIR_FileSize;
+   ssize_t tot_read = 0;
+   ssize_t rc = 0;
+   u32 clu, fatval;
+
+   if (h->e->directory)
+      return -EISDIR;
+
+   if (*pos >= fsize)
+      return 0;
+
+   if (use_fpos) {
+
+      clu = h->curr_cluster;
+
+   } else {
+
+      /* sendfile() with an explicit offset: walk the chain from the start */
+      clu = fat_get_first_cluster(h->e);
+
+      for (offt i = *pos / (offt)d->cluster_size; i > 0; i--)
+         clu = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+   }
+
+   while ((size_t)tot_read < len) {
+
+      char *data = fat_get_pointer_to_cluster_data(d->hdr, clu);
+
+      const offt file_rem       = fsize - *pos;
+      const offt buf_rem        = (offt)(len - (size_t)tot_read);
+      const offt cluster_off    = *pos % (offt)d->cluster_size;
+      const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
+      const offt to_read        = MIN3(cluster_rem, buf_rem, file_rem);
+
+      ASSERT(to_read > 0);
+
+      if ((rc = cb(arg, data + cluster_off, (size_t)to_read, false)) <= 0)
+         break;
+
+      tot_read += rc;
+      *pos += rc;
+
+      if (rc < cluster_rem)
+         break; /* Short write, end of the file or `len` bytes read */
+
+      fatval = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      if (fat_is_end_of_clusterchain(d->type, fatval)) {
+         ASSERT(*pos == fsize);
+         break;
+      }
+
+      /* We do not expect BAD CLUSTERS */
+      ASSERT(!fat_is_bad_cluster(d->type, fatval));
+      clu = fatval;
+
+      if (use_fpos)
+         h->curr_cluster = clu;
+   }
+
+   return tot_read > 0 ? tot_read : rc;
+}
+
 
 STATIC int
 fat_rewind(fs_handle handle)
@@ -466,6 +543,7 @@ static const struct file_ops static_ops_fat =
    .ioctl = fat_ioctl,
    .mmap = fat_mmap,
    .munmap = fat_munmap,
+   .splice_read = fat_splice_read,
 };
 
 STATIC int
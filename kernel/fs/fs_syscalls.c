@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/hal.h>
@@ -11,8 +12,15 @@
 #include <tilck/kernel/fault_resumable.h>
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/pipe.h>
+#include <tilck/kernel/epoll.h>
+#include <tilck/kernel/eventfd.h>
+#include <tilck/kernel/timerfd.h>
+#include <tilck/kernel/io_uring.h>
 
 #include <fcntl.h>      // system header
+#include <sys/eventfd.h> // system header
+#include <sys/timerfd.h> // system header
+#include <linux/io_uring.h> // system header
 
 static inline bool is_fd_in_valid_range(int fd)
 {
@@ -309,6 +317,230 @@ int sys_pwrite64(int fd, const void *u_buf, size_t count, s64 off)
    return ret;
 }
 
+static int do_sendfile(int out_fd, int in_fd, offt *pos, size_t count)
+{
+   fs_handle out, in;
+
+   if (!(out = get_fs_handle(out_fd)) || !(in = get_fs_handle(in_fd)))
+      return -EBADF;
+
+   count = MIN(count, (size_t)INT32_MAX);
+   return (int)vfs_sendfile(out, in, pos, count);
+}
+
+int sys_sendfile(int out_fd, int in_fd, long *u_offset, size_t count)
+{
+   long off;
+   offt pos;
+   int rc;
+
+   if (!u_offset)
+      return do_sendfile(out_fd, in_fd, NULL, count);
+
+   if (copy_from_user(&off, u_offset, sizeof(off)))
+      return -EFAULT;
+
+   if (off < 0)
+      return -EINVAL;
+
+   pos = (offt)off;
+
+   if ((rc = do_sendfile(out_fd, in_fd, &pos, count)) < 0)
+      return rc;
+
+   off = (long)pos;
+
+   if (copy_to_user(u_offset, &off, sizeof(off)))
+      return -EFAULT;
+
+   return rc;
+}
+
+int sys_sendfile64(int out_fd, int in_fd, s64 *u_offset, size_t count)
+{
+   s64 off;
+   offt pos;
+   int rc;
+
+   if (!u_offset)
+      return do_sendfile(out_fd, in_fd, NULL, count);
+
+   if (copy_from_user(&off, u_offset, sizeof(off)))
+      return -EFAULT;
+
+   if (off < 0 || off > OFFT_MAX)
+      return -EINVAL;
+
+   pos = (offt)off;
+
+   if ((rc = do_sendfile(out_fd, in_fd, &pos, count)) < 0)
+      return rc;
+
+   off = (s64)pos;
+
+   if (copy_to_user(u_offset, &off, sizeof(off)))
+      return -EFAULT;
+
+   return rc;
+}
+
+#ifndef SPLICE_F_MOVE
+   #define SPLICE_F_MOVE            1
+   #define SPLICE_F_NONBLOCK        2
+   #define SPLICE_F_MORE            4
+   #define SPLICE_F_GIFT            8
+#endif
+
+#define SPLICE_F_ALL                                                       \
+   (SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)
+
+static int splice_get_pos(fs_handle h, s64 *u_off, offt *buf, offt **pos)
+{
+   struct fs_handle_base *hb = h;
+   s64 off;
+
+   if (!u_off) {
+      *pos = &hb->h_fpos;
+      return 0;
+   }
+
+   if (!hb->fops->seek)
+      return -ESPIPE;
+
+   if (copy_from_user(&off, u_off, sizeof(off)))
+      return -EFAULT;
+
+   if (off < 0 || off > OFFT_MAX)
+      return -EINVAL;
+
+   *buf = (offt)off;
+   *pos = buf;
+   return 0;
+}
+
+static int splice_put_pos(s64 *u_off, offt pos)
+{
+   s64 off = (s64)pos;
+
+   if (u_off && copy_to_user(u_off, &off, sizeof(off)))
+      return -EFAULT;
+
+   return 0;
+}
+
+static int
+do_splice_from_pipe(fs_handle in, fs_handle out, s64 *u_off_out,
+                    size_t len, bool nb)
+{
+   struct fs_handle_base *hout = out;
+   offt off, *pos;
+   int rc;
+
+   if (!hout->fops->write || !(hout->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF;
+
+   if (hout->fl_flags & O_APPEND)
+      return -EINVAL; /* Same as Linux */
+
+   if (hout->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return -EINVAL;
+
+   if ((rc = splice_get_pos(out, u_off_out, &off, &pos)))
+      return rc;
+
+   if ((rc = (int)pipe_splice_out(in, out, pos, len, nb)) > 0) {
+      if (splice_put_pos(u_off_out, *pos))
+         return -EFAULT;
+   }
+
+   return rc;
+}
+
+static int
+do_splice_to_pipe(fs_handle in, s64 *u_off_in, fs_handle out,
+                  size_t len, bool nb)
+{
+   struct fs_handle_base *hin = in;
+   offt off, *pos;
+   int rc;
+
+   if (!hin->fops->read)
+      return -EBADF;
+
+   if ((hin->fl_flags & O_WRONLY) && !(hin->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (hin->spec_flags & VFS_SPFL_NO_USER_COPY)
+      return -EINVAL;
+
+   if ((rc = splice_get_pos(in, u_off_in, &off, &pos)))
+      return rc;
+
+   if ((rc = (int)pipe_splice_in(out, in, pos, len, nb)) > 0) {
+      if (splice_put_pos(u_off_in, *pos))
+         return -EFAULT;
+   }
+
+   return rc;
+}
+
+int sys_splice(int fd_in, s64 *u_off_in, int fd_out, s64 *u_off_out,
+               size_t len, unsigned int flags)
+{
+   const bool nb = !!(flags & SPLICE_F_NONBLOCK);
+   bool in_pipe, out_pipe;
+   fs_handle in, out;
+
+   if (flags & ~SPLICE_F_ALL)
+      return -EINVAL;
+
+   if (!(in = get_fs_handle(fd_in)) || !(out = get_fs_handle(fd_out)))
+      return -EBADF;
+
+   in_pipe = is_pipe_read_end(in);
+   out_pipe = is_pipe_write_end(out);
+
+   if ((in_pipe && u_off_in) || (out_pipe && u_off_out))
+      return -ESPIPE;
+
+   if (!len)
+      return 0;
+
+   len = MIN(len, (size_t)INT32_MAX);
+
+   if (in_pipe && out_pipe)
+      return (int)pipe_splice_pipe(in, out, len, nb, false);
+
+   if (in_pipe)
+      return do_splice_from_pipe(in, out, u_off_out, len, nb);
+
+   if (out_pipe)
+      return do_splice_to_pipe(in, u_off_in, out, len, nb);
+
+   return -EINVAL; /* At least one of the two files must be a pipe */
+}
+
+int sys_tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+   const bool nb = !!(flags & SPLICE_F_NONBLOCK);
+   fs_handle in, out;
+
+   if (flags & ~SPLICE_F_ALL)
+      return -EINVAL;
+
+   if (!(in = get_fs_handle(fd_in)) || !(out = get_fs_handle(fd_out)))
+      return -EBADF;
+
+   if (!is_pipe_read_end(in) || !is_pipe_write_end(out))
+      return -EINVAL;
+
+   if (!len)
+      return 0;
+
+   len = MIN(len, (size_t)INT32_MAX);
+   return (int)pipe_splice_pipe(in, out, len, nb, true);
+}
+
 int sys_ioctl(int fd, ulong request, void *argp)
 {
    fs_handle handle = get_fs_handle(fd);
@@ -384,6 +616,42 @@ int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
    return (int)vfs_readv(handle, iov, u_iovcnt);
 }
 
+int sys_vmsplice(int fd, const struct iovec *u_iov, ulong nr_segs,
+                 unsigned int flags)
+{
+   struct task *curr = get_curr_task();
+   struct iovec *iov = (void *)curr->args_copybuf;
+   const bool nb = !!(flags & SPLICE_F_NONBLOCK);
+   const int iovcnt = (int)nr_segs;
+   fs_handle h;
+
+   if (flags & ~SPLICE_F_ALL)
+      return -EINVAL;
+
+   if (!nr_segs)
+      return 0;
+
+   if (nr_segs > ARGS_COPYBUF_SIZE / sizeof(struct iovec))
+      return -EINVAL;
+
+   if (copy_from_user(iov, u_iov, sizeof(struct iovec) * nr_segs))
+      return -EFAULT;
+
+   if (iov_len_overflow(iov, iovcnt))
+      return -EINVAL;
+
+   if (!(h = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (is_pipe_write_end(h))
+      return (int)pipe_vmsplice_in(h, iov, iovcnt, nb);
+
+   if (is_pipe_read_end(h))
+      return (int)pipe_vmsplice_out(h, iov, iovcnt, nb);
+
+   return -EBADF;
+}
+
 static int
 call_vfs_stat64(const char *u_path,
                 struct k_stat64 *u_statbuf,
@@ -727,6 +995,11 @@ void close_cloexec_handles(struct process *pi)
    kmutex_unlock(&pi->fslock);
 }
 
+#ifndef F_SETPIPE_SZ
+   #define F_SETPIPE_SZ             1031
+   #define F_GETPIPE_SZ             1032
+#endif
+
 int sys_fcntl64(int fd, int cmd, int arg)
 {
    int rc = 0;
@@ -792,6 +1065,23 @@ int sys_fcntl64(int fd, int cmd, int arg)
       case F_GETFL:
          return hb->fl_flags;
 
+      case F_SETPIPE_SZ:
+
+         if (!is_pipe_read_end(hb) && !is_pipe_write_end(hb))
+            return -EBADF;
+
+         if (arg < 0)
+            return -EINVAL;
+
+         return pipe_set_size(hb, (ulong)arg);
+
+      case F_GETPIPE_SZ:
+
+         if (!is_pipe_read_end(hb) && !is_pipe_write_end(hb))
+            return -EBADF;
+
+         return pipe_get_size(hb);
+
       default:
          printk("fcntl64: Ignored unknown cmd %d\n", cmd);
    }
@@ -1047,3 +1337,227 @@ no_fds:
    ret = -EMFILE;
    goto err_end;
 }
+
+int sys_epoll_create1(int flags)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h = NULL;
+   struct epoll *ep = NULL;
+   int fd, ret;
+
+   if (flags & ~EPOLL_CLOEXEC)
+      return -EINVAL;
+
+   kmutex_lock(&curr->pi->fslock);
+
+   if (!(ep = create_epoll())) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if ((fd = get_free_handle_num(curr->pi)) < 0) {
+      ret = -EMFILE;
+      goto out;
+   }
+
+   if (!(h = epoll_create_handle(ep))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if (flags & EPOLL_CLOEXEC)
+      h->fd_flags |= FD_CLOEXEC;
+
+   curr->pi->handles[fd] = h;
+   ret = fd;
+
+out:
+   if (ret < 0 && ep)
+      destroy_epoll(ep);
+
+   kmutex_unlock(&curr->pi->fslock);
+   return ret;
+}
+
+int sys_epoll_create(int size)
+{
+   if (size <= 0)
+      return -EINVAL;
+
+   /* Since Linux 2.6.8, `size` is ignored but must be greater than zero */
+   return sys_epoll_create1(0);
+}
+
+int sys_eventfd2(unsigned int initval, int flags)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h = NULL;
+   struct eventfd *e = NULL;
+   int fd, ret;
+
+   if (flags & ~(EFD_SEMAPHORE | EFD_CLOEXEC | EFD_NONBLOCK))
+      return -EINVAL;
+
+   kmutex_lock(&curr->pi->fslock);
+
+   if (!(e = create_eventfd(initval, flags))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if ((fd = get_free_handle_num(curr->pi)) < 0) {
+      ret = -EMFILE;
+      goto out;
+   }
+
+   if (!(h = eventfd_create_handle(e, O_RDWR | (flags & EFD_NONBLOCK)))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if (flags & EFD_CLOEXEC)
+      h->fd_flags |= FD_CLOEXEC;
+
+   curr->pi->handles[fd] = h;
+   ret = fd;
+
+out:
+   if (ret < 0 && e)
+      destroy_eventfd(e);
+
+   kmutex_unlock(&curr->pi->fslock);
+   return ret;
+}
+
+int sys_eventfd(unsigned int initval)
+{
+   return sys_eventfd2(initval, 0);
+}
+
+int sys_timerfd_create(clockid_t clk_id, int flags)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h = NULL;
+   struct timerfd *t = NULL;
+   int fd, ret;
+
+   if (clk_id != CLOCK_REALTIME && clk_id != CLOCK_MONOTONIC)
+      return -EINVAL;
+
+   if (flags & ~(TFD_CLOEXEC | TFD_NONBLOCK))
+      return -EINVAL;
+
+   kmutex_lock(&curr->pi->fslock);
+
+   if (!(t = create_timerfd(clk_id))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if ((fd = get_free_handle_num(curr->pi)) < 0) {
+      ret = -EMFILE;
+      goto out;
+   }
+
+   if (!(h = timerfd_create_handle(t, O_RDONLY | (flags & TFD_NONBLOCK)))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   if (flags & TFD_CLOEXEC)
+      h->fd_flags |= FD_CLOEXEC;
+
+   curr->pi->handles[fd] = h;
+   ret = fd;
+
+out:
+   if (ret < 0 && t)
+      destroy_timerfd(t);
+
+   kmutex_unlock(&curr->pi->fslock);
+   return ret;
+}
+
+int sys_io_uring_setup(u32 entries, struct io_uring_params *u_params)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h = NULL;
+   struct io_uring_ctx *ctx = NULL;
+   struct io_uring_params p;
+   u32 cq_entries;
+   int fd, ret;
+
+   if (copy_from_user(&p, u_params, sizeof(p)))
+      return -EFAULT;
+
+   /* SQPOLL, IOPOLL and the other setup flags are not supported */
+   if (p.flags & ~(IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP))
+      return -EINVAL;
+
+   if (!entries)
+      return -EINVAL;
+
+   if (entries > IO_URING_MAX_ENTRIES) {
+
+      if (!(p.flags & IORING_SETUP_CLAMP))
+         return -EINVAL;
+
+      entries = IO_URING_MAX_ENTRIES;
+   }
+
+   entries = (u32)roundup_next_power_of_2(entries);
+   cq_entries = 2 * entries;
+
+   if (p.flags & IORING_SETUP_CQSIZE) {
+
+      if (!p.cq_entries)
+         return -EINVAL;
+
+      if (p.cq_entries > 2 * IO_URING_MAX_ENTRIES) {
+
+         if (!(p.flags & IORING_SETUP_CLAMP))
+            return -EINVAL;
+
+         p.cq_entries = 2 * IO_URING_MAX_ENTRIES;
+      }
+
+      cq_entries = (u32)roundup_next_power_of_2(p.cq_entries);
+
+      if (cq_entries < entries)
+         return -EINVAL;
+   }
+
+   if (!(ctx = create_io_uring(entries, cq_entries)))
+      return -ENOMEM;
+
+   io_uring_get_params(ctx, &p);
+
+   if (copy_to_user(u_params, &p, sizeof(p))) {
+      destroy_io_uring(ctx);
+      return -EFAULT;
+   }
+
+   kmutex_lock(&curr->pi->fslock);
+
+   if ((fd = get_free_handle_num(curr->pi)) < 0) {
+      ret = -EMFILE;
+      goto out;
+   }
+
+   if (!(h = io_uring_create_handle(ctx))) {
+      ret = -ENOMEM;
+      goto out;
+   }
+
+   /* As on Linux, io_uring file descriptors are always close-on-exec */
+   h->fd_flags |= FD_CLOEXEC;
+   curr->pi->handles[fd] = h;
+   ret = fd;
+
+out:
+   if (ret < 0)
+      destroy_io_uring(ctx);
+
+   kmutex_unlock(&curr->pi->fslock);
+   return ret;
+}
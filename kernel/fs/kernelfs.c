@@ -14,7 +14,7 @@
  * objects like pipes. It's existence cannot be avoided since all handles must
  * have a valid `fs` pointer.
  *
- * Currently, only pipes use it.
+ * Currently, pipes, epoll, io_uring instances, eventfds and timerfds use it.
  */
 
 static struct mnt_fs *kernelfs;
@@ -1,21 +1,24 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+static struct kmem_cache ramfs_blocks_cache =
+   KMEM_CACHE_INIT("ramfs_block", sizeof(struct ramfs_block), NULL);
+
 static struct ramfs_block *ramfs_new_block(offt page)
 {
    struct ramfs_block *b;
 
    /* Allocate memory for the block object */
-   if (!(b = kalloc_obj(struct ramfs_block)))
+   if (!(b = kmem_cache_alloc(&ramfs_blocks_cache)))
       return NULL;
 
    /* Allocate block's data */
-   if (!(b->vaddr = kzmalloc(PAGE_SIZE))) {
-      kfree_obj(b, struct ramfs_block);
+   if (!(b->vaddr = kzalloc_page())) {
+      kmem_cache_free(&ramfs_blocks_cache, b);
       return NULL;
    }
 
    /* Retain the pageframe used by this block */
-   retain_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
+   retain_kernel_page(b->vaddr);
 
    /* Init the block object */
    bintree_node_init(&b->node);
@@ -25,14 +28,14 @@ static struct ramfs_block *ramfs_new_block(offt page)
 
 static void ramfs_destroy_block(struct ramfs_block *b)
 {
-   /* Release the pageframe used by this block */
-   release_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
-
-   /* Free the memory pointed by this block */
-   kfree2(b->vaddr, PAGE_SIZE);
+   /*
+    * Release the pageframe used by this block. Its memory is freed here,
+    * unless the page is still referenced by someone else (e.g. a pipe).
+    */
+   release_kernel_page(b->vaddr);
 
    /* Free the memory used by the block object itself */
-   kfree_obj(b, struct ramfs_block);
+   kmem_cache_free(&ramfs_blocks_cache, b);
 }
 
 static void
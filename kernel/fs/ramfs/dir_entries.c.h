@@ -1,5 +1,8 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+static struct kmem_cache ramfs_entries_cache =
+   KMEM_CACHE_INIT("ramfs_entry", sizeof(struct ramfs_entry), NULL);
+
 static long ramfs_insert_remove_entry_cmp(const void *a, const void *b)
 {
    const struct ramfs_entry *e1 = a;
@@ -29,7 +32,7 @@ ramfs_dir_add_entry(struct ramfs_inode *idir,
    if (enl > sizeof(e->name))
       return -ENAMETOOLONG;
 
-   if (!(e = kalloc_obj(struct ramfs_entry)))
+   if (!(e = kmem_cache_alloc(&ramfs_entries_cache)))
       return -ENOSPC;
 
    ASSERT(ie->parent_dir != NULL);
@@ -90,7 +93,7 @@ ramfs_dir_remove_entry(struct ramfs_inode *idir, struct ramfs_entry *e)
    ASSERT(ie->nlink > 0);
    ie->nlink--;
    idir->num_entries--;
-   kfree_obj(e, struct ramfs_entry);
+   kmem_cache_free(&ramfs_entries_cache, e);
 }
 
 static struct ramfs_entry *
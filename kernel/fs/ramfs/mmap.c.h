@@ -1,5 +1,18 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+/*
+ * Ramfs mappings are populated lazily: ramfs_mmap() just registers the mapping
+ * in the inode, while the pages are mapped by ramfs_handle_fault() at the first
+ * access. Together with the faulting page, all the resident blocks in the
+ * aligned window of FAULT_AROUND_PAGES pages around it get mapped as well, in
+ * order to save most of the page faults in the sequential access case.
+ *
+ * Holes are mapped read-only to the zero page: writing there creates a block,
+ * exactly as write() does.
+ */
+
+STATIC_ASSERT(FAULT_AROUND_PAGES > 0);
+
 static int ramfs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
 {
    return generic_fs_munmap(um, vaddrp, len);
@@ -10,68 +23,93 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
 {
    struct ramfs_handle *rh = um->h;
    struct ramfs_inode *i = rh->inode;
-   ulong vaddr = um->vaddr;
-   struct bintree_walk_ctx ctx;
-   struct ramfs_block *b;
-   u32 pg_flags;
-   int rc;
-
-   const size_t off_begin = um->off;
-   const size_t off_end = off_begin + um->len;
 
    ASSERT(IS_PAGE_ALIGNED(um->len));
 
    if (i->type != VFS_FILE)
       return -EACCES;
 
-   if (flags & VFS_MM_DONT_MMAP)
-      goto register_mapping;
+   if (!(flags & VFS_MM_DONT_REGISTER)) {
+      list_add_tail(&i->mappings_list, &um->inode_node);
+   }
 
-   bintree_in_order_visit_start(&ctx,
-                                i->blocks_tree_root,
-                                struct ramfs_block,
-                                node,
-                                false);
+   return 0;
+}
 
-   pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
+/*
+ * Un-map the zero page from all the mappings of the hole at `offset`, because
+ * a block has just been created there.
+ */
+static void ramfs_unmap_hole_in_mappings(struct ramfs_inode *i, offt offset)
+{
+   struct user_mapping *um;
+   ulong va;
 
-   if ((rh->fl_flags & O_RDWR) == O_RDWR)
-      pg_flags |= PAGING_FL_RW;
+   ASSERT(!is_preemption_enabled());
 
-   while ((b = bintree_in_order_visit_next(&ctx))) {
+   list_for_each_ro(um, &i->mappings_list, inode_node) {
 
-      if ((size_t)b->offset < off_begin)
-         continue; /* skip this block */
+      if ((size_t)offset < um->off || (size_t)offset >= um->off + um->len)
+         continue;
 
-      if ((size_t)b->offset >= off_end)
-         break;
+      va = um->vaddr + ((size_t)offset - um->off);
+      unmap_page_permissive(um->pi->pdir, (void *)va, false);
+   }
+}
 
-      rc = map_page(pdir,
-                    (void *)vaddr,
-                    LIN_VA_TO_PA(b->vaddr),
-                    pg_flags);
+static inline struct ramfs_block *
+ramfs_find_block(struct ramfs_inode *i, offt offset)
+{
+   return bintree_find_ptr(i->blocks_tree_root,
+                           offset,
+                           struct ramfs_block,
+                           node,
+                           offset);
+}
 
-      if (rc) {
+static int
+ramfs_map_block(pdir_t *pdir,
+                struct user_mapping *um,
+                ulong vaddr,
+                struct ramfs_block *b)
+{
+   u32 pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
 
-         /* mmap failed, we have to unmap the pages already mapped */
-         vaddr -= PAGE_SIZE;
+   if (um->prot & PROT_WRITE)
+      pg_flags |= PAGING_FL_RW;
 
-         for (; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
-            unmap_page_permissive(pdir, (void *)vaddr, false);
-         }
+   return map_page(pdir, (void *)vaddr, LIN_VA_TO_PA(b->vaddr), pg_flags);
+}
 
-         return rc;
-      }
+static void
+ramfs_fault_around(struct process *pi, struct user_mapping *um, ulong vaddr)
+{
+   const size_t win_size = FAULT_AROUND_PAGES * PAGE_SIZE;
+   struct ramfs_inode *inode = ((struct ramfs_handle *)um->h)->inode;
+   const offt fsize = inode->fsize;
+   struct ramfs_block *b;
+   ulong va, start, end;
+   offt off;
 
-      vaddr += PAGE_SIZE;
-   }
+   start = MAX(vaddr - (vaddr % win_size), um->vaddr);
+   end = MIN(start + win_size, um->vaddr + um->len);
 
-register_mapping:
-   if (!(flags & VFS_MM_DONT_REGISTER)) {
-      list_add_tail(&i->mappings_list, &um->inode_node);
-   }
+   for (va = start; va < end; va += PAGE_SIZE) {
 
-   return 0;
+      off = (offt)(um->off + (va - um->vaddr));
+
+      if (off >= fsize)
+         break;
+
+      if (is_mapped(pi->pdir, (void *)va))
+         continue;
+
+      if (!(b = ramfs_find_block(inode, off)))
+         continue; /* Holes are mapped only when accessed */
+
+      if (ramfs_map_block(pi->pdir, um, va, b))
+         break; /* Not a problem: these pages have not been accessed yet */
+   }
 }
 
 static bool
@@ -82,8 +120,9 @@ ramfs_handle_fault_int(struct process *pi,
                        bool rw)
 {
    struct ramfs_handle *rh = um->h;
-   ulong vaddr = (ulong) vaddrp;
-   ulong abs_off;
+   struct ramfs_inode *inode = rh->inode;
+   ulong vaddr = (ulong) vaddrp & PAGE_MASK;
+   offt abs_off;
    struct ramfs_block *block;
    int rc;
 
@@ -93,41 +132,60 @@ ramfs_handle_fault_int(struct process *pi,
 
       /*
        * The page is present, just is read-only and the user code tried to
-       * write: there's nothing we can do.
+       * write. That's fine only if the page is a hole, mapped to the zero
+       * page, in a writable mapping.
        */
 
       ASSERT(rw);
-      ASSERT((um->prot & PROT_WRITE) == 0);
-      return false;
+
+      if (!(um->prot & PROT_WRITE))
+         return false;
+
+      if (get_mapping(pi->pdir, (void *)vaddr) != KERNEL_VA_TO_PA(&zero_page))
+         return false;
+
+      unmap_page(pi->pdir, (void *)vaddr, false);
    }
 
-   /* The page is *not* present */
-   abs_off = um->off + (vaddr - um->vaddr);
+   abs_off = (offt)(um->off + (vaddr - um->vaddr));
 
-   if (abs_off >= (ulong)rh->inode->fsize)
+   if (abs_off >= inode->fsize)
       return false; /* Read/write past EOF */
 
-   if (rw) {
+   if ((block = ramfs_find_block(inode, abs_off))) {
+
+      rc = ramfs_map_block(pi->pdir, um, vaddr, block);
+
+   } else if (rw) {
+
       /* Create and map on-the-fly a struct ramfs_block */
-      if (!(block = ramfs_new_block((offt)(abs_off & PAGE_MASK))))
+      if (!(block = ramfs_new_block(abs_off)))
          panic("Out-of-memory: unable to alloc a ramfs_block. No OOM killer");
 
-      ramfs_append_new_block(rh->inode, block);
-   }
+      ramfs_append_new_block(inode, block);
+
+      /* Other mappings of the same file might have the hole mapped */
+      ramfs_unmap_hole_in_mappings(inode, abs_off);
+      rc = ramfs_map_block(pi->pdir, um, vaddr, block);
 
-   rc = map_page(pi->pdir,
-                 (void *)(vaddr & PAGE_MASK),
-                 rw ? LIN_VA_TO_PA(block->vaddr) : KERNEL_VA_TO_PA(&zero_page),
-                 PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
+   } else {
+
+      /* Reading a hole: map the zero page, read-only */
+      rc = map_page(pi->pdir,
+                    (void *)vaddr,
+                    KERNEL_VA_TO_PA(&zero_page),
+                    PAGING_FL_US | PAGING_FL_SHARED);
+   }
 
    if (rc)
       panic("Out-of-memory: unable to map a ramfs_block. No OOM killer");
 
-   invalidate_page(vaddr);
+   if (FAULT_AROUND_PAGES > 1)
+      ramfs_fault_around(pi, um, vaddr);
+
    return true;
 }
 
-
 static bool
 ramfs_handle_fault(struct user_mapping *um, void *vaddrp, bool p, bool rw)
 {
@@ -11,6 +11,7 @@ static const struct file_ops static_ops_ramfs =
    .mmap = ramfs_mmap,
    .munmap = ramfs_munmap,
    .handle_fault = ramfs_handle_fault,
+   .splice_read = ramfs_splice_read,
 };
 
 static int
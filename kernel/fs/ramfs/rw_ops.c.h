@@ -312,6 +312,84 @@ static ssize_t ramfs_read(fs_handle h, char *buf, size_t len, offt *pos)
    return ret;
 }
 
+/*
+ * Zero-copy read used by sendfile() and splice(): pass to `cb` pointers
+ * directly to the blocks of the file (or to the zero page, for holes).
+ *
+ * The inode is NOT kept locked while `cb` runs, because the callback might
+ * block (e.g. on a full pipe) or lock other inodes: a reference to the block's
+ * page is held instead, so that the page survives a concurrent truncate().
+ */
+static ssize_t
+ramfs_splice_read(fs_handle h, size_t len, offt *pos, vfs_data_cb cb, void *arg)
+{
+   struct ramfs_handle *rh = h;
+   struct ramfs_inode *inode = rh->inode;
+   ssize_t tot_read = 0;
+   ssize_t rc = 0;
+
+   if (inode->type == VFS_DIR)
+      return -EISDIR;
+
+   ASSERT(inode->type == VFS_FILE);
+
+   while ((size_t)tot_read < len) {
+
+      struct ramfs_block *block;
+      char *page = NULL;
+      char *data = NULL;
+      offt to_read;
+
+      ramfs_file_shlock(h);
+      {
+         const offt pg       = *pos & (offt)PAGE_MASK;
+         const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
+         const offt page_rem = (offt)PAGE_SIZE - page_off;
+         const offt file_rem = inode->fsize - *pos;
+         const offt buf_rem  = (offt)(len - (size_t)tot_read);
+
+         to_read = MIN3(page_rem, buf_rem, file_rem);
+
+         if (to_read > 0) {
+
+            block = bintree_find_ptr(inode->blocks_tree_root,
+                                     pg,
+                                     struct ramfs_block,
+                                     node,
+                                     offset);
+
+            if (block) {
+               page = block->vaddr;
+               retain_kernel_page(page);
+            }
+
+            /* Holes are read from the zero page */
+            data = page ? page + page_off : zero_page;
+         }
+      }
+      ramfs_file_shunlock(h);
+
+      if (to_read <= 0)
+         break; /* EOF */
+
+      rc = cb(arg, data, (size_t)to_read, page != NULL);
+
+      if (page)
+         release_kernel_page(page);
+
+      if (rc <= 0)
+         break;
+
+      tot_read += rc;
+      *pos += rc;
+
+      if (rc < to_read)
+         break;
+   }
+
+   return tot_read > 0 ? tot_read : rc;
+}
+
 static ssize_t
 ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 {
@@ -350,6 +428,16 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
             break;
 
          ramfs_append_new_block(inode, block);
+
+         if (!list_is_empty(&inode->mappings_list)) {
+
+            /* The hole might be mapped to the zero page somewhere */
+            disable_preemption();
+            {
+               ramfs_unmap_hole_in_mappings(inode, page);
+            }
+            enable_preemption();
+         }
       }
 
       memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
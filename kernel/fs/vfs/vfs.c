@@ -6,11 +6,14 @@
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/fs/flock.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/kmem_cache.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/epoll.h>
+#include <tilck/kernel/io_uring.h>
 
 #include <dirent.h> // system header
 
@@ -36,6 +39,12 @@ void vfs_close(fs_handle h)
    struct locked_file *lf = hb->lf;
    const struct fs_ops *fsops = fs->fsops;
 
+   if (hb->spec_flags & VFS_SPFL_EPOLL_WATCHED)
+      epoll_on_handle_close(h);
+
+   if (hb->spec_flags & VFS_SPFL_IOURING_WATCHED)
+      io_uring_on_handle_close(h);
+
    if (!pi->vforked)
       remove_all_mappings_of_handle(pi, h);
 
@@ -171,6 +180,112 @@ ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off)
    return hb->fops->write(h, buf, buf_size, &off);
 }
 
+static ssize_t
+vfs_sendfile_data_cb(void *arg, char *buf, size_t len, bool page_ref)
+{
+   struct fs_handle_base *out = arg;
+   return out->fops->write(out, buf, len, &out->h_fpos);
+}
+
+static ssize_t
+vfs_sendfile_bounce(struct fs_handle_base *out,
+                    struct fs_handle_base *in,
+                    offt *in_pos,
+                    size_t count)
+{
+   struct task *curr = get_curr_task();
+   ssize_t tot = 0;
+   ssize_t rc, wrc;
+   offt saved_pos;
+   size_t len;
+
+   while ((size_t)tot < count) {
+
+      len = MIN(count - (size_t)tot, IO_COPYBUF_SIZE);
+      saved_pos = *in_pos;
+
+      if ((rc = in->fops->read(in, curr->io_copybuf, len, in_pos)) <= 0) {
+         tot = tot ? tot : rc;
+         break;
+      }
+
+      wrc = out->fops->write(out, curr->io_copybuf, (size_t)rc, &out->h_fpos);
+
+      if (wrc < rc) {
+
+         /* Un-read what we couldn't write (no effect on pipes and ttys) */
+         *in_pos = saved_pos + MAX(wrc, 0);
+
+         if (wrc > 0)
+            tot += wrc;
+
+         tot = tot ? tot : wrc;
+         break;
+      }
+
+      tot += wrc;
+
+      /*
+       * Don't block waiting for more data on pipes and ttys: after a short
+       * read, or after the first chunk from a non-seekable file, stop here.
+       */
+      if ((size_t)rc < len || !in->fops->seek)
+         break;
+   }
+
+   return tot;
+}
+
+/*
+ * Copy `count` bytes from `in` to `out` entirely in the kernel. When the
+ * source file system implements splice_read(), the data is copied straight
+ * from its backing memory into the destination's write path. Otherwise,
+ * the per-task io_copybuf is used as a bounce buffer.
+ *
+ * If `in_pos` is NULL, the file position of `in` is used and updated.
+ */
+ssize_t vfs_sendfile(fs_handle out_h, fs_handle in_h, offt *in_pos, size_t cnt)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(out_h != NULL);
+   ASSERT(in_h != NULL);
+
+   struct fs_handle_base *out = out_h;
+   struct fs_handle_base *in = in_h;
+   const struct fs_ops *in_fsops = in->fs->fsops;
+
+   if (!in->fops->read || !out->fops->write)
+      return -EBADF;
+
+   if ((in->fl_flags & O_WRONLY) && !(in->fl_flags & O_RDWR))
+      return -EBADF; /* file not opened for reading */
+
+   if (!(out->fl_flags & (O_WRONLY | O_RDWR)))
+      return -EBADF; /* file not opened for writing */
+
+   if (out->fl_flags & O_APPEND)
+      return -EINVAL; /* Same as Linux */
+
+   /* Those handles' read() and write() funcs work only with user pointers */
+   if ((in->spec_flags | out->spec_flags) & VFS_SPFL_NO_USER_COPY)
+      return -EINVAL;
+
+   /* Copying a file onto itself is not supported */
+   if (in->fs == out->fs && in_fsops->get_inode(in) == in_fsops->get_inode(out))
+      return -EINVAL;
+
+   if (!in_pos)
+      in_pos = &in->h_fpos;
+
+   if (!cnt)
+      return 0;
+
+   if (in->fops->splice_read)
+      return in->fops->splice_read(in, cnt, in_pos, vfs_sendfile_data_cb, out);
+
+   return vfs_sendfile_bounce(out, in, in_pos, cnt);
+}
+
 offt vfs_seek(fs_handle h, offt off, int whence)
 {
    NO_TEST_ASSERT(is_preemption_enabled());
@@ -994,6 +1109,9 @@ panic_handles[PANIC_HANDLES][MAX_FS_HANDLE_SIZE] ALIGNED_AT(MAX_FS_HANDLE_SIZE);
 static bool
 panic_handles_used[PANIC_HANDLES];
 
+static struct kmem_cache handles_cache =
+   KMEM_CACHE_INIT("fs_handle", MAX_FS_HANDLE_SIZE, NULL);
+
 fs_handle vfs_alloc_handle_raw(void)
 {
    if (UNLIKELY(in_panic())) {
@@ -1008,7 +1126,7 @@ fs_handle vfs_alloc_handle_raw(void)
       return NULL;
    }
 
-   return kmalloc(MAX_FS_HANDLE_SIZE);
+   return kmem_cache_alloc(&handles_cache);
 }
 
 void vfs_free_handle(fs_handle h)
@@ -1025,7 +1143,7 @@ void vfs_free_handle(fs_handle h)
       return;
    }
 
-   kfree2(h, MAX_FS_HANDLE_SIZE);
+   kmem_cache_free(&handles_cache, h);
 }
 
 fs_handle vfs_alloc_handle(void)
@@ -0,0 +1,535 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/futex.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/list.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/syscalls.h>
+
+#include <linux/futex.h>   // system header
+
+/*
+ * Futexes
+ * ---------
+ *
+ * Waiting tasks are kept in a small table of wait lists, hashed by futex key.
+ * A private futex (FUTEX_PRIVATE_FLAG) is identified by the page directory of
+ * the process plus its user address, while a shared one by its physical
+ * address, in order to work across processes sharing the same memory.
+ *
+ * Each waiter has a `struct futex_q` on its stack, pointed by its wait obj.
+ * The wait obj's `extra` field contains the bitset of the waiter. Everything
+ * here is protected by disabling the preemption.
+ */
+
+#define FUTEX_HASH_BITS               6
+#define FUTEX_HASH_SIZE               (1u << FUTEX_HASH_BITS)
+#define FUTEX_ROBUST_LIST_LIMIT       2048
+
+struct futex_key {
+   ulong space;     /* pdir for private futexes, 0 for shared ones */
+   ulong addr;      /* user vaddr for private futexes, paddr for shared */
+};
+
+struct futex_q {
+   struct futex_key key;
+   bool woken;      /* set by the waker, before calling wake_up() */
+};
+
+static struct list futex_queues[FUTEX_HASH_SIZE];
+
+void init_futexes(void)
+{
+   for (u32 i = 0; i < FUTEX_HASH_SIZE; i++)
+      list_init(&futex_queues[i]);
+}
+
+static struct list *futex_bucket(struct futex_key *key)
+{
+   const u32 h = (u32)((key->addr >> 2) ^ (key->space >> PAGE_SHIFT));
+   return &futex_queues[(h * 2654435761u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+static inline bool
+futex_key_eq(struct futex_key *a, struct futex_key *b)
+{
+   return a->space == b->space && a->addr == b->addr;
+}
+
+static int
+futex_get_key(u32 *uaddr, bool priv, struct futex_key *key)
+{
+   pdir_t *pdir = get_curr_proc()->pdir;
+   ulong paddr;
+   u32 val;
+
+   ASSERT(!is_preemption_enabled());
+
+   if ((ulong)uaddr & (sizeof(u32) - 1))
+      return -EINVAL;
+
+   if (priv) {
+      key->space = (ulong)pdir;
+      key->addr = (ulong)uaddr;
+      return 0;
+   }
+
+   /*
+    * Write back the value, in order to make sure that the page is not shared
+    * copy-on-write with another process: otherwise, the physical address would
+    * change on the first write in user space, making the key stale.
+    */
+   if (copy_from_user(&val, uaddr, sizeof(val)))
+      return -EFAULT;
+
+   if (copy_to_user(uaddr, &val, sizeof(val)))
+      return -EFAULT;
+
+   if (get_mapping2(pdir, uaddr, &paddr))
+      return -EFAULT;
+
+   key->space = 0;
+   key->addr = paddr;
+   return 0;
+}
+
+/*
+ * Wake up to `nr` tasks waiting on `key` with a bitset matching `bitset`.
+ * Returns the number of woken up tasks.
+ */
+static int
+futex_wake_key(struct futex_key *key, int nr, u32 bitset)
+{
+   struct list *bucket = futex_bucket(key);
+   struct wait_obj *pos, *temp;
+   struct futex_q *q;
+   struct task *ti;
+   int cnt = 0;
+
+   ASSERT(!is_preemption_enabled());
+
+   list_for_each(pos, temp, bucket, wait_list_node) {
+
+      if (cnt >= nr)
+         break;
+
+      q = atomic_load_explicit(&pos->__ptr, mo_relaxed);
+
+      if (!futex_key_eq(&q->key, key) || !(pos->extra & bitset))
+         continue;
+
+      ti = CONTAINER_OF(pos, struct task, wobj);
+      q->woken = true;
+      task_cancel_wakeup_timer(ti);
+      wake_up(ti);
+      cnt++;
+   }
+
+   return cnt;
+}
+
+/*
+ * Wake up to `nr_wake` tasks waiting on `key` and move up to `nr_requeue` of
+ * the remaining ones to the wait list of `key2`.
+ */
+static int
+futex_requeue_key(struct futex_key *key,
+                  struct futex_key *key2,
+                  int nr_wake,
+                  int nr_requeue)
+{
+   struct list *bucket = futex_bucket(key);
+   struct list *bucket2 = futex_bucket(key2);
+   struct wait_obj *pos, *temp;
+   struct futex_q *q;
+   int woken, moved = 0;
+
+   ASSERT(!is_preemption_enabled());
+   woken = futex_wake_key(key, nr_wake, FUTEX_BITSET_MATCH_ANY);
+
+   list_for_each(pos, temp, bucket, wait_list_node) {
+
+      if (moved >= nr_requeue)
+         break;
+
+      q = atomic_load_explicit(&pos->__ptr, mo_relaxed);
+
+      if (!futex_key_eq(&q->key, key))
+         continue;
+
+      q->key = *key2;
+
+      if (bucket2 != bucket) {
+         list_remove(&pos->wait_list_node);
+         list_add_tail(bucket2, &pos->wait_list_node);
+      }
+
+      moved++;
+   }
+
+   return woken + moved;
+}
+
+/*
+ * Sleep on the futex at `uaddr` as long as it contains `val`. If `deadline`
+ * is not 0, it's an absolute monotonic time.
+ */
+static int
+futex_wait(u32 *uaddr, bool priv, u32 val, u32 bitset, u64 deadline)
+{
+   struct task *curr = get_curr_task();
+   struct futex_q q = {0};
+   bool timed_out;
+   u32 curr_val;
+   int rc;
+
+   if (!bitset)
+      return -EINVAL;
+
+   disable_preemption();
+
+   if ((rc = futex_get_key(uaddr, priv, &q.key))) {
+      enable_preemption();
+      return rc;
+   }
+
+   if (copy_from_user(&curr_val, uaddr, sizeof(curr_val))) {
+      enable_preemption();
+      return -EFAULT;
+   }
+
+   if (curr_val != val) {
+      enable_preemption();
+      return -EAGAIN;
+   }
+
+   if (deadline)
+      task_set_wakeup_hrtimer(curr, deadline);
+
+   prepare_to_wait_on(WOBJ_FUTEX, &q, bitset, futex_bucket(&q.key));
+   enter_sleep_wait_state();
+
+   /*
+    * We might have been woken up by futex_wake_key(), by a signal or by our
+    * timer. Only in the last case, the wait obj is still set.
+    */
+   wait_obj_reset(&curr->wobj);
+   timed_out = deadline && !curr->wakeup_hrtimer.active;
+   task_cancel_wakeup_timer(curr);
+
+   if (q.woken)
+      return 0;
+
+   return timed_out ? -ETIMEDOUT : -EINTR;
+}
+
+/*
+ * Convert the timeout of FUTEX_WAIT* into an absolute monotonic deadline.
+ * FUTEX_WAIT uses a relative timeout, while FUTEX_WAIT_BITSET an absolute one,
+ * measured against CLOCK_REALTIME if FUTEX_CLOCK_REALTIME is set.
+ */
+static int
+futex_get_deadline(int cmd,
+                   bool clock_rt,
+                   const struct k_timespec64 *ts,
+                   u64 *deadline)
+{
+   struct k_timespec64 now_ts;
+   u64 t, now;
+
+   if (!is_valid_timespec(ts))
+      return -EINVAL;
+
+   t = timespec_to_ns(ts);
+
+   if (cmd == FUTEX_WAIT) {
+      *deadline = hrtimer_expiry_in(t);
+      return 0;
+   }
+
+   if (!clock_rt) {
+      *deadline = MAX(t, 1ull);
+      return 0;
+   }
+
+   /* As in clock_nanosleep(), later changes of the system time are ignored */
+   real_time_get_timespec(&now_ts);
+   now = timespec_to_ns(&now_ts);
+
+   if (t <= now)
+      return -ETIMEDOUT;
+
+   *deadline = hrtimer_expiry_in(t - now);
+   return 0;
+}
+
+static int
+do_futex(u32 *uaddr,
+         int op,
+         u32 val,
+         const struct k_timespec64 *ts,  /* kernel copy of the timeout */
+         ulong val2,                     /* the timeout arg, as an integer */
+         u32 *uaddr2,
+         u32 val3)
+{
+   const int cmd = op & FUTEX_CMD_MASK;
+   const bool priv = !!(op & FUTEX_PRIVATE_FLAG);
+   const bool clock_rt = !!(op & FUTEX_CLOCK_REALTIME);
+   struct futex_key key, key2;
+   u64 deadline = 0;
+   u32 curr_val;
+   int rc;
+
+   if (clock_rt && cmd != FUTEX_WAIT_BITSET)
+      return -ENOSYS;
+
+   switch (cmd) {
+
+      case FUTEX_WAIT:
+         val3 = FUTEX_BITSET_MATCH_ANY;
+         /* fall-through */
+
+      case FUTEX_WAIT_BITSET:
+
+         if (ts && (rc = futex_get_deadline(cmd, clock_rt, ts, &deadline)))
+            return rc;
+
+         return futex_wait(uaddr, priv, val, val3, deadline);
+
+      case FUTEX_WAKE:
+         val3 = FUTEX_BITSET_MATCH_ANY;
+         /* fall-through */
+
+      case FUTEX_WAKE_BITSET:
+
+         if (!val3)
+            return -EINVAL;
+
+         disable_preemption();
+         {
+            if (!(rc = futex_get_key(uaddr, priv, &key)))
+               rc = futex_wake_key(&key, (int)MIN(val, 0x7fffffffu), val3);
+         }
+         enable_preemption();
+         return rc;
+
+      case FUTEX_REQUEUE:
+      case FUTEX_CMP_REQUEUE:
+
+         if ((int)val < 0 || (long)val2 < 0)
+            return -EINVAL;
+
+         disable_preemption();
+         {
+            rc = futex_get_key(uaddr, priv, &key);
+
+            if (!rc)
+               rc = futex_get_key(uaddr2, priv, &key2);
+
+            if (!rc && cmd == FUTEX_CMP_REQUEUE) {
+
+               if (copy_from_user(&curr_val, uaddr, sizeof(curr_val)))
+                  rc = -EFAULT;
+               else if (curr_val != val3)
+                  rc = -EAGAIN;
+            }
+
+            if (!rc)
+               rc = futex_requeue_key(&key, &key2, (int)val, (int)val2);
+         }
+         enable_preemption();
+         return rc;
+
+      default:
+         return -ENOSYS;
+   }
+}
+
+static bool futex_cmd_has_timeout(int op)
+{
+   const int cmd = op & FUTEX_CMD_MASK;
+   return cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_BITSET;
+}
+
+int sys_futex_time32(u32 *uaddr, int op, u32 val,
+                     const struct k_timespec32 *user_ts,
+                     u32 *uaddr2, u32 val3)
+{
+   struct k_timespec32 ts32;
+   struct k_timespec64 ts;
+
+   if (!futex_cmd_has_timeout(op) || !user_ts)
+      return do_futex(uaddr, op, val, NULL, (ulong)user_ts, uaddr2, val3);
+
+   if (copy_from_user(&ts32, user_ts, sizeof(ts32)))
+      return -EFAULT;
+
+   ts = (struct k_timespec64) {
+      .tv_sec = ts32.tv_sec,
+      .tv_nsec = ts32.tv_nsec,
+   };
+
+   return do_futex(uaddr, op, val, &ts, 0, uaddr2, val3);
+}
+
+int sys_futex(u32 *uaddr, int op, u32 val,
+              const struct k_timespec64 *user_ts,
+              u32 *uaddr2, u32 val3)
+{
+   struct k_timespec64 ts;
+
+   if (!futex_cmd_has_timeout(op) || !user_ts)
+      return do_futex(uaddr, op, val, NULL, (ulong)user_ts, uaddr2, val3);
+
+   if (copy_from_user(&ts, user_ts, sizeof(ts)))
+      return -EFAULT;
+
+   return do_futex(uaddr, op, val, &ts, 0, uaddr2, val3);
+}
+
+int sys_set_robust_list(void *head, size_t len)
+{
+   if (len != sizeof(struct robust_list_head))
+      return -EINVAL;
+
+   get_curr_task()->robust_list = head;
+   return 0;
+}
+
+int sys_get_robust_list(int tid, void **user_head, size_t *user_len)
+{
+   const size_t len = sizeof(struct robust_list_head);
+   struct task *ti;
+   void *head;
+
+   disable_preemption();
+   {
+      ti = tid ? get_task(tid) : get_curr_task();
+
+      if (!ti || is_kernel_thread(ti)) {
+         enable_preemption();
+         return -ESRCH;
+      }
+
+      if (ti->pi != get_curr_proc()) {
+         enable_preemption();
+         return -EPERM;
+      }
+
+      head = ti->robust_list;
+   }
+   enable_preemption();
+
+   if (copy_to_user(user_head, &head, sizeof(head)))
+      return -EFAULT;
+
+   if (copy_to_user(user_len, &len, sizeof(len)))
+      return -EFAULT;
+
+   return 0;
+}
+
+/*
+ * Wake up one waiter of the futex at `uaddr`, on behalf of an exiting task.
+ * We don't know if user space waits on it as a private or as a shared futex:
+ * with our keys, the two cases are different, so just try both.
+ */
+static void futex_exit_wake(u32 *uaddr)
+{
+   struct futex_key key;
+
+   if (!futex_get_key(uaddr, true, &key))
+      if (futex_wake_key(&key, 1, FUTEX_BITSET_MATCH_ANY))
+         return;
+
+   if (!futex_get_key(uaddr, false, &key))
+      futex_wake_key(&key, 1, FUTEX_BITSET_MATCH_ANY);
+}
+
+/*
+ * Mark the robust futex at `uaddr` as owned by a dead task, if `ti` was its
+ * owner and wake up one of its waiters, if any.
+ */
+static int handle_futex_death(struct task *ti, u32 *uaddr)
+{
+   u32 val, new_val;
+
+   if (copy_from_user(&val, uaddr, sizeof(val)))
+      return -EFAULT;
+
+   if ((val & FUTEX_TID_MASK) != (u32)ti->tid)
+      return 0;
+
+   new_val = (val & FUTEX_WAITERS) | FUTEX_OWNER_DIED;
+
+   if (copy_to_user(uaddr, &new_val, sizeof(new_val)))
+      return -EFAULT;
+
+   if (val & FUTEX_WAITERS)
+      futex_exit_wake(uaddr);
+
+   return 0;
+}
+
+static void exit_robust_list(struct task *ti)
+{
+   struct robust_list_head head;
+   struct robust_list *entry, *next, *pending;
+   int limit = FUTEX_ROBUST_LIST_LIMIT;
+
+   if (copy_from_user(&head, ti->robust_list, sizeof(head)))
+      return;
+
+   entry = head.list.next;
+   pending = head.list_op_pending;
+
+   while (entry != &((struct robust_list_head *)ti->robust_list)->list) {
+
+      if (copy_from_user(&next, &entry->next, sizeof(next)))
+         return;
+
+      if (entry != pending)
+         if (handle_futex_death(ti, (u32 *)((ulong)entry + head.futex_offset)))
+            return;
+
+      entry = next;
+
+      if (!--limit)
+         return; /* Corrupted or circular list: just give up */
+   }
+
+   if (pending)
+      handle_futex_death(ti, (u32 *)((ulong)pending + head.futex_offset));
+}
+
+void futex_exit(struct task *ti)
+{
+   const int zero = 0;
+   ASSERT(ti == get_curr_task());
+
+   disable_preemption();
+   {
+      if (ti->robust_list) {
+         exit_robust_list(ti);
+         ti->robust_list = NULL;
+      }
+
+      if (ti->clear_child_tid) {
+
+         if (!copy_to_user(ti->clear_child_tid, &zero, sizeof(zero)))
+            futex_exit_wake((u32 *)ti->clear_child_tid);
+
+         ti->clear_child_tid = NULL;
+      }
+   }
+   enable_preemption();
+}
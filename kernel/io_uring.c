@@ -0,0 +1,1043 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/io_uring.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/signal.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/user.h>
+
+#include <fcntl.h>            // system header
+#include <sys/mman.h>         // system header
+#include <linux/io_uring.h>   // system header
+
+/*
+ * io_uring
+ * ----------
+ *
+ * An io_uring instance is a kernelfs object, like epoll, owning a submission
+ * queue (SQ) and a completion queue (CQ) shared with the user space through
+ * mmap(). The layout is the Linux one, described to the user by
+ * io_uring_setup(): the indexes, the CQEs and the SQ array live in a single
+ * region (IORING_FEAT_SINGLE_MMAP), while the SQEs live in a second one.
+ *
+ * Tilck runs on a single CPU and its file systems have no asynchronous paths,
+ * so io_uring_enter() executes the submitted requests inline, in the context
+ * of the submitting task, by calling the regular syscall implementations. Only
+ * the requests waiting for an event (poll and timeout) remain pending: their
+ * completion is posted by a bottom half on a worker thread, enqueued either by
+ * a kcond watch callback (see sync.h) or by an hrtimer callback. As in timerfd,
+ * a pending bottom half holds a reference to the instance and the state it
+ * shares with the callbacks is protected by disabling the interrupts.
+ *
+ * The CQ and the pending list are protected by the instance's mutex, while the
+ * submissions are serialized by a separate mutex, as executing a request might
+ * post other completions (e.g. count-based timeouts). As in epoll, closing a
+ * file handle cancels all the polls on it.
+ *
+ * Limitations: SQPOLL, IOPOLL and registered files and buffers are not
+ * supported. On CQ overflow, the completions are dropped and counted (no
+ * IORING_FEAT_NODROP). A failure cancels the rest of a linked chain, but
+ * pending polls and timeouts do not delay the requests following them.
+ */
+
+#define IO_SQE_FLAGS      (IOSQE_IO_DRAIN | IOSQE_IO_LINK |                \
+                           IOSQE_IO_HARDLINK | IOSQE_ASYNC)
+
+#define IO_POLL_ALWAYS_EVENTS  (POLLERR | POLLHUP)
+
+enum io_watch_type {
+   IO_WATCH_R,
+   IO_WATCH_W,
+   IO_WATCH_E,
+   IO_WATCH_COUNT,
+};
+
+/* The head of the region shared with the user space (IORING_OFF_SQ_RING) */
+struct io_rings {
+
+   ATOMIC(u32) sq_head;             /* written by the kernel */
+   ATOMIC(u32) sq_tail;             /* written by the user */
+   ATOMIC(u32) cq_head;             /* written by the user */
+   ATOMIC(u32) cq_tail;             /* written by the kernel */
+   u32 sq_ring_mask;
+   u32 cq_ring_mask;
+   u32 sq_ring_entries;
+   u32 cq_ring_entries;
+   u32 sq_flags;
+   u32 sq_dropped;
+   u32 cq_flags;
+   u32 cq_overflow;
+
+   /* Followed by the CQEs and by the SQ array */
+};
+
+STATIC_ASSERT((sizeof(struct io_rings) % sizeof(struct io_uring_cqe)) == 0);
+
+struct io_req {
+
+   struct list_node node;           /* node in the pending list */
+   struct io_uring_ctx *ctx;
+   u64 user_data;
+   u8 opcode;                       /* IORING_OP_POLL_ADD or _TIMEOUT */
+   bool done;                       /* removed from the pending list */
+   bool bh_pending;
+
+   /* IORING_OP_POLL_ADD */
+   fs_handle h;
+   u32 events;
+   struct kcond_watch watches[IO_WATCH_COUNT];
+
+   /* IORING_OP_TIMEOUT */
+   struct hrtimer timer;
+   bool has_target;
+   u32 target;                      /* completes when cq_posted reaches it */
+};
+
+struct io_uring_ctx {
+
+   KOBJ_BASE_FIELDS
+
+   struct kmutex sq_mutex;          /* serializes the submissions */
+   struct kmutex mutex;             /* protects the CQ and the pending list */
+   struct kcond cq_cond;            /* signaled on each completion */
+   struct list pending;             /* pending polls and timeouts */
+   struct list_node node;           /* node in `io_uring_list` */
+   bool closed;                     /* all the handles have been closed */
+
+   struct io_rings *rings;
+   struct io_uring_cqe *cqes;
+   u32 *sq_array;
+   struct io_uring_sqe *sqes;
+   size_t rings_size;
+   size_t sqes_size;
+
+   u32 sq_entries;
+   u32 cq_entries;
+   u32 sq_head;                     /* private copies of the kernel-owned */
+   u32 cq_tail;                     /* indexes, not trusting the user ones */
+   u32 cq_posted;                   /* completions, excluding the timeouts */
+
+   ATOMIC(int) handles;
+};
+
+/* All the io_uring instances, used when a polled file handle gets closed */
+static struct list io_uring_list = STATIC_LIST_INIT(io_uring_list);
+static struct kmutex io_uring_list_mutex =
+   STATIC_KMUTEX_INIT(io_uring_list_mutex, 0);
+
+static const struct file_ops static_ops_io_uring;
+
+static inline bool is_io_uring_handle(fs_handle h)
+{
+   return ((struct fs_handle_base *)h)->fops == &static_ops_io_uring;
+}
+
+static inline void *io_uptr(u64 addr)
+{
+   return (void *)(ulong)addr;
+}
+
+static u32 io_cq_ready(struct io_uring_ctx *ctx)
+{
+   u32 head = atomic_load_explicit(&ctx->rings->cq_head, mo_acquire);
+   return MIN(ctx->cq_tail - head, ctx->cq_entries);
+}
+
+static void io_fill_cqe(struct io_uring_ctx *ctx, u64 user_data, s32 res)
+{
+   struct io_rings *r = ctx->rings;
+   struct io_uring_cqe *cqe;
+   ASSERT(kmutex_is_curr_task_holding_lock(&ctx->mutex));
+
+   if (io_cq_ready(ctx) == ctx->cq_entries) {
+      r->cq_overflow++;
+      return;
+   }
+
+   cqe = &ctx->cqes[ctx->cq_tail & (ctx->cq_entries - 1)];
+   cqe->user_data = user_data;
+   cqe->res = res;
+   cqe->flags = 0;
+
+   ctx->cq_tail++;
+   atomic_store_explicit(&r->cq_tail, ctx->cq_tail, mo_release);
+   kcond_signal_all(&ctx->cq_cond);
+}
+
+static void io_req_remove(struct io_req *req)
+{
+   bool free_req;
+   ulong var;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&req->ctx->mutex));
+   list_remove(&req->node);
+
+   for (int i = 0; i < IO_WATCH_COUNT; i++)
+      kcond_watch_remove(&req->watches[i]);
+
+   disable_interrupts(&var);
+   {
+      if (req->opcode == IORING_OP_TIMEOUT)
+         hrtimer_cancel(&req->timer);
+
+      /* If a bottom half is pending, it will free the request */
+      req->done = true;
+      free_req = !req->bh_pending;
+   }
+   enable_interrupts(&var);
+
+   if (free_req)
+      kfree_obj(req, struct io_req);
+}
+
+static void io_flush_timeouts(struct io_uring_ctx *ctx)
+{
+   struct io_req *req, *tmp;
+
+   list_for_each(req, tmp, &ctx->pending, node) {
+
+      if (req->opcode != IORING_OP_TIMEOUT || !req->has_target)
+         continue;
+
+      if ((s32)(ctx->cq_posted - req->target) >= 0) {
+
+         /* Posting a timeout's CQE never removes other requests */
+         io_fill_cqe(ctx, req->user_data, 0);
+         io_req_remove(req);
+      }
+   }
+}
+
+/* Post the completion of a request, other than a timeout */
+static void io_post(struct io_uring_ctx *ctx, u64 user_data, s32 res)
+{
+   io_fill_cqe(ctx, user_data, res);
+   ctx->cq_posted++;
+   io_flush_timeouts(ctx);
+}
+
+static void io_req_complete(struct io_req *req, s32 res)
+{
+   struct io_uring_ctx *ctx = req->ctx;
+   const u64 user_data = req->user_data;
+   const bool is_timeout = req->opcode == IORING_OP_TIMEOUT;
+
+   io_req_remove(req);
+
+   if (is_timeout)
+      io_fill_cqe(ctx, user_data, res);
+   else
+      io_post(ctx, user_data, res);
+}
+
+static u32 io_poll_mask(fs_handle h, u32 events)
+{
+   u32 mask = 0;
+   int rc;
+
+   if ((events & POLLIN) && vfs_read_ready(h))
+      mask |= POLLIN;
+
+   if ((events & POLLOUT) && vfs_write_ready(h))
+      mask |= POLLOUT;
+
+   if ((rc = vfs_except_ready(h)))
+      mask |= rc > 0 ? (u32)rc & events : POLLERR;
+
+   return mask;
+}
+
+static void io_req_bottom_half(void *arg)
+{
+   struct io_req *req = arg;
+   struct io_uring_ctx *ctx = req->ctx;
+   bool done;
+   ulong var;
+   u32 mask;
+
+   kmutex_lock(&ctx->mutex);
+   {
+      disable_interrupts(&var);
+      {
+         req->bh_pending = false;
+         done = req->done;
+      }
+      enable_interrupts(&var);
+
+      if (done) {
+
+         /* Cancelled or completed meanwhile */
+         kfree_obj(req, struct io_req);
+
+      } else if (req->opcode == IORING_OP_TIMEOUT) {
+
+         io_req_complete(req, -ETIME);
+
+      } else if ((mask = io_poll_mask(req->h, req->events))) {
+
+         io_req_complete(req, (s32)mask);
+      }
+   }
+   kmutex_unlock(&ctx->mutex);
+
+   if (release_obj(ctx) == 0)
+      destroy_io_uring(ctx); /* All the handles have been closed meanwhile */
+}
+
+/* Called with interrupts disabled, possibly in IRQ context */
+static void io_req_queue_bh(struct io_req *req)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (req->bh_pending || req->done)
+      return;
+
+   retain_obj(req->ctx);
+
+   if (!wth_enqueue_anywhere(WTH_PRIO_LOWEST, &io_req_bottom_half, req)) {
+      printk("WARNING: io_uring: unable to enqueue job\n");
+      release_obj(req->ctx);
+      return;
+   }
+
+   req->bh_pending = true;
+}
+
+static void io_poll_watch_cb(struct kcond_watch *w)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      io_req_queue_bh(w->arg);
+   }
+   enable_interrupts(&var);
+}
+
+/* Runs in IRQ context, with interrupts disabled */
+static void io_timeout_func(struct hrtimer *t)
+{
+   io_req_queue_bh(CONTAINER_OF(t, struct io_req, timer));
+}
+
+static struct io_req *
+io_alloc_req(struct io_uring_ctx *ctx, const struct io_uring_sqe *sqe)
+{
+   struct io_req *req;
+
+   if (!(req = kzalloc_obj(struct io_req)))
+      return NULL;
+
+   list_node_init(&req->node);
+   req->ctx = ctx;
+   req->user_data = sqe->user_data;
+   req->opcode = sqe->opcode;
+
+   for (int i = 0; i < IO_WATCH_COUNT; i++)
+      kcond_watch_init(&req->watches[i], &io_poll_watch_cb, req);
+
+   hrtimer_init(&req->timer, &io_timeout_func);
+   return req;
+}
+
+static int
+io_poll_add(struct io_uring_ctx *ctx, const struct io_uring_sqe *sqe)
+{
+   struct fs_handle_base *hb;
+   struct kcond *conds[IO_WATCH_COUNT];
+   struct io_req *req;
+   bool watched = false;
+   int rc = 0;
+   u32 mask;
+
+   if (!(hb = get_fs_handle(sqe->fd)))
+      return -EBADF;
+
+   if (!(req = io_alloc_req(ctx, sqe)))
+      return -ENOMEM;
+
+   req->h = hb;
+   req->events = sqe->poll_events | IO_POLL_ALWAYS_EVENTS;
+
+   conds[IO_WATCH_R] = vfs_get_rready_cond(hb);
+   conds[IO_WATCH_W] = vfs_get_wready_cond(hb);
+   conds[IO_WATCH_E] = vfs_get_except_cond(hb);
+
+   kmutex_lock(&ctx->mutex);
+
+   if (ctx->closed) {
+      kfree_obj(req, struct io_req);
+      rc = -ECANCELED;
+      goto out;
+   }
+
+   list_add_tail(&ctx->pending, &req->node);
+   hb->spec_flags |= VFS_SPFL_IOURING_WATCHED;
+
+   for (int i = 0; i < IO_WATCH_COUNT; i++) {
+      if (conds[i]) {
+         kcond_watch_add(conds[i], &req->watches[i]);
+         watched = true;
+      }
+   }
+
+   /*
+    * Check the file after registering the watches, in order to not miss any
+    * event. Files without conditions (e.g. regular files) are always ready.
+    */
+   mask = io_poll_mask(hb, req->events);
+
+   if (mask || !watched)
+      io_req_complete(req, (s32)mask);
+
+out:
+   kmutex_unlock(&ctx->mutex);
+   return rc;
+}
+
+struct io_timespec {
+   s64 tv_sec;
+   s64 tv_nsec;
+};
+
+static int
+io_timeout(struct io_uring_ctx *ctx, const struct io_uring_sqe *sqe)
+{
+   struct io_timespec ts;
+   struct io_req *req;
+   u64 ns, expires;
+   ulong var;
+   int rc = 0;
+
+   if (sqe->len != 1 || (sqe->timeout_flags & ~IORING_TIMEOUT_ABS))
+      return -EINVAL;
+
+   if (copy_from_user(&ts, io_uptr(sqe->addr), sizeof(ts)))
+      return -EFAULT;
+
+   if (ts.tv_sec < 0 || !IN_RANGE(ts.tv_nsec, 0, BILLION))
+      return -EINVAL;
+
+   ns = (u64)ts.tv_sec * BILLION + (u64)ts.tv_nsec;
+
+   /* Absolute timeouts use CLOCK_MONOTONIC, as on Linux */
+   if (sqe->timeout_flags & IORING_TIMEOUT_ABS)
+      expires = ns;
+   else
+      expires = hrtimer_expiry_in(ns);
+
+   if (!(req = io_alloc_req(ctx, sqe)))
+      return -ENOMEM;
+
+   kmutex_lock(&ctx->mutex);
+
+   if (ctx->closed) {
+      kfree_obj(req, struct io_req);
+      rc = -ECANCELED;
+      goto out;
+   }
+
+   if (sqe->off) {
+      req->has_target = true;
+      req->target = ctx->cq_posted + (u32)sqe->off;
+   }
+
+   list_add_tail(&ctx->pending, &req->node);
+
+   disable_interrupts(&var);
+   {
+      hrtimer_start(&req->timer, expires);
+   }
+   enable_interrupts(&var);
+
+out:
+   kmutex_unlock(&ctx->mutex);
+   return rc;
+}
+
+/* Cancel a pending request with the given opcode (any, if < 0) */
+static int io_cancel(struct io_uring_ctx *ctx, u64 user_data, int opcode)
+{
+   struct io_req *req;
+   int rc = -ENOENT;
+
+   kmutex_lock(&ctx->mutex);
+
+   list_for_each_ro(req, &ctx->pending, node) {
+
+      if (req->user_data != user_data)
+         continue;
+
+      if (opcode >= 0 && req->opcode != opcode)
+         continue;
+
+      io_req_complete(req, -ECANCELED);
+      rc = 0;
+      break;
+   }
+
+   kmutex_unlock(&ctx->mutex);
+   return rc;
+}
+
+/* Emulate preadv() and pwritev(), not available as syscalls in Tilck */
+static int
+io_rw_vec_at(int fd, const struct iovec *u_iov, u32 cnt, s64 off, bool wr)
+{
+   struct iovec iov;
+   int tot = 0, rc = 0;
+
+   if ((int)cnt < 0)
+      return -EINVAL;
+
+   for (u32 i = 0; i < cnt; i++) {
+
+      if (copy_from_user(&iov, u_iov + i, sizeof(iov)))
+         return tot ? tot : -EFAULT;
+
+      if (wr)
+         rc = sys_pwrite64(fd, iov.iov_base, iov.iov_len, off + tot);
+      else
+         rc = sys_pread64(fd, iov.iov_base, iov.iov_len, off + tot);
+
+      if (rc <= 0)
+         break;
+
+      tot += rc;
+
+      if ((size_t)rc < iov.iov_len)
+         break;
+   }
+
+   return tot ? tot : rc;
+}
+
+static int io_close(int fd)
+{
+   fs_handle h = get_fs_handle(fd);
+
+   if (h && is_io_uring_handle(h))
+      return -EBADF; /* As on Linux, io_uring instances cannot be closed */
+
+   return sys_close(fd);
+}
+
+/*
+ * Execute a request. Returns its result or, when it has to wait for an event,
+ * sets `*queued` and returns 0: its completion will be posted later.
+ */
+static int
+io_issue(struct io_uring_ctx *ctx,
+         const struct io_uring_sqe *sqe,
+         bool *queued)
+{
+   const bool cur_pos = sqe->off == (u64)-1;
+   const s64 off = (s64)sqe->off;
+   void *buf = io_uptr(sqe->addr);
+   const int fd = sqe->fd;
+   int rc;
+
+   switch (sqe->opcode) {
+
+      case IORING_OP_NOP:
+         return 0;
+
+      case IORING_OP_READ:
+         if (cur_pos)
+            return sys_read(fd, buf, sqe->len);
+         return sys_pread64(fd, buf, sqe->len, off);
+
+      case IORING_OP_WRITE:
+         if (cur_pos)
+            return sys_write(fd, buf, sqe->len);
+         return sys_pwrite64(fd, buf, sqe->len, off);
+
+      case IORING_OP_READV:
+         if (cur_pos)
+            return sys_readv(fd, buf, (int)sqe->len);
+         return io_rw_vec_at(fd, buf, sqe->len, off, false);
+
+      case IORING_OP_WRITEV:
+         if (cur_pos)
+            return sys_writev(fd, buf, (int)sqe->len);
+         return io_rw_vec_at(fd, buf, sqe->len, off, true);
+
+      case IORING_OP_FSYNC:
+         if (sqe->fsync_flags & ~IORING_FSYNC_DATASYNC)
+            return -EINVAL;
+         if (sqe->fsync_flags & IORING_FSYNC_DATASYNC)
+            return sys_fdatasync(fd);
+         return sys_fsync(fd);
+
+      case IORING_OP_OPENAT:
+         if (fd != AT_FDCWD)
+            return -EOPNOTSUPP; /* openat() is not supported in Tilck */
+         return sys_open(buf, (int)sqe->open_flags, (mode_t)sqe->len);
+
+      case IORING_OP_CLOSE:
+         return io_close(fd);
+
+      case IORING_OP_POLL_ADD:
+         if ((rc = io_poll_add(ctx, sqe)) == 0)
+            *queued = true;
+         return rc;
+
+      case IORING_OP_POLL_REMOVE:
+         return io_cancel(ctx, sqe->addr, IORING_OP_POLL_ADD);
+
+      case IORING_OP_TIMEOUT:
+         if ((rc = io_timeout(ctx, sqe)) == 0)
+            *queued = true;
+         return rc;
+
+      case IORING_OP_TIMEOUT_REMOVE:
+         if (sqe->timeout_flags)
+            return -EINVAL; /* Updating a timeout is not supported */
+         return io_cancel(ctx, sqe->addr, IORING_OP_TIMEOUT);
+
+      case IORING_OP_ASYNC_CANCEL:
+         return io_cancel(ctx, sqe->addr, -1);
+
+      default:
+         return -EINVAL;
+   }
+}
+
+/* Consume up to `to_submit` SQEs. Returns the number of submitted requests */
+static u32 io_submit(struct io_uring_ctx *ctx, u32 to_submit)
+{
+   struct io_rings *r = ctx->rings;
+   struct io_uring_sqe sqe;
+   bool cancel = false;
+   u32 tail, idx, n = 0;
+   bool queued;
+   int res;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&ctx->sq_mutex));
+
+   tail = atomic_load_explicit(&r->sq_tail, mo_acquire);
+   to_submit = MIN3(to_submit, tail - ctx->sq_head, ctx->sq_entries);
+
+   for (u32 i = 0; i < to_submit; i++) {
+
+      idx = ctx->sq_array[ctx->sq_head & (ctx->sq_entries - 1)];
+
+      if (idx < ctx->sq_entries)
+         memcpy(&sqe, &ctx->sqes[idx], sizeof(sqe));
+
+      /* The SQE has been copied: the user is free to re-use its slot */
+      ctx->sq_head++;
+      atomic_store_explicit(&r->sq_head, ctx->sq_head, mo_release);
+
+      if (idx >= ctx->sq_entries) {
+         r->sq_dropped++;
+         continue;
+      }
+
+      queued = false;
+
+      if (cancel)
+         res = -ECANCELED;
+      else if (sqe.flags & ~IO_SQE_FLAGS)
+         res = -EINVAL;
+      else
+         res = io_issue(ctx, &sqe, &queued);
+
+      if (!queued) {
+         kmutex_lock(&ctx->mutex);
+         {
+            io_post(ctx, sqe.user_data, res);
+         }
+         kmutex_unlock(&ctx->mutex);
+      }
+
+      n++;
+
+      if (sqe.flags & (IOSQE_IO_LINK | IOSQE_IO_HARDLINK)) {
+
+         if (res < 0 && !(sqe.flags & IOSQE_IO_HARDLINK))
+            cancel = true;
+
+      } else {
+
+         cancel = false; /* end of the chain */
+      }
+
+      if (pending_signals())
+         break; /* Let the signal be delivered */
+   }
+
+   return n;
+}
+
+static int io_wait_cqes(struct io_uring_ctx *ctx, u32 min_complete)
+{
+   int rc = 0;
+   min_complete = MIN(min_complete, ctx->cq_entries);
+
+   kmutex_lock(&ctx->mutex);
+
+   while (io_cq_ready(ctx) < min_complete) {
+
+      kcond_wait(&ctx->cq_cond, &ctx->mutex, KCOND_WAIT_FOREVER);
+
+      /* After wake up */
+      if (pending_signals()) {
+         rc = -EINTR;
+         break;
+      }
+   }
+
+   kmutex_unlock(&ctx->mutex);
+   return rc;
+}
+
+static int io_uring_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_uring_ctx *ctx = (void *)kh->kobj;
+   return io_cq_ready(ctx) > 0;
+}
+
+static struct kcond *io_uring_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_uring_ctx *ctx = (void *)kh->kobj;
+   return &ctx->cq_cond;
+}
+
+static int
+io_uring_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
+{
+   struct kfs_handle *kh = um->h;
+   struct io_uring_ctx *ctx = (void *)kh->kobj;
+   const size_t pg_count = um->len >> PAGE_SHIFT;
+   u32 pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
+   size_t mapped_cnt, size;
+   void *data;
+
+   switch (um->off) {
+
+      case IORING_OFF_SQ_RING:
+      case IORING_OFF_CQ_RING:
+         data = ctx->rings;
+         size = ctx->rings_size;
+         break;
+
+      case IORING_OFF_SQES:
+         data = ctx->sqes;
+         size = ctx->sqes_size;
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   if (um->len > size)
+      return -EINVAL;
+
+   if (flags & VFS_MM_DONT_MMAP)
+      return 0;
+
+   if (um->prot & PROT_WRITE)
+      pg_flags |= PAGING_FL_RW;
+
+   mapped_cnt = map_pages(pdir,
+                          um->vaddrp,
+                          LIN_VA_TO_PA(data),
+                          pg_count,
+                          pg_flags);
+
+   if (mapped_cnt != pg_count) {
+      unmap_pages_permissive(pdir, um->vaddrp, mapped_cnt, false);
+      return -ENOMEM;
+   }
+
+   return 0;
+}
+
+static const struct file_ops static_ops_io_uring =
+{
+   .read_ready = io_uring_read_ready,
+   .get_rready_cond = io_uring_get_rready_cond,
+   .mmap = io_uring_mmap,
+   .munmap = generic_fs_munmap,
+};
+
+void destroy_io_uring(struct io_uring_ctx *ctx)
+{
+   kmutex_lock(&io_uring_list_mutex);
+   {
+      if (list_is_node_in_list(&ctx->node))
+         list_remove(&ctx->node);
+   }
+   kmutex_unlock(&io_uring_list_mutex);
+
+   /* Cancelled when the last handle has been closed */
+   ASSERT(list_is_empty(&ctx->pending));
+
+   kfree2(ctx->rings, ctx->rings_size);
+   kfree2(ctx->sqes, ctx->sqes_size);
+   kcond_destory(&ctx->cq_cond);
+   kmutex_destroy(&ctx->mutex);
+   kmutex_destroy(&ctx->sq_mutex);
+   kfree_obj(ctx, struct io_uring_ctx);
+}
+
+static void io_uring_on_ctx_handle_close(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_uring_ctx *ctx = (void *)kh->kobj;
+   struct io_req *req, *tmp;
+   int old;
+
+   old = atomic_fetch_sub_explicit(&ctx->handles, 1, mo_relaxed);
+   ASSERT(old > 0);
+
+   if (old > 1)
+      return;
+
+   /*
+    * Drop all the pending requests, so that no new bottom half will be
+    * enqueued: the object will be destroyed as soon as all its references
+    * are dropped.
+    */
+   kmutex_lock(&ctx->mutex);
+   {
+      ctx->closed = true;
+
+      list_for_each(req, tmp, &ctx->pending, node)
+         io_req_remove(req);
+   }
+   kmutex_unlock(&ctx->mutex);
+}
+
+static void io_uring_on_ctx_handle_dup(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_uring_ctx *ctx = (void *)kh->kobj;
+   atomic_fetch_add_explicit(&ctx->handles, 1, mo_relaxed);
+}
+
+struct io_uring_ctx *create_io_uring(u32 sq_entries, u32 cq_entries)
+{
+   struct io_uring_ctx *ctx;
+   size_t cqes_off, sq_array_off;
+
+   ASSERT(roundup_next_power_of_2(sq_entries) == sq_entries);
+   ASSERT(roundup_next_power_of_2(cq_entries) == cq_entries);
+
+   if (!(ctx = (void *)kzalloc_obj(struct io_uring_ctx)))
+      return NULL;
+
+   cqes_off = sizeof(struct io_rings);
+   sq_array_off = cqes_off + cq_entries * sizeof(struct io_uring_cqe);
+
+   /* Power-of-2 sizes >= PAGE_SIZE make the chunks page-aligned */
+   ctx->rings_size = roundup_next_power_of_2(
+      MAX(sq_array_off + sq_entries * sizeof(u32), PAGE_SIZE)
+   );
+
+   ctx->sqes_size = roundup_next_power_of_2(
+      MAX(sq_entries * sizeof(struct io_uring_sqe), PAGE_SIZE)
+   );
+
+   ctx->rings = kzmalloc(ctx->rings_size);
+   ctx->sqes = kzmalloc(ctx->sqes_size);
+
+   if (!ctx->rings || !ctx->sqes) {
+
+      if (ctx->rings)
+         kfree2(ctx->rings, ctx->rings_size);
+
+      if (ctx->sqes)
+         kfree2(ctx->sqes, ctx->sqes_size);
+
+      kfree_obj(ctx, struct io_uring_ctx);
+      return NULL;
+   }
+
+   ASSERT(IS_PAGE_ALIGNED(ctx->rings));
+   ASSERT(IS_PAGE_ALIGNED(ctx->sqes));
+
+   ctx->cqes = (void *)((char *)ctx->rings + cqes_off);
+   ctx->sq_array = (void *)((char *)ctx->rings + sq_array_off);
+   ctx->sq_entries = sq_entries;
+   ctx->cq_entries = cq_entries;
+
+   ctx->rings->sq_ring_mask = sq_entries - 1;
+   ctx->rings->cq_ring_mask = cq_entries - 1;
+   ctx->rings->sq_ring_entries = sq_entries;
+   ctx->rings->cq_ring_entries = cq_entries;
+
+   ctx->on_handle_close = &io_uring_on_ctx_handle_close;
+   ctx->on_handle_dup = &io_uring_on_ctx_handle_dup;
+   ctx->destory_obj = (void *)&destroy_io_uring;
+   kmutex_init(&ctx->sq_mutex, 0);
+   kmutex_init(&ctx->mutex, 0);
+   kcond_init(&ctx->cq_cond);
+   list_init(&ctx->pending);
+   list_node_init(&ctx->node);
+
+   kmutex_lock(&io_uring_list_mutex);
+   {
+      list_add_tail(&io_uring_list, &ctx->node);
+   }
+   kmutex_unlock(&io_uring_list_mutex);
+   return ctx;
+}
+
+void io_uring_get_params(struct io_uring_ctx *ctx, struct io_uring_params *p)
+{
+   const u32 cqes_off = sizeof(struct io_rings);
+   const u32 sq_array_off =
+      cqes_off + ctx->cq_entries * sizeof(struct io_uring_cqe);
+
+   p->sq_entries = ctx->sq_entries;
+   p->cq_entries = ctx->cq_entries;
+   p->features = IORING_FEAT_SINGLE_MMAP |
+                 IORING_FEAT_SUBMIT_STABLE |
+                 IORING_FEAT_RW_CUR_POS;
+
+   bzero(&p->sq_off, sizeof(p->sq_off));
+   bzero(&p->cq_off, sizeof(p->cq_off));
+
+   p->sq_off.head = offsetof(struct io_rings, sq_head);
+   p->sq_off.tail = offsetof(struct io_rings, sq_tail);
+   p->sq_off.ring_mask = offsetof(struct io_rings, sq_ring_mask);
+   p->sq_off.ring_entries = offsetof(struct io_rings, sq_ring_entries);
+   p->sq_off.flags = offsetof(struct io_rings, sq_flags);
+   p->sq_off.dropped = offsetof(struct io_rings, sq_dropped);
+   p->sq_off.array = sq_array_off;
+
+   p->cq_off.head = offsetof(struct io_rings, cq_head);
+   p->cq_off.tail = offsetof(struct io_rings, cq_tail);
+   p->cq_off.ring_mask = offsetof(struct io_rings, cq_ring_mask);
+   p->cq_off.ring_entries = offsetof(struct io_rings, cq_ring_entries);
+   p->cq_off.overflow = offsetof(struct io_rings, cq_overflow);
+   p->cq_off.cqes = cqes_off;
+   p->cq_off.flags = offsetof(struct io_rings, cq_flags);
+}
+
+fs_handle io_uring_create_handle(struct io_uring_ctx *ctx)
+{
+   fs_handle res;
+
+   res = kfs_create_new_handle(&static_ops_io_uring, (void *)ctx, O_RDWR);
+
+   if (res != NULL)
+      atomic_fetch_add_explicit(&ctx->handles, 1, mo_relaxed);
+
+   return res;
+}
+
+/*
+ * Called by vfs_close() for the handles with VFS_SPFL_IOURING_WATCHED: cancel
+ * the polls on the handle, in all the io_uring instances.
+ */
+void io_uring_on_handle_close(fs_handle h)
+{
+   struct io_uring_ctx *ctx;
+   struct io_req *req;
+   bool found;
+
+   kmutex_lock(&io_uring_list_mutex);
+
+   list_for_each_ro(ctx, &io_uring_list, node) {
+
+      kmutex_lock(&ctx->mutex);
+
+      do {
+
+         found = false;
+
+         /*
+          * Restart the scan after each completion, as posting a CQE might
+          * complete count-based timeouts as well.
+          */
+         list_for_each_ro(req, &ctx->pending, node) {
+            if (req->opcode == IORING_OP_POLL_ADD && req->h == h) {
+               io_req_complete(req, -ECANCELED);
+               found = true;
+               break;
+            }
+         }
+
+      } while (found);
+
+      kmutex_unlock(&ctx->mutex);
+   }
+
+   kmutex_unlock(&io_uring_list_mutex);
+}
+
+/*
+ * ----------------- SYSCALLS -----------------------
+ */
+
+int sys_io_uring_enter(int fd,
+                       u32 to_submit,
+                       u32 min_complete,
+                       u32 flags,
+                       const sigset_t *u_sigmask,
+                       size_t sigsetsize)
+{
+   struct io_uring_ctx *ctx;
+   struct kfs_handle *kh;
+   u32 submitted = 0;
+   int rc = 0;
+
+   if (flags & ~IORING_ENTER_GETEVENTS)
+      return -EINVAL;
+
+   if (!(kh = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (!is_io_uring_handle(kh))
+      return -EOPNOTSUPP;
+
+   ctx = (void *)kh->kobj;
+   retain_obj(ctx);
+
+   if (to_submit) {
+      kmutex_lock(&ctx->sq_mutex);
+      {
+         submitted = io_submit(ctx, to_submit);
+      }
+      kmutex_unlock(&ctx->sq_mutex);
+   }
+
+   if ((flags & IORING_ENTER_GETEVENTS) && min_complete) {
+
+      if (u_sigmask && (rc = sigmask_temp_set(u_sigmask, sigsetsize)))
+         goto out;
+
+      rc = io_wait_cqes(ctx, min_complete);
+
+      if (u_sigmask)
+         sigmask_temp_restore();
+   }
+
+out:
+   if (release_obj(ctx) == 0)
+      destroy_io_uring(ctx);
+
+   /* As on Linux, errors are reported only if nothing has been submitted */
+   return submitted ? (int)submitted : rc;
+}
@@ -11,6 +11,7 @@ void kcond_init(struct kcond *c)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
    list_init(&c->wait_list);
+   list_init(&c->watch_list);
 }
 
 bool kcond_is_anyone_waiting(struct kcond *c)
@@ -147,11 +148,23 @@ kcond_signal_int(struct kcond *c, struct wait_obj *wo)
    wake_up(ti);
 }
 
+static void
+kcond_notify_watches(struct kcond *c)
+{
+   struct kcond_watch *pos, *temp;
+   ASSERT(!is_preemption_enabled());
+
+   list_for_each(pos, temp, &c->watch_list, node) {
+      pos->func(pos);
+   }
+}
+
 void kcond_signal_one(struct kcond *c)
 {
    disable_preemption();
    {
       DEBUG_ONLY(check_not_in_irq_handler());
+      kcond_notify_watches(c);
 
       if (!list_is_empty(&c->wait_list)) {
 
@@ -170,6 +183,7 @@ void kcond_signal_all(struct kcond *c)
    disable_preemption();
    {
       DEBUG_ONLY(check_not_in_irq_handler());
+      kcond_notify_watches(c);
 
       list_for_each(wo_pos, temp, &c->wait_list, wait_list_node) {
          kcond_signal_int(c, wo_pos);
@@ -178,7 +192,37 @@ void kcond_signal_all(struct kcond *c)
    enable_preemption();
 }
 
+void kcond_watch_init(struct kcond_watch *w, kcond_watch_func func, void *arg)
+{
+   list_node_init(&w->node);
+   w->func = func;
+   w->arg = arg;
+}
+
+void kcond_watch_add(struct kcond *c, struct kcond_watch *w)
+{
+   disable_preemption();
+   {
+      ASSERT(!list_is_node_in_list(&w->node));
+      list_add_tail(&c->watch_list, &w->node);
+   }
+   enable_preemption();
+}
+
+void kcond_watch_remove(struct kcond_watch *w)
+{
+   disable_preemption();
+   {
+      if (list_is_node_in_list(&w->node)) {
+         list_remove(&w->node);
+         list_node_init(&w->node);
+      }
+   }
+   enable_preemption();
+}
+
 void kcond_destory(struct kcond *c)
 {
+   ASSERT(list_is_empty(&c->watch_list));
    bzero(c, sizeof(struct kcond));
 }
@@ -51,6 +51,28 @@ main_heaps_kmalloc(size_t *size, u32 flags)
    return NULL;
 }
 
+static void
+main_heap_kfree(struct kmalloc_heap *h, void *ptr, size_t *size, u32 flags)
+{
+   const ulong vaddr = (ulong) ptr;
+
+   /*
+    * Vaddr must be aligned at least at min_block_size otherwise, something is
+    * wrong with it, maybe it has been allocated with mdalloc()?
+    */
+   ASSERT((vaddr & (h->min_block_size - 1)) == 0);
+
+   per_heap_kfree(h, ptr, size, flags);
+
+   if (KMALLOC_FREE_MEM_POISONING) {
+      memset32(ptr, FREE_MEM_POISON_VAL, *size / 4);
+   }
+
+   if (KMALLOC_SUPPORT_LEAK_DETECTOR && leak_detector_enabled) {
+      debug_kmalloc_register_free((void *)vaddr, *size);
+   }
+}
+
 static int
 main_heaps_kfree(void *ptr, size_t *size, u32 flags)
 {
@@ -72,22 +94,7 @@ main_heaps_kfree(void *ptr, size_t *size, u32 flags)
    if (!h)
       return -ENOENT;
 
-   /*
-    * Vaddr must be aligned at least at min_block_size otherwise, something is
-    * wrong with it, maybe it has been allocated with mdalloc()?
-    */
-   ASSERT((vaddr & (h->min_block_size - 1)) == 0);
-
-   per_heap_kfree(h, ptr, size, flags);
-
-   if (KMALLOC_FREE_MEM_POISONING) {
-      memset32(ptr, FREE_MEM_POISON_VAL, *size / 4);
-   }
-
-   if (KMALLOC_SUPPORT_LEAK_DETECTOR && leak_detector_enabled) {
-      debug_kmalloc_register_free((void *)vaddr, *size);
-   }
-
+   main_heap_kfree(h, ptr, size, flags);
    return 0;
 }
 
@@ -128,7 +135,8 @@ void *general_kmalloc(size_t *size, u32 flags)
 
 void general_kfree(void *ptr, size_t *size, u32 flags)
 {
-   int rc;
+   struct kmalloc_heap *h;
+   int rc = 0;
 
    ASSERT(kmalloc_initialized);
    ASSERT(size != NULL);
@@ -143,7 +151,30 @@ void general_kfree(void *ptr, size_t *size, u32 flags)
 
    disable_preemption();
    {
-      if (*size) {
+      if ((h = heaps_rmap_get((ulong)ptr))) {
+
+         /* Fast path: the reverse map tells us which heap owns the chunk */
+
+         if (is_small_heap(h)) {
+
+            struct small_heap_node *node =
+               CONTAINER_OF(h, struct small_heap_node, heap);
+
+            small_heap_kfree(node, ptr, size, flags);
+
+         } else {
+
+            /*
+             * The min block size of the main heaps is SMALL_HEAP_MAX_ALLOC + 1
+             * and allocations with smaller sub-blocks (the accelerators) always
+             * go to the small heaps: therefore, even the KFREE_FL_ALLOW_SPLIT
+             * frees of a single element from a main heap have a bigger size.
+             */
+            ASSERT(*size == 0 || *size > SMALL_HEAP_MAX_ALLOC);
+            main_heap_kfree(h, ptr, size, flags);
+         }
+
+      } else if (*size) {
 
          /* We know which heap set contains our chunk */
 
@@ -918,6 +918,7 @@ void vfree2(void *ptr, size_t size)
 
 /* Natural continuation of this source file. Purpose: make this file shorter. */
 #include "kmalloc_stats.c.h"
+#include "kmalloc_heaps_rmap.c.h"
 #include "kmalloc_small_heaps.c.h"
 #include "kmalloc_heaps.c.h"
 #include "general_kmalloc.c.h"
@@ -292,6 +292,41 @@ static int kmalloc_internal_add_heap(void *vaddr, size_t heap_size)
    return used_heaps++;
 }
 
+static void init_kmalloc_heaps_rmap(void)
+{
+   struct kmalloc_heap **rmap;
+   struct small_heap_node *pos;
+   ulong end = 0;
+   size_t count;
+
+   for (int i = 0; i < used_heaps; i++) {
+
+      if (heaps[i]->vaddr >= BASE_VA)
+         end = MAX(end, LIN_VA_TO_PA(heaps[i]->heap_last_byte) + 1);
+   }
+
+   count = end / KMALLOC_RMAP_GRANULE;
+
+   if (!count || !(rmap = kzmalloc(count * sizeof(rmap[0])))) {
+      printk("kmalloc: unable to alloc the heaps reverse map\n");
+      return;
+   }
+
+   disable_preemption();
+   {
+      heaps_rmap = rmap;
+      heaps_rmap_count = count;
+
+      for (int i = 0; i < used_heaps; i++)
+         heaps_rmap_set(heaps[i]->vaddr, heaps[i]->size, heaps[i]);
+
+      /* Now, override the entries of the small heaps created so far */
+      list_for_each_ro(pos, &small_heaps_list, node)
+         small_heap_rmap_register(pos);
+   }
+   enable_preemption();
+}
+
 static long greater_than_heap_cmp(const void *a, const void *b)
 {
    const struct kmalloc_heap *const *ha_ref = a;
@@ -352,6 +387,8 @@ void early_init_kmalloc(void)
 
    used_heaps = 0;
    bzero(heaps, sizeof(heaps));
+   heaps_rmap = NULL;
+   heaps_rmap_count = 0;
 
    {
       size_t first_heap_size;
@@ -404,6 +441,8 @@ void init_kmalloc(void)
                       (u32)used_heaps,
                       greater_than_heap_cmp);
 
+   init_kmalloc_heaps_rmap();
+
    for (int i = 0; i < KMALLOC_HEAPS_COUNT; i++) {
 
       struct kmalloc_heap *h = heaps[i];
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef _KMALLOC_C_
+
+   #error This is NOT a header file and it is not meant to be included
+
+#endif
+
+/*
+ * Reverse map from the linear mapping to the kmalloc heaps, used by kfree() to
+ * find in O(1) the heap owning a given chunk, instead of scanning all the
+ * heaps. It has one entry per KMALLOC_RMAP_GRANULE bytes, pointing to the heap
+ * that owns them. Entries covered by a small heap point to the small heap
+ * itself, not to the main heap containing it: that works because each small
+ * heap is exactly one granule, naturally aligned.
+ *
+ * The map is allocated at the end of init_kmalloc(), once all the main heaps
+ * exist: until then, and for addresses not covered by it, kfree() falls back
+ * to the linear search.
+ */
+
+#define KMALLOC_RMAP_GRANULE                   SMALL_HEAP_SIZE
+
+STATIC_ASSERT(KMALLOC_RMAP_GRANULE < KMALLOC_MIN_HEAP_SIZE);
+STATIC_ASSERT((KMALLOC_MIN_HEAP_SIZE % KMALLOC_RMAP_GRANULE) == 0);
+
+static struct kmalloc_heap **heaps_rmap;
+static size_t heaps_rmap_count;
+
+/*
+ * Main heaps are at least KMALLOC_MIN_HEAP_SIZE bytes big, while small heaps
+ * have always the same (smaller) size.
+ */
+static ALWAYS_INLINE bool is_small_heap(struct kmalloc_heap *h)
+{
+   return h->size == SMALL_HEAP_SIZE;
+}
+
+static ALWAYS_INLINE struct kmalloc_heap **heaps_rmap_entry(ulong vaddr)
+{
+   ulong idx;
+
+   if (!heaps_rmap || vaddr < BASE_VA)
+      return NULL;
+
+   idx = LIN_VA_TO_PA(vaddr) / KMALLOC_RMAP_GRANULE;
+   return idx < heaps_rmap_count ? &heaps_rmap[idx] : NULL;
+}
+
+static ALWAYS_INLINE struct kmalloc_heap *heaps_rmap_get(ulong vaddr)
+{
+   struct kmalloc_heap **e = heaps_rmap_entry(vaddr);
+   return e ? *e : NULL;
+}
+
+static void
+heaps_rmap_set(ulong vaddr, size_t size, struct kmalloc_heap *h)
+{
+   struct kmalloc_heap **e;
+
+   ASSERT((vaddr & (KMALLOC_RMAP_GRANULE - 1)) == 0);
+   ASSERT((size & (KMALLOC_RMAP_GRANULE - 1)) == 0);
+
+   for (ulong va = vaddr; va < vaddr + size; va += KMALLOC_RMAP_GRANULE) {
+      if ((e = heaps_rmap_entry(va)))
+         *e = h;
+   }
+}
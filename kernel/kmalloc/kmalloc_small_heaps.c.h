@@ -34,6 +34,7 @@ struct small_heap_node {
 
    struct list_node node;          /* all nodes */
    struct list_node avail_node;    /* non-full nodes, including empty ones */
+   struct kmalloc_heap *parent;    /* main heap containing this small heap */
    struct kmalloc_heap heap;
 };
 
@@ -81,10 +82,22 @@ remove_from_avail_list(struct small_heap_node *node)
    DEBUG_ONLY(list_node_init(&node->avail_node));
 }
 
+static inline void
+small_heap_rmap_register(struct small_heap_node *node)
+{
+   node->parent = heaps_rmap_get(node->heap.vaddr);
+
+   if (node->parent) {
+      ASSERT(!is_small_heap(node->parent));
+      heaps_rmap_set(node->heap.vaddr, SMALL_HEAP_SIZE, &node->heap);
+   }
+}
+
 static inline void
 register_small_heap_node(struct small_heap_node *node)
 {
    ASSERT(node->heap.mem_allocated < node->heap.size);
+   small_heap_rmap_register(node);
 
    list_add_tail(&small_heaps_list, &node->node);
    shs.tot_count++;
@@ -107,6 +120,9 @@ unregister_small_heap_node(struct small_heap_node *node)
    list_remove(&node->node);
    shs.tot_count--;
 
+   if (node->parent)
+      heaps_rmap_set(node->heap.vaddr, SMALL_HEAP_SIZE, node->parent);
+
    ASSERT(node->heap.mem_allocated == SMALL_HEAP_MD_SIZE);
    ASSERT(list_node_is_empty(&node->avail_node));
 }
@@ -245,30 +261,14 @@ static void *small_heaps_kmalloc(size_t *size, u32 flags)
    return ret;
 }
 
-static int
-small_heaps_kfree(void *ptr, size_t *size, u32 flags)
+static void
+small_heap_kfree(struct small_heap_node *node, void *ptr, size_t *size, u32 f)
 {
-   ASSERT(!is_preemption_enabled());
-   struct small_heap_node *pos, *node = NULL;
-   const ulong vaddr = (ulong) ptr;
    bool was_full;
-
-   list_for_each_ro(pos, &small_heaps_list, node) {
-
-      const ulong hva = pos->heap.vaddr;
-      const ulong hend = pos->heap.heap_last_byte-pos->heap.min_block_size+1;
-
-      if (IN_RANGE_INC(vaddr, hva, hend)) {
-         node = pos;
-         break;
-      }
-   }
-
-   if (!node)
-      return -ENOENT;
+   ASSERT(!is_preemption_enabled());
 
    was_full = node->heap.mem_allocated == node->heap.size;
-   per_heap_kfree(&node->heap, ptr, size, flags);
+   per_heap_kfree(&node->heap, ptr, size, f);
 
    if (was_full) {
 
@@ -293,6 +293,29 @@ small_heaps_kfree(void *ptr, size_t *size, u32 flags)
          }
       }
    }
+}
+
+static int
+small_heaps_kfree(void *ptr, size_t *size, u32 flags)
+{
+   ASSERT(!is_preemption_enabled());
+   struct small_heap_node *pos, *node = NULL;
+   const ulong vaddr = (ulong) ptr;
+
+   list_for_each_ro(pos, &small_heaps_list, node) {
+
+      const ulong hva = pos->heap.vaddr;
+      const ulong hend = pos->heap.heap_last_byte-pos->heap.min_block_size+1;
+
+      if (IN_RANGE_INC(vaddr, hva, hend)) {
+         node = pos;
+         break;
+      }
+   }
+
+   if (!node)
+      return -ENOENT;
 
+   small_heap_kfree(node, ptr, size, flags);
    return 0;
 }
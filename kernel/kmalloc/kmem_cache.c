@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/kmem_cache.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/test/kmalloc.h>
+
+#include <tilck_gen_headers/config_kmalloc.h>
+
+/*
+ * Target size of the memory chunk allocated at once to refill a cache. Each
+ * refill allocates MAX(1, KMEM_CACHE_BATCH_SIZE / elem_size) objects, while at
+ * most twice that number of objects are kept in the free-list: the exceeding
+ * ones are returned to kmalloc.
+ */
+#define KMEM_CACHE_BATCH_SIZE                 (8 * KB)
+#define KMEM_CACHE_MIN_ELEM_SIZE                    32
+
+struct free_obj {
+   struct free_obj *next;
+};
+
+static struct list caches_list = STATIC_LIST_INIT(caches_list);
+
+static void kmem_cache_setup(struct kmem_cache *c)
+{
+   u32 batch;
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(c->obj_size > 0);
+
+   c->elem_size = (u32)roundup_next_power_of_2(
+      MAX(c->obj_size, (size_t)KMEM_CACHE_MIN_ELEM_SIZE)
+   );
+
+   batch = MAX(1u, KMEM_CACHE_BATCH_SIZE / c->elem_size);
+   c->max_free = 2 * batch;
+
+   kmalloc_create_accelerator(&c->acc, c->elem_size, batch);
+   list_node_init(&c->node);
+   list_add_tail(&caches_list, &c->node);
+}
+
+static void *kmem_cache_get_obj(struct kmem_cache *c)
+{
+   struct free_obj *obj;
+
+   disable_preemption();
+   {
+      if (UNLIKELY(!c->elem_size))
+         kmem_cache_setup(c);
+
+      if ((obj = c->free_list)) {
+
+         c->free_list = obj->next;
+         c->free_count--;
+
+      } else {
+
+         const bool refill = c->acc.curr_elem == c->acc.elem_count;
+
+         if ((obj = kmalloc_accelerator_get_elem(&c->acc)) && refill)
+            c->refills++;
+      }
+
+      if (obj) {
+         c->allocs++;
+         c->active++;
+         c->peak_active = MAX(c->peak_active, c->active);
+      }
+   }
+   enable_preemption();
+   return obj;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *c)
+{
+   void *obj = kmem_cache_get_obj(c);
+
+   if (obj && c->ctor)
+      c->ctor(obj);
+
+   return obj;
+}
+
+void *kmem_cache_zalloc(struct kmem_cache *c)
+{
+   void *obj = kmem_cache_get_obj(c);
+
+   if (obj) {
+
+      bzero(obj, c->obj_size);
+
+      if (c->ctor)
+         c->ctor(obj);
+   }
+
+   return obj;
+}
+
+static void kmem_cache_release_obj(struct kmem_cache *c, void *obj)
+{
+   size_t size = c->elem_size;
+
+   general_kfree(obj, &size, KFREE_FL_ALLOW_SPLIT);
+   ASSERT(size == c->elem_size);
+}
+
+void kmem_cache_free(struct kmem_cache *c, void *ptr)
+{
+   struct free_obj *obj = ptr;
+
+   if (!obj)
+      return;
+
+   ASSERT(c->elem_size > 0);
+
+   if (KMALLOC_FREE_MEM_POISONING)
+      memset32(ptr, FREE_MEM_POISON_VAL, c->elem_size / 4);
+
+   disable_preemption();
+   {
+      ASSERT(c->active > 0);
+      c->active--;
+      c->frees++;
+
+      if (c->free_count < c->max_free) {
+         obj->next = c->free_list;
+         c->free_list = obj;
+         c->free_count++;
+         obj = NULL;
+      }
+   }
+   enable_preemption();
+
+   if (obj)
+      kmem_cache_release_obj(c, obj);
+}
+
+void kmem_cache_destroy(struct kmem_cache *c)
+{
+   struct free_obj *obj;
+
+   if (!c->elem_size)
+      return; /* Never used */
+
+   disable_preemption();
+   {
+      ASSERT(c->active == 0);
+
+      while ((obj = c->free_list)) {
+         c->free_list = obj->next;
+         kmem_cache_release_obj(c, obj);
+      }
+
+      kmalloc_destroy_accelerator(&c->acc);
+      list_remove(&c->node);
+
+      c->free_count = 0;
+      c->elem_size = 0;
+   }
+   enable_preemption();
+}
+
+bool
+debug_kmem_cache_get_info(int n, struct debug_kmem_cache_info *i)
+{
+   struct kmem_cache *pos;
+   bool found = false;
+
+   disable_preemption();
+   {
+      list_for_each_ro(pos, &caches_list, node) {
+
+         if (n-- > 0)
+            continue;
+
+         *i = (struct debug_kmem_cache_info) {
+            .name = pos->name,
+            .obj_size = pos->obj_size,
+            .elem_size = pos->elem_size,
+            .batch = pos->acc.elem_count,
+            .free_count = pos->free_count,
+            .active = pos->active,
+            .peak_active = pos->peak_active,
+            .refills = pos->refills,
+            .allocs = pos->allocs,
+            .frees = pos->frees,
+         };
+
+         found = true;
+         break;
+      }
+   }
+   enable_preemption();
+   return found;
+}
+
+#ifdef UNIT_TEST_ENVIRONMENT
+
+/*
+ * Forget about all the objects owned by the caches: called when the kmalloc
+ * heaps are re-initialized between unit tests.
+ */
+void kmem_cache_reset_all(void)
+{
+   struct kmem_cache *pos, *temp;
+
+   list_for_each(pos, temp, &caches_list, node) {
+
+      *pos = (struct kmem_cache) {
+         .name = pos->name,
+         .obj_size = pos->obj_size,
+         .ctor = pos->ctor,
+      };
+   }
+
+   list_init(&caches_list);
+}
+
+#endif
@@ -17,8 +17,10 @@
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/futex.h>
 #include <tilck/kernel/elf_loader.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/fs/fat32.h>
@@ -363,6 +365,7 @@ kmain(u32 multiboot_magic, u32 mbi_addr)
    init_segmentation();
    init_fpu_memcpy();
    init_kmalloc();
+   init_page_alloc();
    init_paging();
 
    setup_uefi_runtime_services();
@@ -372,6 +375,7 @@ kmain(u32 multiboot_magic, u32 mbi_addr)
    init_self_tests();
    init_irq_handling();
    init_sched();
+   init_futexes();
    init_syscall_interfaces();
    init_worker_threads();
    init_timer();
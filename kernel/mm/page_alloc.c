@@ -0,0 +1,337 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Page-frame allocator
+ * ----------------------
+ *
+ * A buddy allocator dedicated to page-sized allocations. Free blocks of
+ * 2^order pages are kept in per-order free lists, whose nodes live in the free
+ * pages themselves, while a single byte of metadata per pageframe (pf_info)
+ * tells whether the page is managed by this allocator, whether it's the first
+ * page of a free or of an allocated block and the block's order. Finding a
+ * block's buddy is just a matter of flipping the bit corresponding to its order
+ * in its pfn.
+ *
+ * All the usable memory in the linear mapping (the available regions of the
+ * system memory map) belongs to the kmalloc heaps: instead of statically
+ * splitting it, this allocator borrows from kmalloc naturally-aligned chunks
+ * of KMALLOC_MAX_ALIGN bytes (blocks of the max order) when its free lists are
+ * empty and gives them back once they are entirely free again, beyond a small
+ * cache of PG_ALLOC_CACHED_CHUNKS chunks. Therefore, in the common case
+ * allocating and freeing a page costs O(1), while the cost of the kmalloc()
+ * calls is amortized over many pages.
+ *
+ * When a chunk cannot be allocated, there might still be enough memory in the
+ * kmalloc heaps for a smaller block: in that case, the block is allocated with
+ * kmalloc() and marked as such in pf_info, so that kfree_pages() knows where
+ * to give it back. Any other page passed to kfree_pages() is a bug. Before
+ * init_page_alloc(), there's no pf_info and all the blocks come from kmalloc.
+ */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/page_alloc.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/system_mmap.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/list.h>
+#include <tilck/kernel/test/kmalloc.h>
+
+#define PG_CHUNK_SIZE              (PAGE_SIZE << PG_ALLOC_MAX_ORDER)
+#define PG_CHUNK_PAGES             (1u << PG_ALLOC_MAX_ORDER)
+#define PG_ALLOC_CACHED_CHUNKS     8
+
+#define PF_BUDDY                   (1 << 7)   /* page owned by page_alloc */
+#define PF_FREE                    (1 << 6)   /* first page of a free block */
+#define PF_USED                    (1 << 5)   /* first page of an alloc. block */
+#define PF_KMALLOC                 (1 << 4)   /* block from kmalloc() */
+#define PF_ORDER_MASK              (0x0f)
+
+STATIC_ASSERT(PG_CHUNK_SIZE == KMALLOC_MAX_ALIGN);
+STATIC_ASSERT(PG_ALLOC_MAX_ORDER <= PF_ORDER_MASK);
+
+struct free_block {
+   struct list_node node;
+};
+
+static u8 *pf_info;
+static ulong pf_count;
+static struct list free_lists[PG_ALLOC_MAX_ORDER + 1];
+static u32 free_count[PG_ALLOC_MAX_ORDER + 1];
+static size_t tot_free_pages;
+
+static ALWAYS_INLINE ulong va_to_pfn(void *vaddr)
+{
+   return LIN_VA_TO_PA(vaddr) >> PAGE_SHIFT;
+}
+
+static ALWAYS_INLINE void *pfn_to_va(ulong pfn)
+{
+   return PA_TO_LIN_VA(pfn << PAGE_SHIFT);
+}
+
+static void push_free_block(ulong pfn, u32 order)
+{
+   struct free_block *b = pfn_to_va(pfn);
+
+   pf_info[pfn] = PF_BUDDY | PF_FREE | (u8)order;
+   list_node_init(&b->node);
+   list_add_tail(&free_lists[order], &b->node);
+   free_count[order]++;
+}
+
+static void remove_free_block(ulong pfn, u32 order)
+{
+   struct free_block *b = pfn_to_va(pfn);
+
+   ASSERT(pf_info[pfn] == (PF_BUDDY | PF_FREE | order));
+   list_remove(&b->node);
+   pf_info[pfn] = PF_BUDDY;
+   free_count[order]--;
+}
+
+static bool add_chunk(void)
+{
+   void *chunk = aligned_kmalloc(PG_CHUNK_SIZE, PG_CHUNK_SIZE);
+   ulong pfn;
+
+   if (!chunk)
+      return false;
+
+   pfn = va_to_pfn(chunk);
+
+   if (UNLIKELY(pfn + PG_CHUNK_PAGES > pf_count)) {
+
+      /*
+       * Cannot happen as long as all the kmalloc heaps are in the linear
+       * mapping, but in case that changes, just don't use this chunk.
+       */
+      aligned_kfree2(chunk, PG_CHUNK_SIZE);
+      return false;
+   }
+
+   for (u32 i = 0; i < PG_CHUNK_PAGES; i++) {
+      ASSERT(pf_info[pfn + i] == 0);
+      pf_info[pfn + i] = PF_BUDDY;
+   }
+
+   push_free_block(pfn, PG_ALLOC_MAX_ORDER);
+   tot_free_pages += PG_CHUNK_PAGES;
+   return true;
+}
+
+static void release_chunk(ulong pfn)
+{
+   ASSERT((pfn & (PG_CHUNK_PAGES - 1)) == 0);
+   bzero(&pf_info[pfn], PG_CHUNK_PAGES);
+   tot_free_pages -= PG_CHUNK_PAGES;
+   aligned_kfree2(pfn_to_va(pfn), PG_CHUNK_SIZE);
+}
+
+static void *get_free_block(u32 order)
+{
+   struct free_block *b;
+   ulong pfn;
+   u32 o;
+
+   for (o = order; o <= PG_ALLOC_MAX_ORDER; o++) {
+      if (free_count[o])
+         break;
+   }
+
+   if (o > PG_ALLOC_MAX_ORDER) {
+
+      if (!add_chunk())
+         return NULL;
+
+      o = PG_ALLOC_MAX_ORDER;
+   }
+
+   b = list_first_obj(&free_lists[o], struct free_block, node);
+   pfn = va_to_pfn(b);
+   remove_free_block(pfn, o);
+
+   /* Split the block, putting back its upper halves in the free lists */
+   while (o > order) {
+      o--;
+      push_free_block(pfn + (1u << o), o);
+   }
+
+   pf_info[pfn] = PF_BUDDY | PF_USED | (u8)order;
+   tot_free_pages -= (1u << order);
+   return b;
+}
+
+static void *kmalloc_fallback(u32 order)
+{
+   void *res = aligned_kmalloc(PAGE_SIZE << order, PAGE_SIZE << order);
+   ulong pfn;
+
+   if (!res)
+      return NULL;
+
+   pfn = va_to_pfn(res);
+
+   if (UNLIKELY(pfn >= pf_count)) {
+      /* Same as in add_chunk(): we couldn't keep track of this block */
+      aligned_kfree2(res, PAGE_SIZE << order);
+      return NULL;
+   }
+
+   ASSERT(pf_info[pfn] == 0);
+   pf_info[pfn] = PF_KMALLOC | (u8)order;
+   return res;
+}
+
+void *kalloc_pages(u32 order)
+{
+   void *res;
+   ASSERT(order <= PG_ALLOC_MAX_ORDER);
+
+   if (UNLIKELY(!pf_info))
+      return aligned_kmalloc(PAGE_SIZE << order, PAGE_SIZE << order);
+
+   disable_preemption();
+   {
+      res = get_free_block(order);
+   }
+   enable_preemption();
+
+   if (UNLIKELY(!res)) {
+
+      /*
+       * We couldn't get a whole chunk from kmalloc: still, there might be
+       * enough memory for a smaller allocation.
+       */
+      res = kmalloc_fallback(order);
+   }
+
+   ASSERT(!res || page_ref_count(res) == 0);
+   return res;
+}
+
+void *kzalloc_page(void)
+{
+   void *res = kalloc_page();
+
+   if (res)
+      bzero(res, PAGE_SIZE);
+
+   return res;
+}
+
+void kfree_pages(void *vaddr, u32 order)
+{
+   ulong pfn, buddy;
+
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+   ASSERT(order <= PG_ALLOC_MAX_ORDER);
+   ASSERT(page_ref_count(vaddr) == 0);
+
+   if (UNLIKELY(!pf_info)) {
+      aligned_kfree2(vaddr, PAGE_SIZE << order);
+      return;
+   }
+
+   pfn = va_to_pfn(vaddr);
+
+   if (pfn < pf_count && pf_info[pfn] == (PF_KMALLOC | order)) {
+      /* The block was allocated through the kmalloc() fallback */
+      pf_info[pfn] = 0;
+      aligned_kfree2(vaddr, PAGE_SIZE << order);
+      return;
+   }
+
+   if (pfn >= pf_count || pf_info[pfn] != (PF_BUDDY | PF_USED | order))
+      panic("kfree_pages: block %p (order %u) not allocated here", vaddr, order);
+
+   ASSERT((pfn & ((1u << order) - 1)) == 0);
+
+   disable_preemption();
+   {
+      pf_info[pfn] = PF_BUDDY;
+      tot_free_pages += (1u << order);
+
+      /* Coalesce the block with its buddy as long as the buddy is free */
+      while (order < PG_ALLOC_MAX_ORDER) {
+
+         buddy = pfn ^ (1u << order);
+
+         if (pf_info[buddy] != (PF_BUDDY | PF_FREE | order))
+            break;
+
+         remove_free_block(buddy, order);
+         pf_info[pfn] = PF_BUDDY;
+         pfn = MIN(pfn, buddy);
+         order++;
+      }
+
+      if (order == PG_ALLOC_MAX_ORDER &&
+          free_count[order] >= PG_ALLOC_CACHED_CHUNKS)
+      {
+         release_chunk(pfn);
+      }
+      else
+      {
+         push_free_block(pfn, order);
+      }
+   }
+   enable_preemption();
+}
+
+bool is_kalloc_page(void *vaddr)
+{
+   ulong pfn;
+
+   if (!pf_info || !IS_PAGE_ALIGNED(vaddr))
+      return false;
+
+   pfn = va_to_pfn(vaddr);
+
+   if (pfn >= pf_count)
+      return false;
+
+   return pf_info[pfn] == (PF_BUDDY | PF_USED) || pf_info[pfn] == PF_KMALLOC;
+}
+
+size_t page_alloc_get_free_pages(void)
+{
+   return tot_free_pages;
+}
+
+void init_page_alloc(void)
+{
+   pf_count = (ulong)MIN(get_phys_mem_size(), (u64)LINEAR_MAPPING_SIZE);
+   pf_count >>= PAGE_SHIFT;
+
+   for (u32 i = 0; i <= PG_ALLOC_MAX_ORDER; i++)
+      list_init(&free_lists[i]);
+
+   if (!(pf_info = kzmalloc(pf_count))) {
+
+      if (in_panic())
+         return;        /* We're in panic: keep using the kmalloc fallback */
+
+      panic("Unable to allocate the page-frame allocator's metadata");
+   }
+}
+
+#ifdef UNIT_TEST_ENVIRONMENT
+
+/*
+ * Forget about all the chunks borrowed from kmalloc: called when the kmalloc
+ * heaps are re-initialized between unit tests. After that, the allocator uses
+ * the kmalloc() fallback until init_page_alloc() is called again.
+ */
+void page_alloc_reset(void)
+{
+   pf_info = NULL;
+   pf_count = 0;
+   tot_free_pages = 0;
+   bzero(free_count, sizeof(free_count));
+}
+
+#endif
@@ -9,7 +9,9 @@
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/errno.h>
+#include <tilck/kernel/signal.h>
 #include <tilck/kernel/fs/devfs.h>
 #include <tilck/kernel/syscalls.h>
 
@@ -17,56 +19,167 @@
 
 char page_size_buf[PAGE_SIZE] ALIGNED_AT(PAGE_SIZE);
 
-static void
-brk_syscall_int(struct process *pi, void *new_brk)
+/*
+ * Anonymous mappings, the heap and the stack are populated lazily: mmap() and
+ * brk() just reserve the virtual range, while the pages are mapped at the first
+ * access by handle_user_demand_fault(). The stack grows down from
+ * USERMODE_VADDR_END up to the RLIMIT_STACK limit of the process, capped at
+ * USER_STACK_MAX_SZ: that leaves a guard gap of at least USER_STACK_GUARD_GAP
+ * bytes between it and the mmap area. When the page before the faulting one is
+ * already mapped, the access is likely sequential and up to
+ * DEMAND_FAULT_AROUND_PAGES pages are mapped at once, in order to save the
+ * next page faults.
+ */
+#define DEMAND_FAULT_AROUND_PAGES                        8
+
+static int demand_map_page(pdir_t *pdir, ulong vaddr, bool rw)
 {
-   ASSERT(!is_preemption_enabled());
+   void *kernel_vaddr;
+   ulong paddr;
 
-   if (new_brk < pi->brk) {
+   if (!rw && !MMAP_NO_COW) {
+      /* Read access: map the zero-page, the COW will take care of writes */
+      return map_zero_page(pdir, (void *)vaddr, PAGING_FL_RWUS);
+   }
 
-      /* we have to free pages */
+   if (!(kernel_vaddr = kzalloc_page()))
+      return -ENOMEM;
 
-      for (void *vaddr = new_brk; vaddr < pi->brk; vaddr += PAGE_SIZE) {
-         unmap_page(pi->pdir, vaddr, true);
-      }
+   paddr = LIN_VA_TO_PA(kernel_vaddr);
 
-      pi->brk = new_brk;
-      return;
+   if (map_page(pdir, (void *)vaddr, paddr, PAGING_FL_RWUS) != 0) {
+      kfree_page(kernel_vaddr);
+      return -ENOMEM;
    }
 
-   void *vaddr = pi->brk;
+   return 0;
+}
 
-   while (vaddr < new_brk) {
+STATIC_ASSERT(USER_STACK_PAGES * PAGE_SIZE <= USER_STACK_MAX_SZ);
 
-      if (is_mapped(pi->pdir, vaddr))
-         return; // error: vaddr is already mapped!
+static ulong get_user_stack_bottom(struct process *pi)
+{
+   /* Bigger limits, including RLIM_INFINITY, are clamped to the max size */
+   const ulong lim = MIN(pi->stack_rlim_cur, (ulong)USER_STACK_MAX_SZ);
+   return USERMODE_VADDR_END - pow2_round_up_at(lim, PAGE_SIZE);
+}
+
+static bool
+get_demand_paged_range(struct process *pi,
+                       struct user_mapping *um,
+                       ulong vaddr,
+                       ulong *s,
+                       ulong *e)
+{
+   if (IN_RANGE(vaddr, (ulong)pi->initial_brk, (ulong)pi->brk)) {
+      *s = (ulong)pi->initial_brk;
+      *e = (ulong)pi->brk;
+      return true;
+   }
+
+   if (um && !um->h) {
+      *s = um->vaddr;
+      *e = um->vaddr + um->len;
+      return true;
+   }
+
+   if (IN_RANGE(vaddr, get_user_stack_bottom(pi), USERMODE_VADDR_END)) {
+      *s = get_user_stack_bottom(pi);
+      *e = USERMODE_VADDR_END;
+      return true;
+   }
+
+   return false;
+}
+
+bool handle_user_demand_fault(void *vaddrp, bool p, bool rw)
+{
+   struct task *curr = get_curr_task();
+   struct process *pi = curr->pi;
+   struct user_mapping *um = process_get_user_mapping(vaddrp);
+   ulong vaddr = (ulong)vaddrp & PAGE_MASK;
+   ulong start, end;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (um && um->h) {
+
+      /*
+       * File mappings are populated on demand by their filesystem. Call
+       * vfs_handle_fault() only if in first place the mapping allowed writing
+       * or if it didn't but the memory access type was a READ.
+       */
+      if (rw && !(um->prot & PROT_WRITE))
+         return false;
 
-      vaddr += PAGE_SIZE;
+      return vfs_handle_fault(um, vaddrp, p, rw);
    }
 
-   /* OK, everything looks good here */
+   if (p)
+      return false; /* Not a demand-paging fault */
 
-   vaddr = pi->brk;
+   if (!get_demand_paged_range(pi, um, vaddr, &start, &end))
+      return false;
 
-   while (vaddr < new_brk) {
+   if (demand_map_page(pi->pdir, vaddr, rw) != 0) {
 
-      void *kernel_vaddr = kmalloc(PAGE_SIZE);
+      /*
+       * Out-of-memory. If the fault was caused by the kernel (e.g. in
+       * copy_to_user()), let it fail as if the page was not mapped at all.
+       * Otherwise, just kill the task, like in the COW case.
+       */
+      if (curr->running_in_kernel)
+         return false;
+
+      printk("Out-of-memory: killing pid %d\n", pi->pid);
+      send_signal2(pi->pid, curr->tid, SIGKILL, SIG_FL_FAULT);
+      return true;
+   }
 
-      if (!kernel_vaddr)
-         break; /* we've allocated as much as possible */
+   if (vaddr > start && is_mapped(pi->pdir, (void *)(vaddr - PAGE_SIZE))) {
 
-      const ulong paddr = LIN_VA_TO_PA(kernel_vaddr);
+      end = MIN(end, vaddr + DEMAND_FAULT_AROUND_PAGES * PAGE_SIZE);
 
-      if (map_page(pi->pdir, vaddr, paddr, PAGING_FL_RWUS) != 0) {
-         kfree2(kernel_vaddr, PAGE_SIZE);
-         break;
+      for (vaddr += PAGE_SIZE; vaddr < end; vaddr += PAGE_SIZE) {
+
+         if (is_mapped(pi->pdir, (void *)vaddr))
+            break;
+
+         if (demand_map_page(pi->pdir, vaddr, rw) != 0)
+            break; /* Not a problem: these pages have not been accessed yet */
       }
+   }
 
-      vaddr += PAGE_SIZE;
+   return true;
+}
+
+static void
+brk_syscall_int(struct process *pi, void *new_brk)
+{
+   ASSERT(!is_preemption_enabled());
+
+   if (new_brk < pi->brk) {
+
+      /* Free the pages that have been actually touched */
+      unmap_pages_permissive(pi->pdir,
+                             new_brk,
+                             (size_t)(pi->brk - new_brk) >> PAGE_SHIFT,
+                             true);
+
+      pi->brk = new_brk;
+      return;
    }
 
-   /* We're done. */
-   pi->brk = vaddr;
+   for (void *vaddr = pi->brk; vaddr < new_brk; vaddr += PAGE_SIZE) {
+      if (is_mapped(pi->pdir, vaddr))
+         return; // error: vaddr is already mapped!
+   }
+
+   /*
+    * OK, everything looks good here. Just move the program break: the pages
+    * will be allocated on-demand by handle_user_demand_fault().
+    */
+   pi->brk = new_brk;
 }
 
 void *sys_brk(void *new_brk)
@@ -105,119 +218,125 @@ void *sys_brk(void *new_brk)
 }
 
 static int
-create_process_mmap_heap(struct process *pi)
+create_process_mappings_info(struct process *pi)
 {
-   struct kmalloc_heap *mmap_heap;
-   void *valloc_func = &user_map_zero_page;
-   void *vfree_func = &user_unmap_zero_page;
-
    ASSERT(!pi->mi);
 
-   if (!(pi->mi = kalloc_obj(struct mappings_info)))
+   if (!(pi->mi = kzalloc_obj(struct mappings_info)))
       return -ENOMEM;
 
-   if (!(mmap_heap = kzmalloc(kmalloc_get_heap_struct_size()))) {
-      kfree_obj(pi->mi, struct mappings_info);
-      return -ENOMEM;
-   }
+   pi->mi->mappings = NULL;
+   pi->mi->free_area_hint = USER_MMAP_BEGIN;
+   return 0;
+}
 
-   list_init(&pi->mi->mappings);
-   pi->mi->mmap_heap = mmap_heap;
-   pi->mi->mmap_heap_size = USER_MMAP_MIN_SZ;
+/*
+ * Look for a free range of `len` bytes in [start, end), skipping the existing
+ * mappings one by one in address order.
+ */
+static ulong
+find_free_area_in(struct mappings_info *mi, ulong start, ulong end, size_t len)
+{
+   struct user_mapping *um;
+   ulong va = start;
 
-   if (MMAP_NO_COW) {
-      valloc_func = &user_valloc_and_map;
-      vfree_func = &user_vfree_and_unmap;
-   }
+   while (va < end && end - va >= len) {
 
-   bool success =
-      kmalloc_create_heap(mmap_heap,
-                          USER_MMAP_BEGIN,
-                          pi->mi->mmap_heap_size,
-                          PAGE_SIZE,
-                          PAGE_SIZE,            /* alloc block size */
-                          false,                /* linear mapping */
-                          NULL,                 /* metadata_nodes */
-                          valloc_func,
-                          vfree_func);
+      if (!(um = mi_get_first_mapping_in(mi, va, len)))
+         return va;
 
-   if (!success) {
-      kfree2(pi->mi->mmap_heap, kmalloc_get_heap_struct_size());
-      kfree_obj(pi->mi, struct mappings_info);
-      return -ENOMEM;
+      va = um->vaddr + um->len;
    }
 
    return 0;
 }
 
-static inline void
-mmap_err_case_free(struct process *pi, void *ptr, size_t actual_len)
+/*
+ * Choose the user virtual address for a new mapping of `len` bytes. In the
+ * MAP_FIXED case, `hint` is mandatory (the caller has to unmap whatever is
+ * there). Otherwise, `hint` is used only if the range is free, like on Linux.
+ * By default, we do a next-fit search starting from `mi->free_area_hint` (the
+ * end of the last mapping we created or the lowest range unmapped since
+ * then), wrapping around once.
+ */
+static ulong
+get_mmap_vaddr(struct mappings_info *mi, ulong hint, size_t len, bool fixed)
 {
-   per_heap_kfree(pi->mi->mmap_heap,
-                  ptr,
-                  &actual_len,
-                  KFREE_FL_ALLOW_SPLIT |
-                  KFREE_FL_MULTI_STEP  |
-                  KFREE_FL_NO_ACTUAL_FREE);
-}
+   const ulong start = mi->free_area_hint;
+   ulong res;
 
-static struct user_mapping *
-mmap_on_user_heap(struct process *pi,
-                  size_t *actual_len_ref,
-                  fs_handle handle,
-                  u32 per_heap_kmalloc_flags,
-                  size_t off,
-                  int prot)
-{
-   void *res;
-   struct user_mapping *um;
+   if (hint) {
+
+      if (IN_RANGE(hint, USER_MMAP_BEGIN, USER_MMAP_END) &&
+          USER_MMAP_END - hint >= len)
+      {
+         if (fixed || !mi_get_first_mapping_in(mi, hint, len))
+            return hint;
+      }
+
+      if (fixed)
+         return 0;
+   }
 
-   while (true) {
+   if (!(res = find_free_area_in(mi, start, USER_MMAP_END, len)))
+      res = find_free_area_in(mi, USER_MMAP_BEGIN, start + len, len);
 
-      struct kmalloc_heap *new_heap;
-      struct kmalloc_heap *h = pi->mi->mmap_heap;
-      size_t heap_sz = pi->mi->mmap_heap_size;
+   return res;
+}
 
-      res = per_heap_kmalloc(h,
-                             actual_len_ref,
-                             per_heap_kmalloc_flags);
+static inline bool
+is_anon_mapping_mergeable(struct user_mapping *um, int prot)
+{
+   return um && !um->h && um->prot == prot;
+}
 
-      if (LIKELY(res != NULL))
-         break;        /* great! */
+/*
+ * Try to extend an existing anonymous mapping adjacent to [vaddr, vaddr+len)
+ * instead of creating a new one, merging also the mappings on both sides, if
+ * possible. Returns the extended mapping or NULL.
+ */
+static struct user_mapping *
+merge_anon_mapping(struct mappings_info *mi, ulong vaddr, size_t len, int prot)
+{
+   struct user_mapping *prev = mi_get_mapping(mi, vaddr - 1);
+   struct user_mapping *next = mi_get_mapping(mi, vaddr + len);
 
-      if (heap_sz == USER_MMAP_MAX_SZ)
-         return NULL; /* cannot expand the heap more than that */
+   if (is_anon_mapping_mergeable(prev, prot)) {
 
-      new_heap = kmalloc_heap_dup_expanded(h, heap_sz * 2);
+      if (is_anon_mapping_mergeable(next, prot)) {
 
-      if (!new_heap)
-         return NULL; /* no enough memory */
+         /* Remove `next` before making `prev` overlap with it */
+         len += next->len;
+         process_remove_user_mapping(next);
+      }
 
-      pi->mi->mmap_heap_size = heap_sz * 2;
-      pi->mi->mmap_heap = new_heap;
-      kmalloc_destroy_heap(h);
+      prev->len += len;
+      return prev;
    }
 
-   /* NOTE: here `handle` might be NULL (zero-map case) and that's OK */
-   um = process_add_user_mapping(handle, res, *actual_len_ref, off, prot);
+   if (is_anon_mapping_mergeable(next, prot)) {
 
-   if (!um) {
-      mmap_err_case_free(pi, res, *actual_len_ref);
-      return NULL;
+      /* NOTE: this doesn't change the position of `next` in the tree */
+      next->vaddr = vaddr;
+      next->len += len;
+      return next;
    }
 
-   return um;
+   return NULL;
 }
 
+static int munmap_int(struct process *pi, ulong vaddr, size_t len);
+
 long
 sys_mmap_pgoff(void *addr, size_t len, int prot,
                int flags, int fd, size_t pgoffset)
 {
-   u32 per_heap_kmalloc_flags = KMALLOC_FL_MULTI_STEP | PAGE_SIZE;
    struct task *curr = get_curr_task();
    struct process *pi = curr->pi;
    struct fs_handle_base *handle = NULL;
    struct user_mapping *um = NULL;
+   const bool fixed = !!(flags & MAP_FIXED);
+   ulong vaddr, hint = (ulong)addr;
    size_t actual_len;
    int rc, fl;
 
@@ -227,12 +346,23 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
    if (!len)
       return -EINVAL;
 
-   if (addr)
-      return -EINVAL; /* addr != NULL not supported */
+   if (hint & OFFSET_IN_PAGE_MASK) {
+
+      if (fixed)
+         return -EINVAL;
+
+      hint = 0; /* Just a hint: ignore it */
+   }
+
+   if (fixed && !hint)
+      return -EINVAL;
 
    if (!(prot & PROT_READ))
       return -EINVAL;
 
+   if (len > USER_MMAP_END - USER_MMAP_BEGIN)
+      return -ENOMEM;
+
    actual_len = pow2_round_up_at(len, PAGE_SIZE);
 
    if (fd == -1) {
@@ -274,32 +404,49 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
          if (!(fl & O_WRONLY) && (fl & O_RDWR) != O_RDWR)
             return -EACCES;
       }
-
-      per_heap_kmalloc_flags |= KMALLOC_FL_NO_ACTUAL_ALLOC;
    }
 
    if (!pi->mi) {
-      if ((rc = create_process_mmap_heap(pi))) {
+      if ((rc = create_process_mappings_info(pi))) {
          return rc;
       }
    }
 
    disable_preemption();
    {
-      um = mmap_on_user_heap(pi,
-                             &actual_len,
-                             handle,
-                             per_heap_kmalloc_flags,
-                             pgoffset << PAGE_SHIFT,
-                             prot);
+      vaddr = get_mmap_vaddr(pi->mi, hint, actual_len, fixed);
+
+      if (!vaddr) {
+         enable_preemption();
+         return fixed ? -EINVAL : -ENOMEM;
+      }
+
+      if (fixed && (rc = munmap_int(pi, vaddr, actual_len))) {
+         enable_preemption();
+         return rc;
+      }
+
+      if (!handle)
+         um = merge_anon_mapping(pi->mi, vaddr, actual_len, prot);
+
+      if (!um) {
+
+         /* NOTE: here `handle` might be NULL (zero-map case) and that's OK */
+         um = process_add_user_mapping(handle,
+                                       (void *)vaddr,
+                                       actual_len,
+                                       pgoffset << PAGE_SHIFT,
+                                       prot);
+      }
+
+      if (um)
+         pi->mi->free_area_hint = vaddr + actual_len;
    }
    enable_preemption();
 
    if (!um)
       return -ENOMEM;
 
-   ASSERT(actual_len == pow2_round_up_at(len, PAGE_SIZE));
-
    if (handle) {
 
       if ((rc = vfs_mmap(um, pi->pdir, 0))) {
@@ -312,122 +459,131 @@ sys_mmap_pgoff(void *addr, size_t len, int prot,
 
          disable_preemption();
          {
-            mmap_err_case_free(pi, um->vaddrp, actual_len);
             process_remove_user_mapping(um);
          }
          enable_preemption();
          return rc;
       }
-
-
-   } else {
-
-      if (MMAP_NO_COW)
-         bzero(um->vaddrp, actual_len);
    }
 
-   return (long)um->vaddr;
+   return (long)vaddr;
 }
 
-static int munmap_int(struct process *pi, void *vaddrp, size_t len)
+/*
+ * Un-map [vaddr, vaddr + len), which must be entirely contained in `um`.
+ */
+static int
+munmap_in_mapping(struct process *pi,
+                  struct user_mapping *um,
+                  ulong vaddr,
+                  size_t len)
 {
-   u32 kfree_flags = KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP;
-   struct user_mapping *um = NULL, *um2 = NULL;
-   ulong vaddr = (ulong) vaddrp;
-   size_t actual_len;
+   struct user_mapping *um2 = NULL;
+   const ulong um_vend = um->vaddr + um->len;
    int rc;
 
-   ASSERT(!is_preemption_enabled());
-
-   actual_len = pow2_round_up_at(len, PAGE_SIZE);
-   um = process_get_user_mapping(vaddrp);
+   ASSERT(vaddr >= um->vaddr && vaddr + len <= um_vend);
 
-   if (!um) {
+   if (vaddr > um->vaddr && vaddr + len < um_vend) {
 
       /*
-       * We just don't have any user_mappings containing [vaddrp, vaddrp+len).
-       * Just ignore that and return 0 [linux behavior].
+       * Unmap something at the middle of the chunk: shrink the current
+       * struct user_mapping, so that it doesn't overlap anymore with its 2nd
+       * part, and create a new struct user_mapping for the latter, before
+       * changing anything else.
        */
 
-      printk("[%d] Un-map unknown chunk at [%p, %p)\n",
-             pi->pid, TO_PTR(vaddr), TO_PTR(vaddr + actual_len));
-      return 0;
+      um->len = vaddr - um->vaddr;
+
+      um2 = process_add_user_mapping(
+         um->h,
+         (void *)(vaddr + len),
+         (um_vend - (vaddr + len)),
+         um->off + um->len + len,
+         um->prot
+      );
+
+      if (!um2) {
+
+         /*
+          * Oops, we're out-of-memory! No problem, revert um->len and return
+          * -ENOMEM. Linux is allowed to do that.
+          */
+         um->len = um_vend - um->vaddr;
+         return -ENOMEM;
+      }
    }
 
-   const ulong um_vend = um->vaddr + um->len;
+   if (um->h) {
 
-   if (actual_len == um->len) {
+      rc = vfs_munmap(um, (void *)vaddr, len);
 
-      process_remove_user_mapping(um);
+      /*
+       * If there's an actual user_mapping entry, it means um->h's fops MUST
+       * HAVE mmap() implemented. Therefore, we MUST REQUIRE munmap() to be
+       * present as well.
+       */
+
+      ASSERT(rc != -ENODEV);
+      (void) rc; /* prevent the "unused variable" Werror in release */
 
    } else {
 
-      /* partial un-map */
+      /* Free only the pages that have been actually touched */
+      user_vfree_and_unmap(vaddr, len >> PAGE_SHIFT);
+   }
 
-      if (vaddr == um->vaddr) {
+   if (vaddr == um->vaddr && len == um->len) {
 
-         /* unmap the beginning of the chunk */
-         um->vaddr += actual_len;
-         um->off += actual_len;
-         um->len -= actual_len;
+      process_remove_user_mapping(um);
 
-      } else if (vaddr + actual_len == um_vend) {
+   } else if (vaddr == um->vaddr) {
 
-         /* unmap the end of the chunk */
-         um->len -= actual_len;
+      /* unmap the beginning of the chunk */
+      um->vaddr += len;
+      um->off += len;
+      um->len -= len;
 
-      } else {
+   } else {
 
-         /* Unmap something at the middle of the chunk */
+      /* unmap the end or the middle of the chunk */
+      um->len = vaddr - um->vaddr;
 
-         /* Shrink the current struct user_mapping */
-         um->len = vaddr - um->vaddr;
+      if (um2 && um2->h)
+         vfs_mmap(um2, pi->pdir, VFS_MM_DONT_MMAP);
+   }
 
-         /* Create a new struct user_mapping for its 2nd part */
-         um2 = process_add_user_mapping(
-            um->h,
-            (void *)(vaddr + actual_len),
-            (um_vend - (vaddr + actual_len)),
-            um->off + um->len + actual_len,
-            um->prot
-         );
+   if (vaddr < pi->mi->free_area_hint)
+      pi->mi->free_area_hint = vaddr;
 
-         if (!um2) {
+   return 0;
+}
 
-            /*
-             * Oops, we're out-of-memory! No problem, revert um->page_count
-             * and return -ENOMEM. Linux is allowed to do that.
-             */
-            um->len = um_vend - um->vaddr;
-            return -ENOMEM;
-         }
-      }
-   }
+static int munmap_int(struct process *pi, ulong vaddr, size_t len)
+{
+   struct user_mapping *um;
+   const ulong vend = vaddr + pow2_round_up_at(len, PAGE_SIZE);
+   ulong s, e;
+   int rc;
 
-   if (um->h) {
+   ASSERT(!is_preemption_enabled());
 
-      kfree_flags |= KFREE_FL_NO_ACTUAL_FREE;
-      rc = vfs_munmap(um, vaddrp, actual_len);
+   /*
+    * Un-map all the mappings overlapping with [vaddr, vend). Unmapping ranges
+    * without any mapping is fine [linux behavior].
+    */
 
-      /*
-       * If there's an actual user_mapping entry, it means um->h's fops MUST
-       * HAVE mmap() implemented. Therefore, we MUST REQUIRE munmap() to be
-       * present as well.
-       */
+   while ((um = mi_get_first_mapping_in(pi->mi, vaddr, vend - vaddr))) {
 
-      ASSERT(rc != -ENODEV);
-      (void) rc; /* prevent the "unused variable" Werror in release */
+      s = MAX(vaddr, um->vaddr);
+      e = MIN(vend, um->vaddr + um->len);
 
-      if (um2)
-         vfs_mmap(um2, pi->pdir, VFS_MM_DONT_MMAP);
-   }
+      if ((rc = munmap_in_mapping(pi, um, s, e - s)))
+         return rc;
 
-   per_heap_kfree(pi->mi->mmap_heap,
-                  vaddrp,
-                  &actual_len,
-                  kfree_flags);
+      vaddr = e;
+   }
 
-   ASSERT(actual_len == pow2_round_up_at(len, PAGE_SIZE));
    return 0;
 }
 
@@ -438,20 +594,155 @@ int sys_munmap(void *vaddrp, size_t len)
    ulong vaddr = (ulong) vaddrp;
    int rc;
 
-   if (!len || !pi->mi->mmap_heap)
+   if (!len || (vaddr & OFFSET_IN_PAGE_MASK))
       return -EINVAL;
 
-   if (!IN_RANGE(vaddr,
-                 USER_MMAP_BEGIN,
-                 USER_MMAP_BEGIN + pi->mi->mmap_heap_size))
+   if (!IN_RANGE(vaddr, USER_MMAP_BEGIN, USER_MMAP_END) ||
+       len > USER_MMAP_END - vaddr)
    {
       return -EINVAL;
    }
 
+   if (!pi->mi)
+      return 0; /* No mappings at all */
+
+   disable_preemption();
+   {
+      rc = munmap_int(pi, vaddr, len);
+   }
+   enable_preemption();
+   return rc;
+}
+
+#ifndef MREMAP_MAYMOVE
+   #define MREMAP_MAYMOVE           1
+   #define MREMAP_FIXED             2
+#endif
+
+/*
+ * Move the pages in [old_vaddr, old_vaddr + old_len) to a new anonymous mapping
+ * of `new_len` bytes, without copying their contents: only the page table
+ * entries are moved. Returns the new address or a negative error code.
+ */
+static long
+mremap_move(struct process *pi, ulong old_vaddr, size_t old_len, size_t new_len)
+{
+   struct mappings_info *mi = pi->mi;
+   struct user_mapping *um = mi_get_mapping(mi, old_vaddr);
+   void *const old_va = (void *)old_vaddr;
+   const size_t old_pages = old_len >> PAGE_SHIFT;
+   DEBUG_ONLY_UNSAFE(int rc2);
+   ulong vaddr;
+   int rc;
+
+   if (!(vaddr = get_mmap_vaddr(mi, 0, new_len, false)))
+      return -ENOMEM;
+
+   um = process_add_user_mapping(NULL, (void *)vaddr, new_len, 0, um->prot);
+
+   if (!um)
+      return -ENOMEM;
+
+   if ((rc = move_pages(pi->pdir, old_va, (void *)vaddr, old_pages))) {
+      process_remove_user_mapping(um);
+      return rc;
+   }
+
+   /*
+    * Nothing is mapped anymore in the old range, so un-mapping it just drops
+    * (or splits) its user_mapping. That fails only when we're out of memory
+    * and the mapping had to be split: in that case, move the pages back,
+    * which cannot fail because all the page tables involved exist already.
+    */
+   if ((rc = munmap_int(pi, old_vaddr, old_len))) {
+
+      DEBUG_ONLY_UNSAFE(rc2 =)
+         move_pages(pi->pdir, (void *)vaddr, old_va, old_pages);
+
+      ASSERT(rc2 == 0);
+      process_remove_user_mapping(um);
+      return rc;
+   }
+
+   mi->free_area_hint = vaddr + new_len;
+   return (long)vaddr;
+}
+
+long
+sys_mremap(void *old_addr, size_t old_len, size_t new_len,
+           int flags, void *new_addr)
+{
+   struct task *curr = get_curr_task();
+   struct process *pi = curr->pi;
+   const ulong old_vaddr = (ulong)old_addr;
+   struct user_mapping *um;
+   ulong old_end;
+   long rc;
+
+   if ((old_vaddr & OFFSET_IN_PAGE_MASK) || !new_len)
+      return -EINVAL;
+
+   if (flags & ~MREMAP_MAYMOVE)
+      return -EINVAL; /* MREMAP_FIXED is not supported */
+
+   if (!old_len)
+      return -EINVAL; /* Duplicating shared mappings is not supported */
+
+   if (new_len > USER_MMAP_END - USER_MMAP_BEGIN)
+      return -ENOMEM;
+
+   old_len = pow2_round_up_at(old_len, PAGE_SIZE);
+   new_len = pow2_round_up_at(new_len, PAGE_SIZE);
+   old_end = old_vaddr + old_len;
+
+   if (!pi->mi)
+      return -EFAULT;
+
    disable_preemption();
+
+   um = mi_get_mapping(pi->mi, old_vaddr);
+
+   if (!um || old_end > um->vaddr + um->len) {
+      rc = -EFAULT; /* The old range must be inside a single mapping */
+      goto out;
+   }
+
+   if (new_len <= old_len) {
+
+      /* Shrinking is always done in place */
+      rc = munmap_int(pi, old_vaddr + new_len, old_len - new_len);
+      rc = rc ? rc : (long)old_vaddr;
+      goto out;
+   }
+
+   if (um->h) {
+      rc = -EINVAL; /* Growing file mappings is not supported */
+      goto out;
+   }
+
+   if (old_end == um->vaddr + um->len &&
+       USER_MMAP_END - old_end >= new_len - old_len &&
+       !mi_get_first_mapping_in(pi->mi, old_end, new_len - old_len))
    {
-      rc = munmap_int(pi, vaddrp, len);
+      /*
+       * Grow in place: the pages are allocated on demand, as usual. Merging
+       * the new range with `um` cannot fail, and it might merge the next
+       * mapping as well.
+       */
+      DEBUG_ONLY_UNSAFE(struct user_mapping *res =)
+         merge_anon_mapping(pi->mi, old_end, new_len - old_len, um->prot);
+
+      ASSERT(res == um);
+      rc = (long)old_vaddr;
+      goto out;
    }
+
+   if (flags & MREMAP_MAYMOVE)
+      rc = mremap_move(pi, old_vaddr, old_len, new_len);
+   else
+      rc = -ENOMEM;
+
+out:
    enable_preemption();
    return rc;
 }
@@ -3,6 +3,83 @@
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/kmem_cache.h>
+
+static struct kmem_cache user_mappings_cache =
+   KMEM_CACHE_INIT("user_mapping", sizeof(struct user_mapping), NULL);
+
+/*
+ * The user mappings of a process are kept in an AVL tree ordered by vaddr.
+ * Because they never overlap, the tree works also as an interval tree: a
+ * mapping compares as "equal" to any address it contains (um_vaddr_cmp), so
+ * bintree_find() and bintree_find_ceil() give us in O(log n) respectively the
+ * mapping containing a given address and the first one ending after it.
+ */
+
+static long um_insert_cmp(const void *a, const void *b)
+{
+   const struct user_mapping *um1 = a;
+   const struct user_mapping *um2 = b;
+
+   if (um1->vaddr == um2->vaddr)
+      return 0;
+
+   return um1->vaddr < um2->vaddr ? -1 : 1;
+}
+
+static long um_vaddr_cmp(const void *obj, const void *value)
+{
+   const struct user_mapping *um = obj;
+   const ulong vaddr = (ulong)value;
+
+   if (vaddr < um->vaddr)
+      return 1;
+
+   if (vaddr >= um->vaddr + um->len)
+      return -1;
+
+   return 0;
+}
+
+struct user_mapping *
+mi_get_mapping(struct mappings_info *mi, ulong vaddr)
+{
+   return bintree_find(mi->mappings,
+                       TO_PTR(vaddr),
+                       um_vaddr_cmp,
+                       struct user_mapping,
+                       pi_node);
+}
+
+static struct user_mapping *
+mi_get_mapping_from(struct mappings_info *mi, ulong vaddr)
+{
+   return bintree_find_ceil(mi->mappings,
+                            TO_PTR(vaddr),
+                            um_vaddr_cmp,
+                            struct user_mapping,
+                            pi_node);
+}
+
+/*
+ * Get the first mapping overlapping with [vaddr, vaddr + len), or NULL.
+ */
+struct user_mapping *
+mi_get_first_mapping_in(struct mappings_info *mi, ulong vaddr, size_t len)
+{
+   struct user_mapping *um = mi_get_mapping_from(mi, vaddr);
+
+   if (um && um->vaddr < vaddr + len)
+      return um;
+
+   return NULL;
+}
+
+struct user_mapping *
+mi_get_next_mapping(struct mappings_info *mi, struct user_mapping *um)
+{
+   return mi_get_mapping_from(mi, um->vaddr + um->len);
+}
 
 struct user_mapping *
 process_add_user_mapping(fs_handle h,
@@ -19,10 +96,10 @@ process_add_user_mapping(fs_handle h,
    ASSERT(!process_get_user_mapping(vaddr));
    ASSERT(pi->mi);
 
-   if (!(um = kzalloc_obj(struct user_mapping)))
+   if (!(um = kmem_cache_zalloc(&user_mappings_cache)))
       return NULL;
 
-   list_node_init(&um->pi_node);
+   bintree_node_init(&um->pi_node);
    list_node_init(&um->inode_node);
 
    um->pi = pi;
@@ -32,70 +109,66 @@ process_add_user_mapping(fs_handle h,
    um->off = off;
    um->prot = prot;
 
-   list_add_tail(&pi->mi->mappings, &um->pi_node);
+   DEBUG_ONLY_UNSAFE(bool success =)
+      bintree_insert(&pi->mi->mappings,
+                     um,
+                     um_insert_cmp,
+                     struct user_mapping,
+                     pi_node);
+
+   ASSERT(success);
    return um;
 }
 
 void process_remove_user_mapping(struct user_mapping *um)
 {
+   DEBUG_ONLY_UNSAFE(void *res);
    ASSERT(!is_preemption_enabled());
 
-   list_remove(&um->pi_node);
+   DEBUG_ONLY_UNSAFE(res =)
+      bintree_remove(&um->pi->mi->mappings,
+                     TO_PTR(um->vaddr),
+                     um_vaddr_cmp,
+                     struct user_mapping,
+                     pi_node);
+
+   ASSERT(res == um);
    list_remove(&um->inode_node);
-   kfree_obj(um, struct user_mapping);
+   kmem_cache_free(&user_mappings_cache, um);
 }
 
 struct user_mapping *process_get_user_mapping(void *vaddrp)
 {
-   const ulong vaddr = (ulong)vaddrp;
    struct process *pi = get_curr_proc();
-   struct user_mapping *pos;
 
    ASSERT(!is_preemption_enabled());
 
-   if (pi->mi) {
-
-      /*
-       * Given that pi->mi->mappings contains at the moment only the memory
-       * mappings done with mmap(), some small processes that don't use dynamic
-       * memory allocation will not even have this field (pi->mi == NULL).
-       *
-       * For the rest, the list is supposed to be *short*, so a linear scan
-       * is acceptable for the moment. If in the future we start to put
-       * there also the mappings for program's text and data and expect to have
-       * more than a few elements, it will be necessary to use a BST to perform
-       * the lookup here below.
-       */
-
-      list_for_each_ro(pos, &pi->mi->mappings, pi_node) {
-
-         if (IN_RANGE(vaddr, pos->vaddr, pos->vaddr + pos->len))
-            return pos;
-      }
-   }
+   /*
+    * Some small processes that don't use mmap() will not even have the
+    * mappings info (pi->mi == NULL).
+    */
+   if (!pi->mi)
+      return NULL;
 
-   return NULL;
+   return mi_get_mapping(pi->mi, (ulong)vaddrp);
 }
 
 void remove_all_user_zero_mem_mappings(struct process *pi)
 {
-   struct user_mapping *um;
-   struct list *mappings_list_p;
+   struct user_mapping *um, *tmp;
 
    ASSERT(!is_preemption_enabled());
 
    if (!pi->mi)
       return;
 
-   mappings_list_p = &pi->mi->mappings;
-
-   list_for_each_ro(um, mappings_list_p, pi_node) {
+   mi_for_each_mapping(um, tmp, pi->mi) {
 
       if (!um->h)
          full_remove_user_mapping(pi, um);
    }
 
-   ASSERT(list_is_empty(mappings_list_p));
+   ASSERT(pi->mi->mappings == NULL);
 }
 
 void remove_all_mappings_of_handle(struct process *pi, fs_handle h)
@@ -108,7 +181,7 @@ void remove_all_mappings_of_handle(struct process *pi, fs_handle h)
 
    disable_preemption();
    {
-      list_for_each(pos, temp, &mi->mappings, pi_node) {
+      mi_for_each_mapping(pos, temp, mi) {
          if (pos->h == h)
             full_remove_user_mapping(pi, pos);
       }
@@ -118,21 +191,10 @@ void remove_all_mappings_of_handle(struct process *pi, fs_handle h)
 
 void full_remove_user_mapping(struct process *pi, struct user_mapping *um)
 {
-   struct mappings_info *mi = pi->mi;
-   size_t actual_len = um->len;
-
-   ASSERT(mi);
-   ASSERT(mi->mmap_heap);
+   ASSERT(pi->mi);
 
    if (um->h)
-      vfs_munmap(um, um->vaddrp, actual_len);
-
-   per_heap_kfree(mi->mmap_heap,
-                  um->vaddrp,
-                  &actual_len,
-                  KFREE_FL_ALLOW_SPLIT |
-                  KFREE_FL_MULTI_STEP  |
-                  KFREE_FL_NO_ACTUAL_FREE);
+      vfs_munmap(um, um->vaddrp, um->len);
 
    process_remove_user_mapping(um);
 }
@@ -154,21 +216,16 @@ struct mappings_info *
 duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi)
 {
    struct mappings_info *new_mi = NULL;
-   struct user_mapping *um, *um2;
-
-   if (!(new_mi = kalloc_obj(struct mappings_info)))
-      goto oom_case;
-
-   list_init(&new_mi->mappings);
+   struct user_mapping *um, *um2, *tmp;
 
-   if (!(new_mi->mmap_heap = kmalloc_heap_dup(mi->mmap_heap)))
+   if (!(new_mi = kzalloc_obj(struct mappings_info)))
       goto oom_case;
 
-   new_mi->mmap_heap_size = mi->mmap_heap_size;
+   new_mi->free_area_hint = mi->free_area_hint;
 
-   list_for_each_ro(um, &mi->mappings, pi_node) {
+   mi_for_each_mapping(um, tmp, mi) {
 
-      if (!(um2 = kalloc_obj(struct user_mapping)))
+      if (!(um2 = kmem_cache_alloc(&user_mappings_cache)))
          goto oom_case;
 
       /* First just copy the mapping info */
@@ -178,11 +235,15 @@ duplicate_mappings_info(struct process *new_pi, struct mappings_info *mi)
       um2->pi = new_pi;
 
       /* Re-init the new nodes */
-      list_node_init(&um2->pi_node);
+      bintree_node_init(&um2->pi_node);
       list_node_init(&um2->inode_node);
 
-      /* Add the pi_node to new process's mappings list */
-      list_add_tail(&new_mi->mappings, &um2->pi_node);
+      /* Add the pi_node to new process's mappings tree */
+      bintree_insert(&new_mi->mappings,
+                     um2,
+                     um_insert_cmp,
+                     struct user_mapping,
+                     pi_node);
 
       /*
        * If the inode_node belongs to a list (mappings per inode)
@@ -198,14 +259,16 @@ oom_case:
 
    if (new_mi) {
 
-      if (new_mi->mmap_heap) {
-         kmalloc_destroy_heap(new_mi->mmap_heap);
-         kfree2(new_mi->mmap_heap, kmalloc_get_heap_struct_size());
-      }
+      while ((um = new_mi->mappings)) {
 
-      list_for_each(um, um2, &new_mi->mappings, pi_node) {
-         list_remove(&um->pi_node);
-         kfree_obj(um, struct user_mapping);
+         bintree_remove(&new_mi->mappings,
+                        TO_PTR(um->vaddr),
+                        um_vaddr_cmp,
+                        struct user_mapping,
+                        pi_node);
+
+         list_remove(&um->inode_node);
+         kmem_cache_free(&user_mappings_cache, um);
       }
 
       kfree_obj(new_mi, struct mappings_info);
@@ -228,88 +291,6 @@ void user_vfree_and_unmap(ulong user_vaddr, size_t page_count)
    }
 }
 
-bool user_valloc_and_map_slow(ulong user_vaddr, size_t page_count)
-{
-   pdir_t *pdir = get_curr_pdir();
-   ulong pa, va = user_vaddr;
-   void *kernel_vaddr;
-
-   for (size_t i = 0; i < page_count; i++, va += PAGE_SIZE) {
-
-      if (is_mapped(pdir, (void *)va)) {
-         user_vfree_and_unmap(user_vaddr, i);
-         return false;
-      }
-
-      if (!(kernel_vaddr = kmalloc(PAGE_SIZE))) {
-         user_vfree_and_unmap(user_vaddr, i);
-         return false;
-      }
-
-      pa = LIN_VA_TO_PA(kernel_vaddr);
-
-      if (map_page(pdir, (void *)va, pa, PAGING_FL_RWUS) != 0) {
-         kfree2(kernel_vaddr, PAGE_SIZE);
-         user_vfree_and_unmap(user_vaddr, i);
-         return false;
-      }
-   }
-
-   return true;
-}
-
-bool user_valloc_and_map(ulong user_vaddr, size_t page_count)
-{
-   pdir_t *pdir = get_curr_pdir();
-   size_t size = (size_t)page_count << PAGE_SHIFT;
-   size_t count;
-
-   void *kernel_vaddr =
-      general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE);
-
-   if (!kernel_vaddr)
-      return user_valloc_and_map_slow(user_vaddr, page_count);
-
-   ASSERT(size == (size_t)page_count << PAGE_SHIFT);
-
-   count = map_pages(pdir,
-                     (void *)user_vaddr,
-                     LIN_VA_TO_PA(kernel_vaddr),
-                     page_count,
-                     PAGING_FL_US | PAGING_FL_RW);
-
-   if (count != page_count) {
-      unmap_pages(pdir, (void *)user_vaddr, count, false);
-      general_kfree(kernel_vaddr,
-                    &size,
-                    KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
-      return false;
-   }
-
-   return true;
-}
-
-void user_unmap_zero_page(ulong user_vaddr, size_t page_count)
-{
-   pdir_t *pdir = get_curr_pdir();
-   unmap_pages(pdir, (void *)user_vaddr, page_count, true);
-}
-
-bool user_map_zero_page(ulong user_vaddr, size_t page_count)
-{
-   size_t count = map_zero_pages(get_curr_pdir(),
-                                 (void *)user_vaddr,
-                                 page_count,
-                                 PAGING_FL_US | PAGING_FL_RW);
-
-   if (count != page_count) {
-      user_unmap_zero_page(user_vaddr, count);
-      return false;
-   }
-
-   return true;
-}
-
 int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
 {
    struct fs_handle_base *hb = um->h;
@@ -2,22 +2,52 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/kmem_cache.h>
+#include <tilck/kernel/page_alloc.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/pipe.h>
 #include <tilck/kernel/fs/kernelfs.h>
-#include <tilck/kernel/ringbuf.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/user.h>
+
+/*
+ * A pipe is a ring of page references. Each buffer points to a ref-counted
+ * kernel page (see retain_kernel_page()), containing `len` bytes of data at
+ * offset `off`. Pages allocated by write() belong to the pipe and more data
+ * can be appended to them (PIPE_BUF_FL_CAN_MERGE). Pages coming from splice(),
+ * vmsplice() and tee() instead are shared with someone else and the pipe
+ * never writes in them.
+ *
+ * NOTE: appending data to a page is safe even when other pipes (tee) hold a
+ * reference to it, because they can only see the data before `off + len`.
+ */
+
+#define PIPE_BUF_FL_CAN_MERGE        (1 << 0)
+
+struct pipe_buf {
+   char *page;
+   u16 off;
+   u16 len;
+   u32 flags;
+};
 
 struct pipe {
 
    KOBJ_BASE_FIELDS
 
-   char *buf;
-   struct ringbuf rb;
+   struct pipe_buf *bufs;
+   u32 bufs_count;                  /* capacity of the ring, in buffers */
+   u32 head;                        /* index of the first buffer with data */
+   u32 used;                        /* number of buffers with data */
+
    struct kmutex mutex;
    struct kcond not_full_cond;
    struct kcond not_empty_cond;
@@ -27,46 +57,205 @@ struct pipe {
    ATOMIC(int) write_handles;
 };
 
-static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
+static struct kmem_cache pipe_cache =
+   KMEM_CACHE_INIT("pipe", sizeof(struct pipe), NULL);
+
+/* System-wide limit for F_SETPIPE_SZ, tunable via sysfs */
+ulong pipe_max_size = PIPE_MAX_SIZE_KB * 1024;
+
+static ALWAYS_INLINE struct pipe *get_pipe(fs_handle h)
 {
    struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
-   bool sig_pending = false;
-   ssize_t rc = 0;
-   ASSERT(*pos == 0);
+   return (void *)kh->kobj;
+}
 
-   if (!size)
-      return 0;
+static ALWAYS_INLINE struct pipe_buf *pipe_buf_at(struct pipe *p, u32 n)
+{
+   return &p->bufs[(p->head + n) % p->bufs_count];
+}
 
-   kmutex_lock(&p->mutex);
+static ALWAYS_INLINE bool pipe_is_empty(struct pipe *p)
+{
+   return !p->used;
+}
 
-   while (true) {
+static ALWAYS_INLINE bool pipe_has_free_buf(struct pipe *p)
+{
+   return p->used < p->bufs_count;
+}
+
+static struct pipe_buf *pipe_get_merge_buf(struct pipe *p)
+{
+   struct pipe_buf *b;
 
-      rc = (ssize_t)ringbuf_read_bytes(&p->rb, (u8 *)buf, size);
+   if (!p->used)
+      return NULL;
+
+   b = pipe_buf_at(p, p->used - 1);
+
+   if (!(b->flags & PIPE_BUF_FL_CAN_MERGE) || b->off + b->len == PAGE_SIZE)
+      return NULL;
+
+   return b;
+}
+
+static bool pipe_is_full(struct pipe *p)
+{
+   return !pipe_has_free_buf(p) && !pipe_get_merge_buf(p);
+}
+
+static size_t pipe_free_space(struct pipe *p)
+{
+   struct pipe_buf *b = pipe_get_merge_buf(p);
+   size_t space = (size_t)(p->bufs_count - p->used) * PAGE_SIZE;
 
-      if (rc)
-         break; /* Everything is alright, we read something */
+   if (b)
+      space += PAGE_SIZE - b->off - b->len;
+
+   return space;
+}
+
+/* Append a buffer to the ring: the caller's reference to `page` is moved */
+static void
+pipe_push_buf(struct pipe *p, char *page, size_t off, size_t len, u32 flags)
+{
+   ASSERT(pipe_has_free_buf(p));
+   ASSERT(off + len <= PAGE_SIZE);
+
+   *pipe_buf_at(p, p->used++) = (struct pipe_buf) {
+      .page = page,
+      .off = (u16)off,
+      .len = (u16)len,
+      .flags = flags,
+   };
+}
+
+static void pipe_consume(struct pipe *p, struct pipe_buf *b, size_t n)
+{
+   ASSERT(b == &p->bufs[p->head]);
+   ASSERT(n <= b->len);
+
+   b->off += n;
+   b->len -= n;
+
+   if (!b->len) {
+      release_kernel_page(b->page);
+      b->page = NULL;
+      p->head = (p->head + 1) % p->bufs_count;
+      p->used--;
+   }
+}
+
+static size_t pipe_write_bytes(struct pipe *p, const char *buf, size_t size)
+{
+   struct pipe_buf *b = pipe_get_merge_buf(p);
+   size_t tot = 0;
+   size_t n;
+   char *page;
+
+   if (b) {
+      n = MIN(size, PAGE_SIZE - b->off - b->len);
+      memcpy(b->page + b->off + b->len, buf, n);
+      b->len += n;
+      tot += n;
+   }
+
+   while (tot < size && pipe_has_free_buf(p)) {
+
+      if (!(page = kalloc_page()))
+         break;
+
+      retain_kernel_page(page);
+      n = MIN(size - tot, PAGE_SIZE);
+      memcpy(page, buf + tot, n);
+      pipe_push_buf(p, page, 0, n, PIPE_BUF_FL_CAN_MERGE);
+      tot += n;
+   }
+
+   return tot;
+}
+
+static size_t pipe_read_bytes(struct pipe *p, char *buf, size_t size)
+{
+   struct pipe_buf *b;
+   size_t tot = 0;
+   size_t n;
+
+   while (tot < size && !pipe_is_empty(p)) {
+      b = &p->bufs[p->head];
+      n = MIN(size - tot, b->len);
+      memcpy(buf + tot, b->page + b->off, n);
+      pipe_consume(p, b, n);
+      tot += n;
+   }
+
+   return tot;
+}
+
+/*
+ * Wait for the pipe to have some data. Returns 1 when there's data to read,
+ * 0 when the pipe is empty and there are no more writers, < 0 in case of
+ * error.
+ */
+static int pipe_wait_data(struct pipe *p, bool nonblock)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&p->mutex));
+
+   while (pipe_is_empty(p)) {
 
       if (atomic_load_explicit(&p->write_handles, mo_relaxed) == 0) {
          /* No more writers, always return 0, no matter what. */
-         break;
+         return 0;
       }
 
-      if (kh->fl_flags & O_NONBLOCK) {
-         rc = -EAGAIN;
-         break;
-      }
+      if (nonblock)
+         return -EAGAIN;
 
       /* Wait for writers to fill up the buffer */
       kcond_wait(&p->not_empty_cond, &p->mutex, KCOND_WAIT_FOREVER);
 
       /* After wake up */
-      if (pending_signals()) {
-         sig_pending = true;
-         break;
+      if (pending_signals())
+         return -EINTR;
+   }
+
+   return 1;
+}
+
+/*
+ * Wait for the pipe to have some free space or, when `need_buf` is true, at
+ * least one free buffer (for page references). Returns 0 or an error.
+ */
+static int pipe_wait_space(struct pipe *p, bool nonblock, bool need_buf)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&p->mutex));
+
+   while (true) {
+
+      if (atomic_load_explicit(&p->read_handles, mo_relaxed) == 0) {
+
+         /* Broken pipe */
+         send_signal(get_curr_pid(), SIGPIPE, true);
+         return -EPIPE;
       }
+
+      if (need_buf ? pipe_has_free_buf(p) : !pipe_is_full(p))
+         return 0;
+
+      if (nonblock)
+         return -EAGAIN;
+
+      /* Wait for readers to empty the buffer */
+      kcond_wait(&p->not_full_cond, &p->mutex, KCOND_WAIT_FOREVER);
+
+      /* After wake up */
+      if (pending_signals())
+         return -EINTR;
    }
+}
 
+static void pipe_wake_up_after_read(struct pipe *p)
+{
    /*
     * Wake up one blocked writer instead of all of them.
     *
@@ -81,84 +270,82 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
     */
    kcond_signal_one(&p->not_full_cond);
 
-   if (!ringbuf_is_empty(&p->rb)) {
+   if (!pipe_is_empty(p)) {
       /* The buffer is not empty: wake up one more reader, if any */
       kcond_signal_one(&p->not_empty_cond);
    }
+}
 
-   /* Unlock the pipe's state lock and return */
-   kmutex_unlock(&p->mutex);
-   return !sig_pending ? rc : -EINTR;
+static void pipe_wake_up_after_write(struct pipe *p)
+{
+   /*
+    * Wake up one blocked reader, instead of all of them.
+    * See the comments in pipe_wake_up_after_read() above.
+    */
+   kcond_signal_one(&p->not_empty_cond);
+
+   if (!pipe_is_full(p)) {
+      /* The buffer is not full: wake up one more writer, if any */
+      kcond_signal_one(&p->not_full_cond);
+   }
 }
 
-static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
+static ALWAYS_INLINE bool is_nonblock(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
-   bool sig_pending = false;
-   ssize_t rc = 0;
+   return !!(((struct fs_handle_base *)h)->fl_flags & O_NONBLOCK);
+}
+
+static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct pipe *p = get_pipe(h);
+   ssize_t rc;
    ASSERT(*pos == 0);
 
    if (!size)
       return 0;
 
    kmutex_lock(&p->mutex);
+   {
+      if ((rc = pipe_wait_data(p, is_nonblock(h))) > 0)
+         rc = (ssize_t)pipe_read_bytes(p, buf, size);
 
-   while (true) {
-
-      if (atomic_load_explicit(&p->read_handles, mo_relaxed) == 0) {
-
-         /* Broken pipe */
-         send_signal(get_curr_pid(), SIGPIPE, true);
-         rc = -EPIPE;
-         break;
-      }
-
-      rc = (ssize_t)ringbuf_write_bytes(&p->rb, (u8 *)buf, size);
+      pipe_wake_up_after_read(p);
+   }
+   kmutex_unlock(&p->mutex);
+   return rc;
+}
 
-      if (rc)
-         break; /* Everything is alright, we wrote something */
+static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct pipe *p = get_pipe(h);
+   ssize_t rc;
+   ASSERT(*pos == 0);
 
-      if (kh->fl_flags & O_NONBLOCK) {
-         rc = -EAGAIN;
-         break;
-      }
+   if (!size)
+      return 0;
 
-      /* Wait for readers to empty the buffer */
-      kcond_wait(&p->not_full_cond, &p->mutex, KCOND_WAIT_FOREVER);
+   kmutex_lock(&p->mutex);
+   {
+      if (!(rc = pipe_wait_space(p, is_nonblock(h), false))) {
 
-      /* After wake up */
-      if (pending_signals()) {
-         sig_pending = true;
-         break;
+         if (!(rc = (ssize_t)pipe_write_bytes(p, buf, size)))
+            rc = -ENOMEM;
       }
-   }
 
-   /*
-    * Wake up one blocked reader, instead of all of them.
-    * See the comments in pipe_read() above.
-    */
-   kcond_signal_one(&p->not_empty_cond);
-
-   if (!ringbuf_is_full(&p->rb)) {
-      /* The buffer is not full: wake up one more writer, if any */
-      kcond_signal_one(&p->not_full_cond);
+      pipe_wake_up_after_write(p);
    }
-
-   /* Unlock the pipe's state lock and return */
    kmutex_unlock(&p->mutex);
-   return !sig_pending ? rc : -EINTR;
+   return rc;
 }
 
 static int pipe_read_ready(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    bool ret;
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_empty(&p->rb) ||
+      ret = !pipe_is_empty(p) ||
             atomic_load_explicit(&p->write_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -167,20 +354,18 @@ static int pipe_read_ready(fs_handle h)
 
 static struct kcond *pipe_get_rready_cond(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    return &p->not_empty_cond;
 }
 
 static int pipe_write_ready(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    bool ret;
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_full(&p->rb) ||
+      ret = !pipe_is_full(p) ||
             atomic_load_explicit(&p->read_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -189,15 +374,13 @@ static int pipe_write_ready(fs_handle h)
 
 static struct kcond *pipe_get_wready_cond(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    return &p->not_full_cond;
 }
 
 static int pipe_except_ready(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    int ret = 0;
 
    kmutex_lock(&p->mutex);
@@ -214,8 +397,7 @@ static int pipe_except_ready(fs_handle h)
 
 static struct kcond *pipe_get_except_cond(fs_handle h)
 {
-   struct kfs_handle *kh = h;
-   struct pipe *p = (void *)kh->kobj;
+   struct pipe *p = get_pipe(h);
    return &p->err_cond;
 }
 
@@ -237,15 +419,486 @@ static const struct file_ops static_ops_pipe_write_end =
    .get_except_cond = pipe_get_except_cond,
 };
 
+bool is_pipe_read_end(fs_handle h)
+{
+   return ((struct fs_handle_base *)h)->fops == &static_ops_pipe_read_end;
+}
+
+bool is_pipe_write_end(fs_handle h)
+{
+   return ((struct fs_handle_base *)h)->fops == &static_ops_pipe_write_end;
+}
+
+/*
+ * F_GETPIPE_SZ: returns the capacity of the pipe, in bytes.
+ */
+int pipe_get_size(fs_handle h)
+{
+   struct pipe *p = get_pipe(h);
+   int ret;
+
+   ASSERT(is_pipe_read_end(h) || is_pipe_write_end(h));
+
+   kmutex_lock(&p->mutex);
+   {
+      ret = (int)(p->bufs_count * PAGE_SIZE);
+   }
+   kmutex_unlock(&p->mutex);
+   return ret;
+}
+
+/*
+ * F_SETPIPE_SZ: resize the ring of the pipe, so that it can contain at least
+ * `size` bytes. Returns the new capacity of the pipe, in bytes.
+ */
+int pipe_set_size(fs_handle h, ulong size)
+{
+   struct pipe *p = get_pipe(h);
+   struct pipe_buf *new_bufs, *old_bufs;
+   u32 count, old_count;
+   int rc;
+
+   ASSERT(is_pipe_read_end(h) || is_pipe_write_end(h));
+
+   if (size > INT32_MAX - PAGE_SIZE)
+      return -EINVAL;
+
+   size = pow2_round_up_at(MAX(size, PAGE_SIZE), PAGE_SIZE);
+
+   if (size > pipe_max_size)
+      return -EPERM;
+
+   count = (u32)(size / PAGE_SIZE);
+
+   if (!(new_bufs = kzalloc_array_obj(struct pipe_buf, count)))
+      return -ENOMEM;
+
+   kmutex_lock(&p->mutex);
+
+   if (p->used > count) {
+      rc = -EBUSY; /* Same as Linux: the data in the pipe must fit */
+      goto out;
+   }
+
+   for (u32 i = 0; i < p->used; i++)
+      new_bufs[i] = *pipe_buf_at(p, i);
+
+   old_bufs = p->bufs;
+   old_count = p->bufs_count;
+   p->bufs = new_bufs;
+   p->bufs_count = count;
+   p->head = 0;
+
+   new_bufs = old_bufs;
+   count = old_count;
+   rc = (int)(p->bufs_count * PAGE_SIZE);
+
+   /* The pipe might have grown: wake up the blocked writers */
+   kcond_signal_all(&p->not_full_cond);
+
+out:
+   kmutex_unlock(&p->mutex);
+
+   /* Free the old ring or, in case of failure, the unused new one */
+   kfree_array_obj(new_bufs, struct pipe_buf, count);
+   return rc;
+}
+
+/* ------------------- splice(), tee() and vmsplice() ---------------------- */
+
+/*
+ * splice_read() callback used to fill a pipe. It's called without the pipe's
+ * mutex held, possibly with the source file's locks held: that's why it never
+ * blocks. It returns a short count or -EAGAIN when the pipe is full.
+ */
+static ssize_t
+pipe_splice_in_cb(void *arg, char *buf, size_t len, bool page_ref)
+{
+   struct pipe *p = arg;
+   char *page;
+   ssize_t rc = 0;
+
+   kmutex_lock(&p->mutex);
+   {
+      if (page_ref) {
+
+         if (pipe_has_free_buf(p)) {
+            page = (char *)((ulong)buf & PAGE_MASK);
+            retain_kernel_page(page);
+            pipe_push_buf(p, page, (size_t)(buf - page), len, 0);
+            rc = (ssize_t)len;
+         }
+
+      } else {
+
+         rc = (ssize_t)pipe_write_bytes(p, buf, len);
+      }
+
+      if (rc > 0)
+         pipe_wake_up_after_write(p);
+      else
+         rc = pipe_is_full(p) ? -EAGAIN : -ENOMEM;
+   }
+   kmutex_unlock(&p->mutex);
+   return rc;
+}
+
+/*
+ * Move up to `len` bytes from the file `in` to the pipe `wh`. Files
+ * implementing splice_read() pass their pages by reference, while the data of
+ * all the other files is copied in the pipe.
+ */
+ssize_t
+pipe_splice_in(fs_handle wh, fs_handle in, offt *pos, size_t len, bool nb)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *hin = in;
+   struct pipe *p = get_pipe(wh);
+   ssize_t rc;
+
+   ASSERT(is_pipe_write_end(wh));
+   nb = nb || is_nonblock(wh);
+
+   if (hin->fops->splice_read) {
+
+      do {
+
+         kmutex_lock(&p->mutex);
+         {
+            rc = pipe_wait_space(p, nb, true);
+         }
+         kmutex_unlock(&p->mutex);
+
+         if (rc)
+            return rc;
+
+         rc = hin->fops->splice_read(in, len, pos, pipe_splice_in_cb, p);
+
+         /* Other writers might have filled up the pipe in the meanwhile */
+      } while (rc == -EAGAIN && !nb);
+
+      return rc;
+   }
+
+   /*
+    * Generic case: read in our bounce buffer and then copy in the pipe, no
+    * more than what the pipe can take now, in order to not lose data.
+    */
+   kmutex_lock(&p->mutex);
+   {
+      if (!(rc = pipe_wait_space(p, nb, false)))
+         len = MIN3(len, pipe_free_space(p), IO_COPYBUF_SIZE);
+   }
+   kmutex_unlock(&p->mutex);
+
+   if (rc)
+      return rc;
+
+   if ((rc = hin->fops->read(in, curr->io_copybuf, len, pos)) <= 0)
+      return rc;
+
+   return pipe_splice_in_cb(p, curr->io_copybuf, (size_t)rc, false);
+}
+
+/*
+ * Move up to `len` bytes from the pipe `rh` to the file `out`. The data
+ * is written in `out` directly from the pipe's pages.
+ */
+ssize_t
+pipe_splice_out(fs_handle rh, fs_handle out, offt *pos, size_t len, bool nb)
+{
+   struct fs_handle_base *hout = out;
+   struct pipe *p = get_pipe(rh);
+   struct pipe_buf *b;
+   ssize_t rc, wrc;
+   size_t n;
+
+   ASSERT(is_pipe_read_end(rh));
+   nb = nb || is_nonblock(rh);
+
+   kmutex_lock(&p->mutex);
+
+   if ((rc = pipe_wait_data(p, nb)) > 0) {
+
+      rc = 0;
+
+      while ((size_t)rc < len && !pipe_is_empty(p)) {
+
+         b = &p->bufs[p->head];
+         n = MIN(len - (size_t)rc, b->len);
+         wrc = hout->fops->write(out, b->page + b->off, n, pos);
+
+         if (wrc <= 0) {
+            rc = rc ? rc : wrc;
+            break;
+         }
+
+         pipe_consume(p, b, (size_t)wrc);
+         rc += wrc;
+
+         if ((size_t)wrc < n)
+            break;
+      }
+   }
+
+   pipe_wake_up_after_read(p);
+   kmutex_unlock(&p->mutex);
+   return rc;
+}
+
+static void pipe_lock_both(struct pipe *a, struct pipe *b)
+{
+   /* Always lock the pipes in the same order, in order to avoid deadlocks */
+   if (a < b) {
+      kmutex_lock(&a->mutex);
+      kmutex_lock(&b->mutex);
+   } else {
+      kmutex_lock(&b->mutex);
+      kmutex_lock(&a->mutex);
+   }
+}
+
+static void pipe_unlock_both(struct pipe *a, struct pipe *b)
+{
+   kmutex_unlock(&a->mutex);
+   kmutex_unlock(&b->mutex);
+}
+
+static size_t
+pipe_move_bufs(struct pipe *in, struct pipe *out, size_t len, bool dup)
+{
+   struct pipe_buf *b;
+   size_t tot = 0;
+   size_t n;
+
+   for (u32 i = 0; tot < len && i < in->used && pipe_has_free_buf(out); ) {
+
+      b = dup ? pipe_buf_at(in, i++) : &in->bufs[in->head];
+      n = MIN(len - tot, b->len);
+
+      retain_kernel_page(b->page);
+      pipe_push_buf(out, b->page, b->off, n, 0);
+      tot += n;
+
+      if (!dup)
+         pipe_consume(in, b, n);
+   }
+
+   return tot;
+}
+
+/*
+ * Move (or duplicate, when `dup` is true) up to `len` bytes from a pipe to
+ * another one, without copying the data: only page references are moved.
+ */
+ssize_t
+pipe_splice_pipe(fs_handle rh, fs_handle wh, size_t len, bool nb, bool dup)
+{
+   struct pipe *in = get_pipe(rh);
+   struct pipe *out = get_pipe(wh);
+   const bool in_nb = nb || is_nonblock(rh);
+   const bool out_nb = nb || is_nonblock(wh);
+   ssize_t rc;
+
+   ASSERT(is_pipe_read_end(rh));
+   ASSERT(is_pipe_write_end(wh));
+
+   if (in == out)
+      return -EINVAL;
+
+   while (true) {
+
+      kmutex_lock(&in->mutex);
+      {
+         rc = pipe_wait_data(in, in_nb);
+      }
+      kmutex_unlock(&in->mutex);
+
+      if (rc <= 0)
+         return rc;
+
+      kmutex_lock(&out->mutex);
+      {
+         rc = pipe_wait_space(out, out_nb, true);
+      }
+      kmutex_unlock(&out->mutex);
+
+      if (rc < 0)
+         return rc;
+
+      pipe_lock_both(in, out);
+      {
+         rc = (ssize_t)pipe_move_bufs(in, out, len, dup);
+
+         if (rc > 0) {
+
+            if (!dup)
+               pipe_wake_up_after_read(in);
+
+            pipe_wake_up_after_write(out);
+         }
+      }
+      pipe_unlock_both(in, out);
+
+      if (rc > 0)
+         return rc;
+
+      /*
+       * Other readers emptied the input pipe or other writers filled up the
+       * output one, after we checked. Just try again.
+       */
+   }
+}
+
+static ssize_t
+pipe_vmsplice_chunk(struct pipe *p, void *user_va, size_t len, bool nb)
+{
+   struct task *curr = get_curr_task();
+   const bool by_ref = IS_PAGE_ALIGNED(user_va) && len == PAGE_SIZE;
+   char *page = NULL;
+   ssize_t rc;
+
+   ASSERT(len <= PAGE_SIZE);
+
+   if (by_ref) {
+
+      /* Whole user pages are shared with the pipe, as CoW pages */
+      disable_preemption();
+      {
+         page = user_page_share_cow(curr->pi->pdir, user_va);
+      }
+      enable_preemption();
+   }
+
+   if (!page && copy_from_user(curr->io_copybuf, user_va, len))
+      return -EFAULT;
+
+   kmutex_lock(&p->mutex);
+   {
+      if (!(rc = pipe_wait_space(p, nb, !!page))) {
+
+         if (page) {
+            pipe_push_buf(p, page, 0, len, 0);
+            page = NULL;
+            rc = (ssize_t)len;
+         } else {
+            rc = (ssize_t)pipe_write_bytes(p, curr->io_copybuf, len);
+            rc = rc ? rc : -ENOMEM;
+         }
+
+         pipe_wake_up_after_write(p);
+      }
+   }
+   kmutex_unlock(&p->mutex);
+
+   if (page)
+      release_kernel_page(page);
+
+   return rc;
+}
+
+/*
+ * vmsplice() on the write end of a pipe: copy the user data in the pipe, or
+ * share with it the whole, page-aligned, user pages. The `iov` array is in
+ * kernel memory, while the buffers it points to are in user space.
+ */
+ssize_t
+pipe_vmsplice_in(fs_handle wh, const struct iovec *iov, int iovcnt, bool nb)
+{
+   struct pipe *p = get_pipe(wh);
+   ssize_t tot = 0;
+   ssize_t rc = 0;
+   size_t rem, n;
+   ulong va;
+
+   ASSERT(is_pipe_write_end(wh));
+   nb = nb || is_nonblock(wh);
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      va = (ulong)iov[i].iov_base;
+      rem = iov[i].iov_len;
+
+      while (rem > 0) {
+
+         /* Never cross a page boundary */
+         n = MIN(rem, PAGE_SIZE - (va & OFFSET_IN_PAGE_MASK));
+
+         /* After having moved some data, don't block anymore */
+         if ((rc = pipe_vmsplice_chunk(p, TO_PTR(va), n, nb || tot)) <= 0)
+            goto out;
+
+         tot += rc;
+         va += (ulong)rc;
+         rem -= (size_t)rc;
+
+         if ((size_t)rc < n)
+            goto out;
+      }
+   }
+
+out:
+   return tot ? tot : rc;
+}
+
+/*
+ * vmsplice() on the read end of a pipe: copy the pipe's data directly to the
+ * user buffers described by `iov`, which is in kernel memory.
+ */
+ssize_t
+pipe_vmsplice_out(fs_handle rh, const struct iovec *iov, int iovcnt, bool nb)
+{
+   struct pipe *p = get_pipe(rh);
+   struct pipe_buf *b;
+   ssize_t tot = 0;
+   ssize_t rc;
+   size_t n, done;
+
+   ASSERT(is_pipe_read_end(rh));
+   nb = nb || is_nonblock(rh);
+
+   kmutex_lock(&p->mutex);
+
+   if ((rc = pipe_wait_data(p, nb)) <= 0)
+      goto out;
+
+   for (int i = 0; i < iovcnt && !pipe_is_empty(p); i++) {
+
+      for (done = 0; done < iov[i].iov_len && !pipe_is_empty(p); done += n) {
+
+         b = &p->bufs[p->head];
+         n = MIN(iov[i].iov_len - done, b->len);
+
+         if (copy_to_user((char *)iov[i].iov_base + done, b->page + b->off, n))
+         {
+            rc = -EFAULT;
+            goto out;
+         }
+
+         pipe_consume(p, b, n);
+         tot += n;
+      }
+   }
+
+out:
+   pipe_wake_up_after_read(p);
+   kmutex_unlock(&p->mutex);
+   return tot ? tot : rc;
+}
+
+/* ------------------------------------------------------------------------- */
+
 void destroy_pipe(struct pipe *p)
 {
+   while (!pipe_is_empty(p))
+      pipe_consume(p, &p->bufs[p->head], p->bufs[p->head].len);
+
    kcond_destory(&p->err_cond);
    kcond_destory(&p->not_empty_cond);
    kcond_destory(&p->not_full_cond);
    kmutex_destroy(&p->mutex);
-   ringbuf_destory(&p->rb);
-   kfree2(p->buf, PIPE_BUF_SIZE);
-   kfree_obj(p, struct pipe);
+   kfree_array_obj(p->bufs, struct pipe_buf, p->bufs_count);
+   kmem_cache_free(&pipe_cache, p);
 }
 
 static void pipe_on_handle_close(fs_handle h)
@@ -285,18 +938,19 @@ struct pipe *create_pipe(void)
 {
    struct pipe *p;
 
-   if (!(p = (void *)kzalloc_obj(struct pipe)))
+   if (!(p = kmem_cache_zalloc(&pipe_cache)))
       return NULL;
 
-   if (!(p->buf = kmalloc(PIPE_BUF_SIZE))) {
-      kfree_obj(p, struct pipe);
+   p->bufs_count = PIPE_DEF_BUFS;
+
+   if (!(p->bufs = kzalloc_array_obj(struct pipe_buf, p->bufs_count))) {
+      kmem_cache_free(&pipe_cache, p);
       return NULL;
    }
 
    p->on_handle_close = &pipe_on_handle_close;
    p->on_handle_dup = &pipe_on_handle_dup;
    p->destory_obj = (void *)&destroy_pipe;
-   ringbuf_init(&p->rb, PIPE_BUF_SIZE, 1, p->buf);
    kmutex_init(&p->mutex, 0);
    kcond_init(&p->not_full_cond);
    kcond_init(&p->not_empty_cond);
@@ -9,6 +9,7 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 
 static int
 poll_count_conds(struct pollfd *fds, nfds_t nfds)
@@ -155,6 +156,12 @@ poll_count_ready_fds(struct pollfd *fds, nfds_t nfds)
    return cnt;
 }
 
+static u64
+poll_timeout_to_deadline(int timeout_ms)
+{
+   return hrtimer_expiry_in((u64)timeout_ms * (TS_SCALE / 1000));
+}
+
 static int
 poll_wait_on_cond(struct pollfd *fds, nfds_t nfds, int timeout, int cond_cnt)
 {
@@ -173,10 +180,8 @@ poll_wait_on_cond(struct pollfd *fds, nfds_t nfds, int timeout, int cond_cnt)
       return ready_fds_cnt;
    }
 
-   if (timeout > 0) {
-      u32 ticks = MAX((u32)timeout / (1000 / TIMER_HZ), 1u);
-      task_set_wakeup_timer(curr, ticks);
-   }
+   if (timeout > 0)
+      task_set_wakeup_hrtimer(curr, poll_timeout_to_deadline(timeout));
 
    while (true) {
 
@@ -225,8 +230,13 @@ poll_wait_on_cond(struct pollfd *fds, nfds_t nfds, int timeout, int cond_cnt)
 
    free_mobj_waiter(waiter);
 
-   if (pending_signals())
+   if (pending_signals()) {
+
+      if (timeout > 0)
+         task_cancel_wakeup_timer(curr);
+
       return -EINTR;
+   }
 
    return ready_fds_cnt;
 }
@@ -265,7 +275,7 @@ int sys_poll(struct pollfd *user_fds, nfds_t nfds, int timeout)
    } else {
 
       if (timeout > 0) {
-         kernel_sleep((u64)timeout / (1000 / TIMER_HZ));
+         kernel_sleep_until(poll_timeout_to_deadline(timeout));
 
          if (pending_signals())
             return -EINTR;
@@ -2,6 +2,7 @@
 
 #include <tilck_gen_headers/config_debug.h>
 #include <tilck_gen_headers/mod_debugpanel.h>
+#include <tilck_gen_headers/config_mm.h>
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
@@ -12,14 +13,24 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/kmem_cache.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/fs/vfs.h>
 
 #include <sys/prctl.h>        // system header
+#include <sys/resource.h>     // system header
 
 STATIC_ASSERT(IS_PAGE_ALIGNED(KERNEL_STACK_SIZE));
+
+/* Main threads: struct task immediately followed by its struct process */
+static struct kmem_cache proc_cache =
+   KMEM_CACHE_INIT("process", TOT_PROC_AND_TASK_SIZE, NULL);
+
+/* All the other threads: struct task only */
+static struct kmem_cache task_cache =
+   KMEM_CACHE_INIT("task", sizeof(struct task), NULL);
 STATIC_ASSERT(IS_PAGE_ALIGNED(IO_COPYBUF_SIZE));
 STATIC_ASSERT(IS_PAGE_ALIGNED(ARGS_COPYBUF_SIZE));
 
@@ -136,9 +147,6 @@ void process_free_mappings_info(struct process *pi)
    struct mappings_info *mi = pi->mi;
 
    if (mi) {
-      ASSERT(mi->mmap_heap);
-      kmalloc_destroy_heap(mi->mmap_heap);
-      kfree2(mi->mmap_heap, kmalloc_get_heap_struct_size());
       kfree_obj(mi, struct mappings_info);
       pi->mi = NULL;
    }
@@ -146,8 +154,9 @@ void process_free_mappings_info(struct process *pi)
 
 void free_common_task_allocs(struct task *ti)
 {
-   struct process *pi = ti->pi;
-   process_free_mappings_info(pi);
+   /* The mappings belong to the process: other threads must not free them */
+   if (is_main_thread(ti))
+      process_free_mappings_info(ti->pi);
 
    free_kernel_stack(ti);
    kfree2(ti->io_copybuf, IO_COPYBUF_SIZE + ARGS_COPYBUF_SIZE);
@@ -171,6 +180,12 @@ void free_mem_for_zombie_task(struct task *ti)
 
    free_common_task_allocs(ti);
 
+   if (!is_main_thread(ti) && !is_kernel_thread(ti)) {
+      /* Nobody waits for user threads: they are reaped immediately */
+      remove_task(ti);
+      return;
+   }
+
    if (ti->pi->automatic_reaping) {
       /* The SIGCHLD signal has been EXPLICITLY ignored by the parent */
       remove_task(ti);
@@ -180,9 +195,12 @@ void free_mem_for_zombie_task(struct task *ti)
 void init_task_lists(struct task *ti)
 {
    bintree_node_init(&ti->tree_by_tid_node);
+   bintree_node_init(&ti->runnable_tree_node);
    list_node_init(&ti->runnable_node);
    list_node_init(&ti->wakeup_timer_node);
    list_node_init(&ti->siblings_node);
+   list_node_init(&ti->thread_node);
+   hrtimer_init(&ti->wakeup_hrtimer, NULL);
 
    list_init(&ti->tasks_waiting_list);
    list_init(&ti->on_exit);
@@ -192,6 +210,7 @@ void init_task_lists(struct task *ti)
 void init_process_lists(struct process *pi)
 {
    list_init(&pi->children);
+   list_init(&pi->threads);
    kmutex_init(&pi->fslock, KMUTEX_FL_RECURSIVE);
 }
 
@@ -203,7 +222,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    bool common_allocs = false;
    bool arch_fields = false;
 
-   if (UNLIKELY(!(ti = kmalloc(TOT_PROC_AND_TASK_SIZE))))
+   if (UNLIKELY(!(ti = kmem_cache_alloc(&proc_cache))))
       goto oom_case;
 
    pi = (struct process *)(ti + 1);
@@ -235,6 +254,9 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    pi->cwd.fs = NULL;
    pi->vforked = false;
    pi->inherited_mmap_heap = false;
+   pi->group_exit = false;
+   pi->dead_threads_ticks = 0;
+   pi->dead_threads_ticks_kernel = 0;
 
    if (new_pdir != parent_pi->pdir) {
 
@@ -248,6 +270,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
 
    } else {
       pi->vforked = true;
+      pi->vfork_parent_tid = parent->tid;
       pi->inherited_mmap_heap = !!pi->mi;
    }
 
@@ -255,6 +278,8 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    ti->tid = pid;
    ti->is_main_thread = true;
    ti->timer_ready = false;
+   ti->clear_child_tid = NULL;
+   ti->robust_list = NULL;
 
    /*
     * From fork(2):
@@ -306,7 +331,7 @@ oom_case:
       if (MOD_debugpanel && pi->debug_cmdline)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
 
-      kfree2(ti, TOT_PROC_AND_TASK_SIZE);
+      kmem_cache_free(&proc_cache, ti);
    }
 
    return NULL;
@@ -316,14 +341,14 @@ struct task *allocate_new_thread(struct process *pi, int tid, bool alloc_bufs)
 {
    ASSERT(pi != NULL);
    struct task *process_task = get_process_task(pi);
-   struct task *ti = kzalloc_obj(struct task);
+   struct task *ti = kmem_cache_zalloc(&task_cache);
 
    if (!ti || !(ti->pi = pi) || !do_common_task_allocs(ti, alloc_bufs)) {
 
       if (ti) /* do_common_task_allocs() failed */
          free_common_task_allocs(ti);
 
-      kfree_obj(ti, struct task);
+      kmem_cache_free(&task_cache, ti);
       return NULL;
    }
 
@@ -331,7 +356,13 @@ struct task *allocate_new_thread(struct process *pi, int tid, bool alloc_bufs)
    ti->is_main_thread = false;
 
    init_task_lists(ti);
-   arch_specific_new_task_setup(ti, process_task);
+
+   if (!arch_specific_new_task_setup(ti, process_task)) {
+      free_common_task_allocs(ti);
+      kmem_cache_free(&task_cache, ti);
+      return NULL;
+   }
+
    return ti;
 }
 
@@ -339,23 +370,23 @@ static void free_process_int(struct process *pi)
 {
    ASSERT(get_ref_count(pi) > 0);
 
-   if (LIKELY(pi->cwd.fs != NULL)) {
+   if (release_obj(pi) == 0) {
 
-      /*
-       * When we change the current directory or when we fork a process, we
-       * set a new value for the struct vfs_path pi->cwd which has its inode
-       * retained as well as its owning fs. Here we have to release those
-       * ref-counts.
-       */
+      if (LIKELY(pi->cwd.fs != NULL)) {
 
-      vfs_release_inode_at(&pi->cwd);
-      release_obj(pi->cwd.fs);
-   }
+         /*
+          * When we change the current directory or when we fork a process, we
+          * set a new value for the struct vfs_path pi->cwd which has its inode
+          * retained as well as its owning fs. Here we have to release those
+          * ref-counts.
+          */
 
-   if (release_obj(pi) == 0) {
+         vfs_release_inode_at(&pi->cwd);
+         release_obj(pi->cwd.fs);
+      }
 
       arch_specific_free_proc(pi);
-      kfree2(get_process_task(pi), TOT_PROC_AND_TASK_SIZE);
+      kmem_cache_free(&proc_cache, get_process_task(pi));
 
       if (MOD_debugpanel)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
@@ -373,10 +404,45 @@ void free_task(struct task *ti)
 
    list_remove(&ti->siblings_node);
 
-   if (is_main_thread(ti))
+   if (is_main_thread(ti)) {
+
       free_process_int(ti->pi);
-   else
-      kfree_obj(ti, struct task);
+
+   } else if (is_kernel_thread(ti)) {
+
+      kmem_cache_free(&task_cache, ti);
+
+   } else {
+
+      /* User thread: drop the reference to the process taken by clone() */
+      struct process *pi = ti->pi;
+      kmem_cache_free(&task_cache, ti);
+      free_process_int(pi);
+   }
+}
+
+/*
+ * Get the total and the kernel ticks of the whole process: the sum of the ticks
+ * of all its threads, including the ones already dead.
+ */
+void process_get_ticks(struct process *pi, u64 *total, u64 *total_kernel)
+{
+   struct task *main_ti = get_process_task(pi);
+   struct task *pos;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      *total = main_ti->ticks.total + pi->dead_threads_ticks;
+      *total_kernel = main_ti->ticks.total_kernel;
+      *total_kernel += pi->dead_threads_ticks_kernel;
+
+      list_for_each_ro(pos, &pi->threads, thread_node) {
+         *total += pos->ticks.total;
+         *total_kernel += pos->ticks.total_kernel;
+      }
+   }
+   enable_interrupts(&var);
 }
 
 void *task_temp_kernel_alloc(size_t size)
@@ -535,7 +601,7 @@ unblock_parent_of_vforked_child(struct process *pi)
 
    ASSERT(!is_preemption_enabled());
    ASSERT(pi->vforked);
-   parent = get_task(pi->parent_pid);
+   parent = get_task(pi->vfork_parent_tid);
 
    ASSERT(parent != NULL);
    ASSERT(parent->stopped);
@@ -551,7 +617,7 @@ vforked_child_transfer_dispose_mi(struct process *pi)
    struct task *parent;
    ASSERT(pi->vforked);
 
-   parent = get_task(pi->parent_pid);
+   parent = get_task(pi->vfork_parent_tid);
 
    if (!pi->inherited_mmap_heap) {
 
@@ -711,6 +777,156 @@ int sys_getpgrp(void)
    return get_curr_proc()->pgid;
 }
 
+/*
+ * Only RLIMIT_STACK can actually be changed. Its limits are stored as ulong
+ * values, where ULONG_MAX means RLIM_INFINITY, and the stack never grows
+ * beyond USER_STACK_MAX_SZ, whatever the soft limit is. All the other limits
+ * are fixed: RLIMIT_NOFILE is MAX_HANDLES, while the rest is unlimited.
+ */
+
+static ALWAYS_INLINE u64 stack_rlim_to_u64(ulong val)
+{
+   return val == ULONG_MAX ? K_RLIM_INFINITY : val;
+}
+
+static ALWAYS_INLINE ulong stack_rlim_from_u64(u64 val)
+{
+   return (ulong)MIN(val, (u64)ULONG_MAX);
+}
+
+static int
+get_rlimit(struct process *pi, int res, struct k_rlimit64 *lim)
+{
+   if (res < 0 || res >= K_RLIMIT_NLIMITS)
+      return -EINVAL;
+
+   switch (res) {
+
+      case RLIMIT_STACK:
+         *lim = (struct k_rlimit64) {
+            stack_rlim_to_u64(pi->stack_rlim_cur),
+            stack_rlim_to_u64(pi->stack_rlim_max),
+         };
+         break;
+
+      case RLIMIT_NOFILE:
+         *lim = (struct k_rlimit64) { MAX_HANDLES, MAX_HANDLES };
+         break;
+
+      default:
+         *lim = (struct k_rlimit64) { K_RLIM_INFINITY, K_RLIM_INFINITY };
+         break;
+   }
+
+   return 0;
+}
+
+static int
+set_rlimit(struct process *pi, int res, const struct k_rlimit64 *lim)
+{
+   struct k_rlimit64 curr;
+   int rc;
+
+   if ((rc = get_rlimit(pi, res, &curr)))
+      return rc;
+
+   if (lim->rlim_cur > lim->rlim_max)
+      return -EINVAL;
+
+   if (res != RLIMIT_STACK) {
+
+      if (lim->rlim_cur != curr.rlim_cur || lim->rlim_max != curr.rlim_max)
+         return -EPERM; /* Not supported */
+
+      return 0;
+   }
+
+   /*
+    * All the processes run as root in Tilck: like on Linux, they're allowed
+    * to raise the hard limit as well.
+    */
+   pi->stack_rlim_cur = stack_rlim_from_u64(lim->rlim_cur);
+   pi->stack_rlim_max = stack_rlim_from_u64(lim->rlim_max);
+   return 0;
+}
+
+int sys_prlimit64(int pid,
+                  int res,
+                  const struct k_rlimit64 *user_new_lim,
+                  struct k_rlimit64 *user_old_lim)
+{
+   struct k_rlimit64 new_lim, old_lim;
+   struct process *pi;
+   int rc = 0;
+
+   if (user_new_lim) {
+      if (copy_from_user(&new_lim, user_new_lim, sizeof(new_lim)))
+         return -EFAULT;
+   }
+
+   disable_preemption();
+   {
+      pi = pid ? get_process(pid) : get_curr_proc();
+
+      if (!pi) {
+         rc = -ESRCH;
+      } else {
+
+         rc = get_rlimit(pi, res, &old_lim);
+
+         if (!rc && user_new_lim)
+            rc = set_rlimit(pi, res, &new_lim);
+      }
+   }
+   enable_preemption();
+
+   if (rc)
+      return rc;
+
+   if (user_old_lim) {
+      if (copy_to_user(user_old_lim, &old_lim, sizeof(old_lim)))
+         return -EFAULT;
+   }
+
+   return 0;
+}
+
+int sys_getrlimit(int res, struct k_rlimit *user_lim)
+{
+   struct k_rlimit64 lim64;
+   struct k_rlimit lim;
+   int rc;
+
+   if ((rc = get_rlimit(get_curr_proc(), res, &lim64)))
+      return rc;
+
+   lim = (struct k_rlimit) {
+      .rlim_cur = (ulong)MIN(lim64.rlim_cur, (u64)ULONG_MAX),
+      .rlim_max = (ulong)MIN(lim64.rlim_max, (u64)ULONG_MAX),
+   };
+
+   if (copy_to_user(user_lim, &lim, sizeof(lim)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_setrlimit(int res, const struct k_rlimit *user_lim)
+{
+   struct k_rlimit64 lim64;
+   struct k_rlimit lim;
+
+   if (copy_from_user(&lim, user_lim, sizeof(lim)))
+      return -EFAULT;
+
+   lim64 = (struct k_rlimit64) {
+      .rlim_cur = lim.rlim_cur == ULONG_MAX ? K_RLIM_INFINITY : lim.rlim_cur,
+      .rlim_max = lim.rlim_max == ULONG_MAX ? K_RLIM_INFINITY : lim.rlim_max,
+   };
+
+   return set_rlimit(get_curr_proc(), res, &lim64);
+}
+
 int sys_prctl(int option, ulong a2, ulong a3, ulong a4, ulong a5)
 {
    // TODO: actually implement sys_prctl()
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck_gen_headers/config_mm.h>
+
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/string_util.h>
 
@@ -20,8 +22,18 @@ ATOMIC(int) __need_resched;               /* see docs/atomics.md */
 struct task *kernel_process;
 struct process *kernel_process_pi;
 
-/* Task lists */
-struct list runnable_tasks_list;
+/*
+ * Runnable tasks
+ *
+ * Regular runnable tasks live in an AVL tree ordered by vruntime, with a cached
+ * pointer to its leftmost (lowest vruntime) element, which is the next task to
+ * run. Tasks just woken up by their wakeup timer have always precedence over
+ * the rest and are kept instead in a FIFO list, because they need no ordering.
+ * The idle task is never part of either of them: it's just the fall-back.
+ */
+static struct task *runnable_tree_root;
+static struct task *runnable_tree_first;
+static struct list timer_ready_tasks_list;
 
 /* Static variables */
 static struct task *tree_by_tid_root;
@@ -116,7 +128,7 @@ int sched_count_proc_in_group(int pgid)
 
       while ((ti = bintree_in_order_visit_next(&ctx))) {
 
-         if (ti->pi->pgid == pgid)
+         if (ti->pi->pgid == pgid && is_main_thread(ti))
             count++;
       }
    }
@@ -378,7 +390,18 @@ static void idle(void)
       ASSERT(is_preemption_enabled());
 
       idle_ticks++;
-      halt();
+
+      /*
+       * Check for pending work with the interrupts disabled and then enable
+       * them and halt atomically: otherwise, with the periodic ticks stopped,
+       * we might sleep for a long time after missing a wake-up.
+       */
+      disable_interrupts_forced();
+
+      if (!need_reschedule() && runnable_tasks_count <= 1)
+         nohz_idle_enter();
+
+      safe_halt();
 
       if (need_reschedule() || runnable_tasks_count > 1)
          schedule();
@@ -403,7 +426,7 @@ static void create_kernel_process(void)
    struct task *s_kernel_ti = (struct task *)kernel_proc_buf;
    struct process *s_kernel_pi = (struct process *)(s_kernel_ti + 1);
 
-   list_init(&runnable_tasks_list);
+   list_init(&timer_ready_tasks_list);
    s_kernel_pi->pid = create_new_pid();
    s_kernel_ti->tid = create_new_kernel_tid();
    s_kernel_pi->ref_count = 1;
@@ -415,6 +438,10 @@ static void create_kernel_process(void)
    s_kernel_ti->running_in_kernel = true;
    memcpy(s_kernel_pi->str_cwd, "/", 2);
 
+   /* Inherited by all the user processes */
+   s_kernel_pi->stack_rlim_cur = USER_STACK_PAGES * PAGE_SIZE;
+   s_kernel_pi->stack_rlim_max = USER_STACK_MAX_SZ;
+
    s_kernel_ti->state = TASK_STATE_SLEEPING;
 
    kernel_process = s_kernel_ti;
@@ -444,6 +471,115 @@ void process_set_tty(struct process *pi, void *t)
    pi->proc_tty = t;
 }
 
+static long runnable_tree_cmp(const void *a, const void *b)
+{
+   const struct task *t1 = a;
+   const struct task *t2 = b;
+
+   if (t1->ticks.vruntime != t2->ticks.vruntime)
+      return t1->ticks.vruntime < t2->ticks.vruntime ? -1 : 1;
+
+   /* Equal vruntime: use the tid as a tie-breaker, keys must be unique */
+   return (long)t1->tid - (long)t2->tid;
+}
+
+static void runnable_tree_insert(struct task *ti)
+{
+   DEBUG_ONLY_UNSAFE(bool success =)
+      bintree_insert(&runnable_tree_root,
+                     ti,
+                     runnable_tree_cmp,
+                     struct task,
+                     runnable_tree_node);
+
+   ASSERT(success);
+
+   if (!runnable_tree_first || runnable_tree_cmp(ti, runnable_tree_first) < 0)
+      runnable_tree_first = ti;
+}
+
+static void runnable_tree_remove(struct task *ti)
+{
+   DEBUG_ONLY_UNSAFE(void *removed =)
+      bintree_remove(&runnable_tree_root,
+                     ti,
+                     runnable_tree_cmp,
+                     struct task,
+                     runnable_tree_node);
+
+   ASSERT(removed == ti);
+   bintree_node_init(&ti->runnable_tree_node);
+
+   if (ti == runnable_tree_first) {
+      runnable_tree_first = bintree_get_first_obj(runnable_tree_root,
+                                                  struct task,
+                                                  runnable_tree_node);
+   }
+}
+
+static void runnable_enqueue(struct task *ti)
+{
+   if (ti == idle_task)
+      return;
+
+   if (ti->timer_ready)
+      list_add_tail(&timer_ready_tasks_list, &ti->runnable_node);
+   else
+      runnable_tree_insert(ti);
+}
+
+static void runnable_dequeue(struct task *ti)
+{
+   if (ti == idle_task)
+      return;
+
+   if (list_is_node_in_list(&ti->runnable_node)) {
+      list_remove(&ti->runnable_node);
+      list_node_init(&ti->runnable_node);
+   } else {
+      runnable_tree_remove(ti);
+   }
+}
+
+static void runnable_dequeue_idle_task(void)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      if (idle_task->state == TASK_STATE_RUNNABLE)
+         runnable_tree_remove(idle_task);
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Add `delta` to the vruntime of the given task. Typically, `ti` is the current
+ * task and it's in the RUNNING state, but it might also have been woken up
+ * while it was still running (see enter_sleep_wait_state()): in that case, it
+ * is part of the runnable tree and its key cannot change in-place.
+ */
+static void task_add_vruntime(struct task *ti, u64 delta)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      const bool in_tree =
+         ti->state == TASK_STATE_RUNNABLE &&
+         !is_worker_thread(ti) &&
+         ti != idle_task &&
+         !list_is_node_in_list(&ti->runnable_node);
+
+      if (in_tree) {
+         runnable_tree_remove(ti);
+         ti->ticks.vruntime += delta;
+         runnable_tree_insert(ti);
+      } else {
+         ti->ticks.vruntime += delta;
+      }
+   }
+   enable_interrupts(&var);
+}
+
 void init_sched(void)
 {
    int tid;
@@ -458,6 +594,14 @@ void init_sched(void)
       panic("Unable to create the idle_task!");
 
    idle_task = get_task(tid);
+
+   /*
+    * The idle task has been added in the runnable tree by kthread_create(),
+    * before `idle_task` was set. Remove it from there: it's never selected
+    * from the tree anyway, and its vruntime never grows, so it would otherwise
+    * stay forever as the leftmost node in the tree.
+    */
+   runnable_dequeue_idle_task();
 }
 
 void set_current_task_in_kernel(void)
@@ -474,7 +618,7 @@ static void task_add_to_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_add_tail(&runnable_tasks_list, &ti->runnable_node);
+         runnable_enqueue(ti);
          runnable_tasks_count++;
          break;
 
@@ -503,7 +647,7 @@ static void task_remove_from_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_remove(&ti->runnable_node);
+         runnable_dequeue(ti);
          runnable_tasks_count--;
          ASSERT(runnable_tasks_count >= 0);
          break;
@@ -586,6 +730,20 @@ void remove_task(struct task *ti)
    enable_preemption();
 }
 
+/*
+ * Account the ticks skipped by the tickless idle (see timer.c) to the idle
+ * task. Its vruntime never increases, so only the total counters are affected.
+ */
+void sched_account_idle_ticks(u32 ticks)
+{
+   struct sched_ticks *t = &idle_task->ticks;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(get_curr_task() == idle_task);
+
+   t->total += ticks;
+   t->total_kernel += ticks;
+}
+
 void sched_account_ticks(void)
 {
    struct task *curr = get_curr_task();
@@ -620,7 +778,7 @@ void sched_account_ticks(void)
        * tasks that that consumed 100% of the CPU when no other task was
        * runnable won't be so much penalized.
        */
-      t->vruntime += (u64)(runnable_tasks_count - 1);
+      task_add_vruntime(curr, (u64)(runnable_tasks_count - 1));
    }
 
    /*
@@ -666,28 +824,61 @@ sched_should_return_immediately(struct task *curr, enum task_state curr_state)
    return false;
 }
 
+/*
+ * Returns the non-stopped runnable task with the lowest vruntime. In the common
+ * case that's just the cached leftmost node of the tree: O(1). Stopped tasks
+ * remain in the tree (they're still RUNNABLE), so we might need to skip some.
+ */
+static struct task *
+sched_get_first_runnable_task(void)
+{
+   struct bintree_walk_ctx ctx;
+   struct task *pos = runnable_tree_first;
+
+   if (LIKELY(!pos || !pos->stopped))
+      return pos;
+
+   bintree_in_order_visit_start(&ctx,
+                                runnable_tree_root,
+                                struct task,
+                                runnable_tree_node,
+                                false);
+
+   while ((pos = bintree_in_order_visit_next(&ctx))) {
+
+      ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
+
+      if (!pos->stopped)
+         break;
+   }
+
+   return pos;
+}
+
 static struct task *
 sched_do_select_runnable_task(enum task_state curr_state, bool resched)
 {
    struct task *curr = get_curr_task();
    struct task *selected = NULL;
    struct task *pos;
+   ulong var;
 
-   list_for_each_ro(pos, &runnable_tasks_list, runnable_node) {
-
-      ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
+   disable_interrupts(&var);
+   {
+      list_for_each_ro(pos, &timer_ready_tasks_list, runnable_node) {
 
-      if (pos->stopped || pos == idle_task)
-         continue;
+         ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
 
-      if (pos->timer_ready) {
-         selected = pos;
-         break;
+         if (!pos->stopped) {
+            selected = pos;
+            break;
+         }
       }
 
-      if (!selected || pos->ticks.vruntime < selected->ticks.vruntime)
-         selected = pos;
+      if (!selected)
+         selected = sched_get_first_runnable_task();
    }
+   enable_interrupts(&var);
 
    /* If there is still no selected task, check for current task */
    if (!selected) {
@@ -701,8 +892,9 @@ sched_do_select_runnable_task(enum task_state curr_state, bool resched)
       /*
        * If need_resched is not set, the caller didn't want necessarily to
        * yield, but just give the scheduler an opportunity to switch the current
-       * task. In the loop avoid, the current task was not included because its
-       * state is typically RUNNING, so it's not present in the runnable_list.
+       * task. In the lookup above, the current task was not included because
+       * its state is typically RUNNING, so it's not present in the runnable
+       * tree.
        */
 
       if (curr_state == TASK_STATE_RUNNING && !curr->stopped)
@@ -790,7 +982,7 @@ struct process *get_process(int pid)
 
    ti = get_task(pid);
 
-   if (ti && !is_kernel_thread(ti))
+   if (ti && is_main_thread(ti) && !is_kernel_thread(ti))
       return ti->pi;
 
    return NULL;
@@ -821,6 +1013,9 @@ int send_signal_to_group(int pgid, int sig)
 
       struct process *pi = ti->pi;
 
+      if (!is_main_thread(ti))
+         continue; /* signal each process just once */
+
       if (pi->pgid == pgid && pi != curr_pi && pi->pid != 1) {
 
          if (pi->pid != pgid)
@@ -867,6 +1062,9 @@ int send_signal_to_session(int sid, int sig)
 
       struct process *pi = ti->pi;
 
+      if (!is_main_thread(ti))
+         continue; /* signal each process just once */
+
       if (pi->pgid == sid && pi != curr_pi && pi->pid != 1) {
 
          if (pi->pid != sid)
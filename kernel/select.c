@@ -8,6 +8,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 
 struct select_ctx {
    int nfds;
@@ -16,7 +17,8 @@ struct select_ctx {
    struct k_timeval *tv;
    struct k_timeval *user_tv;
    int cond_cnt;
-   u32 timeout_ticks;
+   u64 timeout;         /* in TS_SCALE units, 0 = no timeout or zero */
+   u64 deadline;        /* monotonic time of the timeout, if any */
 };
 
 static const func_get_rwe_cond gcf[3] = {
@@ -147,6 +149,19 @@ count_ready_streams(int nfds, fd_set *sets[3])
    return count;
 }
 
+/* Store in the user's timeval the time left until the deadline */
+static void
+select_set_tv_rem(struct select_ctx *c)
+{
+   struct k_timespec64 rem = {0};
+   const u64 now = get_mono_time();
+
+   if (c->deadline > now)
+      ns_to_timespec(c->deadline - now, &rem);
+
+   *c->tv = k_ts64_to_k_timeval(rem);
+}
+
 static int
 select_wait_on_cond(struct select_ctx *c)
 {
@@ -164,8 +179,9 @@ select_wait_on_cond(struct select_ctx *c)
    }
 
    if (c->tv) {
-      ASSERT(c->timeout_ticks > 0);
-      task_set_wakeup_timer(curr, c->timeout_ticks);
+      ASSERT(c->timeout > 0);
+      c->deadline = hrtimer_expiry_in(c->timeout);
+      task_set_wakeup_hrtimer(curr, c->deadline);
    }
 
    while (true) {
@@ -197,9 +213,8 @@ select_wait_on_cond(struct select_ctx *c)
             if (!count_ready_streams(c->nfds, c->sets))
                continue; /* No ready streams, we have to wait again. */
 
-            u32 rem = task_cancel_wakeup_timer(curr);
-            c->tv->tv_sec = rem / TIMER_HZ;
-            c->tv->tv_usec = (rem % TIMER_HZ) * (1000000 / TIMER_HZ);
+            task_cancel_wakeup_timer(curr);
+            select_set_tv_rem(c);
          }
 
       } else {
@@ -217,8 +232,13 @@ select_wait_on_cond(struct select_ctx *c)
 out:
    free_mobj_waiter(waiter);
 
-   if (pending_signals())
+   if (pending_signals()) {
+
+      if (c->tv)
+         task_cancel_wakeup_timer(curr);
+
       return -EINTR;
+   }
 
    return rc;
 }
@@ -245,7 +265,7 @@ select_read_user_sets(fd_set *sets[3], fd_set *u_sets[3])
 static int
 select_read_user_tv(struct k_timeval *user_tv,
                     struct k_timeval **tv_ref,
-                    u32 *timeout)
+                    u64 *timeout)
 {
    struct task *curr = get_curr_task();
    struct k_timeval *tv = NULL;
@@ -257,12 +277,15 @@ select_read_user_tv(struct k_timeval *user_tv,
       if (copy_from_user(tv, user_tv, sizeof(struct k_timeval)))
          return -EFAULT;
 
-      u64 tmp = 0;
-      tmp += (u64)tv->tv_sec * TIMER_HZ;
-      tmp += (u64)tv->tv_usec / (1000000 / TIMER_HZ);
+      if (tv->tv_sec < 0 || !IN_RANGE(tv->tv_usec, 0, 1000000))
+         return -EINVAL;
 
-      /* NOTE: select() can't sleep for more than UINT32_MAX ticks */
-      *timeout = (u32) CLAMP(tmp, 1u, UINT32_MAX);
+      struct k_timespec64 ts = {
+         .tv_sec = tv->tv_sec,
+         .tv_nsec = tv->tv_usec * 1000,
+      };
+
+      *timeout = timespec_to_ns(&ts);
    }
 
    *tv_ref = tv;
@@ -274,7 +297,7 @@ select_compute_cond_cnt(struct select_ctx *c)
 {
    int rc;
 
-   if (!c->tv || c->timeout_ticks > 0) {
+   if (!c->tv || c->timeout > 0) {
       for (int i = 0; i < 3; i++) {
          if ((rc = select_count_cond_per_set(c, c->sets[i], gcf[i])))
             return rc;
@@ -319,7 +342,8 @@ int sys_select(int user_nfds,
       .tv = NULL,
       .user_tv = user_tv,
       .cond_cnt = 0,
-      .timeout_ticks = 0,
+      .timeout = 0,
+      .deadline = 0,
    };
 
    int rc;
@@ -330,7 +354,7 @@ int sys_select(int user_nfds,
    if ((rc = select_read_user_sets(ctx.sets, ctx.u_sets)))
       return rc;
 
-   if ((rc = select_read_user_tv(user_tv, &ctx.tv, &ctx.timeout_ticks)))
+   if ((rc = select_read_user_tv(user_tv, &ctx.tv, &ctx.timeout)))
       return rc;
 
    if ((rc = count_ready_streams(ctx.nfds, ctx.sets)) > 0)
@@ -339,7 +363,7 @@ int sys_select(int user_nfds,
    if ((rc = select_compute_cond_cnt(&ctx)))
       return rc;
 
-   if (ctx.cond_cnt > 0 && (!user_tv || ctx.timeout_ticks > 0)) {
+   if (ctx.cond_cnt > 0 && (!user_tv || ctx.timeout > 0)) {
 
       /*
        * The count of condition variables for all the file descriptors is
@@ -357,7 +381,7 @@ int sys_select(int user_nfds,
        * be NULL (see the comment below).
        */
 
-      if (ctx.timeout_ticks > 0) {
+      if (ctx.timeout > 0) {
 
          /*
           * Corner case: no conditions on which to wait, but timeout is > 0:
@@ -366,10 +390,13 @@ int sys_select(int user_nfds,
           * was even used as a portable implementation of nanosleep().
           */
 
-         kernel_sleep(ctx.timeout_ticks);
+         ctx.deadline = hrtimer_expiry_in(ctx.timeout);
+         kernel_sleep_until(ctx.deadline);
 
          if (pending_signals())
             return -EINTR;
+
+         select_set_tv_rem(&ctx);
       }
    }
 
@@ -395,6 +395,27 @@ static void do_send_signal(struct task *ti, int signum, int fl)
    }
 }
 
+/*
+ * A signal sent to the whole process is delivered to its main thread, unless
+ * that thread is blocking it or it's exiting: in that case, the first thread
+ * able to handle the signal gets it.
+ */
+static struct task *
+get_task_for_process_signal(struct task *ti, int signum)
+{
+   struct task *pos;
+
+   if (ti->nested_sig_handlers >= 0 && !is_sig_masked(ti, signum))
+      return ti;
+
+   list_for_each_ro(pos, &ti->pi->threads, thread_node) {
+      if (pos->nested_sig_handlers >= 0 && !is_sig_masked(pos, signum))
+         return pos;
+   }
+
+   return ti;
+}
+
 int send_signal2(int pid, int tid, int signum, int flags)
 {
    struct task *ti;
@@ -421,7 +442,9 @@ int send_signal2(int pid, int tid, int signum, int flags)
    if (ti->state == TASK_STATE_ZOMBIE)
       goto end; /* do nothing */
 
-   /* TODO: update this code when thread support is added */
+   if (flags & SIG_FL_PROCESS)
+      ti = get_task_for_process_signal(ti, signum);
+
    do_send_signal(ti, signum, flags);
 
 end:
@@ -470,19 +493,24 @@ bool pending_signals(void)
 /* NOTE: deprecated syscall */
 int sys_tkill(int tid, int sig)
 {
+   struct task *ti;
+   int pid = -1;
+
    if (!IN_RANGE(sig, 0, _NSIG) || tid <= 0)
       return -EINVAL;
 
-   return send_signal(tid, sig, false);
+   disable_preemption();
+   {
+      if ((ti = get_task(tid)))
+         pid = ti->pi->pid;
+   }
+   enable_preemption();
+
+   return send_signal2(pid, tid, sig, false);
 }
 
 int sys_tgkill(int pid /* linux: tgid */, int tid, int sig)
 {
-   if (pid != tid) {
-      printk("sys_tgkill: pid != tid NOT SUPPORTED yet.\n");
-      return -EINVAL;
-   }
-
    if (!IN_RANGE(sig, 0, _NSIG) || pid <= 0 || tid <= 0)
       return -EINVAL;
 
@@ -494,9 +522,11 @@ static int kill_each_task(void *obj, void *arg)
    struct task *ti = obj;
    int sig = *(int *)arg;
 
-   if (ti != get_curr_task() && !is_kernel_thread(ti)) {
+   if (is_kernel_thread(ti) || !is_main_thread(ti))
+      return 0; /* processes are signalled through their main thread */
+
+   if (ti->pi != get_curr_proc())
       send_signal(ti->tid, sig, false);
-   }
 
    return 0;
 }
@@ -819,6 +849,62 @@ int sys_rt_sigsuspend(sigset_t *u_mask, size_t sigsetsize)
    return sys_pause();
 }
 
+/*
+ * Temporarily replace the signal mask of the current task with the one at
+ * `u_mask`, for syscalls like epoll_pwait(). The old mask is restored by
+ * sigmask_temp_restore() or, when the syscall gets interrupted by a signal,
+ * after its handler runs, exactly as for sigsuspend().
+ */
+int sigmask_temp_set(const sigset_t *u_mask, size_t sigsetsize)
+{
+   struct task *curr = get_curr_task();
+   ulong mask[K_SIGACTION_MASK_WORDS];
+   int rc = 0;
+
+   if (sigsetsize < sizeof(mask))
+      return -EINVAL;
+
+   if (copy_from_user(mask, u_mask, sizeof(mask)))
+      return -EFAULT;
+
+   disable_preemption();
+   {
+      if (!curr->in_sigsuspend) {
+
+         memcpy(curr->sa_old_mask, curr->sa_mask, sizeof(curr->sa_old_mask));
+         memcpy(curr->sa_mask, mask, sizeof(curr->sa_mask));
+         __del_sig(curr->sa_mask, SIGKILL);
+         __del_sig(curr->sa_mask, SIGSTOP);
+         curr->in_sigsuspend = true;
+
+      } else {
+
+         /* The old mask is already in use: see sys_rt_sigsuspend() */
+         rc = -EPERM;
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+void sigmask_temp_restore(void)
+{
+   struct task *curr = get_curr_task();
+
+   disable_preemption();
+   {
+      /*
+       * With pending signals, leave the temporary mask in place: it will be
+       * restored after running the handler, see sys_rt_sigreturn().
+       */
+      if (curr->in_sigsuspend && !pending_signals()) {
+         memcpy(curr->sa_mask, curr->sa_old_mask, sizeof(curr->sa_mask));
+         curr->in_sigsuspend = false;
+      }
+   }
+   enable_preemption();
+}
+
 int sys_pause(void)
 {
    ASSERT(!is_preemption_enabled()); /* Thanks to SYSFL_NO_PREEMPT */
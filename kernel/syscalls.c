@@ -32,36 +32,124 @@ int sys_madvise(void *addr, size_t len, int advice)
    return 0;
 }
 
-int
-do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
+/*
+ * Sleep until the monotonic time `deadline`. In case of a signal, return
+ * -EINTR and, if `rem` is not NULL, store there the time left.
+ */
+static int
+do_sleep_until(u64 deadline, struct k_timespec64 *rem)
 {
-   u64 ticks_to_sleep;
-   u64 exp_wake_up_ticks;
+   u64 now;
+   kernel_sleep_until(deadline);
+
+   if (!pending_signals())
+      return 0;
+
+   if (rem) {
+
+      now = get_mono_time();
+      ns_to_timespec(deadline > now ? deadline - now : 0, rem);
+   }
 
-   ticks_to_sleep = timespec_to_ticks(req);
-   exp_wake_up_ticks = get_ticks() + ticks_to_sleep;
-   kernel_sleep(ticks_to_sleep);
+   return -EINTR;
+}
+
+static int
+do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
+{
+   if (!is_valid_timespec(req))
+      return -EINVAL;
 
-   /* After wake-up */
    rem->tv_sec = 0;
    rem->tv_nsec = 0;
+   return do_sleep_until(hrtimer_expiry_in(timespec_to_ns(req)), rem);
+}
 
-   if (pending_signals()) {
+int
+sys_nanosleep_time32(const struct k_timespec32 *user_req,
+                     struct k_timespec32 *user_rem)
+{
+   struct k_timespec32 req32;
+   struct k_timespec64 req;
+   struct k_timespec32 rem32;
+   struct k_timespec64 rem;
+   int rc;
 
-      u64 ticks = get_ticks();
+   if (copy_from_user(&req32, user_req, sizeof(req32)))
+      return -EFAULT;
 
-      if (ticks < exp_wake_up_ticks)
-         ticks_to_timespec(exp_wake_up_ticks - ticks, rem);
+   req = (struct k_timespec64) {
+      .tv_sec = req32.tv_sec,
+      .tv_nsec = req32.tv_nsec,
+   };
+
+   rc = do_nanosleep(&req, &rem);
+
+   if (user_rem && rc == -EINTR) {
 
-      return -EINTR;
+      rem32 = (struct k_timespec32) {
+         .tv_sec = (s32) rem.tv_sec,
+         .tv_nsec = rem.tv_nsec,
+      };
+
+      if (copy_to_user(user_rem, &rem32, sizeof(rem32)))
+         return -EFAULT;
    }
 
-   return 0;
+   return rc;
+}
+
+static int
+do_clock_nanosleep(clockid_t clk_id,
+                   int flags,
+                   const struct k_timespec64 *req,
+                   struct k_timespec64 *rem)
+{
+   struct k_timespec64 now_ts;
+   u64 deadline, now;
+
+   if (!is_valid_timespec(req))
+      return -EINVAL;
+
+   switch (clk_id) {
+
+      case CLOCK_REALTIME:
+      case CLOCK_MONOTONIC:
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   if (!(flags & TIMER_ABSTIME))
+      return do_sleep_until(hrtimer_expiry_in(timespec_to_ns(req)), rem);
+
+   deadline = timespec_to_ns(req);
+
+   if (clk_id == CLOCK_REALTIME) {
+
+      /*
+       * Convert the deadline to the monotonic clock. Note: changes to the
+       * system time while we're sleeping are not taken into account.
+       */
+      real_time_get_timespec(&now_ts);
+      now = timespec_to_ns(&now_ts);
+
+      if (deadline <= now)
+         return 0;
+
+      deadline = hrtimer_expiry_in(deadline - now);
+   }
+
+   /* With TIMER_ABSTIME, `rem` is never touched */
+   return do_sleep_until(deadline, NULL);
 }
 
 int
-sys_nanosleep_time32(const struct k_timespec32 *user_req,
-                     struct k_timespec32 *user_rem)
+sys_clock_nanosleep_time32(clockid_t clk_id,
+                           int flags,
+                           const struct k_timespec32 *user_req,
+                           struct k_timespec32 *user_rem)
 {
    struct k_timespec32 req32;
    struct k_timespec64 req;
@@ -69,7 +157,7 @@ sys_nanosleep_time32(const struct k_timespec32 *user_req,
    struct k_timespec64 rem;
    int rc;
 
-   if (copy_from_user(&req32, user_req, sizeof(req)))
+   if (copy_from_user(&req32, user_req, sizeof(req32)))
       return -EFAULT;
 
    req = (struct k_timespec64) {
@@ -77,9 +165,9 @@ sys_nanosleep_time32(const struct k_timespec32 *user_req,
       .tv_nsec = req32.tv_nsec,
    };
 
-   rc = do_nanosleep(&req, &rem);
+   rc = do_clock_nanosleep(clk_id, flags, &req, &rem);
 
-   if (user_rem) {
+   if (user_rem && rc == -EINTR && !(flags & TIMER_ABSTIME)) {
 
       rem32 = (struct k_timespec32) {
          .tv_sec = (s32) rem.tv_sec,
@@ -93,6 +181,29 @@ sys_nanosleep_time32(const struct k_timespec32 *user_req,
    return rc;
 }
 
+int
+sys_clock_nanosleep(clockid_t clk_id,
+                    int flags,
+                    const struct k_timespec64 *user_req,
+                    struct k_timespec64 *user_rem)
+{
+   struct k_timespec64 req;
+   struct k_timespec64 rem;
+   int rc;
+
+   if (copy_from_user(&req, user_req, sizeof(req)))
+      return -EFAULT;
+
+   rc = do_clock_nanosleep(clk_id, flags, &req, &rem);
+
+   if (user_rem && rc == -EINTR && !(flags & TIMER_ABSTIME)) {
+      if (copy_to_user(user_rem, &rem, sizeof(rem)))
+         return -EFAULT;
+   }
+
+   return rc;
+}
+
 int sys_newuname(struct utsname *user_buf)
 {
    struct commit_hash_and_date comm;
@@ -114,7 +225,7 @@ int sys_newuname(struct utsname *user_buf)
 
 NORETURN int sys_exit(int exit_status)
 {
-   terminate_process(exit_status, 0 /* term_sig */);
+   terminate_thread(exit_status);
 
    /* Necessary to guarantee to the compiler that we won't return. */
    NOT_REACHED();
@@ -122,30 +233,25 @@ NORETURN int sys_exit(int exit_status)
 
 NORETURN int sys_exit_group(int status)
 {
-   // TODO: update when user threads are supported
-   sys_exit(status);
+   terminate_process(status, 0 /* term_sig */);
+   NOT_REACHED();
 }
 
 ulong sys_times(struct tms *user_buf)
 {
-   struct task *curr = get_curr_task();
    struct tms buf;
+   u64 total, total_kernel;
 
-   // TODO (threads): when threads are supported, update sys_times()
    // TODO: consider supporting tms_cutime and tms_cstime in sys_times()
 
-   disable_preemption();
-   {
-
-      buf = (struct tms) {
-         .tms_utime = (clock_t) curr->ticks.total,
-         .tms_stime = (clock_t) curr->ticks.total_kernel,
-         .tms_cutime = 0,
-         .tms_cstime = 0,
-      };
+   process_get_ticks(get_curr_proc(), &total, &total_kernel);
 
-   }
-   enable_preemption();
+   buf = (struct tms) {
+      .tms_utime = (clock_t) total,
+      .tms_stime = (clock_t) total_kernel,
+      .tms_cutime = 0,
+      .tms_cstime = 0,
+   };
 
    if (copy_to_user(user_buf, &buf, sizeof(buf)) != 0)
       return (ulong) -EBADF;
@@ -178,16 +284,20 @@ int sys_getrusage(int who, struct k_rusage *user_buf)
    if (who != RUSAGE_SELF && who != RUSAGE_THREAD)
       return -EINVAL;
 
-   /*
-    * Since there can only be one thread per process,
-    * RUSAGE_SELF and RUSAGE_THREAD have the same meaning.
-    */
-   disable_interrupts_forced();
-   {
-      stime_ticks = curr->ticks.total_kernel;
-      utime_ticks = curr->ticks.total - curr->ticks.total_kernel;
+   if (who == RUSAGE_SELF) {
+
+      process_get_ticks(curr->pi, &utime_ticks, &stime_ticks);
+      utime_ticks -= stime_ticks;
+
+   } else {
+
+      disable_interrupts_forced();
+      {
+         stime_ticks = curr->ticks.total_kernel;
+         utime_ticks = curr->ticks.total - curr->ticks.total_kernel;
+      }
+      enable_interrupts_forced();
    }
-   enable_interrupts_forced();
 
    ticks_to_timespec(utime_ticks, &utime);
    ticks_to_timespec(stime_ticks, &stime);
@@ -5,6 +5,7 @@
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/hal.h>
@@ -13,6 +14,7 @@
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/vdso.h>
 
 FASTCALL void asm_nop_loop(u32 iters);
 
@@ -25,18 +27,104 @@ u32 __tick_duration;       /* the real duration of a tick, ~TS_SCALE/TIMER_HZ */
 int __tick_adj_val;
 int __tick_adj_ticks_rem;
 
+/*
+ * TSC clocksource
+ *
+ * Once the TSC has been calibrated against the timer, `__tick_tsc` holds the
+ * TSC value at the last tick and the time elapsed since then is interpolated
+ * with the TSC, giving ns resolution to get_sys_time() and get_mono_time().
+ */
+#define TSC_NS_SHIFT                 32
+
+static u64 __tick_tsc;     /* TSC value at the last tick */
+static u32 tsc_per_tick;   /* TSC cycles per tick, 0 = no TSC clocksource */
+static u64 tsc_ns_mult;    /* ns = (cycles * tsc_ns_mult) >> TSC_NS_SHIFT */
+
+/* Data page shared read-only with userspace, used by the vDSO */
+union vdso_data_page vdso_data_page ALIGNED_AT(PAGE_SIZE);
+
+STATIC_ASSERT(TSC_NS_SHIFT == 32); /* assumed by vdso.S */
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, seq) == VDSO_DATA_SEQ_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, tsc_per_tick) ==
+              VDSO_DATA_TSC_PER_TICK_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, tsc_ns_mult) ==
+              VDSO_DATA_TSC_NS_MULT_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, tick_tsc) == VDSO_DATA_TICK_TSC_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, sys_time) == VDSO_DATA_SYS_TIME_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, mono_time) ==
+              VDSO_DATA_MONO_TIME_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, boot_timestamp) ==
+              VDSO_DATA_BOOT_TS_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, sys_ns_cap) ==
+              VDSO_DATA_SYS_NS_CAP_OFF);
+STATIC_ASSERT(OFFSET_OF(struct vdso_data, mono_ns_cap) ==
+              VDSO_DATA_MONO_NS_CAP_OFF);
+
+extern s64 boot_timestamp;
+
 /* Debug counters */
 u32 slow_timer_irq_handler_count;
 
 /* Temporary global used by asm_do_bogomips_loop() */
 volatile ATOMIC(u32) __bogo_loops;
 
+/*
+ * Hierarchical timer wheel
+ * -------------------------
+ *
+ * Tasks' wakeup timers are kept in TW_LEVELS levels of TW_SIZE slots each.
+ * Level 0 contains the timers expiring in the next TW_SIZE ticks, one slot per
+ * tick. Each level L > 0 contains the timers expiring in the next
+ * TW_SIZE^(L+1) ticks, with a granularity of TW_SIZE^L ticks per slot. Every
+ * TW_SIZE ticks, the slot of level 1 that has just become "current" is
+ * cascaded (re-distributed) down into level 0 and so on, recursively, for the
+ * upper levels.
+ *
+ * This way, arming and canceling a timer is O(1) and the work done on each
+ * tick is proportional just to the number of timers expiring on that tick,
+ * plus the amortized cost of the cascading. With TW_BITS = 6 and TW_LEVELS = 6,
+ * the wheel covers 2^36 ticks, more than the u32 ticks accepted by
+ * task_set_wakeup_timer().
+ *
+ * `tw_next_tick` is the next tick to be processed by the wheel. It's always
+ * <= __ticks + 1 and it's equal to it, once tick_all_timers() has returned.
+ */
+#define TW_BITS                                    6
+#define TW_SIZE                        (1 << TW_BITS)
+#define TW_MASK                          (TW_SIZE - 1)
+#define TW_LEVELS                                  6
+
+STATIC_ASSERT(TW_BITS * TW_LEVELS > 32);
+
+static struct list timer_wheel[TW_LEVELS][TW_SIZE];
+static u64 tw_next_tick = 1;
+
 /* Static variables */
-static struct list timer_wakeup_list = STATIC_LIST_INIT(timer_wakeup_list);
 static u32 loops_per_tick;         /* Tilck bogoMips as loops/tick    */
 static u32 loops_per_ms = 5000000; /* loops/millisecond (initial val)  */
 static u32 loops_per_us = 5000;    /* loops/microsecond (initial val) */
 
+bool has_tsc_clocksource(void)
+{
+   return tsc_per_tick != 0;
+}
+
+/*
+ * Nanoseconds elapsed since the last tick, capped to a tick duration, as the
+ * tick itself might be late. Without a TSC clocksource, it's always 0.
+ */
+u32 ns_since_last_tick(void)
+{
+   u64 cycles;
+
+   if (!tsc_per_tick)
+      return 0;
+
+   ASSERT(!are_interrupts_enabled());
+   cycles = MIN(RDTSC() - __tick_tsc, (u64)tsc_per_tick);
+   return (u32)((cycles * tsc_ns_mult) >> TSC_NS_SHIFT);
+}
+
 u64 get_ticks(void)
 {
    u64 curr_ticks;
@@ -50,6 +138,112 @@ u64 get_ticks(void)
    return curr_ticks;
 }
 
+static ALWAYS_INLINE u32 next_tick_ns_delta(void)
+{
+   if (__tick_adj_ticks_rem) {
+      __tick_adj_ticks_rem--;
+      return (u32)((s32)__tick_duration + __tick_adj_val);
+   }
+
+   return __tick_duration;
+}
+
+/*
+ * Publish the current time base on the vDSO data page. Called on each tick and
+ * every time the time base changes, with interrupts disabled. Userspace never
+ * sees a torn update thanks to the seqcount.
+ */
+void vdso_update_time(void)
+{
+   struct vdso_data *d = &vdso_data_page.data;
+   u32 sys_cap = __tick_duration;
+   ASSERT(!are_interrupts_enabled());
+
+   if (__tick_adj_ticks_rem && __tick_adj_val < 0)
+      sys_cap = (u32)((s32)__tick_duration + __tick_adj_val);
+
+   d->seq++;
+   asmVolatile("" ::: "memory");
+
+   d->tsc_per_tick = tsc_per_tick;
+   d->tsc_ns_mult = tsc_ns_mult;
+   d->tick_tsc = __tick_tsc;
+   d->sys_time = __time_ns;
+   d->mono_time = __ticks * __tick_duration;
+   d->boot_timestamp = boot_timestamp;
+   d->sys_ns_cap = sys_cap;
+   d->mono_ns_cap = __tick_duration;
+
+   asmVolatile("" ::: "memory");
+   d->seq++;
+}
+
+static void tw_init(void)
+{
+   for (int i = 0; i < TW_LEVELS; i++)
+      for (int j = 0; j < TW_SIZE; j++)
+         list_init(&timer_wheel[i][j]);
+
+   tw_next_tick = __ticks + 1;
+}
+
+/* Place the timer of `ti` in the right slot. Expects interrupts disabled */
+static void tw_add_timer(struct task *ti)
+{
+   const u64 expire = ti->wakeup_timer_tick;
+   struct list *slot;
+   int level = 0;
+
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(expire > 0);
+
+   if (expire < tw_next_tick) {
+
+      /* Already expired: make it fire on the next processed tick */
+      slot = &timer_wheel[0][tw_next_tick & TW_MASK];
+
+   } else {
+
+      const u64 delta = expire - tw_next_tick;
+
+      while (level < TW_LEVELS - 1 && delta >= (1ull << (TW_BITS*(level+1))))
+         level++;
+
+      slot = &timer_wheel[level][(expire >> (TW_BITS * level)) & TW_MASK];
+   }
+
+   list_add_tail(slot, &ti->wakeup_timer_node);
+}
+
+static void tw_remove_timer(struct task *ti)
+{
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
+
+   list_remove(&ti->wakeup_timer_node);
+   list_node_init(&ti->wakeup_timer_node);
+}
+
+/*
+ * Move all the timers in the current slot of the given level (> 0) to the lower
+ * levels. Returns the index of the slot, which is 0 when the level wrapped
+ * around and the next level needs to be cascaded as well.
+ */
+static int tw_cascade(int level)
+{
+   const int idx = (int)((tw_next_tick >> (TW_BITS * level)) & TW_MASK);
+   struct list *slot = &timer_wheel[level][idx];
+   struct task *pos, *temp;
+
+   list_for_each(pos, temp, slot, wakeup_timer_node) {
+      list_remove(&pos->wakeup_timer_node);
+      tw_add_timer(pos);
+   }
+
+   list_init(slot);
+   return idx;
+}
+
 void task_set_wakeup_timer(struct task *ti, u32 ticks)
 {
    ulong var;
@@ -57,14 +251,15 @@ void task_set_wakeup_timer(struct task *ti, u32 ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up == 0) {
-         ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
-         list_add_tail(&timer_wakeup_list, &ti->wakeup_timer_node);
+      if (ti->wakeup_timer_tick != 0) {
+         tw_remove_timer(ti);
       } else {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
+         ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
       }
 
-      ti->ticks_before_wake_up = ticks;
+      hrtimer_cancel(&ti->wakeup_hrtimer);
+      ti->wakeup_timer_tick = __ticks + ticks;
+      tw_add_timer(ti);
    }
    enable_interrupts(&var);
 }
@@ -76,9 +271,10 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
 
    disable_interrupts(&var);
    {
-      if (ti->ticks_before_wake_up > 0) {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-         ti->ticks_before_wake_up = new_ticks;
+      if (ti->wakeup_timer_tick != 0) {
+         tw_remove_timer(ti);
+         ti->wakeup_timer_tick = __ticks + new_ticks;
+         tw_add_timer(ti);
       }
    }
    enable_interrupts(&var);
@@ -87,15 +283,37 @@ void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
 u32 task_cancel_wakeup_timer(struct task *ti)
 {
    ulong var;
-   u32 old;
+   u32 old = 0;
    disable_interrupts(&var);
    {
-      old = ti->ticks_before_wake_up;
+      if (ti->wakeup_timer_tick != 0) {
+
+         /*
+          * The timer might be due in this very tick, but not processed yet by
+          * tick_all_timers(): in that case, consider it as having 1 tick left,
+          * as an active timer always has at least one tick left.
+          */
+         old = ti->wakeup_timer_tick > __ticks
+            ? (u32)(ti->wakeup_timer_tick - __ticks)
+            : 1;
 
-      if (old > 0) {
          ti->timer_ready = false;
-         ti->ticks_before_wake_up = 0;
-         list_remove(&ti->wakeup_timer_node);
+         ti->wakeup_timer_tick = 0;
+         tw_remove_timer(ti);
+
+      } else if (ti->wakeup_hrtimer.active) {
+
+         const u64 now = __ticks * __tick_duration;
+         const u64 exp = ti->wakeup_hrtimer.expires;
+         u64 rem = 1;
+
+         if (exp > now)
+            rem = div_round_up64(exp - now, __tick_duration);
+
+         old = (u32)MIN(rem, (u64)UINT32_MAX);
+
+         ti->timer_ready = false;
+         hrtimer_cancel(&ti->wakeup_hrtimer);
       }
    }
    enable_interrupts(&var);
@@ -108,64 +326,37 @@ static void tick_all_timers(void)
    bool any_woken_up_task = false;
    ulong var;
 
-   /*
-    * This is *NOT* the best we can do. In particular, it's terrible to keep
-    * the interrupts disabled while iterating the _whole_ timer_wakeup_list.
-    *
-    * Possible better solutions
-    * -----------------------------
-    * 1. Keep the tasks to wake-up in a sort of ordered list and then use
-    * relative timers. This way, at each tick we'll have to decrement just one
-    * single counter. We'll start decrement the next counter only when the first
-    * counter reaches 0 and its list node is removed. Of course, if we cannot
-    * use kmalloc() in case of sleep, it gets much harder to create such an
-    * ordered list and make it live inside a member of struct task. Maybe a BST
-    * will do the job, but that would require paying O(logN) per tick for
-    * finding the earliest timer. Not sure how better would be now for N < 50
-    * (typical), given the huge added constant for the BST functions. Also, the
-    * cancellation of a timer would require some extra effort in order to
-    * re-calculate the relative timer values, while we want the cancellation to
-    * be light-fast because it's run by IRQ handlers.
-    *
-    * 2. Use a fixed number of wakeup lists like: short-term, mid-term and
-    * long-term. Current task's wakeup list node will be placed in one those
-    * lists, depending on far in the future the task is supposted to be woke up.
-    * On every tick, here in tick_all_timers(), ONLY the short-term list will be
-    * iterated. That's a considerable improvement. In a system, there might be
-    * even 1,000 active timers, but how many of them will expire in the next
-    * second? Only a small percentage of them. To further improve the
-    * scalability, it's possible to have even more than 3 lists, or to further
-    * reduce the time-horizon of the short-term list. Periodically, but NOT on
-    * every tick, the `ticks_before_wake_up` field belonging to tasks in the
-    * other wakeup lists will adjusted with bigger decrements and tasks will be
-    * moved from one list to another. That will also happen in case the wakeup
-    * timer is changed for task with an already active timer. This solution
-    * looks much better than solution 1.
-    *
-    * Conclusion
-    * ---------------------
-    * For the moment, given the very limited scale of Tilck (tens of tasks at
-    * most running on the whole system), the current solution is safe and
-    * good-enough but, at some point, a smarter ad-hoc solution should be
-    * devised. Probably solution 2 is the right candidate.
-    */
    disable_interrupts(&var);
 
-   list_for_each(pos, temp, &timer_wakeup_list, wakeup_timer_node) {
+   while (tw_next_tick <= __ticks) {
 
-      /* If task is part of this list, it's counter must be > 0 */
-      ASSERT(pos->ticks_before_wake_up > 0);
+      const int idx = (int)(tw_next_tick & TW_MASK);
+      struct list *slot = &timer_wheel[0][idx];
 
-      if (UNLIKELY(--pos->ticks_before_wake_up == 0)) {
+      if (!idx) {
+         for (int level = 1; level < TW_LEVELS; level++)
+            if (tw_cascade(level))
+               break;
+      }
+
+      list_for_each(pos, temp, slot, wakeup_timer_node) {
+
+         /* All the timers in this slot must expire exactly now */
+         ASSERT(pos->wakeup_timer_tick <= tw_next_tick);
 
          pos->timer_ready = true;
+         pos->wakeup_timer_tick = 0;
          list_remove(&pos->wakeup_timer_node);
+         list_node_init(&pos->wakeup_timer_node);
 
          if (pos->state == TASK_STATE_SLEEPING) {
             task_change_state(pos, TASK_STATE_RUNNABLE);
             any_woken_up_task = true;
          }
       }
+
+      list_init(slot);
+      tw_next_tick++;
    }
 
    enable_interrupts(&var);
@@ -174,6 +365,433 @@ static void tick_all_timers(void)
       sched_set_need_resched();
 }
 
+/*
+ * Tickless idle (NO_HZ)
+ * ----------------------
+ *
+ * When the idle task is the only one that can run, there's no point in getting
+ * a timer IRQ on every tick just to increment the counters: instead, the idle
+ * task calls nohz_idle_enter() right before halting the CPU, which stops the
+ * periodic ticks and programs a one-shot IRQ on the first tick the wheel has
+ * something to do on. The first IRQ of any kind after that, calls
+ * nohz_irq_enter() before any handler runs: there, we catch up `__ticks`,
+ * `__time_ns` (applying the clock drift compensation on each tick, exactly as
+ * the timer IRQ handler would) and the ticks of the idle task.
+ *
+ * When the wake-up came from another IRQ, the hardware timer keeps counting
+ * until the next tick boundary, and the periodic mode is restored only then
+ * (HWT_RESYNC), so that the phase of the ticks does not change.
+ */
+
+#define NOHZ_MAX_IDLE_TICKS                  TW_SIZE
+
+enum hw_timer_mode {
+   HWT_PERIODIC,        /* regular periodic ticks */
+   HWT_NOHZ_IDLE,       /* one-shot on a future tick, see above */
+   HWT_SUBTICK,         /* one-shot inside the current tick, see hrtimers */
+   HWT_RESYNC,          /* one-shot on the next tick boundary */
+};
+
+static enum hw_timer_mode hwt_mode;
+static u32 hrt_ticks_until_first(u32 max);
+
+/* Does the wheel have anything to do on tick `t`? */
+static bool tw_tick_has_work(u64 t)
+{
+   if (!list_is_empty(&timer_wheel[0][t & TW_MASK]))
+      return true;
+
+   if (t & TW_MASK)
+      return false;
+
+   /* Cascading tick: check the slots that are going to be cascaded */
+   for (int level = 1; level < TW_LEVELS; level++) {
+
+      const int idx = (int)((t >> (TW_BITS * level)) & TW_MASK);
+
+      if (!list_is_empty(&timer_wheel[level][idx]))
+         return true;
+
+      if (idx)
+         break;
+   }
+
+   return false;
+}
+
+/*
+ * Returns the number of ticks, in [1, max], from now until the first tick the
+ * wheel has something to do on. Expects interrupts disabled and all the ticks
+ * so far to be processed by the wheel.
+ */
+static u32 tw_ticks_until_next_work(u32 max)
+{
+   u32 n;
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(tw_next_tick == __ticks + 1);
+
+   for (n = 1; n < max; n++)
+      if (tw_tick_has_work(__ticks + n))
+         break;
+
+   return n;
+}
+
+static void nohz_catch_up(u32 ticks)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   for (u32 i = 0; i < ticks; i++)
+      __time_ns += next_tick_ns_delta();
+
+   __ticks += ticks;
+   __tick_tsc += (u64)ticks * tsc_per_tick;  /* Where the last tick would be */
+   sched_account_idle_ticks(ticks);
+   vdso_update_time();
+}
+
+void nohz_idle_enter(void)
+{
+   u32 ticks;
+   ASSERT(!are_interrupts_enabled());
+
+   if (!KRN_NO_HZ_IDLE || hwt_mode != HWT_PERIODIC)
+      return;
+
+   if (tw_next_tick != __ticks + 1)
+      return; /* The timer IRQ handler has not processed the last tick yet */
+
+   ticks = tw_ticks_until_next_work(NOHZ_MAX_IDLE_TICKS);
+   ticks = hrt_ticks_until_first(ticks);
+
+   if (ticks < 2)
+      return; /* Nothing to gain: just get the next tick, as usual */
+
+   if (!hw_timer_oneshot_start(ticks))
+      return;
+
+   hwt_mode = HWT_NOHZ_IDLE;
+}
+
+void nohz_irq_enter(int irq)
+{
+   bool expired;
+   u32 passed;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (LIKELY(hwt_mode == HWT_PERIODIC || hwt_mode == HWT_SUBTICK))
+      return; /* The ticks never stopped */
+
+   if (hwt_mode == HWT_RESYNC) {
+
+      if (irq == X86_PC_TIMER_IRQ) {
+         /* We're on the tick boundary: go back to the periodic ticks */
+         hw_timer_periodic_resume();
+         hwt_mode = HWT_PERIODIC;
+      }
+
+      return;
+   }
+
+   passed = hw_timer_oneshot_stop(&expired);
+
+   if (expired) {
+
+      /*
+       * The one-shot IRQ has been raised: it's either the current IRQ or it
+       * will be served right after this one. In both the cases, the last tick
+       * will be accounted by the regular timer IRQ handler.
+       */
+      hw_timer_periodic_resume();
+      hwt_mode = HWT_PERIODIC;
+      passed--;
+
+   } else {
+
+      hwt_mode = HWT_RESYNC;
+   }
+
+   nohz_catch_up(passed);
+}
+
+/*
+ * High-resolution timers
+ * ------------------------
+ *
+ * The hrtimers are kept in an AVL tree ordered by expiry time, caching the
+ * first one. The ticks never stop for them: when the first hrtimer expires
+ * inside the current tick, the hardware timer is switched to one-shot mode
+ * and the tick gets split in sub-tick events (HWT_SUBTICK), up until its
+ * boundary. There, the one-shot IRQ is served as a regular tick (HWT_RESYNC)
+ * and the periodic mode is restored. The sub-tick IRQs don't account any
+ * ticks, they just run the expired hrtimers.
+ */
+
+static void *hrt_root;
+static struct hrtimer *hrt_first;  /* cached first (earliest) hrtimer */
+static u64 hrt_event;              /* time of the programmed sub-tick event */
+
+static long hrt_cmp(const void *a, const void *b)
+{
+   const struct hrtimer *t1 = a;
+   const struct hrtimer *t2 = b;
+
+   if (t1->expires != t2->expires)
+      return t1->expires < t2->expires ? -1 : 1;
+
+   /* Equal expiry time: use the address as a tie-breaker */
+   if (t1 != t2)
+      return t1 < t2 ? -1 : 1;
+
+   return 0;
+}
+
+static void hrt_insert(struct hrtimer *t)
+{
+   DEBUG_ONLY_UNSAFE(bool ok =)
+      bintree_insert(&hrt_root, t, hrt_cmp, struct hrtimer, node);
+
+   ASSERT(ok);
+   t->active = true;
+
+   if (!hrt_first || hrt_cmp(t, hrt_first) < 0)
+      hrt_first = t;
+}
+
+static void hrt_remove(struct hrtimer *t)
+{
+   DEBUG_ONLY_UNSAFE(void *res =)
+      bintree_remove(&hrt_root, t, hrt_cmp, struct hrtimer, node);
+
+   ASSERT(res != NULL);
+   bintree_node_init(&t->node);
+   t->active = false;
+
+   if (t == hrt_first)
+      hrt_first = bintree_get_first_obj(hrt_root, struct hrtimer, node);
+}
+
+/*
+ * Program the hardware timer for the first hrtimer, if it expires inside the
+ * current tick. With `force`, re-program it even if the current one-shot has
+ * already expired: that's what the timer IRQ handler does after serving it.
+ * Otherwise, an expired one-shot is left alone, because its IRQ is pending and
+ * the handler will take care of everything.
+ */
+static void hrt_program_hw(bool force)
+{
+   const u64 tick_start = __ticks * __tick_duration;
+   u32 off = 0;
+   ASSERT(!are_interrupts_enabled());
+
+   if (hwt_mode == HWT_NOHZ_IDLE)
+      return; /* nohz_irq_enter() will run before anything else */
+
+   if (hrt_first && hrt_first->expires < tick_start + __tick_duration) {
+      off = hrt_first->expires > tick_start
+         ? (u32)(hrt_first->expires - tick_start)
+         : 1;
+   }
+
+   if (hwt_mode == HWT_PERIODIC) {
+
+      if (off && hw_timer_subtick_start(off)) {
+         hwt_mode = HWT_SUBTICK;
+         hrt_event = tick_start + off;
+      }
+
+   } else if (force || !hw_timer_oneshot_expired()) {
+
+      if (hw_timer_subtick_next(off)) {
+         hwt_mode = HWT_SUBTICK;
+         hrt_event = tick_start + off;
+      } else {
+         hwt_mode = HWT_RESYNC;
+      }
+   }
+}
+
+static void hrt_run_expired(u64 now)
+{
+   struct hrtimer *t;
+   ASSERT(!are_interrupts_enabled());
+
+   while ((t = hrt_first) && t->expires <= now) {
+      hrt_remove(t);
+      t->func(t);
+   }
+}
+
+/* Called on each tick, after the wheel */
+static void hrt_tick(void)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      hrt_run_expired(__ticks * __tick_duration + ns_since_last_tick());
+      hrt_program_hw(true);
+   }
+   enable_interrupts(&var);
+}
+
+/* Called for the sub-tick one-shot IRQs, with interrupts disabled */
+static void hrt_subtick_irq(void)
+{
+   u64 now = __ticks * __tick_duration;
+   ASSERT(!are_interrupts_enabled());
+
+   /*
+    * With the TSC clocksource, we know exactly how much time has passed. Else,
+    * assume the event we've programmed has just fired.
+    */
+   now = tsc_per_tick ? now + ns_since_last_tick() : MAX(now, hrt_event);
+
+   hrt_run_expired(now);
+   hrt_program_hw(true);
+}
+
+/*
+ * Returns the number of ticks, in [1, max], from now until the last tick
+ * boundary before the first hrtimer expires. Used by the NO_HZ code.
+ */
+static u32 hrt_ticks_until_first(u32 max)
+{
+   u64 t;
+   ASSERT(!are_interrupts_enabled());
+
+   if (!hrt_first)
+      return max;
+
+   t = hrt_first->expires / __tick_duration;
+
+   if (t <= __ticks)
+      return 1;
+
+   return (u32)MIN(t - __ticks, (u64)max);
+}
+
+void hrtimer_init(struct hrtimer *t, hrtimer_func func)
+{
+   bintree_node_init(&t->node);
+   t->expires = 0;
+   t->func = func;
+   t->active = false;
+}
+
+/* (Re-)start the timer `t`, to expire at the absolute monotonic time given */
+void hrtimer_start(struct hrtimer *t, u64 expires)
+{
+   ulong var;
+   ASSERT(t->func != NULL);
+
+   disable_interrupts(&var);
+   {
+      if (t->active)
+         hrt_remove(t);
+
+      t->expires = expires;
+      hrt_insert(t);
+
+      if (t == hrt_first)
+         hrt_program_hw(false);
+   }
+   enable_interrupts(&var);
+}
+
+/* Stop the timer `t`. Returns true if it was active. */
+bool hrtimer_cancel(struct hrtimer *t)
+{
+   bool was_active;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      was_active = t->active;
+
+      if (was_active)
+         hrt_remove(t);
+
+      /*
+       * Note: we don't bother re-programming the hardware timer here. In the
+       * worst case, we'll get a sub-tick IRQ with nothing to do.
+       */
+   }
+   enable_interrupts(&var);
+   return was_active;
+}
+
+/*
+ * The expiry time for a timer `ns` (TS_SCALE units) from now. Without the TSC
+ * clocksource, we don't know where we are inside the current tick: add a whole
+ * tick, in order to never expire too early.
+ */
+u64 hrtimer_expiry_in(u64 ns)
+{
+   u64 now = get_mono_time();
+
+   if (!has_tsc_clocksource())
+      now += __tick_duration;
+
+   return ns < UINT64_MAX - now ? now + ns : UINT64_MAX;
+}
+
+static void task_wakeup_hrtimer_func(struct hrtimer *t)
+{
+   struct task *ti = CONTAINER_OF(t, struct task, wakeup_hrtimer);
+
+   ti->timer_ready = true;
+
+   if (ti->state == TASK_STATE_SLEEPING) {
+      task_change_state(ti, TASK_STATE_RUNNABLE);
+      sched_set_need_resched();
+   }
+}
+
+/*
+ * Like task_set_wakeup_timer(), but with an absolute monotonic time instead of
+ * a number of ticks. A task has at most one wakeup timer of either kind.
+ */
+void task_set_wakeup_hrtimer(struct task *ti, u64 expires)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      if (ti->wakeup_timer_tick != 0) {
+         tw_remove_timer(ti);
+         ti->wakeup_timer_tick = 0;
+      }
+
+      ti->wakeup_hrtimer.func = &task_wakeup_hrtimer_func;
+      hrtimer_start(&ti->wakeup_hrtimer, expires);
+   }
+   enable_interrupts(&var);
+}
+
+void kernel_sleep_until(u64 deadline)
+{
+   struct task *curr = get_curr_task();
+
+   if (in_panic())
+      return; /* See kernel_sleep() */
+
+   DEBUG_ONLY(check_not_in_irq_handler());
+
+   do {
+
+      if (pending_signals())
+         break;
+
+      disable_preemption();
+      task_change_state(curr, TASK_STATE_SLEEPING);
+      task_set_wakeup_hrtimer(curr, deadline);
+      kernel_yield_preempt_disabled();
+
+   } while (curr->wakeup_hrtimer.active); /* Woken up for some other reason */
+
+   task_cancel_wakeup_timer(curr);
+}
+
 static void do_sleep_internal(u32 ticks)
 {
    ASSERT(are_interrupts_enabled());
@@ -213,14 +831,12 @@ void kernel_sleep(u64 ticks)
     *    }
     *    kernel_yield();
     *
-    * But that would require task->ticks_before_wake_up to be actually 64-bit,
-    * wide and that's bad on 32-bit systems because:
+    * But that would require task_set_wakeup_timer() to accept 64-bit values
+    * and that's bad on 32-bit systems because it would require using the soft
+    * 64-bit integers (slow) in all of its callers, while a 32-bit counter
+    * is more than enough in 99.9% of the cases.
     *
-    *    - it would require using the soft 64-bit integers (slow)
-    *    - it would make impossible, in the case we wanted that, the counter
-    *      to be atomic.
-    *
-    * Therefore, in order to use a 32-bit value for 'ticks_before_wake_up' and,
+    * Therefore, in order to use a 32-bit value for the wakeup timer and,
     * at the same time being able to sleep for more than 2^32-1 ticks, we need
     * a more tricky implementation (below), and the little extra runtime price
     * for it is totally fine, since we're going to sleep anyways!
@@ -229,7 +845,7 @@ void kernel_sleep(u64 ticks)
     * ----------------------
     *
     * The simpler way to explain the algorithm is to just assume everything
-    * is in base 10 and that ticks_before_wake_up has 2 digits, while we want
+    * is in base 10 and that the wakeup timer has 2 digits, while we want
     * to support 4 digits sleep time. For example, we want to sleep for 234
     * ticks. The algorithm first computes 534 % 100 = 34 and then 534 / 100 = 5.
     * After that, it sleeps q (= 5) times for 99 ticks (max allowed). Clearly,
@@ -299,6 +915,23 @@ static enum irq_action timer_irq_handler(void *ctx)
    u32 ns_delta;
    ASSERT(are_interrupts_enabled());
 
+   disable_interrupts_forced();
+   {
+      if (hwt_mode == HWT_SUBTICK) {
+
+         /*
+          * Not a tick: just a sub-tick event for the hrtimers. It's handled
+          * entirely with interrupts disabled, therefore it's fine even when
+          * nested in a regular tick, and it must never be skipped, as nothing
+          * else would re-program the one-shot.
+          */
+         hrt_subtick_irq();
+         enable_interrupts_forced();
+         return IRQ_HANDLED;
+      }
+   }
+   enable_interrupts_forced();
+
    if (KRN_TRACK_NESTED_INTERR)
       if (timer_nested_irq())
          return IRQ_HANDLED;
@@ -310,16 +943,13 @@ static enum irq_action timer_irq_handler(void *ctx)
     *
     *    1. `__tick_duration` is immutable
     *    2. `__tick_adj_val` is changed only by datetime.c while keeping
-    *       interrupts disabled and it's read only here. Nested timer IRQs
-    *       will be ignored (see above). No other IRQ handler should read it.
+    *       interrupts disabled and it's read only here and in nohz_catch_up(),
+    *       which runs with interrupts disabled on the idle task. Nested timer
+    *       IRQs will be ignored (see above). No other IRQ handler should read
+    *       it.
     */
 
-   if (__tick_adj_ticks_rem) {
-      ns_delta = (u32)((s32)__tick_duration + __tick_adj_val);
-      __tick_adj_ticks_rem--;
-   } else {
-      ns_delta = __tick_duration;
-   }
+   ns_delta = next_tick_ns_delta();
 
    disable_interrupts_forced();
    {
@@ -331,11 +961,17 @@ static enum irq_action timer_irq_handler(void *ctx)
        */
       __ticks++;
       __time_ns += ns_delta;
+
+      if (tsc_per_tick)
+         __tick_tsc = RDTSC();
+
+      vdso_update_time();
    }
    enable_interrupts_forced();
 
    sched_account_ticks();
    tick_all_timers();
+   hrt_tick();
    return IRQ_HANDLED;
 }
 
@@ -348,8 +984,20 @@ struct bogo_measure_ctx {
    bool started;
    bool pass_start;
    u32 ticks;
+   u64 tsc_start;
 };
 
+static void tsc_calibrate(u64 start, u64 end)
+{
+   const u64 per_tick = (end - start) / MEASURE_BOGOMIPS_TICKS;
+
+   if (!per_tick || per_tick > 0xffffffff)
+      return; /* Something went wrong: don't use the TSC */
+
+   tsc_ns_mult = ((u64)__tick_duration << TSC_NS_SHIFT) / per_tick;
+   tsc_per_tick = (u32)per_tick;
+}
+
 static enum irq_action measure_bogomips_irq_handler(void *arg)
 {
    struct bogo_measure_ctx *ctx = arg;
@@ -370,6 +1018,10 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
        */
       __bogo_loops = 0;
       ctx->pass_start = true;
+
+      if (cpu_has_tsc())
+         ctx->tsc_start = RDTSC();
+
       return IRQ_NOT_HANDLED;
    }
 
@@ -385,6 +1037,13 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
          loops_per_ms = loops_per_tick / (1000 / TIMER_HZ);
          loops_per_us = loops_per_ms / 1000;
          __bogo_loops = -1;
+
+         /*
+          * Calibrate the TSC as well, using the same ticks. The regular timer
+          * IRQ handler, which runs after us, will set `__tick_tsc`.
+          */
+         if (cpu_has_tsc())
+            tsc_calibrate(ctx->tsc_start, RDTSC());
       }
       enable_interrupts_forced();
    }
@@ -405,6 +1064,14 @@ static void do_bogomips_loop(void *arg)
    }
    enable_preemption();
    printk("Tilck bogoMips: %u.%03u\n", loops_per_us, loops_per_ms % 1000);
+
+   if (tsc_per_tick) {
+
+      const u64 khz = (u64)tsc_per_tick * (TS_SCALE / 1000) / __tick_duration;
+
+      printk("TSC clocksource: %u.%03u MHz\n",
+             (u32)(khz / 1000), (u32)(khz % 1000));
+   }
 }
 
 void delay_us(u32 us)
@@ -427,6 +1094,7 @@ void init_timer(void)
    measure_bogomips.context = &ctx;
 
    __tick_duration = hw_timer_setup(TS_SCALE / TIMER_HZ);
+   tw_init();
 
    printk("*** Init the kernel timer\n");
 
@@ -0,0 +1,492 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/timerfd.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/user.h>
+
+#include <sys/timerfd.h>   // system header
+
+/*
+ * timerfd
+ * ---------
+ *
+ * A timerfd is an hrtimer (see timer.h) plus an expiration counter, readable
+ * with read(). Both CLOCK_MONOTONIC and CLOCK_REALTIME are supported, but the
+ * timer always runs on the monotonic clock: absolute CLOCK_REALTIME times are
+ * converted when the timer is armed. Therefore, changes to the system time
+ * while the timer is armed are not taken into account.
+ *
+ * The hrtimer callback runs in IRQ context, where the kconds cannot be
+ * signaled: it just updates the counter and, if needed, enqueues a bottom
+ * half on a worker thread to wake up the readers. The pending bottom half
+ * holds a reference to the object. All the state touched by the callback is
+ * protected by disabling the interrupts.
+ */
+
+struct timerfd {
+
+   KOBJ_BASE_FIELDS
+
+   clockid_t clk_id;
+   struct hrtimer timer;
+   u64 interval;                 /* 0 for one-shot timers (TS_SCALE units) */
+   u64 expirations;              /* not read yet */
+   bool bh_pending;
+   struct kcond rd_cond;
+
+   ATOMIC(int) handles;
+};
+
+static void tfd_bottom_half(void *arg)
+{
+   struct timerfd *t = arg;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      t->bh_pending = false;
+   }
+   enable_interrupts(&var);
+
+   kcond_signal_all(&t->rd_cond);
+
+   if (release_obj(t) == 0)
+      destroy_timerfd(t); /* All the handles have been closed meanwhile */
+}
+
+/* Runs in IRQ context, with interrupts disabled */
+static void tfd_timer_func(struct hrtimer *h)
+{
+   struct timerfd *t = CONTAINER_OF(h, struct timerfd, timer);
+   u64 now, n = 1;
+
+   if (t->interval) {
+
+      /* Account all the periods elapsed since the expiration, if any */
+      now = get_mono_time();
+
+      if (now > h->expires)
+         n += (now - h->expires) / t->interval;
+
+      hrtimer_start(h, h->expires + n * t->interval);
+   }
+
+   t->expirations += n;
+
+   if (t->bh_pending)
+      return;
+
+   retain_obj(t);
+
+   if (!wth_enqueue_anywhere(WTH_PRIO_LOWEST, &tfd_bottom_half, t)) {
+      printk("WARNING: timerfd: unable to enqueue job\n");
+      release_obj(t);
+      return;
+   }
+
+   t->bh_pending = true;
+}
+
+static ssize_t tfd_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct task *curr = get_curr_task();
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   u64 val;
+   ulong var;
+
+   if (size < sizeof(u64))
+      return -EINVAL;
+
+   while (true) {
+
+      disable_preemption();
+      disable_interrupts(&var);
+      {
+         val = t->expirations;
+         t->expirations = 0;
+      }
+      enable_interrupts(&var);
+
+      if (val)
+         break;
+
+      if (kh->fl_flags & O_NONBLOCK) {
+         enable_preemption();
+         return -EAGAIN;
+      }
+
+      /*
+       * The bottom half cannot run before we're in the wait list, because
+       * it runs in a worker thread and the preemption is disabled.
+       */
+      prepare_to_wait_on(WOBJ_KCOND, &t->rd_cond, NO_EXTRA,
+                         &t->rd_cond.wait_list);
+
+      enter_sleep_wait_state();
+      wait_obj_reset(&curr->wobj);
+
+      if (pending_signals())
+         return -EINTR;
+   }
+
+   enable_preemption();
+   memcpy(buf, &val, sizeof(val));
+   return sizeof(val);
+}
+
+static int tfd_read_ready(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   bool ret;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      ret = t->expirations > 0;
+   }
+   enable_interrupts(&var);
+   return ret;
+}
+
+static struct kcond *tfd_get_rready_cond(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   return &t->rd_cond;
+}
+
+static const struct file_ops static_ops_timerfd =
+{
+   .read = tfd_read,
+   .read_ready = tfd_read_ready,
+   .get_rready_cond = tfd_get_rready_cond,
+};
+
+void destroy_timerfd(struct timerfd *t)
+{
+   ASSERT(!t->timer.active);
+   ASSERT(!t->bh_pending);
+
+   kcond_destory(&t->rd_cond);
+   kfree_obj(t, struct timerfd);
+}
+
+static void tfd_on_handle_close(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   int old;
+
+   old = atomic_fetch_sub_explicit(&t->handles, 1, mo_relaxed);
+   ASSERT(old > 0);
+
+   if (old == 1) {
+
+      /*
+       * Stop the timer, so that no new bottom half will be enqueued: the
+       * object will be destroyed as soon as all its references are dropped.
+       */
+      hrtimer_cancel(&t->timer);
+   }
+}
+
+static void tfd_on_handle_dup(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct timerfd *t = (void *)kh->kobj;
+   atomic_fetch_add_explicit(&t->handles, 1, mo_relaxed);
+}
+
+struct timerfd *create_timerfd(clockid_t clk_id)
+{
+   struct timerfd *t;
+
+   if (!(t = (void *)kzalloc_obj(struct timerfd)))
+      return NULL;
+
+   t->on_handle_close = &tfd_on_handle_close;
+   t->on_handle_dup = &tfd_on_handle_dup;
+   t->destory_obj = (void *)&destroy_timerfd;
+   t->clk_id = clk_id;
+   hrtimer_init(&t->timer, &tfd_timer_func);
+   kcond_init(&t->rd_cond);
+   return t;
+}
+
+fs_handle timerfd_create_handle(struct timerfd *t, int fl_flags)
+{
+   fs_handle res;
+
+   res = kfs_create_new_handle(&static_ops_timerfd, (void *)t, fl_flags);
+
+   if (res != NULL)
+      atomic_fetch_add_explicit(&t->handles, 1, mo_relaxed);
+
+   return res;
+}
+
+/* Must be called with interrupts disabled */
+static void
+tfd_get_time(struct timerfd *t, struct k_itimerspec64 *curr)
+{
+   u64 now, rem = 0;
+   ASSERT(!are_interrupts_enabled());
+
+   if (t->timer.active) {
+      now = get_mono_time();
+      rem = t->timer.expires > now ? t->timer.expires - now : 1;
+   }
+
+   *curr = (struct k_itimerspec64) { 0 };
+   ns_to_timespec(t->interval, &curr->it_interval);
+   ns_to_timespec(rem, &curr->it_value);
+}
+
+static int
+tfd_settime(struct timerfd *t,
+            int flags,
+            const struct k_itimerspec64 *new_val,
+            struct k_itimerspec64 *old_val)
+{
+   struct k_timespec64 now_ts;
+   u64 value, expires = 0;
+   ulong var;
+
+   /*
+    * TFD_TIMER_CANCEL_ON_SET is not supported: changes to the system time are
+    * not taken into account (see above), so we could never report them with
+    * -ECANCELED. Better fail than silently ignore the flag.
+    */
+   if (flags & ~TFD_TIMER_ABSTIME)
+      return -EINVAL;
+
+   if (!is_valid_timespec(&new_val->it_value) ||
+       !is_valid_timespec(&new_val->it_interval))
+   {
+      return -EINVAL;
+   }
+
+   value = timespec_to_ns(&new_val->it_value);
+
+   if (!value) {
+
+      /* Disarm the timer */
+
+   } else if (!(flags & TFD_TIMER_ABSTIME)) {
+
+      expires = hrtimer_expiry_in(value);
+
+   } else if (t->clk_id == CLOCK_MONOTONIC) {
+
+      expires = value;
+
+   } else {
+
+      /* Convert the absolute CLOCK_REALTIME time to the monotonic clock */
+      real_time_get_timespec(&now_ts);
+      expires = timespec_to_ns(&now_ts);
+      expires = hrtimer_expiry_in(value > expires ? value - expires : 0);
+   }
+
+   disable_interrupts(&var);
+   {
+      tfd_get_time(t, old_val);
+      hrtimer_cancel(&t->timer);
+
+      t->interval = timespec_to_ns(&new_val->it_interval);
+      t->expirations = 0;
+
+      /* Don't re-arm the timer if all the handles have been closed */
+      if (expires && atomic_load_explicit(&t->handles, mo_relaxed) > 0)
+         hrtimer_start(&t->timer, expires);
+   }
+   enable_interrupts(&var);
+   return 0;
+}
+
+/*
+ * Get the timerfd for `fd` and retain it: a concurrent close() must not
+ * destroy it while we're using it.
+ */
+static int tfd_get(int fd, struct timerfd **t)
+{
+   struct process *pi = get_curr_proc();
+   struct kfs_handle *kh;
+   int rc = 0;
+
+   kmutex_lock(&pi->fslock);
+   {
+      kh = get_fs_handle(fd);
+
+      if (!kh)
+         rc = -EBADF;
+      else if (kh->fops != &static_ops_timerfd)
+         rc = -EINVAL;
+      else
+         retain_obj((*t = (void *)kh->kobj));
+   }
+   kmutex_unlock(&pi->fslock);
+   return rc;
+}
+
+static void tfd_put(struct timerfd *t)
+{
+   if (release_obj(t) == 0)
+      destroy_timerfd(t);
+}
+
+static int
+do_timerfd_settime(int fd,
+                   int flags,
+                   const struct k_itimerspec64 *new_val,
+                   struct k_itimerspec64 *old_val)
+{
+   struct timerfd *t;
+   int rc;
+
+   if ((rc = tfd_get(fd, &t)))
+      return rc;
+
+   rc = tfd_settime(t, flags, new_val, old_val);
+   tfd_put(t);
+   return rc;
+}
+
+static int
+do_timerfd_gettime(int fd, struct k_itimerspec64 *curr)
+{
+   struct timerfd *t;
+   ulong var;
+   int rc;
+
+   if ((rc = tfd_get(fd, &t)))
+      return rc;
+
+   disable_interrupts(&var);
+   {
+      tfd_get_time(t, curr);
+   }
+   enable_interrupts(&var);
+
+   tfd_put(t);
+   return 0;
+}
+
+static void
+itimerspec_32_to_64(const struct k_itimerspec32 *src,
+                    struct k_itimerspec64 *dst)
+{
+   *dst = (struct k_itimerspec64) {
+      .it_interval = {
+         .tv_sec = src->it_interval.tv_sec,
+         .tv_nsec = src->it_interval.tv_nsec,
+      },
+      .it_value = {
+         .tv_sec = src->it_value.tv_sec,
+         .tv_nsec = src->it_value.tv_nsec,
+      },
+   };
+}
+
+static void
+itimerspec_64_to_32(const struct k_itimerspec64 *src,
+                    struct k_itimerspec32 *dst)
+{
+   *dst = (struct k_itimerspec32) {
+      .it_interval = to_k_timespec32(src->it_interval),
+      .it_value = to_k_timespec32(src->it_value),
+   };
+}
+
+int sys_timerfd_settime(int fd,
+                        int flags,
+                        const struct k_itimerspec64 *u_new,
+                        struct k_itimerspec64 *u_old)
+{
+   struct k_itimerspec64 new_val, old_val;
+   int rc;
+
+   if (copy_from_user(&new_val, u_new, sizeof(new_val)))
+      return -EFAULT;
+
+   if ((rc = do_timerfd_settime(fd, flags, &new_val, &old_val)))
+      return rc;
+
+   if (u_old && copy_to_user(u_old, &old_val, sizeof(old_val)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_gettime(int fd, struct k_itimerspec64 *u_curr)
+{
+   struct k_itimerspec64 curr;
+   int rc;
+
+   if ((rc = do_timerfd_gettime(fd, &curr)))
+      return rc;
+
+   if (copy_to_user(u_curr, &curr, sizeof(curr)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_settime32(int fd,
+                          int flags,
+                          const struct k_itimerspec32 *u_new,
+                          struct k_itimerspec32 *u_old)
+{
+   struct k_itimerspec32 new32, old32;
+   struct k_itimerspec64 new_val, old_val;
+   int rc;
+
+   if (copy_from_user(&new32, u_new, sizeof(new32)))
+      return -EFAULT;
+
+   itimerspec_32_to_64(&new32, &new_val);
+
+   if ((rc = do_timerfd_settime(fd, flags, &new_val, &old_val)))
+      return rc;
+
+   itimerspec_64_to_32(&old_val, &old32);
+
+   if (u_old && copy_to_user(u_old, &old32, sizeof(old32)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_timerfd_gettime32(int fd, struct k_itimerspec32 *u_curr)
+{
+   struct k_itimerspec32 curr32;
+   struct k_itimerspec64 curr;
+   int rc;
+
+   if ((rc = do_timerfd_gettime(fd, &curr)))
+      return rc;
+
+   itimerspec_64_to_32(&curr, &curr32);
+
+   if (copy_to_user(u_curr, &curr32, sizeof(curr32)))
+      return -EFAULT;
+
+   return 0;
+}
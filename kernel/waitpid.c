@@ -154,7 +154,11 @@ void wake_up_tasks_waiting_on(struct task *ti, enum wakeup_reason r)
          wake_up(task_to_wake_up);
    }
 
-   if (LIKELY(pi->parent_pid > 0)) {
+   /*
+    * Only the main thread represents the process for its parent: the other
+    * threads are waited for just by the main one, in terminate_process().
+    */
+   if (LIKELY(pi->parent_pid > 0) && is_main_thread(ti)) {
 
       struct task *parent_task = get_task(pi->parent_pid);
       int tid;
@@ -265,14 +269,15 @@ int sys_wait4(int tid, int *user_wstatus, int options, void *user_rusage)
 
       struct k_rusage ru = {0};
       struct k_timespec64 tp;
-      u64 user_ticks = chtask->ticks.total - chtask->ticks.total_kernel;
+      u64 ticks, kernel_ticks;
 
-      ticks_to_timespec(user_ticks, &tp);
+      process_get_ticks(chtask->pi, &ticks, &kernel_ticks);
+      ticks_to_timespec(ticks - kernel_ticks, &tp);
 
       ru.ru_utime.tv_sec = (long) tp.tv_sec;
       ru.ru_utime.tv_usec = tp.tv_nsec / 1000;
 
-      ticks_to_timespec(chtask->ticks.total_kernel, &tp);
+      ticks_to_timespec(kernel_ticks, &tp);
       ru.ru_stime.tv_sec = (long) tp.tv_sec;
       ru.ru_stime.tv_usec = tp.tv_nsec / 1000;
 
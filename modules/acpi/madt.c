@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/string_util.h>
+
+#include "acpi_int.h"
+
+static void
+madt_handle_ioapic(struct acpi_madt_info *info, ACPI_MADT_IO_APIC *io)
+{
+   /*
+    * We support just a single IO-APIC: the one handling the legacy ISA IRQs,
+    * which is (virtually) always the one starting at GSI 0.
+    */
+
+   if (info->ioapic_paddr && io->GlobalIrqBase != 0)
+      return;
+
+   info->ioapic_paddr = io->Address;
+   info->ioapic_gsi_base = io->GlobalIrqBase;
+}
+
+static void
+madt_handle_override(struct acpi_madt_info *info,
+                     ACPI_MADT_INTERRUPT_OVERRIDE *ov)
+{
+   const u16 polarity = ov->IntiFlags & ACPI_MADT_POLARITY_MASK;
+   const u16 trigger = ov->IntiFlags & ACPI_MADT_TRIGGER_MASK;
+   u8 flags = 0;
+
+   if (ov->Bus != 0 || ov->SourceIrq >= ARRAY_SIZE(info->isa_gsi))
+      return; /* Not an ISA IRQ */
+
+   /* "Conforms" means: use the default of the bus. ISA is active-high, edge */
+
+   if (polarity == ACPI_MADT_POLARITY_ACTIVE_LOW)
+      flags |= MADT_IRQ_ACTIVE_LOW;
+
+   if (trigger == ACPI_MADT_TRIGGER_LEVEL)
+      flags |= MADT_IRQ_LEVEL;
+
+   info->isa_gsi[ov->SourceIrq] = ov->GlobalIrq;
+   info->isa_flags[ov->SourceIrq] = flags;
+}
+
+bool
+acpi_read_madt(struct acpi_madt_info *info)
+{
+   ACPI_TABLE_MADT *madt;
+   ACPI_SUBTABLE_HEADER *h;
+   ACPI_STATUS rc;
+   ulong p, end;
+
+   if (get_acpi_init_status() < ais_tables_initialized)
+      return false;
+
+   rc = AcpiGetTable(ACPI_SIG_MADT, 1, (struct acpi_table_header **)&madt);
+
+   if (rc == AE_NOT_FOUND)
+      return false;
+
+   if (ACPI_FAILURE(rc)) {
+      print_acpi_failure("AcpiGetTable", "MADT", rc);
+      return false;
+   }
+
+   bzero(info, sizeof(*info));
+   info->lapic_paddr = madt->Address;
+   info->has_8259 = !!(madt->Flags & ACPI_MADT_PCAT_COMPAT);
+
+   for (u32 i = 0; i < ARRAY_SIZE(info->isa_gsi); i++)
+      info->isa_gsi[i] = i;    /* Identity mapping, unless overridden */
+
+   p = (ulong)(madt + 1);
+   end = (ulong)madt + madt->Header.Length;
+
+   while (p + sizeof(*h) <= end) {
+
+      h = (void *)p;
+
+      if (h->Length < sizeof(*h) || p + h->Length > end)
+         break; /* Corrupted table */
+
+      switch (h->Type) {
+
+         case ACPI_MADT_TYPE_IO_APIC:
+            madt_handle_ioapic(info, (void *)h);
+            break;
+
+         case ACPI_MADT_TYPE_INTERRUPT_OVERRIDE:
+            madt_handle_override(info, (void *)h);
+            break;
+
+         case ACPI_MADT_TYPE_LOCAL_APIC_OVERRIDE:
+         {
+            ACPI_MADT_LOCAL_APIC_OVERRIDE *lo = (void *)h;
+
+            if ((ulong)lo->Address == lo->Address)
+               info->lapic_paddr = (ulong)lo->Address;
+
+            break;
+         }
+
+         default:
+            break;
+      }
+
+      p += h->Length;
+   }
+
+   AcpiPutTable((struct acpi_table_header *)madt);
+   return info->lapic_paddr && info->ioapic_paddr;
+}
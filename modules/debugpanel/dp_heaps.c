@@ -5,6 +5,7 @@
 
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/kmalloc_debug.h>
+#include <tilck/kernel/kmem_cache.h>
 
 #include "termutil.h"
 #include "dp_int.h"
@@ -12,6 +13,7 @@
 static size_t heaps_alloc[KMALLOC_HEAPS_COUNT];
 static struct debug_kmalloc_heap_info hi;
 static struct debug_kmalloc_stats stats;
+static struct debug_kmem_cache_info ci;
 static size_t tot_usable_mem_kb;
 static size_t tot_used_mem_kb;
 static long tot_diff;
@@ -42,6 +44,47 @@ static void dp_heaps_on_enter(void)
    debug_kmalloc_get_stats(&stats);
 }
 
+static void dp_show_kmem_caches(int row)
+{
+   dp_writeln(
+      "    cache    "
+      TERM_VLINE " size "
+      TERM_VLINE " active "
+      TERM_VLINE "  peak  "
+      TERM_VLINE " free "
+      TERM_VLINE " refills "
+      TERM_VLINE "   allocs   "
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqqqqqnqqqqqqnqqqqqqqqnqqqqqqqqnqqqqqqnqqqqqqqqqnqqqqqqqqqqqq"
+      GFX_OFF
+   );
+
+   for (int i = 0; debug_kmem_cache_get_info(i, &ci); i++) {
+
+      dp_writeln(
+         " %-11s "
+         TERM_VLINE " %4u "
+         TERM_VLINE " %6u "
+         TERM_VLINE " %6u "
+         TERM_VLINE " %4u "
+         TERM_VLINE " %7u "
+         TERM_VLINE " %10llu ",
+         ci.name,
+         ci.elem_size,
+         ci.active,
+         ci.peak_active,
+         ci.free_count,
+         ci.refills,
+         ci.allocs
+      );
+   }
+
+   dp_writeln("");
+}
+
 static void dp_show_kmalloc_heaps(void)
 {
    int row = dp_screen_start_row;
@@ -121,6 +164,7 @@ static void dp_show_kmalloc_heaps(void)
    }
 
    dp_writeln("");
+   dp_show_kmem_caches(row);
 }
 
 static void dp_heaps_on_exit(void)
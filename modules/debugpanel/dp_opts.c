@@ -87,6 +87,7 @@ static void dp_show_opts(void)
    DUMP_BOOL_OPT(BOOT_INTERACTIVE);
    DUMP_BOOL_OPT(KERNEL_64BIT_OFFT);
    DUMP_BOOL_OPT(KRN_CLOCK_DRIFT_COMP);
+   DUMP_BOOL_OPT(KRN_NO_HZ_IDLE);
 
    DUMP_LABEL("Disabled by default");
    DUMP_BOOL_OPT(KRN_NO_SYS_WARN);
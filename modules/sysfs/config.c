@@ -50,6 +50,7 @@ DEF_STATIC_CONF_RO(BOOL,  mmap_no_cow,             MMAP_NO_COW);
 DEF_STATIC_CONF_RO(BOOL,  ubsan,                   KERNEL_UBSAN);
 DEF_STATIC_CONF_RO(BOOL,  kernel_64bit_offt,       KERNEL_64BIT_OFFT);
 DEF_STATIC_CONF_RO(BOOL,  clock_drift_comp,        KRN_CLOCK_DRIFT_COMP);
+DEF_STATIC_CONF_RO(BOOL,  no_hz_idle,              KRN_NO_HZ_IDLE);
 
 /* config/console */
 DEF_STATIC_CONF_RO(ULONG, big_font_threshold,      FBCON_BIGFONT_THR);
@@ -115,6 +116,7 @@ void sysfs_create_config_obj(void)
       SYSOBJ_CONF_PROP_PAIR(ubsan),
       SYSOBJ_CONF_PROP_PAIR(kernel_64bit_offt),
       SYSOBJ_CONF_PROP_PAIR(clock_drift_comp),
+      SYSOBJ_CONF_PROP_PAIR(no_hz_idle),
       NULL
    );
 
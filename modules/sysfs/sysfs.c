@@ -25,6 +25,7 @@
 #include "lock_and_retain.c.h"
 
 void sysfs_create_config_obj(void);
+void sysfs_create_tunables_obj(void);
 static struct mnt_fs *sysfs;
 
 static int
@@ -756,6 +757,7 @@ init_sysfs(void)
       panic("Unable to create default objects");
 
    sysfs_create_config_obj();
+   sysfs_create_tunables_obj();
 }
 
 static struct module sysfs_module = {
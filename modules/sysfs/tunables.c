@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/pipe.h>
+#include <tilck/kernel/errno.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+/*
+ * Run-time tunables: unlike the properties in /syst/config, those are
+ * writable and backed directly by kernel variables.
+ */
+
+static offt
+pipe_max_size_load(struct sysobj *obj,
+                   void *data,
+                   void *buf,
+                   offt buf_sz,
+                   offt off)
+{
+   ASSERT(off == 0);
+   return snprintk(buf, (size_t)buf_sz, "%lu\n", *(ulong *)data);
+}
+
+static offt
+pipe_max_size_store(struct sysobj *obj,
+                    void *data,
+                    void *buf,
+                    offt buf_sz)
+{
+   int err = 0;
+   ulong val;
+   char tmp[32] = {0};
+   memcpy(tmp, buf, (size_t)MIN(buf_sz, (offt)sizeof(tmp) - 1));
+
+   val = tilck_strtoul(tmp, NULL, 10, &err);
+
+   /* Pipes cannot be smaller than one page, nor bigger than what fits an int */
+   if (err || val < PAGE_SIZE || val > INT32_MAX - PAGE_SIZE)
+      return -EINVAL;
+
+   /* Like F_SETPIPE_SZ, round the value up to a multiple of the page size */
+   *(ulong *)data = pow2_round_up_at(val, PAGE_SIZE);
+   return buf_sz;
+}
+
+static const struct sysobj_prop_type ptype_pipe_max_size = {
+   .load = &pipe_max_size_load,
+   .store = &pipe_max_size_store,
+};
+
+DEF_STATIC_SYSOBJ_PROP(pipe_max_size, &ptype_pipe_max_size);
+
+void sysfs_create_tunables_obj(void)
+{
+   struct sysobj *tunables;
+
+   tunables = sysfs_create_custom_obj(
+      "tunables",
+      NULL,       /* hooks */
+      &prop_pipe_max_size, &pipe_max_size,
+      NULL
+   );
+
+   if (!tunables)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "tunables", tunables))
+      goto fail;
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs tunables obj");
+}
@@ -78,7 +78,7 @@ sysfs_ulong_store(struct sysobj *obj,
    int err = 0;
    ulong val;
    char tmp[32] = {0};
-   memcpy(tmp, buf, (size_t)MAX(buf_sz, 31));
+   memcpy(tmp, buf, (size_t)MIN(buf_sz, (offt)sizeof(tmp) - 1));
 
    val = tilck_strtoul(tmp, NULL, 10, &err);
 
@@ -126,7 +126,7 @@ sysfs_long_store(struct sysobj *obj,
    int err = 0;
    long val;
    char tmp[32] = {0};
-   memcpy(tmp, buf, (size_t)MAX(buf_sz, (offt)sizeof(tmp) - 1));
+   memcpy(tmp, buf, (size_t)MIN(buf_sz, (offt)sizeof(tmp) - 1));
 
    val = tilck_strtol(tmp, NULL, 10, &err);
 
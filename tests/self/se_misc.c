@@ -86,6 +86,47 @@ void selftest_sleep()
 
 REGISTER_SELF_TEST(sleep, se_short, &selftest_sleep)
 
+/*
+ * Sleep times chosen to hit both the first two levels of the timer wheel and
+ * the boundaries between them (see kernel/timer.c).
+ */
+static const u32 timer_wheel_test_ticks[] = {
+   1, 2, 3, 62, 63, 64, 65, 66, 127, 128, 129, 191, 200, 255, 256, 300
+};
+
+static void timer_wheel_test_kthread(void *arg)
+{
+   const u32 wait_ticks = timer_wheel_test_ticks[(ulong)arg];
+   const u64 before = get_ticks();
+
+   kernel_sleep(wait_ticks);
+
+   const u64 elapsed = get_ticks() - before;
+
+   if (elapsed < wait_ticks || elapsed - wait_ticks > TIMER_HZ / 10) {
+      panic("[timer_wheel] elapsed ticks: %" PRIu64 " (expected: %u)\n",
+            elapsed, wait_ticks);
+   }
+}
+
+void selftest_timer_wheel()
+{
+   int tids[ARRAY_SIZE(timer_wheel_test_ticks)];
+
+   for (ulong i = 0; i < ARRAY_SIZE(tids); i++) {
+
+      tids[i] = kthread_create(&timer_wheel_test_kthread, 0, (void *)i);
+
+      if (tids[i] < 0)
+         panic("Unable to create timer_wheel_test_kthread");
+   }
+
+   kthread_join_all(tids, ARRAY_SIZE(tids), true);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(timer_wheel, se_short, &selftest_timer_wheel)
+
 void selftest_join()
 {
    int tid;
@@ -11,6 +11,7 @@
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/self_tests.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
 
 extern u32 __tick_duration;
 extern int __tick_adj_ticks_rem;
@@ -181,3 +182,37 @@ void selftest_clock_latency(void)
 }
 
 REGISTER_SELF_TEST(clock_latency, se_long, &selftest_clock_latency)
+
+void selftest_mono_time(void)
+{
+   const int iters = 200 * 1000;
+   u64 prev_sys = get_sys_time();
+   u64 prev_mono = get_mono_time();
+   u64 sys, mono;
+   u32 sub_tick_steps = 0;
+
+   for (int i = 0; i < iters && !se_is_stop_requested(); i++) {
+
+      sys = get_sys_time();
+      mono = get_mono_time();
+
+      VERIFY(sys >= prev_sys);
+      VERIFY(mono >= prev_mono);
+
+      if (mono > prev_mono && mono - prev_mono < __tick_duration / 2)
+         sub_tick_steps++;
+
+      prev_sys = sys;
+      prev_mono = mono;
+   }
+
+   printk("TSC clocksource: %s\n", has_tsc_clocksource() ? "yes" : "no");
+   printk("Sub-tick increments: %u\n", sub_tick_steps);
+
+   if (has_tsc_clocksource())
+      VERIFY(sub_tick_steps > 0);
+
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(mono_time, se_short, &selftest_mono_time)
@@ -18,6 +18,7 @@ CMD_ENTRY(fork0,        TT_MED,    true)
 CMD_ENTRY(fork1,        TT_SHORT,  true)
 CMD_ENTRY(sysenter,     TT_SHORT,  true)
 CMD_ENTRY(fork_se,      TT_MED,    true)
+CMD_ENTRY(fork_cow_pt,  TT_SHORT,  true)
 CMD_ENTRY(bad_read,     TT_SHORT,  true)
 CMD_ENTRY(bad_write,    TT_SHORT,  true)
 CMD_ENTRY(fork_perf,    TT_LONG,   true)
@@ -27,6 +28,8 @@ CMD_ENTRY(fpu,          TT_SHORT,  true)
 CMD_ENTRY(brk,          TT_SHORT,  true)
 CMD_ENTRY(mmap,         TT_MED,    true)
 CMD_ENTRY(mmap2,        TT_SHORT,  true)
+CMD_ENTRY(mremap,       TT_SHORT,  true)
+CMD_ENTRY(stack_grow,   TT_SHORT,  true)
 CMD_ENTRY(kcow,         TT_SHORT,  true)
 CMD_ENTRY(wpid1,        TT_SHORT,  true)
 CMD_ENTRY(wpid2,        TT_SHORT,  true)
@@ -59,11 +62,16 @@ CMD_ENTRY(fmmap4,       TT_SHORT,  true)
 CMD_ENTRY(fmmap5,       TT_SHORT,  true)
 CMD_ENTRY(fmmap6,       TT_SHORT,  true)
 CMD_ENTRY(fmmap7,       TT_SHORT,  true)
+CMD_ENTRY(fmmap8,       TT_SHORT,  true)
 CMD_ENTRY(pipe1,        TT_SHORT,  true)
 CMD_ENTRY(pipe2,        TT_SHORT,  true)
 CMD_ENTRY(pipe3,        TT_SHORT,  true)
 CMD_ENTRY(pipe4,        TT_SHORT,  true)
 CMD_ENTRY(pipe5,        TT_SHORT,  true)
+CMD_ENTRY(pipe6,        TT_SHORT,  true)
+CMD_ENTRY(sendfile,     TT_SHORT,  true)
+CMD_ENTRY(splice,       TT_SHORT,  true)
+CMD_ENTRY(io_uring,     TT_SHORT,  true)
 CMD_ENTRY(pollerr,      TT_SHORT,  true)
 CMD_ENTRY(pollhup,      TT_SHORT,  true)
 CMD_ENTRY(poll1,        TT_SHORT,  true)
@@ -73,6 +81,11 @@ CMD_ENTRY(select1,      TT_SHORT,  true)
 CMD_ENTRY(select2,      TT_SHORT,  true)
 CMD_ENTRY(select3,      TT_SHORT,  true)
 CMD_ENTRY(select4,      TT_SHORT,  true)
+CMD_ENTRY(epoll1,       TT_SHORT,  true)
+CMD_ENTRY(epoll2,       TT_SHORT,  true)
+CMD_ENTRY(eventfd,      TT_SHORT,  true)
+CMD_ENTRY(timerfd,      TT_SHORT,  true)
+CMD_ENTRY(threads,      TT_SHORT,  true)
 CMD_ENTRY(execve0,      TT_SHORT,  true)
 CMD_ENTRY(vfork0,       TT_SHORT,  true)
 CMD_ENTRY(extra,        TT_MED,    true)
@@ -98,3 +111,5 @@ CMD_ENTRY(sigsegv5,     TT_SHORT,  true)
 CMD_ENTRY(getuids,      TT_SHORT,  true)
 CMD_ENTRY(getrusage,    TT_SHORT,  true)
 CMD_ENTRY(exit_cb,      TT_SHORT,  true)
+CMD_ENTRY(vdso,         TT_SHORT,  true)
+CMD_ENTRY(hrtimer,      TT_SHORT,  true)
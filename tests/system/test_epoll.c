@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+#include "devshell.h"
+
+static int epoll_wait_one(int epfd, struct epoll_event *ev, int timeout)
+{
+   return epoll_wait(epfd, ev, 1, timeout);
+}
+
+/* Level-triggered, edge-triggered and one-shot modes on a pipe */
+int cmd_epoll1(int argc, char **argv)
+{
+   struct epoll_event ev;
+   int epfd, pipefd[2], rc;
+   char buf[16];
+
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+   DEVSHELL_CMD_ASSERT((epfd = epoll_create1(EPOLL_CLOEXEC)) >= 0);
+
+   /* Invalid arguments */
+   DEVSHELL_CMD_ASSERT(epoll_create(0) < 0 && errno == EINVAL);
+   DEVSHELL_CMD_ASSERT(epoll_create1(-1) < 0 && errno == EINVAL);
+
+   ev = (struct epoll_event) { .events = EPOLLIN, .data.u64 = 1234 };
+   rc = epoll_ctl(epfd, EPOLL_CTL_ADD, epfd, &ev);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = epoll_ctl(pipefd[0], EPOLL_CTL_ADD, pipefd[1], &ev);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+   rc = epoll_ctl(epfd, EPOLL_CTL_MOD, pipefd[0], &ev);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == ENOENT);
+   rc = epoll_wait(epfd, &ev, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   /* Level-triggered: the event is reported until the data is consumed */
+   ev = (struct epoll_event) { .events = EPOLLIN, .data.u64 = 1234 };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_ADD, pipefd[0], &ev) == 0);
+   rc = epoll_ctl(epfd, EPOLL_CTL_ADD, pipefd[0], &ev);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EEXIST);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "ab", 2) == 2);
+
+   for (int i = 0; i < 2; i++) {
+      DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+      DEVSHELL_CMD_ASSERT(ev.events == EPOLLIN);
+      DEVSHELL_CMD_ASSERT(ev.data.u64 == 1234);
+   }
+
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == 2);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+
+   /* Edge-triggered: the event is reported once per write */
+   ev = (struct epoll_event) { .events = EPOLLIN | EPOLLET, .data.fd = 7 };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_MOD, pipefd[0], &ev) == 0);
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "a", 1) == 1);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+   DEVSHELL_CMD_ASSERT(ev.data.fd == 7);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "b", 1) == 1);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == 2);
+
+   /* One-shot: disabled after the first event, until EPOLL_CTL_MOD */
+   ev = (struct epoll_event) { .events = EPOLLIN | EPOLLONESHOT };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_MOD, pipefd[0], &ev) == 0);
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "a", 1) == 1);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "b", 1) == 1);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+   ev = (struct epoll_event) { .events = EPOLLIN | EPOLLONESHOT };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_MOD, pipefd[0], &ev) == 0);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == 2);
+
+   /* Closing the write end: EPOLLHUP is always reported */
+   ev = (struct epoll_event) { .events = EPOLLIN };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_MOD, pipefd[0], &ev) == 0);
+   close(pipefd[1]);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 1);
+   DEVSHELL_CMD_ASSERT(ev.events & EPOLLHUP);
+
+   /* Closing a watched fd removes it from the interest list */
+   close(pipefd[0]);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 0) == 0);
+
+   close(epfd);
+   return 0;
+}
+
+/* Blocking epoll_wait(): timeout and wake-up from another process */
+int cmd_epoll2(int argc, char **argv)
+{
+   struct epoll_event ev;
+   struct timespec t0, t1;
+   int epfd, pipefd[2], wstatus, rc;
+   long long elapsed_ms;
+   pid_t childpid;
+
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+   DEVSHELL_CMD_ASSERT((epfd = epoll_create(1)) >= 0);
+
+   ev = (struct epoll_event) { .events = EPOLLIN };
+   DEVSHELL_CMD_ASSERT(epoll_ctl(epfd, EPOLL_CTL_ADD, pipefd[0], &ev) == 0);
+
+   /* Timeout */
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   DEVSHELL_CMD_ASSERT(epoll_wait_one(epfd, &ev, 50) == 0);
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+
+   elapsed_ms = (t1.tv_sec - t0.tv_sec) * 1000;
+   elapsed_ms += (t1.tv_nsec - t0.tv_nsec) / 1000000;
+   DEVSHELL_CMD_ASSERT(elapsed_ms >= 50);
+
+   /* Wake-up */
+   DEVSHELL_CMD_ASSERT((childpid = fork()) >= 0);
+
+   if (!childpid) {
+      usleep(50 * 1000);
+      exit(write(pipefd[1], "x", 1) == 1 ? 0 : 1);
+   }
+
+   rc = epoll_wait_one(epfd, &ev, -1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(ev.events == EPOLLIN);
+
+   DEVSHELL_CMD_ASSERT(waitpid(childpid, &wstatus, 0) == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   close(epfd);
+   return 0;
+}
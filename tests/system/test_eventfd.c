@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+
+#include "devshell.h"
+
+int cmd_eventfd(int argc, char **argv)
+{
+   struct pollfd pfd;
+   uint64_t val;
+   int efd, wstatus;
+   pid_t childpid;
+
+   DEVSHELL_CMD_ASSERT(eventfd(0, -1) < 0 && errno == EINVAL);
+
+   /* Counter mode: read() returns the whole counter */
+   DEVSHELL_CMD_ASSERT((efd = eventfd(3, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0);
+   DEVSHELL_CMD_ASSERT(read(efd, &val, 4) < 0 && errno == EINVAL);
+
+   val = 2;
+   DEVSHELL_CMD_ASSERT(write(efd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val == 5);
+   DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+
+   /* The counter cannot exceed UINT64_MAX - 1 */
+   val = UINT64_MAX;
+   DEVSHELL_CMD_ASSERT(write(efd, &val, sizeof(val)) < 0 && errno == EINVAL);
+   val = UINT64_MAX - 1;
+   DEVSHELL_CMD_ASSERT(write(efd, &val, sizeof(val)) == sizeof(val));
+   val = 1;
+   DEVSHELL_CMD_ASSERT(write(efd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+   close(efd);
+
+   /* Semaphore mode: read() decrements the counter by one */
+   DEVSHELL_CMD_ASSERT((efd = eventfd(2, EFD_SEMAPHORE | EFD_NONBLOCK)) >= 0);
+
+   for (int i = 0; i < 2; i++) {
+      DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) == sizeof(val));
+      DEVSHELL_CMD_ASSERT(val == 1);
+   }
+
+   DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+   close(efd);
+
+   /* Blocking read() and poll(), woken up by another process */
+   DEVSHELL_CMD_ASSERT((efd = eventfd(0, 0)) >= 0);
+   DEVSHELL_CMD_ASSERT((childpid = fork()) >= 0);
+
+   if (!childpid) {
+
+      for (int i = 0; i < 2; i++) {
+         usleep(50 * 1000);
+         val = 1;
+
+         if (write(efd, &val, sizeof(val)) != sizeof(val))
+            exit(1);
+      }
+
+      exit(0);
+   }
+
+   pfd = (struct pollfd) { .fd = efd, .events = POLLIN };
+   DEVSHELL_CMD_ASSERT(poll(&pfd, 1, -1) == 1);
+   DEVSHELL_CMD_ASSERT(pfd.revents == POLLIN);
+   DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val == 1);
+   DEVSHELL_CMD_ASSERT(read(efd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val == 1);
+
+   DEVSHELL_CMD_ASSERT(waitpid(childpid, &wstatus, 0) == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   close(efd);
+   return 0;
+}
@@ -295,3 +295,320 @@ int cmd_vfork0(int argc, char **argv)
    print_waitpid_change(pid, wstatus);
    return failed;
 }
+
+/*
+ * Tests for the copy-on-write page tables: after fork(), the parent and the
+ * child share their user page tables until one of them has to modify one.
+ * Each case checks the contents of the memory in both processes, not just
+ * that nothing crashed.
+ */
+
+#define COW_PT_PAGES          8
+
+static const char cow_pt_file[] = "/tmp/cow_pt_shared";
+static size_t cow_pt_pg_size;
+static char *cow_pt_shared;
+static int p2c[2], c2p[2];     /* parent-to-child and child-to-parent pipes */
+
+static char *cow_pt_alloc(char val)
+{
+   char *buf = mmap(NULL,
+                    COW_PT_PAGES * cow_pt_pg_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_ANONYMOUS | MAP_PRIVATE,
+                    -1,
+                    0);
+
+   DEVSHELL_CMD_ASSERT(buf != (void *)-1);
+
+   /* Touch all the pages, in order to have them mapped before fork() */
+   memset(buf, val, COW_PT_PAGES * cow_pt_pg_size);
+   return buf;
+}
+
+static bool cow_pt_check(const char *buf, size_t pages, char val)
+{
+   for (size_t i = 0; i < pages * cow_pt_pg_size; i++)
+      if (buf[i] != val)
+         return false;
+
+   return true;
+}
+
+static void cow_pt_open_pipes(void)
+{
+   DEVSHELL_CMD_ASSERT(pipe(p2c) == 0);
+   DEVSHELL_CMD_ASSERT(pipe(c2p) == 0);
+}
+
+static void cow_pt_child_side(void)
+{
+   close(p2c[1]);
+   close(c2p[0]);
+}
+
+static void cow_pt_parent_side(void)
+{
+   close(p2c[0]);
+   close(c2p[1]);
+}
+
+static void cow_pt_send(int fd)
+{
+   char c = 'x';
+   DEVSHELL_CMD_ASSERT(write(fd, &c, 1) == 1);
+}
+
+/* Fails with EOF as well, when the other side died because of an assert */
+static void cow_pt_recv(int fd)
+{
+   char c;
+   DEVSHELL_CMD_ASSERT(read(fd, &c, 1) == 1);
+}
+
+static void cow_pt_wait_child(int pid)
+{
+   int rc, wstatus;
+
+   rc = waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == pid);
+   print_waitpid_change(pid, wstatus);
+
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus));
+   DEVSHELL_CMD_ASSERT(WEXITSTATUS(wstatus) == 0);
+}
+
+/* Both the processes write to private pages mapped by a shared table */
+static void cow_pt_private_write(void)
+{
+   char *buf = cow_pt_alloc('a');
+   int pid;
+
+   printf(STR_PARENT "Private pages: write in both the processes\n");
+   cow_pt_open_pipes();
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      cow_pt_child_side();
+
+      /* The parent writes first: it has to see nothing of that */
+      cow_pt_recv(p2c[0]);
+      DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'a'));
+
+      /* Now we're the only user of our copy of the table */
+      memset(buf, 'c', COW_PT_PAGES * cow_pt_pg_size);
+      DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'c'));
+      cow_pt_send(c2p[1]);
+      exit(0);
+   }
+
+   cow_pt_parent_side();
+
+   memset(buf, 'p', COW_PT_PAGES * cow_pt_pg_size);
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'p'));
+   cow_pt_send(p2c[1]);
+
+   cow_pt_recv(c2p[0]);
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'p'));
+
+   cow_pt_wait_child(pid);
+   close(p2c[1]);
+   close(c2p[0]);
+   DEVSHELL_CMD_ASSERT(munmap(buf, COW_PT_PAGES * cow_pt_pg_size) == 0);
+}
+
+/* The first write after fork() is to a MAP_SHARED page in a shared table */
+static void cow_pt_shared_write(void)
+{
+   static const char child_str[] = "written by the child";
+   static const char parent_str[] = "written by the parent";
+   char *buf = cow_pt_alloc('a');
+   int pid;
+
+   printf(STR_PARENT "MAP_SHARED page in a shared table\n");
+   cow_pt_open_pipes();
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      cow_pt_child_side();
+      strcpy(cow_pt_shared, child_str);
+      cow_pt_send(c2p[1]);
+
+      cow_pt_recv(p2c[0]);
+      DEVSHELL_CMD_ASSERT(!strcmp(cow_pt_shared, parent_str));
+      DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'a'));
+      exit(0);
+   }
+
+   cow_pt_parent_side();
+
+   /* The parent didn't write anything: its table is still the shared one */
+   cow_pt_recv(c2p[0]);
+   DEVSHELL_CMD_ASSERT(!strcmp(cow_pt_shared, child_str));
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'a'));
+
+   strcpy(cow_pt_shared, parent_str);
+   cow_pt_send(p2c[1]);
+
+   cow_pt_wait_child(pid);
+   close(p2c[1]);
+   close(c2p[0]);
+   DEVSHELL_CMD_ASSERT(munmap(buf, COW_PT_PAGES * cow_pt_pg_size) == 0);
+}
+
+/* The child changes its mappings in the range of a shared table */
+static void cow_pt_child_remap(void)
+{
+   const size_t hole = COW_PT_PAGES / 2;
+   char *buf = cow_pt_alloc('a');
+   char *page;
+   int pid;
+
+   printf(STR_PARENT "munmap() and mmap() in the child\n");
+   cow_pt_open_pipes();
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      cow_pt_child_side();
+
+      DEVSHELL_CMD_ASSERT(munmap(buf + hole * cow_pt_pg_size,
+                                 cow_pt_pg_size) == 0);
+
+      page = mmap(NULL,
+                  cow_pt_pg_size,
+                  PROT_READ | PROT_WRITE,
+                  MAP_ANONYMOUS | MAP_PRIVATE,
+                  -1,
+                  0);
+
+      DEVSHELL_CMD_ASSERT(page != (void *)-1);
+      DEVSHELL_CMD_ASSERT(cow_pt_check(page, 1, 0));
+      memset(page, 'n', cow_pt_pg_size);
+      DEVSHELL_CMD_ASSERT(cow_pt_check(page, 1, 'n'));
+
+      DEVSHELL_CMD_ASSERT(cow_pt_check(buf, hole, 'a'));
+      DEVSHELL_CMD_ASSERT(cow_pt_check(buf + (hole + 1) * cow_pt_pg_size,
+                                       COW_PT_PAGES - hole - 1, 'a'));
+
+      cow_pt_send(c2p[1]);
+      exit(0);
+   }
+
+   cow_pt_parent_side();
+   cow_pt_recv(c2p[0]);
+
+   /* All of our pages, including the one unmapped by the child, are there */
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'a'));
+   memset(buf, 'p', COW_PT_PAGES * cow_pt_pg_size);
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'p'));
+
+   cow_pt_wait_child(pid);
+   close(p2c[1]);
+   close(c2p[0]);
+   DEVSHELL_CMD_ASSERT(munmap(buf, COW_PT_PAGES * cow_pt_pg_size) == 0);
+}
+
+/*
+ * The parent of a process sharing a table exits first: the grandchild remains
+ * the only user of the table, which gets reclaimed instead of being copied.
+ */
+static void cow_pt_parent_exits_first(void)
+{
+   char *buf = cow_pt_alloc('a');
+   int pid, gpid;
+
+   printf(STR_PARENT "The parent exits first\n");
+   cow_pt_open_pipes();
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+
+      cow_pt_child_side();
+      cow_pt_recv(p2c[0]);
+
+      gpid = fork();
+      DEVSHELL_CMD_ASSERT(gpid >= 0);
+
+      if (!gpid) {
+
+         /* Wait for our parent to die, then write */
+         cow_pt_recv(p2c[0]);
+         DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'a'));
+
+         memset(buf, 'g', COW_PT_PAGES * cow_pt_pg_size);
+         DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'g'));
+         cow_pt_send(c2p[1]);
+         exit(0);
+      }
+
+      /* Exit without writing anything in the shared table */
+      exit(0);
+   }
+
+   cow_pt_parent_side();
+
+   /* Get our own copy of the table before the grandchild is created */
+   memset(buf, 'p', COW_PT_PAGES * cow_pt_pg_size);
+   cow_pt_send(p2c[1]);
+
+   cow_pt_wait_child(pid);
+   cow_pt_send(p2c[1]);
+
+   cow_pt_recv(c2p[0]);
+   DEVSHELL_CMD_ASSERT(cow_pt_check(buf, COW_PT_PAGES, 'p'));
+
+   close(p2c[1]);
+   close(c2p[0]);
+   DEVSHELL_CMD_ASSERT(munmap(buf, COW_PT_PAGES * cow_pt_pg_size) == 0);
+}
+
+int cmd_fork_cow_pt(int argc, char **argv)
+{
+   int fd, rc;
+
+   cow_pt_pg_size = getpagesize();
+
+   fd = open(cow_pt_file, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   cow_pt_shared = calloc(1, cow_pt_pg_size);
+   DEVSHELL_CMD_ASSERT(cow_pt_shared != NULL);
+
+   rc = write(fd, cow_pt_shared, cow_pt_pg_size);
+   DEVSHELL_CMD_ASSERT(rc == (int)cow_pt_pg_size);
+   free(cow_pt_shared);
+
+   cow_pt_shared = mmap(NULL,
+                        cow_pt_pg_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED,
+                        fd,
+                        0);
+
+   DEVSHELL_CMD_ASSERT(cow_pt_shared != (void *)-1);
+   close(fd);
+
+   /* Touch the page, in order to have it mapped before fork() */
+   DEVSHELL_CMD_ASSERT(cow_pt_shared[0] == 0);
+
+   cow_pt_private_write();
+   cow_pt_shared_write();
+   cow_pt_child_remap();
+   cow_pt_parent_exits_first();
+
+   DEVSHELL_CMD_ASSERT(munmap(cow_pt_shared, cow_pt_pg_size) == 0);
+   DEVSHELL_CMD_ASSERT(unlink(cow_pt_file) == 0);
+   printf(STR_PARENT "clean exit\n");
+   return 0;
+}
@@ -575,3 +575,59 @@ int cmd_fmmap7(int argc, char **argv)
    unlink(test_file);
    return rc;
 }
+
+/* Holes in a file mapped twice, filled through mmap and through write() */
+int cmd_fmmap8(int argc, char **argv)
+{
+   const size_t page_size = getpagesize();
+   char *m1, *m2;
+   int fd, rc;
+
+   fd = open(test_file, O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   /* Create a file with 3 holes, followed by one byte */
+   rc = lseek(fd, 3 * page_size, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(rc == (int)(3 * page_size));
+
+   rc = write(fd, "x", 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+
+   m1 = mmap(NULL, 4 * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(m1 != MAP_FAILED);
+
+   m2 = mmap(NULL, 4 * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   DEVSHELL_CMD_ASSERT(m2 != MAP_FAILED);
+
+   /* Reading the holes through both the mappings gives zeros */
+   DEVSHELL_CMD_ASSERT(m1[0] == 0 && m1[page_size] == 0);
+   DEVSHELL_CMD_ASSERT(m2[0] == 0 && m2[page_size] == 0);
+   DEVSHELL_CMD_ASSERT(m1[3 * page_size] == 'x');
+
+   /* Fill a hole through a mapping: the other one must see the change */
+   m1[0] = 'a';
+   DEVSHELL_CMD_ASSERT(m2[0] == 'a');
+
+   /* Fill a hole with write(): both the mappings must see the change */
+   rc = lseek(fd, page_size, SEEK_SET);
+   DEVSHELL_CMD_ASSERT(rc == (int)page_size);
+
+   rc = write(fd, "b", 1);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(m1[page_size] == 'b');
+   DEVSHELL_CMD_ASSERT(m2[page_size] == 'b');
+
+   /* The 3rd hole has never been touched */
+   DEVSHELL_CMD_ASSERT(m2[2 * page_size] == 0);
+
+   rc = munmap(m1, 4 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = munmap(m2, 4 * page_size);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   close(fd);
+   rc = unlink(test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
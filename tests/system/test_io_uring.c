@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "devshell.h"
+
+#ifndef SYS_io_uring_setup
+   #define SYS_io_uring_setup       425
+   #define SYS_io_uring_enter       426
+#endif
+
+struct test_ring {
+
+   int fd;
+   struct io_uring_params p;
+
+   char *rings;
+   size_t rings_sz;
+   struct io_uring_sqe *sqes;
+   size_t sqes_sz;
+
+   unsigned *sq_tail;
+   unsigned *sq_array;
+   unsigned *cq_head;
+   unsigned *cq_tail;
+   struct io_uring_cqe *cqes;
+};
+
+static const char iou_file[] = "/tmp/io_uring_test";
+
+static int ring_init(struct test_ring *r, unsigned entries)
+{
+   size_t sq_sz, cq_sz;
+
+   memset(r, 0, sizeof(*r));
+   r->fd = (int)syscall(SYS_io_uring_setup, entries, &r->p);
+
+   if (r->fd < 0)
+      return -1;
+
+   sq_sz = r->p.sq_off.array + r->p.sq_entries * sizeof(unsigned);
+   cq_sz = r->p.cq_off.cqes + r->p.cq_entries * sizeof(struct io_uring_cqe);
+   r->rings_sz = sq_sz > cq_sz ? sq_sz : cq_sz;
+   r->sqes_sz = r->p.sq_entries * sizeof(struct io_uring_sqe);
+
+   r->rings = mmap(NULL, r->rings_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, r->fd, IORING_OFF_SQ_RING);
+
+   if (r->rings == MAP_FAILED)
+      return -1;
+
+   r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, r->fd, IORING_OFF_SQES);
+
+   if (r->sqes == MAP_FAILED)
+      return -1;
+
+   r->sq_tail = (void *)(r->rings + r->p.sq_off.tail);
+   r->sq_array = (void *)(r->rings + r->p.sq_off.array);
+   r->cq_head = (void *)(r->rings + r->p.cq_off.head);
+   r->cq_tail = (void *)(r->rings + r->p.cq_off.tail);
+   r->cqes = (void *)(r->rings + r->p.cq_off.cqes);
+   return 0;
+}
+
+static void ring_destroy(struct test_ring *r)
+{
+   munmap(r->sqes, r->sqes_sz);
+   munmap(r->rings, r->rings_sz);
+   close(r->fd);
+}
+
+static struct io_uring_sqe *
+ring_queue(struct test_ring *r, int op, int fd, void *addr, unsigned len,
+           uint64_t off, uint64_t user_data)
+{
+   unsigned tail = *r->sq_tail;
+   unsigned idx = tail & (r->p.sq_entries - 1);
+   struct io_uring_sqe *sqe = &r->sqes[idx];
+
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = (uint8_t)op;
+   sqe->fd = fd;
+   sqe->addr = (uint64_t)(uintptr_t)addr;
+   sqe->len = len;
+   sqe->off = off;
+   sqe->user_data = user_data;
+
+   r->sq_array[idx] = idx;
+   __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   return sqe;
+}
+
+static int ring_enter(struct test_ring *r, unsigned submit, unsigned wait)
+{
+   return (int)syscall(SYS_io_uring_enter, r->fd, submit, wait,
+                       wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+/* Pop a completion, returning false if the CQ is empty */
+static bool ring_pop(struct test_ring *r, struct io_uring_cqe *cqe)
+{
+   unsigned head = *r->cq_head;
+
+   if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+      return false;
+
+   *cqe = r->cqes[head & (r->p.cq_entries - 1)];
+   __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+static bool ring_pop_check(struct test_ring *r, uint64_t user_data, int res)
+{
+   struct io_uring_cqe cqe;
+
+   if (!ring_pop(r, &cqe))
+      return false;
+
+   return cqe.user_data == user_data && cqe.res == res;
+}
+
+int cmd_io_uring(int argc, char **argv)
+{
+   struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 10 * 1000 * 1000 };
+   struct io_uring_cqe cqe;
+   struct test_ring r;
+   struct io_uring_sqe *sqe;
+   char buf[32] = {0};
+   int fd, pipefd[2];
+
+   DEVSHELL_CMD_ASSERT(ring_init(&r, 5) == 0);
+   DEVSHELL_CMD_ASSERT(r.p.sq_entries == 8);
+   DEVSHELL_CMD_ASSERT(r.p.cq_entries == 16);
+   DEVSHELL_CMD_ASSERT(r.p.features & IORING_FEAT_SINGLE_MMAP);
+
+   /* Batch: open, write at offset 0, read from the current position, close */
+   sqe = ring_queue(&r, IORING_OP_OPENAT, AT_FDCWD, (void *)iou_file,
+                    0644, 0, 1);
+   sqe->open_flags = O_CREAT | O_TRUNC | O_RDWR;
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 1) == 1);
+   DEVSHELL_CMD_ASSERT(ring_pop(&r, &cqe) && cqe.user_data == 1);
+   DEVSHELL_CMD_ASSERT((fd = cqe.res) >= 0);
+
+   ring_queue(&r, IORING_OP_WRITE, fd, "hello io_uring", 14, 0, 2);
+   ring_queue(&r, IORING_OP_READ, fd, buf, sizeof(buf), (uint64_t)-1, 3);
+   ring_queue(&r, IORING_OP_NOP, -1, NULL, 0, 0, 4);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 3, 3) == 3);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 2, 14));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 3, 14));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 4, 0));
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, "hello io_uring", 14));
+
+   ring_queue(&r, IORING_OP_CLOSE, fd, NULL, 0, 0, 5);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 1) == 1);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 5, 0));
+   DEVSHELL_CMD_ASSERT(close(fd) < 0 && errno == EBADF);
+
+   /* A failure cancels the rest of the linked chain */
+   sqe = ring_queue(&r, IORING_OP_READ, 1234, buf, 1, 0, 6);
+   sqe->flags = IOSQE_IO_LINK;
+   ring_queue(&r, IORING_OP_NOP, -1, NULL, 0, 0, 7);
+   ring_queue(&r, IORING_OP_NOP, -1, NULL, 0, 0, 8);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 3, 3) == 3);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 6, -EBADF));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 7, -ECANCELED));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 8, 0));
+
+   /* Poll: completes only when the pipe becomes readable */
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+   sqe = ring_queue(&r, IORING_OP_POLL_ADD, pipefd[0], NULL, 0, 0, 9);
+   sqe->poll_events = POLLIN;
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 0) == 1);
+   DEVSHELL_CMD_ASSERT(!ring_pop(&r, &cqe));
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "x", 1) == 1);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 0, 1) == 0);
+   DEVSHELL_CMD_ASSERT(ring_pop(&r, &cqe) && cqe.user_data == 9);
+   DEVSHELL_CMD_ASSERT(cqe.res & POLLIN);
+
+   /* Poll removal */
+   sqe = ring_queue(&r, IORING_OP_POLL_ADD, pipefd[1], NULL, 0, 0, 10);
+   sqe->poll_events = POLLPRI;
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 0) == 1);
+   DEVSHELL_CMD_ASSERT(!ring_pop(&r, &cqe));
+   ring_queue(&r, IORING_OP_POLL_REMOVE, -1, (void *)10, 0, 0, 11);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 2) == 1);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 10, -ECANCELED));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 11, 0));
+   close(pipefd[1]);
+   close(pipefd[0]);
+
+   /* Timeouts: expiration and completion count */
+   ring_queue(&r, IORING_OP_TIMEOUT, -1, &ts, 1, 0, 12);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 1, 1) == 1);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 12, -ETIME));
+
+   ts.tv_sec = 10;
+   ring_queue(&r, IORING_OP_TIMEOUT, -1, &ts, 1, 1, 13);
+   ring_queue(&r, IORING_OP_NOP, -1, NULL, 0, 0, 14);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 2, 2) == 2);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 14, 0));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 13, 0));
+
+   ring_queue(&r, IORING_OP_TIMEOUT, -1, &ts, 1, 0, 15);
+   ring_queue(&r, IORING_OP_TIMEOUT_REMOVE, -1, (void *)15, 0, 0, 16);
+   DEVSHELL_CMD_ASSERT(ring_enter(&r, 2, 2) == 2);
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 15, -ECANCELED));
+   DEVSHELL_CMD_ASSERT(ring_pop_check(&r, 16, 0));
+
+   ring_destroy(&r);
+   DEVSHELL_CMD_ASSERT(unlink(iou_file) == 0);
+   return 0;
+}
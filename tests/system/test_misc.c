@@ -14,6 +14,7 @@
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/auxv.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -491,4 +492,123 @@ int cmd_getrusage(int argc, char **argv)
 
    printf("OK\n");
    return 0;
-}
\ No newline at end of file
+}
+
+static ull_t timespec_to_ns(struct timespec *ts)
+{
+   return (ull_t)ts->tv_sec * 1000000000ull + (ull_t)ts->tv_nsec;
+}
+
+int cmd_vdso(int argc, char **argv)
+{
+   const int iters = 1000;
+   struct timespec ts;
+   struct { long tv_sec; long tv_nsec; } ts32;
+   ull_t prev = 0, curr, sys, start, vdso_cycles, sys_cycles;
+
+   if (running_on_tilck())
+      DEVSHELL_CMD_ASSERT(getauxval(AT_SYSINFO_EHDR) != 0);
+
+   /* The time read through the vDSO must never go backwards */
+   for (int i = 0; i < 100 * iters; i++) {
+      DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+      curr = timespec_to_ns(&ts);
+      DEVSHELL_CMD_ASSERT(curr >= prev);
+      prev = curr;
+   }
+
+   /* And it must be consistent with the time read through the syscall */
+   for (int i = 0; i < iters; i++) {
+
+      DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+      prev = timespec_to_ns(&ts);
+
+      DEVSHELL_CMD_ASSERT(
+         syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts32) == 0
+      );
+      sys = (ull_t)ts32.tv_sec * 1000000000ull + (ull_t)ts32.tv_nsec;
+
+      DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+      curr = timespec_to_ns(&ts);
+
+      DEVSHELL_CMD_ASSERT(prev <= sys && sys <= curr);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++)
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   vdso_cycles = (RDTSC() - start) / iters;
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++)
+      syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts32);
+
+   sys_cycles = (RDTSC() - start) / iters;
+   printf("clock_gettime(): %llu cycles (vDSO), %llu cycles (syscall)\n",
+          vdso_cycles, sys_cycles);
+   return 0;
+}
+
+static ull_t mono_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return timespec_to_ns(&ts);
+}
+
+int cmd_hrtimer(int argc, char **argv)
+{
+   const int iters = 50;
+   const ull_t sleep_ns = 200 * 1000;
+   struct timespec req, now;
+   ull_t start, elapsed, deadline;
+
+   /* Sub-tick sleeps: never shorter than requested */
+   start = mono_now_ns();
+
+   for (int i = 0; i < iters; i++) {
+
+      ull_t t = mono_now_ns();
+      req = (struct timespec) { .tv_sec = 0, .tv_nsec = (long)sleep_ns };
+      DEVSHELL_CMD_ASSERT(nanosleep(&req, NULL) == 0);
+      DEVSHELL_CMD_ASSERT(mono_now_ns() - t >= sleep_ns);
+   }
+
+   elapsed = mono_now_ns() - start;
+   printf("nanosleep(200 us): %llu us on average\n", elapsed / iters / 1000);
+
+   /* Absolute sleeps on the monotonic clock */
+   for (int i = 0; i < iters; i++) {
+
+      deadline = mono_now_ns() + sleep_ns;
+      req = (struct timespec) {
+         .tv_sec = (time_t)(deadline / 1000000000ull),
+         .tv_nsec = (long)(deadline % 1000000000ull),
+      };
+
+      DEVSHELL_CMD_ASSERT(
+         clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL) == 0
+      );
+
+      DEVSHELL_CMD_ASSERT(mono_now_ns() >= deadline);
+   }
+
+   /* An absolute deadline in the past must return immediately */
+   DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_REALTIME, &now) == 0);
+   now.tv_sec--;
+   DEVSHELL_CMD_ASSERT(
+      clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &now, NULL) == 0
+   );
+
+   /* Invalid arguments: clock_nanosleep() returns the error, not -1 */
+   req = (struct timespec) { .tv_sec = 0, .tv_nsec = 1000000000 };
+   DEVSHELL_CMD_ASSERT(nanosleep(&req, NULL) == -1 && errno == EINVAL);
+   DEVSHELL_CMD_ASSERT(
+      clock_nanosleep(CLOCK_MONOTONIC, 0, &req, NULL) == EINVAL
+   );
+
+   printf("OK\n");
+   return 0;
+}
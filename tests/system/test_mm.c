@@ -14,6 +14,7 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -159,6 +160,144 @@ int cmd_mmap2(int argc, char **argv)
    return 0;
 }
 
+#ifndef MREMAP_MAYMOVE
+   #define MREMAP_MAYMOVE           1
+#endif
+
+static void *
+do_mremap(void *old_addr, size_t old_len, size_t new_len, int flags)
+{
+   return (void *)syscall(SYS_mremap, old_addr, old_len, new_len, flags, 0);
+}
+
+int cmd_mremap(int argc, char **argv)
+{
+   const size_t sz = 64 * KB;
+   char *p, *p2, *p3;
+
+   p = mmap(NULL, 2 * sz, PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   DEVSHELL_CMD_ASSERT(p != MAP_FAILED);
+   memset(p, 'a', sz);
+
+   /* Shrink in place */
+   DEVSHELL_CMD_ASSERT(do_mremap(p, 2 * sz, sz, 0) == p);
+
+   /* Grow in place, since the range after the mapping is free */
+   DEVSHELL_CMD_ASSERT(do_mremap(p, sz, 2 * sz, 0) == p);
+   DEVSHELL_CMD_ASSERT(p[sz - 1] == 'a');
+   DEVSHELL_CMD_ASSERT(p[sz] == 0);
+
+   /* Occupy the range after the mapping */
+   p2 = mmap(p + 2 * sz, sz, PROT_READ | PROT_WRITE,
+             MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+   DEVSHELL_CMD_ASSERT(p2 == p + 2 * sz);
+
+   /* Now, growing requires moving the pages */
+   DEVSHELL_CMD_ASSERT(do_mremap(p, 2 * sz, 4 * sz, 0) == MAP_FAILED);
+   DEVSHELL_CMD_ASSERT(errno == ENOMEM);
+
+   p3 = do_mremap(p, 2 * sz, 4 * sz, MREMAP_MAYMOVE);
+   DEVSHELL_CMD_ASSERT(p3 != MAP_FAILED);
+   DEVSHELL_CMD_ASSERT(p3 != p);
+   DEVSHELL_CMD_ASSERT(p3[0] == 'a');
+   DEVSHELL_CMD_ASSERT(p3[sz - 1] == 'a');
+   DEVSHELL_CMD_ASSERT(p3[sz] == 0);
+   DEVSHELL_CMD_ASSERT(p3[4 * sz - 1] == 0);
+
+   /* The old range must be unmapped */
+   DEVSHELL_CMD_ASSERT(do_mremap(p, sz, sz, 0) == MAP_FAILED);
+   DEVSHELL_CMD_ASSERT(errno == EFAULT);
+
+   DEVSHELL_CMD_ASSERT(munmap(p2, sz) == 0);
+   DEVSHELL_CMD_ASSERT(munmap(p3, 4 * sz) == 0);
+   return 0;
+}
+
+static rlim_t stack_test_limit;
+
+static NO_INLINE void use_1mb_of_stack(void)
+{
+   volatile char buf[1 * MB];
+
+   /* Touch one byte per page, starting from the top, as the stack grows */
+   for (long off = sizeof(buf) - 1; off >= 0; off -= 4 * KB)
+      buf[off] = 'x';
+
+   buf[0] = 'x';
+}
+
+static void stack_grow_child(void *unused)
+{
+   struct rlimit rl;
+
+   if (getrlimit(RLIMIT_STACK, &rl) < 0) {
+      printf(STR_CHILD "getrlimit failed: %s\n", strerror(errno));
+      exit(1);
+   }
+
+   rl.rlim_cur = stack_test_limit;
+
+   if (setrlimit(RLIMIT_STACK, &rl) < 0) {
+      printf(STR_CHILD "setrlimit failed: %s\n", strerror(errno));
+      exit(1);
+   }
+
+   use_1mb_of_stack();
+   exit(0);
+}
+
+int cmd_stack_grow(int argc, char **argv)
+{
+   struct rlimit rl, orig_rl;
+
+   if (!running_on_tilck()) {
+      not_on_tilck_message();
+      return 0;
+   }
+
+   DEVSHELL_CMD_ASSERT(getrlimit(RLIMIT_STACK, &rl) == 0);
+   DEVSHELL_CMD_ASSERT(rl.rlim_cur == USER_STACK_PAGES * 4 * KB);
+   DEVSHELL_CMD_ASSERT(rl.rlim_max >= 2 * MB);
+
+   /* The soft limit cannot be above the hard one */
+   rl.rlim_cur = rl.rlim_max + 4 * KB;
+   DEVSHELL_CMD_ASSERT(setrlimit(RLIMIT_STACK, &rl) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EINVAL);
+
+   /* Like `ulimit -s unlimited`: the stack is still limited to the max size */
+   orig_rl = (struct rlimit) { USER_STACK_PAGES * 4 * KB, rl.rlim_max };
+   rl = (struct rlimit) { RLIM_INFINITY, RLIM_INFINITY };
+   DEVSHELL_CMD_ASSERT(setrlimit(RLIMIT_STACK, &rl) == 0);
+   DEVSHELL_CMD_ASSERT(getrlimit(RLIMIT_STACK, &rl) == 0);
+   DEVSHELL_CMD_ASSERT(rl.rlim_cur == RLIM_INFINITY);
+   DEVSHELL_CMD_ASSERT(rl.rlim_max == RLIM_INFINITY);
+
+   stack_test_limit = RLIM_INFINITY;
+
+   if (test_sig(&stack_grow_child, NULL, 0, 0, 0))
+      return 1;
+
+   /* The hard limit can be lowered again */
+   DEVSHELL_CMD_ASSERT(setrlimit(RLIMIT_STACK, &orig_rl) == 0);
+
+   /* With a big enough limit, the stack grows on demand */
+   stack_test_limit = 2 * MB;
+
+   if (test_sig(&stack_grow_child, NULL, 0, 0, 0))
+      return 1;
+
+   /* Otherwise, the process gets killed by SIGSEGV */
+   stack_test_limit = 256 * KB;
+
+   if (test_sig(&stack_grow_child, NULL, SIGSEGV, 0, 0))
+      return 1;
+
+   return 0;
+}
+
 static size_t fork_oom_alloc_size;
 
 static void fork_oom_child(void *buf)
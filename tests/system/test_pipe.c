@@ -388,10 +388,8 @@ pipe_random_test(int readers, int writers)
       return 1;
    }
 
-   if (!getenv("TILCK")) {
-      fcntl(pipefd[0], F_SETPIPE_SZ, 4096);
-      fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
-   }
+   fcntl(pipefd[0], F_SETPIPE_SZ, 4096);
+   fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
 
    for (int i = 0; i < writers; i++) {
 
@@ -469,3 +467,51 @@ int cmd_pipe5(int argc, char **argv)
 
    return 0;
 }
+
+int cmd_pipe6(int argc, char **argv)
+{
+   char buf[4096] = {0};
+   int pipefd[2];
+   int tot, rc, fd;
+
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[0], F_GETPIPE_SZ) == 64 * KB);
+
+   /* The size is rounded up and it's shared by both the ends */
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[1], F_SETPIPE_SZ, 128 * KB) == 128 * KB);
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[0], F_GETPIPE_SZ) == 128 * KB);
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[0], F_SETPIPE_SZ, 1) == 4096);
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[1], F_GETPIPE_SZ) == 4096);
+
+   /* Fill the pipe */
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[1], F_SETFL, O_NONBLOCK) == 0);
+
+   for (tot = 0; (rc = write(pipefd[1], buf, 1024)) > 0; tot += rc) { }
+
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+   DEVSHELL_CMD_ASSERT(tot == 4096);
+
+   /* Grow it: there's room for more data now */
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[1], F_SETPIPE_SZ, 8192) == 8192);
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], buf, sizeof(buf)) == sizeof(buf));
+
+   /* The data in the pipe must fit in the new size */
+   rc = fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBUSY);
+
+   if (getenv("TILCK")) {
+      /* Exceeding the system-wide limit (only root can do that on Linux) */
+      rc = fcntl(pipefd[1], F_SETPIPE_SZ, 64 * 1024 * KB);
+      DEVSHELL_CMD_ASSERT(rc < 0 && errno == EPERM);
+   }
+
+   /* Not a pipe */
+   DEVSHELL_CMD_ASSERT((fd = open("/", O_RDONLY)) >= 0);
+   rc = fcntl(fd, F_GETPIPE_SZ);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBADF);
+   close(fd);
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   return 0;
+}
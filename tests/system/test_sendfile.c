@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "devshell.h"
+
+#define SF_FILE_SIZE          (3 * 4096 + 123)
+#define SF_HOLE_OFF           (5 * 4096)
+
+static const char sf_src[] = "/tmp/sendfile_src";
+static const char sf_dst[] = "/tmp/sendfile_dst";
+
+static char sf_buf[SF_HOLE_OFF + 16];
+static char sf_buf2[SF_HOLE_OFF + 16];
+
+int cmd_sendfile(int argc, char **argv)
+{
+   int src, dst, pipefd[2];
+   struct stat st;
+   off_t off;
+
+   for (int i = 0; i < SF_FILE_SIZE; i++)
+      sf_buf[i] = (char)('a' + i % 26);
+
+   DEVSHELL_CMD_ASSERT((src = open(sf_src, O_CREAT | O_RDWR, 0644)) >= 0);
+   DEVSHELL_CMD_ASSERT(write(src, sf_buf, SF_FILE_SIZE) == SF_FILE_SIZE);
+
+   /* Leave a hole between SF_FILE_SIZE and SF_HOLE_OFF */
+   DEVSHELL_CMD_ASSERT(lseek(src, SF_HOLE_OFF, SEEK_SET) == SF_HOLE_OFF);
+   DEVSHELL_CMD_ASSERT(write(src, "end", 3) == 3);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_SET) == 0);
+
+   /* File to file, using (and updating) the file position of `src` */
+   DEVSHELL_CMD_ASSERT((dst = open(sf_dst, O_CREAT | O_RDWR, 0644)) >= 0);
+   DEVSHELL_CMD_ASSERT(sendfile(dst, src, NULL, 1 << 20) == SF_HOLE_OFF + 3);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == SF_HOLE_OFF + 3);
+   DEVSHELL_CMD_ASSERT(sendfile(dst, src, NULL, 1 << 20) == 0);
+
+   DEVSHELL_CMD_ASSERT(fstat(dst, &st) == 0);
+   DEVSHELL_CMD_ASSERT(st.st_size == SF_HOLE_OFF + 3);
+
+   DEVSHELL_CMD_ASSERT(lseek(dst, 0, SEEK_SET) == 0);
+   DEVSHELL_CMD_ASSERT(read(dst, sf_buf2, sizeof(sf_buf2)) == SF_HOLE_OFF + 3);
+   DEVSHELL_CMD_ASSERT(!memcmp(sf_buf, sf_buf2, SF_FILE_SIZE));
+
+   for (int i = SF_FILE_SIZE; i < SF_HOLE_OFF; i++)
+      DEVSHELL_CMD_ASSERT(sf_buf2[i] == 0);
+
+   DEVSHELL_CMD_ASSERT(!memcmp(sf_buf2 + SF_HOLE_OFF, "end", 3));
+
+   /* A file cannot be sent to itself */
+   DEVSHELL_CMD_ASSERT(sendfile(dst, dst, NULL, 10) < 0 && errno == EINVAL);
+
+   /* Explicit offset: the file position of `src` doesn't change */
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+   off = 4090;
+   DEVSHELL_CMD_ASSERT(sendfile(pipefd[1], src, &off, 10) == 10);
+   DEVSHELL_CMD_ASSERT(off == 4100);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == SF_HOLE_OFF + 3);
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], sf_buf2, sizeof(sf_buf2)) == 10);
+   DEVSHELL_CMD_ASSERT(!memcmp(sf_buf2, sf_buf + 4090, 10));
+
+   /* Pipe to file, through the bounce buffer */
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], "hello", 5) == 5);
+   DEVSHELL_CMD_ASSERT(ftruncate(dst, 0) == 0);
+   DEVSHELL_CMD_ASSERT(lseek(dst, 0, SEEK_SET) == 0);
+   DEVSHELL_CMD_ASSERT(sendfile(dst, pipefd[0], NULL, 100) == 5);
+   DEVSHELL_CMD_ASSERT(pread(dst, sf_buf2, 5, 0) == 5);
+   DEVSHELL_CMD_ASSERT(!memcmp(sf_buf2, "hello", 5));
+
+   /* Bad file descriptors and modes */
+   DEVSHELL_CMD_ASSERT(sendfile(pipefd[0], src, NULL, 1) < 0 && errno == EBADF);
+   DEVSHELL_CMD_ASSERT(sendfile(dst, pipefd[1], NULL, 1) < 0 && errno == EBADF);
+   DEVSHELL_CMD_ASSERT(sendfile(dst, 1234, NULL, 1) < 0 && errno == EBADF);
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   close(dst);
+   close(src);
+   DEVSHELL_CMD_ASSERT(unlink(sf_dst) == 0);
+   DEVSHELL_CMD_ASSERT(unlink(sf_src) == 0);
+   return 0;
+}
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "devshell.h"
+
+#define SP_FILE_SIZE          (2 * 4096 + 100)
+
+static const char sp_src[] = "/tmp/splice_src";
+static const char sp_dst[] = "/tmp/splice_dst";
+
+static char sp_buf[SP_FILE_SIZE];
+static char sp_buf2[SP_FILE_SIZE];
+static char sp_page[2 * 4096] __attribute__((aligned(4096)));
+
+static int splice_files(int p[2])
+{
+   int src, dst;
+   loff_t off_in, off_out;
+
+   for (int i = 0; i < SP_FILE_SIZE; i++)
+      sp_buf[i] = (char)('a' + i % 26);
+
+   DEVSHELL_CMD_ASSERT((src = open(sp_src, O_CREAT | O_RDWR, 0644)) >= 0);
+   DEVSHELL_CMD_ASSERT((dst = open(sp_dst, O_CREAT | O_RDWR, 0644)) >= 0);
+   DEVSHELL_CMD_ASSERT(write(src, sp_buf, SP_FILE_SIZE) == SP_FILE_SIZE);
+
+   /* File to pipe, with an explicit offset: the file position is unchanged */
+   off_in = 0;
+   DEVSHELL_CMD_ASSERT(
+      splice(src, &off_in, p[1], NULL, SP_FILE_SIZE, 0) == SP_FILE_SIZE
+   );
+   DEVSHELL_CMD_ASSERT(off_in == SP_FILE_SIZE);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == SP_FILE_SIZE);
+
+   /* Pipe to file */
+   off_out = 10;
+   DEVSHELL_CMD_ASSERT(
+      splice(p[0], NULL, dst, &off_out, SP_FILE_SIZE, 0) == SP_FILE_SIZE
+   );
+   DEVSHELL_CMD_ASSERT(off_out == SP_FILE_SIZE + 10);
+   DEVSHELL_CMD_ASSERT(pread(dst, sp_buf2, SP_FILE_SIZE, 10) == SP_FILE_SIZE);
+   DEVSHELL_CMD_ASSERT(!memcmp(sp_buf, sp_buf2, SP_FILE_SIZE));
+
+   /* The file position is used and updated when no offset is passed */
+   DEVSHELL_CMD_ASSERT(lseek(src, 4000, SEEK_SET) == 4000);
+   DEVSHELL_CMD_ASSERT(splice(src, NULL, p[1], NULL, 200, 0) == 200);
+   DEVSHELL_CMD_ASSERT(lseek(src, 0, SEEK_CUR) == 4200);
+   DEVSHELL_CMD_ASSERT(read(p[0], sp_buf2, sizeof(sp_buf2)) == 200);
+   DEVSHELL_CMD_ASSERT(!memcmp(sp_buf + 4000, sp_buf2, 200));
+
+   /* Offsets are not allowed on pipes and one end must be a pipe */
+   off_in = 0;
+   DEVSHELL_CMD_ASSERT(splice(p[0], &off_in, dst, NULL, 1, 0) < 0);
+   DEVSHELL_CMD_ASSERT(errno == ESPIPE);
+   DEVSHELL_CMD_ASSERT(splice(src, NULL, dst, NULL, 1, 0) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EINVAL);
+
+   close(dst);
+   close(src);
+   DEVSHELL_CMD_ASSERT(unlink(sp_dst) == 0);
+   DEVSHELL_CMD_ASSERT(unlink(sp_src) == 0);
+   return 0;
+}
+
+static int splice_pipes(int p[2], int p2[2])
+{
+   char buf[32];
+
+   /* tee() duplicates the data, without consuming it */
+   DEVSHELL_CMD_ASSERT(write(p[1], "hello world", 11) == 11);
+   DEVSHELL_CMD_ASSERT(tee(p[0], p2[1], 100, 0) == 11);
+   DEVSHELL_CMD_ASSERT(read(p2[0], buf, sizeof(buf)) == 11);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, "hello world", 11));
+
+   /* Pipe to pipe: the data moves */
+   DEVSHELL_CMD_ASSERT(splice(p[0], NULL, p2[1], NULL, 5, 0) == 5);
+   DEVSHELL_CMD_ASSERT(read(p2[0], buf, sizeof(buf)) == 5);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, "hello", 5));
+   DEVSHELL_CMD_ASSERT(read(p[0], buf, sizeof(buf)) == 6);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, " world", 6));
+
+   /* A pipe cannot be tee-ed to itself */
+   DEVSHELL_CMD_ASSERT(tee(p[0], p[1], 1, 0) < 0 && errno == EINVAL);
+
+   /* SPLICE_F_NONBLOCK on an empty pipe */
+   DEVSHELL_CMD_ASSERT(tee(p[0], p2[1], 1, SPLICE_F_NONBLOCK) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EAGAIN);
+   DEVSHELL_CMD_ASSERT(splice(p[0], 0, p2[1], 0, 1, SPLICE_F_NONBLOCK) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EAGAIN);
+   return 0;
+}
+
+static int vmsplice_pipe(int p[2])
+{
+   struct iovec iov;
+   char buf[16];
+
+   /* A whole page is shared with the pipe, the rest is copied */
+   memset(sp_page, 'A', sizeof(sp_page));
+   iov = (struct iovec) { .iov_base = sp_page, .iov_len = 4096 + 10 };
+   DEVSHELL_CMD_ASSERT(vmsplice(p[1], &iov, 1, 0) == 4096 + 10);
+
+   /* The pipe must see a snapshot of the data */
+   memset(sp_page, 'B', sizeof(sp_page));
+   DEVSHELL_CMD_ASSERT(read(p[0], sp_buf2, sizeof(sp_buf2)) == 4096 + 10);
+
+   for (int i = 0; i < 4096 + 10; i++)
+      DEVSHELL_CMD_ASSERT(sp_buf2[i] == 'A');
+
+   /* vmsplice() on the read end copies to the user buffers */
+   DEVSHELL_CMD_ASSERT(write(p[1], "abc", 3) == 3);
+   iov = (struct iovec) { .iov_base = buf, .iov_len = sizeof(buf) };
+   DEVSHELL_CMD_ASSERT(vmsplice(p[0], &iov, 1, 0) == 3);
+   DEVSHELL_CMD_ASSERT(!memcmp(buf, "abc", 3));
+   return 0;
+}
+
+int cmd_splice(int argc, char **argv)
+{
+   int p[2], p2[2];
+
+   DEVSHELL_CMD_ASSERT(pipe(p) == 0);
+   DEVSHELL_CMD_ASSERT(pipe(p2) == 0);
+
+   DEVSHELL_CMD_ASSERT(splice_files(p) == 0);
+   DEVSHELL_CMD_ASSERT(splice_pipes(p, p2) == 0);
+   DEVSHELL_CMD_ASSERT(vmsplice_pipe(p) == 0);
+
+   close(p2[1]);
+   close(p2[0]);
+   close(p[1]);
+   close(p[0]);
+   return 0;
+}
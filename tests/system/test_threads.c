@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "devshell.h"
+
+#define THREADS_COUNT        4
+#define INCS_PER_THREAD      10000
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static volatile int counter;
+static volatile int ready;
+
+static int futex(int *uaddr, int op, int val, const struct timespec *ts)
+{
+   return syscall(SYS_futex, uaddr, op, val, ts, NULL, 0);
+}
+
+static void *thread_inc(void *arg)
+{
+   for (int i = 0; i < INCS_PER_THREAD; i++) {
+
+      pthread_mutex_lock(&mutex);
+      {
+         counter++;
+
+         if (!(i % 1000))
+            sched_yield(); /* make the other threads contend the mutex */
+      }
+      pthread_mutex_unlock(&mutex);
+   }
+
+   return (void *)(long)syscall(SYS_gettid);
+}
+
+static void *thread_signal_cond(void *arg)
+{
+   usleep(50 * 1000);
+
+   pthread_mutex_lock(&mutex);
+   {
+      ready = 1;
+      pthread_cond_signal(&cond);
+   }
+   pthread_mutex_unlock(&mutex);
+   return NULL;
+}
+
+static void *thread_exit_group(void *arg)
+{
+   usleep(50 * 1000);
+   exit(23);
+}
+
+int cmd_threads(int argc, char **argv)
+{
+   pthread_t threads[THREADS_COUNT];
+   struct timespec ts;
+   int futex_word = 0;
+   int wstatus;
+   pid_t childpid;
+   void *ret;
+
+   /* Mutex contention and join */
+   counter = 0;
+
+   for (int i = 0; i < THREADS_COUNT; i++)
+      DEVSHELL_CMD_ASSERT(!pthread_create(&threads[i], NULL, thread_inc, NULL));
+
+   for (int i = 0; i < THREADS_COUNT; i++) {
+      DEVSHELL_CMD_ASSERT(!pthread_join(threads[i], &ret));
+      DEVSHELL_CMD_ASSERT((long)ret != getpid());
+   }
+
+   DEVSHELL_CMD_ASSERT(counter == THREADS_COUNT * INCS_PER_THREAD);
+
+   /* Condition variable */
+   ready = 0;
+   DEVSHELL_CMD_ASSERT(
+      !pthread_create(&threads[0], NULL, thread_signal_cond, NULL)
+   );
+
+   pthread_mutex_lock(&mutex);
+   {
+      while (!ready)
+         pthread_cond_wait(&cond, &mutex);
+   }
+   pthread_mutex_unlock(&mutex);
+   DEVSHELL_CMD_ASSERT(!pthread_join(threads[0], NULL));
+
+   /* FUTEX_WAIT: value mismatch and timeout */
+   DEVSHELL_CMD_ASSERT(futex(&futex_word, FUTEX_WAIT, 1, NULL) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EAGAIN);
+
+   ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+   DEVSHELL_CMD_ASSERT(futex(&futex_word, FUTEX_WAIT, 0, &ts) < 0);
+   DEVSHELL_CMD_ASSERT(errno == ETIMEDOUT);
+
+   /* FUTEX_WAKE with no waiters */
+   DEVSHELL_CMD_ASSERT(futex(&futex_word, FUTEX_WAKE, 1, NULL) == 0);
+
+   /* exit() from a thread terminates the whole process */
+   DEVSHELL_CMD_ASSERT((childpid = fork()) >= 0);
+
+   if (!childpid) {
+
+      if (pthread_create(&threads[0], NULL, thread_exit_group, NULL))
+         exit(1);
+
+      pause();
+      exit(2);
+   }
+
+   DEVSHELL_CMD_ASSERT(waitpid(childpid, &wstatus, 0) == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 23);
+   return 0;
+}
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+
+#include "devshell.h"
+
+static uint64_t mono_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+int cmd_timerfd(int argc, char **argv)
+{
+   struct itimerspec its, old;
+   struct pollfd pfd;
+   uint64_t val, start;
+   int tfd;
+
+   DEVSHELL_CMD_ASSERT(timerfd_create(CLOCK_MONOTONIC, -1) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EINVAL);
+   DEVSHELL_CMD_ASSERT(timerfd_create(12345, 0) < 0 && errno == EINVAL);
+
+   tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   DEVSHELL_CMD_ASSERT(tfd >= 0);
+
+   /* Disarmed: nothing to read */
+   DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+   DEVSHELL_CMD_ASSERT(timerfd_gettime(tfd, &its) == 0);
+   DEVSHELL_CMD_ASSERT(its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0);
+
+   /* One-shot timer, 50 ms */
+   its = (struct itimerspec) { .it_value = { .tv_nsec = 50 * 1000000 } };
+   start = mono_ms();
+   DEVSHELL_CMD_ASSERT(timerfd_settime(tfd, 0, &its, NULL) == 0);
+   DEVSHELL_CMD_ASSERT(timerfd_gettime(tfd, &its) == 0);
+   DEVSHELL_CMD_ASSERT(its.it_value.tv_nsec > 0);
+
+   pfd = (struct pollfd) { .fd = tfd, .events = POLLIN };
+   DEVSHELL_CMD_ASSERT(poll(&pfd, 1, 1000) == 1);
+   DEVSHELL_CMD_ASSERT(mono_ms() - start >= 50);
+   DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val == 1);
+   DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+   close(tfd);
+
+   /* Periodic timer, every 20 ms, blocking reads */
+   DEVSHELL_CMD_ASSERT((tfd = timerfd_create(CLOCK_REALTIME, 0)) >= 0);
+
+   its = (struct itimerspec) {
+      .it_interval = { .tv_nsec = 20 * 1000000 },
+      .it_value = { .tv_nsec = 20 * 1000000 },
+   };
+
+   start = mono_ms();
+   DEVSHELL_CMD_ASSERT(timerfd_settime(tfd, 0, &its, NULL) == 0);
+
+   for (int i = 0; i < 3; i++) {
+      DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) == sizeof(val));
+      DEVSHELL_CMD_ASSERT(val >= 1);
+   }
+
+   DEVSHELL_CMD_ASSERT(mono_ms() - start >= 60);
+
+   /* Missed expirations are accumulated */
+   usleep(100 * 1000);
+   DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val >= 4);
+
+   /* Disarm it, getting the old value */
+   its = (struct itimerspec) { 0 };
+   DEVSHELL_CMD_ASSERT(timerfd_settime(tfd, 0, &its, &old) == 0);
+   DEVSHELL_CMD_ASSERT(old.it_interval.tv_nsec == 20 * 1000000);
+
+   /* Absolute time in the past: expires immediately */
+   DEVSHELL_CMD_ASSERT(clock_gettime(CLOCK_REALTIME, &its.it_value) == 0);
+   its.it_value.tv_sec--;
+   DEVSHELL_CMD_ASSERT(
+      timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == 0
+   );
+   DEVSHELL_CMD_ASSERT(read(tfd, &val, sizeof(val)) == sizeof(val));
+   DEVSHELL_CMD_ASSERT(val == 1);
+
+   close(tfd);
+   return 0;
+}
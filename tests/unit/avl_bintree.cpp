@@ -417,6 +417,34 @@ TEST(avl_bintree, first_last_obj)
    ASSERT_TRUE(l == &arr[elems - 1]);
 }
 
+TEST(avl_bintree, find_ceil)
+{
+   constexpr const int elems = 32;
+   int_struct arr[elems];
+   int_struct *root = NULL;
+   int_struct *res;
+
+   /* Insert only the even numbers: 0, 2, 4, ... 62 */
+   for (int i = 0; i < elems; i++)
+      arr[i] = int_struct(2 * i);
+
+   for (int i = 0; i < elems; i++)
+      bintree_insert(&root, &arr[i], my_cmpfun, int_struct, node);
+
+   for (int v = -1; v <= 2 * elems; v++) {
+
+      res = (int_struct *)
+         bintree_find_ceil(root, &v, cmpfun_objval, int_struct, node);
+
+      if (v > 2 * (elems - 1)) {
+         ASSERT_TRUE(res == NULL);
+      } else {
+         ASSERT_TRUE(res != NULL);
+         ASSERT_EQ(res->val, v <= 0 ? 0 : v + (v & 1));
+      }
+   }
+}
+
 static void test_insert_rand_data(int iters, int elems, bool slow_checks)
 {
    random_device rdev;
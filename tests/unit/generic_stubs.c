@@ -7,6 +7,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/kmalloc.h>
 
 void hw_read_clock(struct datetime *out)
 {
@@ -32,6 +33,12 @@ void gdt_install() { }
 void idt_install() { }
 void irq_install() { }
 void hw_timer_setup() { }
+void hw_timer_periodic_resume() { }
+int hw_timer_oneshot_start() { return 0; }
+int hw_timer_oneshot_stop() { return 0; }
+bool hw_timer_oneshot_expired() { return false; }
+bool hw_timer_subtick_start() { return false; }
+bool hw_timer_subtick_next() { return false; }
 void irq_install_handler() { }
 void irq_uninstall_handler() { }
 void setup_sysenter_interface() { }
@@ -44,18 +51,26 @@ void set_curr_pdir() { }
 void set_current_task_in_user_mode() { }
 void arch_specific_new_task_setup() { NOT_REACHED(); }
 void arch_specific_free_task() { NOT_REACHED(); }
+void arch_specific_new_thread_setup() { NOT_REACHED(); }
 void arch_specific_new_proc_setup() { NOT_REACHED(); }
 void arch_specific_free_proc() { NOT_REACHED(); }
 void fpu_context_begin() { }
 void fpu_context_end() { }
 void map_zero_pages() { NOT_REACHED(); }
+int map_zero_page() { NOT_REACHED(); return -1; }
+int move_pages() { NOT_REACHED(); return -1; }
 void dump_var_mtrrs() { }
 void set_page_rw() { }
+int get_mapping2() { return -1; }
 void poweroff() { NOT_REACHED(); }
 int get_irq_num(void *ctx) { return -1; }
 int get_int_num(void *ctx) { return -1; }
 void retain_pageframes_mapped_at() { }
 void release_pageframes_mapped_at() { }
+void retain_kernel_page() { }
+void release_kernel_page(void *va) { kfree2(va, 4096); }
+u32 page_ref_count() { return 0; }
+void *user_page_share_cow() { return NULL; }
 bool irq_is_masked() { NOT_REACHED(); return false; }
 
 void *hi_vmem_reserve(size_t size) { return NULL; }
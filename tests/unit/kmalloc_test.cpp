@@ -21,6 +21,7 @@ extern "C" {
    #include <tilck/common/utils.h>
 
    #include <tilck/kernel/kmalloc.h>
+   #include <tilck/kernel/kmem_cache.h>
    #include <tilck/kernel/paging.h>
    #include <tilck/kernel/self_tests.h>
 
@@ -99,7 +100,8 @@ void check_heaps_metadata(unique_ptr<u8[]> *meta_before)
 }
 
 void kmalloc_chaos_test_sub(default_random_engine &eng,
-                            lognormal_distribution<> &dist)
+                            lognormal_distribution<> &dist,
+                            bool pass_size = true)
 {
    vector<pair<void *, size_t>> allocations;
 
@@ -118,7 +120,7 @@ void kmalloc_chaos_test_sub(default_random_engine &eng,
    }
 
    for (const auto& e : allocations) {
-      kfree2(e.first, e.second);
+      kfree2(e.first, pass_size ? e.second : 0);
    }
 }
 
@@ -181,6 +183,37 @@ TEST_F(kmalloc_test, chaos_test)
    }
 }
 
+TEST_F(kmalloc_test, chaos_test_kfree_without_size)
+{
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine e(seed);
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   lognormal_distribution<> dist(5.0, 3);
+
+   unique_ptr<u8[]> meta_before[KMALLOC_HEAPS_COUNT];
+
+   for (int h = 0; h < KMALLOC_HEAPS_COUNT && heaps[h]; h++) {
+      u8 *buf = new u8[heaps[h]->metadata_size];
+      memset(buf, 0, heaps[h]->metadata_size);
+      meta_before[h].reset(buf);
+   }
+
+   for (int i = 0; i < 50; i++) {
+
+      save_heaps_metadata(meta_before);
+
+      ASSERT_NO_FATAL_FAILURE({
+         kmalloc_chaos_test_sub(e, dist, false);
+      }) << "i: " << i;
+
+      ASSERT_NO_FATAL_FAILURE({
+         check_heaps_metadata(meta_before);
+      }) << "i: " << i;
+   }
+}
+
 #define COLOR_RED           "\033[31m"
 #define COLOR_YELLOW        "\033[93m"
 #define COLOR_BRIGHT_GREEN  "\033[92m"
@@ -808,3 +841,62 @@ TEST_F(kmalloc_test, partial_free)
 
    kmalloc_destroy_heap(&h);
 }
+
+struct test_obj {
+   int magic;
+   char data[96];
+};
+
+static void test_obj_ctor(void *obj)
+{
+   ((struct test_obj *)obj)->magic = 1234;
+}
+
+TEST_F(kmalloc_test, kmem_cache)
+{
+   struct kmem_cache c =
+      KMEM_CACHE_INIT("test", sizeof(struct test_obj), &test_obj_ctor);
+
+   struct debug_kmem_cache_info ci;
+   vector<struct test_obj *> objs;
+   unordered_map<void *, bool> seen;
+
+   for (int i = 0; i < 200; i++) {
+
+      struct test_obj *obj = (struct test_obj *)kmem_cache_zalloc(&c);
+
+      ASSERT_TRUE(obj != NULL);
+      ASSERT_EQ((ulong)obj & (c.elem_size - 1), 0u);
+      ASSERT_EQ(obj->magic, 1234);
+      ASSERT_EQ(obj->data[0], 0);
+      ASSERT_FALSE(seen[obj]);
+
+      seen[obj] = true;
+      memset(obj->data, 0xaa, sizeof(obj->data));
+      objs.push_back(obj);
+   }
+
+   ASSERT_TRUE(debug_kmem_cache_get_info(0, &ci));
+   EXPECT_STREQ(ci.name, "test");
+   EXPECT_EQ(ci.elem_size, 128u);
+   EXPECT_EQ(ci.active, 200u);
+   EXPECT_EQ(ci.peak_active, 200u);
+   EXPECT_EQ(ci.refills, (200u + ci.batch - 1) / ci.batch);
+   EXPECT_FALSE(debug_kmem_cache_get_info(1, &ci));
+
+   for (auto obj : objs)
+      kmem_cache_free(&c, obj);
+
+   ASSERT_TRUE(debug_kmem_cache_get_info(0, &ci));
+   EXPECT_EQ(ci.active, 0u);
+   EXPECT_EQ(ci.frees, 200u);
+   EXPECT_EQ(ci.free_count, MIN(200u, 2 * ci.batch));
+
+   /* The cached objects are recycled, starting from the last one freed */
+   struct test_obj *last = objs[ci.free_count - 1];
+   EXPECT_EQ(kmem_cache_alloc(&c), (void *)last);
+   kmem_cache_free(&c, last);
+
+   kmem_cache_destroy(&c);
+   EXPECT_FALSE(debug_kmem_cache_get_info(0, &ci));
+}
@@ -26,6 +26,7 @@ extern "C" {
 #include <tilck/kernel/test/kmalloc.h>
 
 extern bool suppress_printk;
+extern u32 __mem_upper_kb;
 
 void *base_va = nullptr;
 static unordered_map<ulong, ulong> mappings;
@@ -50,6 +51,8 @@ void initialize_test_kernel_heap()
       .type = MULTIBOOT_MEMORY_AVAILABLE,
       .extra = 0,
    };
+
+   __mem_upper_kb = test_mem_size / KB;
 }
 
 void init_kmalloc_for_tests()
@@ -60,10 +63,12 @@ void init_kmalloc_for_tests()
    bzero(&used_heaps, sizeof(used_heaps));
    bzero(&max_tot_heap_mem_free, sizeof(max_tot_heap_mem_free));
 
+   page_alloc_reset();
    initialize_test_kernel_heap();
    suppress_printk = true;
    early_init_kmalloc();
    init_kmalloc();
+   kmem_cache_reset_all();
    suppress_printk = false;
 }
 
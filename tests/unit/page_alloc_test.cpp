@@ -0,0 +1,269 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <random>
+
+#include <gtest/gtest.h>
+#include "kernel_init_funcs.h"
+
+extern "C" {
+
+   #include <tilck/kernel/kmalloc.h>
+   #include <tilck/kernel/page_alloc.h>
+   #include <tilck/kernel/paging.h>
+   #include <tilck/kernel/test/kmalloc.h>
+   #include <kernel/kmalloc/kmalloc_heap_struct.h> // kmalloc private header
+}
+
+using namespace std;
+using namespace testing;
+
+#define CHUNK_PAGES             (1u << PG_ALLOC_MAX_ORDER)
+#define CHUNK_SIZE              (PAGE_SIZE << PG_ALLOC_MAX_ORDER)
+
+static char *page_n(void *base, u32 n)
+{
+   return (char *)base + n * PAGE_SIZE;
+}
+
+static bool in_first_heap(void *p)
+{
+   size_t size;
+   char *heap = (char *)kmalloc_get_first_heap(&size);
+   return (char *)p >= heap && (char *)p < heap + size;
+}
+
+class page_alloc_test : public Test {
+
+   vector<void *> reserved;
+
+   void SetUp() override {
+
+      void *p;
+
+      init_kmalloc_for_tests();
+      init_page_alloc();
+
+      /*
+       * In the unit tests, the first kmalloc heap is allocated with glibc's
+       * aligned_alloc(), outside of the fake linear mapping: page_alloc cannot
+       * use chunks from there and would fall back to kmalloc() until the first
+       * heap is full. Fill it in advance, in order to test the buddy allocator
+       * from the first allocation.
+       */
+      while ((p = aligned_kmalloc(CHUNK_SIZE, CHUNK_SIZE))) {
+
+         if (!in_first_heap(p)) {
+            aligned_kfree2(p, CHUNK_SIZE);
+            break;
+         }
+
+         reserved.push_back(p);
+      }
+   }
+
+   void TearDown() override {
+
+      for (auto p : reserved)
+         aligned_kfree2(p, CHUNK_SIZE);
+
+      reserved.clear();
+   }
+};
+
+TEST_F(page_alloc_test, alignment)
+{
+   vector<pair<void *, u32>> blocks;
+
+   for (int i = 0; i < 4; i++) {
+      for (u32 order = 0; order <= PG_ALLOC_MAX_ORDER; order++) {
+
+         void *p = kalloc_pages(order);
+
+         ASSERT_TRUE(p != NULL);
+         ASSERT_EQ((ulong)p & ((PAGE_SIZE << order) - 1), 0u) << order;
+         blocks.push_back(make_pair(p, order));
+      }
+   }
+
+   for (const auto &b : blocks)
+      kfree_pages(b.first, b.second);
+}
+
+TEST_F(page_alloc_test, split_and_merge)
+{
+   void *a, *b, *c, *d, *e;
+
+   ASSERT_EQ(page_alloc_get_free_pages(), 0u);
+
+   /* The first allocation borrows a chunk from kmalloc and splits it */
+   a = kalloc_pages(0);
+   ASSERT_TRUE(a != NULL);
+   ASSERT_EQ((ulong)a & (CHUNK_SIZE - 1), 0u);
+   EXPECT_EQ(page_alloc_get_free_pages(), CHUNK_PAGES - 1);
+
+   /* The upper halves are handed out in order of size */
+   b = kalloc_pages(0);
+   c = kalloc_pages(1);
+   d = kalloc_pages(2);
+   e = kalloc_pages(3);
+
+   EXPECT_EQ(b, page_n(a, 1));
+   EXPECT_EQ(c, page_n(a, 2));
+   EXPECT_EQ(d, page_n(a, 4));
+   EXPECT_EQ(e, page_n(a, 8));
+   EXPECT_EQ(page_alloc_get_free_pages(), 0u);
+
+   /* `a` cannot be merged with `b`, which is still allocated */
+   kfree_pages(a, 0);
+   EXPECT_EQ(page_alloc_get_free_pages(), 1u);
+   EXPECT_EQ(kalloc_pages(0), a);
+   kfree_pages(a, 0);
+
+   /* Freeing the buddies in any order gives back the whole chunk */
+   kfree_pages(d, 2);
+   kfree_pages(b, 0);
+   kfree_pages(e, 3);
+   kfree_pages(c, 1);
+   EXPECT_EQ(page_alloc_get_free_pages(), CHUNK_PAGES);
+
+   /* The chunk is not split anymore: it can be allocated as a whole */
+   EXPECT_EQ(kalloc_pages(PG_ALLOC_MAX_ORDER), a);
+   EXPECT_EQ(page_alloc_get_free_pages(), 0u);
+   kfree_pages(a, PG_ALLOC_MAX_ORDER);
+}
+
+TEST_F(page_alloc_test, chaos)
+{
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine e(seed);
+   uniform_int_distribution<u32> order_dist(0, PG_ALLOC_MAX_ORDER);
+   bernoulli_distribution free_dist(0.5);
+   vector<pair<char *, u32>> blocks;
+   unordered_map<ulong, bool> used;
+   size_t free_pages;
+
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   for (int iter = 0; iter < 20; iter++) {
+
+      for (int i = 0; i < 200; i++) {
+
+         const u32 order = order_dist(e);
+         char *p = (char *)kalloc_pages(order);
+
+         ASSERT_TRUE(p != NULL);
+         ASSERT_EQ((ulong)p & ((PAGE_SIZE << order) - 1), 0u);
+
+         /* No page can be handed out twice */
+         for (u32 j = 0; j < (1u << order); j++) {
+            ASSERT_FALSE(used[(ulong)page_n(p, j)]);
+            used[(ulong)page_n(p, j)] = true;
+         }
+
+         memset(p, (int)order, PAGE_SIZE << order);
+         blocks.push_back(make_pair(p, order));
+      }
+
+      /* Free about half of the blocks, checking their contents */
+      for (size_t i = 0; i < blocks.size(); i++) {
+
+         char *p = blocks[i].first;
+         const u32 order = blocks[i].second;
+
+         if (free_dist(e))
+            continue;
+
+         for (u32 j = 0; j < (PAGE_SIZE << order); j += PAGE_SIZE / 4)
+            ASSERT_EQ(p[j], (char)order);
+
+         for (u32 j = 0; j < (1u << order); j++)
+            used[(ulong)page_n(p, j)] = false;
+
+         kfree_pages(p, order);
+         blocks[i] = blocks.back();
+         blocks.pop_back();
+         i--;
+      }
+   }
+
+   for (const auto &b : blocks)
+      kfree_pages(b.first, b.second);
+
+   blocks.clear();
+
+   /* Everything got merged back into whole chunks */
+   free_pages = page_alloc_get_free_pages();
+   EXPECT_EQ(free_pages % CHUNK_PAGES, 0u);
+
+   for (size_t i = 0; i < free_pages / CHUNK_PAGES; i++) {
+      void *p = kalloc_pages(PG_ALLOC_MAX_ORDER);
+      ASSERT_TRUE(p != NULL);
+      blocks.push_back(make_pair((char *)p, PG_ALLOC_MAX_ORDER));
+   }
+
+   EXPECT_EQ(page_alloc_get_free_pages(), 0u);
+
+   for (const auto &b : blocks)
+      kfree_pages(b.first, b.second);
+}
+
+TEST_F(page_alloc_test, exhaustion)
+{
+   vector<void *> chunks, pages;
+   void *p;
+
+   /* Take all the memory available in kmalloc's heaps, chunk by chunk */
+   while ((p = kalloc_pages(PG_ALLOC_MAX_ORDER))) {
+      ASSERT_EQ((ulong)p & (CHUNK_SIZE - 1), 0u);
+      chunks.push_back(p);
+   }
+
+   ASSERT_GT(chunks.size(), 0u);
+   EXPECT_EQ(page_alloc_get_free_pages(), 0u);
+
+   /* Single pages might still come from the kmalloc() fallback */
+   while ((p = kalloc_pages(0)))
+      pages.push_back(p);
+
+   /* A freed chunk gets split to serve single pages again */
+   p = chunks.back();
+   chunks.pop_back();
+   kfree_pages(p, PG_ALLOC_MAX_ORDER);
+   EXPECT_EQ(page_alloc_get_free_pages(), CHUNK_PAGES);
+
+   for (u32 i = 0; i < CHUNK_PAGES; i++) {
+      void *pg = kalloc_pages(0);
+      ASSERT_EQ(pg, page_n(p, i));
+      pages.push_back(pg);
+   }
+
+   EXPECT_EQ(kalloc_pages(0), (void *)NULL);
+
+   for (auto pg : pages)
+      kfree_pages(pg, 0);
+
+   for (auto c : chunks)
+      kfree_pages(c, PG_ALLOC_MAX_ORDER);
+
+   /* Nothing got lost: the same number of chunks can be allocated again */
+   const size_t count = chunks.size() + 1;
+   chunks.clear();
+
+   while ((p = kalloc_pages(PG_ALLOC_MAX_ORDER)))
+      chunks.push_back(p);
+
+   EXPECT_EQ(chunks.size(), count);
+
+   for (auto c : chunks)
+      kfree_pages(c, PG_ALLOC_MAX_ORDER);
+}